@@ -6,777 +6,1141 @@
 
 #include <cvrUtil/MultiListenSocket.h>
 #include <cvrUtil/CVRSocket.h>
+#include <cvrCollaborative/CollaborativeDelta.h>
 
 #include <osg/ArgumentParser>
 
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 
-#ifdef WIN32
+#ifndef WIN32
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <winsock2.h>
+#define poll WSAPoll
 #pragma comment(lib, "wsock32.lib")
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#define COLLAB_USE_EPOLL
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 using namespace cvr;
 
+namespace
+{
+
+// limits on client supplied sizes, a client past these is dropped
+const int MAX_CLIENT_MESSAGES = 4096;
+const int MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+// an update and its messages must fit in the input buffer
+const int MAX_INPUT_SIZE = 2 * MAX_MESSAGE_SIZE;
+// data queued for a client that is not reading it
+const int MAX_OUTPUT_SIZE = 4 * MAX_MESSAGE_SIZE;
+
+const int MAX_EVENTS = 256;
+const int MAX_IOVECS = 64;
+const int READ_SIZE = 64 * 1024;
+
+}
+
 CollaborativeServer::CollaborativeServer(int port)
 {
     _port = port;
     _masterID = -1;
     _currentMode = UNLOCKED;
+    _nextID = 0;
+    _tick = 0;
+    _epollFD = -1;
+    _snapshot = NULL;
+    _listenSocket = NULL;
 }
 
 CollaborativeServer::~CollaborativeServer()
 {
+    while(_clients.size())
+    {
+        Client * client = _clients.begin()->second;
+        client->active = false;
+        removeClient(client);
+    }
+
+    if(_listenSocket)
+    {
+        delete _listenSocket;
+    }
+
+#ifdef COLLAB_USE_EPOLL
+    if(_epollFD >= 0)
+    {
+        close(_epollFD);
+    }
+#endif
 }
 
 bool CollaborativeServer::init()
 {
-    _listenSocket = new cvr::MultiListenSocket(_port);
-    if(_listenSocket->setup())
+    _listenSocket = new cvr::MultiListenSocket(_port,SOMAXCONN);
+    if(!_listenSocket->setup())
     {
-        std::cerr << "Socket setup ok." << std::endl;
-        return true;
+        std::cerr << "Socket setup failure." << std::endl;
+        return false;
     }
-    else
+
+#ifdef COLLAB_USE_EPOLL
+    _epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if(_epollFD < 0)
     {
-        std::cerr << "Socket setup failure." << std::endl;
+        perror("epoll_create1");
         return false;
     }
+
+    // the listen socket is the only entry without a client
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if(epoll_ctl(_epollFD,EPOLL_CTL_ADD,_listenSocket->getSocketFD(),&event)
+            < 0)
+    {
+        perror("epoll_ctl");
+        return false;
+    }
+#endif
+
+    std::cerr << "Socket setup ok." << std::endl;
+    return true;
 }
 
 void CollaborativeServer::run()
 {
-    int socketid = 0;
-
 #ifndef WIN32
     signal(SIGPIPE,SIG_IGN);
 #endif
 
+    std::vector<ReadyEvent> events;
+
     while(1)
     {
-        //std::cerr << "Checking for waiting connection." << std::endl;
-        cvr::CVRSocket * con;
-        if((con = _listenSocket->accept()))
+        if(!waitEvents(events))
         {
-            std::cerr << "Found connection." << std::endl;
-            con->setNoDelay(true);
-            initConnection(socketid,con);
-            socketid++;
+            return;
         }
-        //sleep(5);
-        checkSockets();
-    }
-}
 
-void CollaborativeServer::initConnection(int id, CVRSocket * sock)
-{
-    if(!sock->send(&id,sizeof(int)))
-    {
-        delete sock;
-        return;
-    }
-    /*int namesize;
-     if(!sock->recv(&namesize,sizeof(int)))
-     {
-     delete sock;
-     return;
-     }
-     std::cerr << "Got name size: " << namesize << std::endl;
-     char name[255];
-     if(!sock->recv(name,namesize))
-     {
-     delete sock;
-     return;
-     }*/
+        _tick++;
 
-    ClientInitInfo cii;
-    if(!sock->recv(&cii,sizeof(struct ClientInitInfo)))
-    {
-        delete sock;
-        return;
-    }
+        for(int i = 0; i < (int)events.size(); i++)
+        {
+            Client * client = events[i].client;
+            if(!client)
+            {
+                acceptClients();
+                continue;
+            }
 
-    std::cerr << "Got name: " << cii.name << " numHands: " << cii.numHands
-            << " numHeads: " << cii.numHeads << std::endl;
+            if(client->closed)
+            {
+                continue;
+            }
 
-    _serverLock.lock();
+            if(events[i].read)
+            {
+                if(!readClient(client))
+                {
+                    client->closed = true;
+                    continue;
+                }
+            }
 
-    ServerInitInfo sii;
-    sii.numUsers = _clientInitMap.size();
-
-    ClientInitInfo * activeClients = NULL;
-
-    if(sii.numUsers)
-    {
-        activeClients = new ClientInitInfo[sii.numUsers];
-        int acindex = 0;
-        for(std::map<int,struct ClientInitInfo>::iterator it =
-                _clientInitMap.begin(); it != _clientInitMap.end(); it++)
-        {
-            activeClients[acindex] = it->second;
-            std::cerr << "Adding client init info to send name: "
-                    << activeClients[acindex].name << " id: "
-                    << activeClients[acindex].id << " heads: "
-                    << activeClients[acindex].numHeads << " hands: "
-                    << activeClients[acindex].numHands << std::endl;
-            acindex++;
-        }
-    }
-
-    // send other users' id and and name size
-    /*int index = 0;
-     int totalsize = 0;
-     int * userinfo = NULL;
-     char * usernames = NULL;
-     if(sii.numUsers)
-     {
-     userinfo = new int[sii.numUsers * 2];
-     for(std::map<int, std::string>::iterator it = _nameMap.begin(); it != _nameMap.end(); it++)
-     {
-     userinfo[index++] = it->first;
-     userinfo[index++] = it->second.size()+1;
-     totalsize += it->second.size()+1;
-     }
-     usernames = new char[totalsize];
-     index = 0;
-     for(int i = 0; i < _nameMap.size(); i++)
-     {
-     strcpy(usernames + index, _nameMap[userinfo[i*2]].c_str());
-     index += userinfo[(i*2)+1];
-     }
-     }*/
-
-    _serverLock.unlock();
-
-    if(!sock->send(&sii,sizeof(struct ServerInitInfo)))
-    {
-        delete sock;
-        return;
-    }
+            if(events[i].write)
+            {
+                if(!flushClient(client))
+                {
+                    client->closed = true;
+                }
+            }
+        }
 
-    if(sii.numUsers)
-    {
-        /*if(!sock->send(userinfo,sizeof(int)*sii.numUsers*2))
-         {
-         delete[] userinfo;
-         delete[] usernames;
-         delete sock;
-         return;
-         }
+        // answer all updates from this pass with one snapshot
+        for(std::map<int,Client*>::iterator it = _clients.begin();
+                it != _clients.end(); it++)
+        {
+            Client * client = it->second;
+            if(client->closed || !client->repliesPending)
+            {
+                continue;
+            }
 
-         if(!sock->send(usernames,sizeof(char)*totalsize))
-         {
-         delete[] userinfo;
-         delete[] usernames;
-         delete sock;
-         return;
-         }
+            if(!_snapshot)
+            {
+                buildSnapshot();
+            }
 
-         delete[] userinfo;
-         delete[] usernames;*/
+            for(; client->repliesPending && !client->closed;
+                    client->repliesPending--)
+            {
+                queueReply(client);
+            }
+        }
 
-        if(!sock->send(activeClients,
-                sizeof(struct ClientInitInfo) * sii.numUsers))
+        if(_snapshot)
         {
-            delete[] activeClients;
-            delete sock;
-            return;
+            _snapshot->unref();
+            _snapshot = NULL;
         }
 
-        delete[] activeClients;
-    }
-
-    ClientUpdate * cu = &_clientMap[id];
-    memset(cu,0,sizeof(struct ClientUpdate));
-    cu->objScale = 1.0;
-    cu->objTrans[0] = cu->objTrans[5] = cu->objTrans[10] = cu->objTrans[15] =
-            1.0;
-    cu->numMes = id;
+        std::vector<Client*> removeList;
+        for(std::map<int,Client*>::iterator it = _clients.begin();
+                it != _clients.end(); it++)
+        {
+            Client * client = it->second;
+            if(!client->closed && client->output.size()
+                    && !flushClient(client))
+            {
+                client->closed = true;
+            }
 
-    cii.id = id;
-    _clientInitMap[id] = cii;
+            if(client->closed)
+            {
+                removeList.push_back(client);
+            }
+            else
+            {
+                updateEvents(client);
+            }
+        }
 
-    _clientHeadList[id] = std::vector<BodyUpdate>();
-    _clientHandList[id] = std::vector<BodyUpdate>();
+        for(int i = 0; i < removeList.size(); i++)
+        {
+            removeClient(removeList[i]);
+        }
+    }
+}
 
-    BodyUpdate bu;
-    bu.pos[0] = bu.pos[1] = bu.pos[2] = 0.0;
-    bu.rot[0] = bu.rot[1] = bu.rot[2] = 0.0;
-    bu.rot[3] = 1.0;
+bool CollaborativeServer::waitEvents(std::vector<ReadyEvent> & events)
+{
+    events.clear();
 
-    for(int i = 0; i < cii.numHeads; i++)
+#ifdef COLLAB_USE_EPOLL
+    struct epoll_event epollEvents[MAX_EVENTS];
+    int numEvents;
+    do
     {
-        _clientHeadList[id].push_back(bu);
+        numEvents = epoll_wait(_epollFD,epollEvents,MAX_EVENTS,-1);
     }
+    while(numEvents < 0 && errno == EINTR);
 
-    for(int i = 0; i < cii.numHands; i++)
+    if(numEvents < 0)
     {
-        _clientHandList[id].push_back(bu);
+        perror("epoll_wait");
+        return false;
     }
 
-    if(_threadList.size())
+    for(int i = 0; i < numEvents; i++)
     {
+        ReadyEvent event;
+        event.client = (Client*)epollEvents[i].data.ptr;
+        event.read = (epollEvents[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                != 0;
+        event.write = (epollEvents[i].events & EPOLLOUT) != 0;
+        events.push_back(event);
+    }
+#else
+    // poll has no registered set, the list is made from the clients each pass
+    std::vector<struct pollfd> fds;
+    std::vector<Client*> fdClients;
+
+    struct pollfd pfd;
+    pfd.fd = _listenSocket->getSocketFD();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    fds.push_back(pfd);
+    fdClients.push_back(NULL);
+
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
+    {
+        pfd.fd = it->second->socket->getSocketFD();
+        pfd.events = POLLIN | (it->second->writeWait ? POLLOUT : 0);
+        fds.push_back(pfd);
+        fdClients.push_back(it->second);
+    }
 
-        /*int msize = strlen(cii.name) + 1;
-         msize += sizeof(int);
-         char * mdata = new char[msize];
-
-         *((int *)mdata) = id;
-         strcpy(mdata+sizeof(int), cii.name);*/
-        ClientInitInfo * newcii = new ClientInitInfo;
-        *newcii = cii;
-
-        CollaborativeMessageHeader cmh;
-        cmh.type = ADD_CLIENT;
-        strcpy(cmh.target,"Collaborative");
-        cmh.size = sizeof(struct ClientInitInfo);
-
-        CollaborativeMessage * cmessage = new CollaborativeMessage(
-                _threadList.size(),cmh,(char*)newcii);
+    int numEvents;
+    do
+    {
+        numEvents = poll(&fds[0],fds.size(),-1);
+    }
+    while(numEvents < 0 && errno == EINTR);
 
-        _messageAddLock.lock();
+    if(numEvents < 0)
+    {
+        perror("poll");
+        return false;
+    }
 
-        for(int i = 0; i < _threadList.size(); i++)
+    for(int i = 0; i < (int)fds.size(); i++)
+    {
+        if(!fds[i].revents)
         {
-            _threadList[i]->addMessage(cmessage);
+            continue;
         }
 
-        _messageAddLock.unlock();
-
+        ReadyEvent event;
+        event.client = fdClients[i];
+        event.read = (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+        event.write = (fds[i].revents & POLLOUT) != 0;
+        events.push_back(event);
     }
+#endif
 
-    SocketThread * st;
-    st = new SocketThread(sock,cii.name,id,this);
-
-    _serverLock.lock();
-
-    _threadList.push_back(st);
-
-    _serverLock.unlock();
-
-    st->start();
-    std::cerr << "Added socket from host: " << cii.name << std::endl;
+    return true;
 }
 
-void CollaborativeServer::checkSockets()
+bool CollaborativeServer::watchClient(Client * client)
 {
-    if(!_threadList.size())
+#ifdef COLLAB_USE_EPOLL
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    if(epoll_ctl(_epollFD,EPOLL_CTL_ADD,client->socket->getSocketFD(),&event)
+            < 0)
     {
-        return;
+        perror("epoll_ctl");
+        return false;
     }
+#endif
+    return true;
+}
 
-    for(std::vector<SocketThread*>::iterator it = _threadList.begin();
-            it != _threadList.end();)
+void CollaborativeServer::acceptClients()
+{
+    cvr::CVRSocket * con;
+    while((con = _listenSocket->accept()))
     {
-        if(!(*it)->isRunning())
+        con->setBlocking(false);
+        con->setNoDelay(true);
+
+        Client * client = new Client;
+        client->socket = con;
+        client->id = _nextID++;
+        client->active = false;
+        client->closed = false;
+        client->writeWait = false;
+        client->repliesPending = 0;
+        client->protocol = 1;
+        client->updateVersion = 0;
+        client->input.resize(READ_SIZE);
+        client->inputSize = 0;
+        client->outputOffset = 0;
+        client->outputSize = 0;
+        client->messageSize = 0;
+        memset(&client->initInfo,0,sizeof(struct ClientInitInfo));
+        memset(&client->update,0,sizeof(struct ClientUpdate));
+
+        if(!watchClient(client))
         {
-            std::cerr << "Removing client " << (*it)->getName() << std::endl;
-            _serverLock.lock();
+            delete con;
+            delete client;
+            continue;
+        }
 
-            int * cid = new int[1];
-            cid[0] = (*it)->getID();
+        _clients[client->id] = client;
 
-            CollaborativeMessageHeader cmh;
-            cmh.type = REMOVE_CLIENT;
-            strcpy(cmh.target,"Collaborative");
-            cmh.size = sizeof(int);
+        std::cerr << "Found connection." << std::endl;
 
-            CollaborativeMessage * cmessage = new CollaborativeMessage(
-                    _threadList.size(),cmh,(char*)cid);
+        OutputBuffer * ob = new OutputBuffer();
+        ob->append(&client->id,sizeof(int));
+        queueOutput(client,ob,&ob->_data[0],ob->_data.size());
+    }
+}
 
-            _messageAddLock.lock();
+bool CollaborativeServer::readClient(Client * client)
+{
+    // anything past the limit is left for the next pass
+    while(client->inputSize < MAX_INPUT_SIZE)
+    {
+        if(client->inputSize == (int)client->input.size())
+        {
+            client->input.resize(
+                    std::min((int)client->input.size() * 2,MAX_INPUT_SIZE));
+        }
 
-            for(int i = 0; i < _threadList.size(); i++)
-            {
-                _threadList[i]->addMessage(cmessage);
-            }
+        SocketBuffer buffer;
+        buffer.data = &client->input[client->inputSize];
+        buffer.len = client->input.size() - client->inputSize;
+        int bytes = client->socket->tryRecvv(&buffer,1);
+        if(bytes < 0)
+        {
+            return false;
+        }
+        if(bytes == 0)
+        {
+            break;
+        }
+        client->inputSize += bytes;
+    }
 
-            _messageAddLock.unlock();
+    int offset = 0;
+    while(offset < client->inputSize)
+    {
+        int used;
+        if(client->active)
+        {
+            used = parseUpdate(client,&client->input[offset],
+                    client->inputSize - offset);
+        }
+        else
+        {
+            used = parseInit(client,&client->input[offset],
+                    client->inputSize - offset);
+        }
 
-            _clientMap.erase((*it)->getID());
-            _clientInitMap.erase((*it)->getID());
-            if(_currentMode == LOCKED)
-            {
-                if(_masterID == (*it)->getID())
-                {
-                    _currentMode = UNLOCKED;
-                    _masterID = -1;
-                }
-            }
+        if(used < 0)
+        {
+            return false;
+        }
+        if(!used)
+        {
+            break;
+        }
+        offset += used;
+    }
 
-            delete (*it);
+    if(offset)
+    {
+        memmove(&client->input[0],&client->input[offset],
+                client->inputSize - offset);
+        client->inputSize -= offset;
+    }
 
-            it = _threadList.erase(it);
+    if(client->inputSize == MAX_INPUT_SIZE)
+    {
+        std::cerr << "Client " << client->initInfo.name
+                << " sent an update over " << MAX_INPUT_SIZE
+                << " bytes, disconnecting." << std::endl;
+        return false;
+    }
 
-            _serverLock.unlock();
-            continue;
-        }
-        it++;
+    // let a large message buffer go once it is used
+    if(!client->inputSize && client->input.size() > READ_SIZE)
+    {
+        std::vector<char>(READ_SIZE).swap(client->input);
     }
-}
 
-SocketThread::SocketThread(CVRSocket * socket, std::string name, int id,
-        CollaborativeServer * server)
-{
-    _socket = socket;
-    _name = name;
-    _id = id;
-    _quit = false;
-    _server = server;
+    return true;
 }
 
-SocketThread::~SocketThread()
+int CollaborativeServer::parseInit(Client * client, const char * data,
+        int size)
 {
-    if(_socket)
+    if(size < sizeof(struct ClientInitInfo))
     {
-        delete _socket;
+        return 0;
     }
 
-    quit();
-    join();
+    ClientInitInfo cii;
+    memcpy(&cii,data,sizeof(struct ClientInitInfo));
+    cii.name[255] = '\0';
+    if(cii.numHeads < 0 || cii.numHands < 0)
+    {
+        return -1;
+    }
 
-    queueCleanup(_messageQueue);
-}
+    std::cerr << "Got name: " << cii.name << " numHands: " << cii.numHands
+            << " numHeads: " << cii.numHeads << std::endl;
 
-void SocketThread::run()
-{
-    while(1)
+    // clients that support delta updates mark the id field with the highest
+    // version they know, answer with the version used
+    int protocol = 1;
+    if((cii.id & COLLAB_PROTOCOL_MAGIC_MASK) == COLLAB_PROTOCOL_MAGIC)
     {
-        _quitLock.lock();
-        if(_quit)
+        protocol = cii.id & ~COLLAB_PROTOCOL_MAGIC_MASK;
+        if(protocol > COLLAB_PROTOCOL_DELTA)
         {
-            return;
+            protocol = COLLAB_PROTOCOL_DELTA;
+        }
+        else if(protocol < 1)
+        {
+            protocol = 1;
         }
-        _quitLock.unlock();
+    }
+    client->protocol = protocol;
+
+    OutputBuffer * ob = new OutputBuffer();
+    if(protocol > 1)
+    {
+        int accepted = -protocol;
+        ob->append(&accepted,sizeof(int));
+    }
 
-        if(!checkSocket())
+    ServerInitInfo sii;
+    sii.numUsers = getNumActive();
+    ob->append(&sii,sizeof(struct ServerInitInfo));
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
+    {
+        if(it->second->active)
         {
-            return;
+            ob->append(&it->second->initInfo,sizeof(struct ClientInitInfo));
         }
     }
-}
+    queueOutput(client,ob,&ob->_data[0],ob->_data.size());
 
-void SocketThread::quit()
-{
-    _quitLock.lock();
-    _quit = true;
-    _quitLock.unlock();
-}
+    cii.id = client->id;
+    client->initInfo = cii;
 
-void SocketThread::addMessage(CollaborativeMessage * message)
-{
-    _messageLock.lock();
+    client->update.objScale = 1.0;
+    client->update.objTrans[0] = client->update.objTrans[5] =
+            client->update.objTrans[10] = client->update.objTrans[15] = 1.0;
+    client->update.numMes = client->id;
 
-    _messageQueue.push(message);
+    BodyUpdate bu;
+    bu.pos[0] = bu.pos[1] = bu.pos[2] = 0.0;
+    bu.rot[0] = bu.rot[1] = bu.rot[2] = 0.0;
+    bu.rot[3] = 1.0;
+    client->bodies.resize(cii.numHeads + cii.numHands,bu);
+    packBodies(client);
+    client->updateVersion = _tick;
 
-    _messageLock.unlock();
-}
+    if(getNumActive())
+    {
+        ClientInitInfo * newcii = new ClientInitInfo;
+        *newcii = cii;
+        addMessage(new CollaborativeMessage(ADD_CLIENT,"Collaborative",
+                sizeof(struct ClientInitInfo),(char*)newcii),NULL);
+    }
 
-std::string SocketThread::getName()
-{
-    return _name;
-}
+    client->active = true;
 
-int SocketThread::getID()
-{
-    return _id;
+    std::cerr << "Added socket from host: " << cii.name << " protocol: "
+            << protocol << std::endl;
+
+    return sizeof(struct ClientInitInfo);
 }
 
-bool SocketThread::checkSocket()
+int CollaborativeServer::parseUpdate(Client * client, const char * data,
+        int size)
 {
-    fd_set socketsetR;
-    FD_ZERO(&socketsetR);
-    FD_SET((unsigned int)_socket->getSocketFD(),&socketsetR);
+    if(client->protocol >= COLLAB_PROTOCOL_DELTA)
+    {
+        return parseDeltaUpdate(client,data,size);
+    }
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 500;
+    // an update is only used once all of it has arrived
+    int needed = sizeof(struct ClientUpdate)
+            + client->bodies.size() * sizeof(struct BodyUpdate);
+    if(size < needed)
+    {
+        return 0;
+    }
 
-    select(_socket->getSocketFD() + 1,&socketsetR,NULL,NULL,&tv);
+    ClientUpdate cu;
+    memcpy(&cu,data,sizeof(struct ClientUpdate));
+    if(cu.numMes < 0 || cu.numMes > MAX_CLIENT_MESSAGES)
+    {
+        return -1;
+    }
 
-    if(FD_ISSET(_socket->getSocketFD(),&socketsetR))
+    if(cu.numMes)
     {
-        return processEvents();
+        int used = parseMessages(client,data + needed,size - needed,
+                cu.numMes);
+        if(used <= 0)
+        {
+            return used;
+        }
+        needed += used;
     }
 
-    return true;
+    if(client->bodies.size())
+    {
+        memcpy(&client->bodies[0],data + sizeof(struct ClientUpdate),
+                client->bodies.size() * sizeof(struct BodyUpdate));
+        packBodies(client);
+    }
+
+    cu.numMes = client->id;
+    if(memcmp(&cu,&client->update,sizeof(struct ClientUpdate)))
+    {
+        client->update = cu;
+        client->updateVersion = _tick;
+    }
+    client->repliesPending++;
+
+    return needed;
 }
 
-bool SocketThread::processEvents()
+int CollaborativeServer::parseDeltaUpdate(Client * client, const char * data,
+        int size)
 {
-    struct ClientUpdate cu;
-    if(!_socket->recv(&cu,sizeof(struct ClientUpdate)))
+    if(size < sizeof(struct DeltaUpdate))
     {
-        return false;
+        return 0;
     }
 
-    int numTargets = _server->_clientHeadList[_id].size()
-            + _server->_clientHandList[_id].size();
-    int index = 0;
+    DeltaUpdate du;
+    memcpy(&du,data,sizeof(struct DeltaUpdate));
+    if(du.numMes < 0 || du.numMes > MAX_CLIENT_MESSAGES || du.size < 0
+            || du.size > MAX_MESSAGE_SIZE)
+    {
+        return -1;
+    }
 
-    BodyUpdate * bu = NULL;
-    if(numTargets)
+    int needed = sizeof(struct DeltaUpdate) + du.size;
+    if(size < needed)
     {
-        bu = new BodyUpdate[numTargets];
-        if(!_socket->recv(bu,sizeof(struct BodyUpdate) * numTargets))
-        {
-            delete[] bu;
-            return false;
-        }
+        return 0;
     }
 
-    CollaborativeMessageHeader * cmesh = NULL;
-    if(cu.numMes)
+    if(du.numMes)
     {
-        //Process client messages
-        cmesh = new CollaborativeMessageHeader[cu.numMes];
-        if(!_socket->recv(cmesh,
-                sizeof(struct CollaborativeMessageHeader) * cu.numMes))
+        int used = parseMessages(client,data + needed,size - needed,
+                du.numMes);
+        if(used <= 0)
         {
-            if(bu)
-            {
-                delete[] bu;
-            }
-            delete[] cmesh;
-            return false;
+            return used;
         }
+        needed += used;
+    }
 
-        for(int i = 0; i < cu.numMes; i++)
-        {
-            if(!processMessage(cmesh[i]))
-            {
-                if(bu)
-                {
-                    delete[] bu;
-                }
-                return false;
-            }
-        }
+    const char * block = data + sizeof(struct DeltaUpdate);
+    DeltaClientHeader header;
+    ClientUpdate cu;
+    int used = CollaborativeDelta::readClientHeader(block,du.size,header,cu);
+    if(used < 0)
+    {
+        return -1;
+    }
+
+    if(header.flags & DELTA_CLIENT_UPDATE)
+    {
+        cu.numMes = client->id;
+        client->update = cu;
+        client->updateVersion = _tick;
+    }
 
-        delete[] cmesh;
+    if(CollaborativeDelta::readBodies(block + used,du.size - used,
+            client->bodies.size(),
+            client->bodies.size() ? &client->bodies[0] : NULL,
+            client->packed.size() ? &client->packed[0] : NULL,
+            client->bodyVersions.size() ? &client->bodyVersions[0] : NULL,
+            _tick) < 0)
+    {
+        return -1;
     }
 
-    cu.numMes = _id;
-    struct ServerUpdate su;
+    client->repliesPending++;
 
-    _server->_serverLock.lock();
+    return needed;
+}
 
-    if(_server->_clientMap.find(_server->_masterID)
-            == _server->_clientMap.end())
+int CollaborativeServer::parseMessages(Client * client, const char * data,
+        int size, int numMes)
+{
+    int needed = numMes * sizeof(struct CollaborativeMessageHeader);
+    if(size < needed)
     {
-        _server->_masterID = -1;
+        return 0;
     }
 
-    su.numUsers = _server->_threadList.size();
-    su.mode = _server->_currentMode;
-    su.masterID = _server->_masterID;
-    struct ClientUpdate * culist = NULL;
-    struct BodyUpdate * cubu = NULL;
-    int numToSend = 0;
-    int numBodyToSend = 0;
+    std::vector<CollaborativeMessageHeader> cmh(numMes);
+    memcpy(&cmh[0],data,needed);
 
-    if(_server->_currentMode == LOCKED)
+    for(int i = 0; i < numMes; i++)
     {
-        if(_server->_masterID >= 0 && _server->_masterID != _id)
+        if(cmh[i].size < 0 || cmh[i].size > MAX_MESSAGE_SIZE)
         {
-            numToSend = 1;
-            culist = new struct ClientUpdate[1];
-            culist[0] = _server->_clientMap[_server->_masterID];
-            numBodyToSend = _server->_clientHeadList[_server->_masterID].size()
-                    + _server->_clientHandList[_server->_masterID].size();
-            int index = 0;
-            cubu = new struct BodyUpdate[numBodyToSend];
-            for(int i = 0;
-                    i < _server->_clientHeadList[_server->_masterID].size();
-                    i++)
-            {
-                cubu[index] = _server->_clientHeadList[_server->_masterID][i];
-                index++;
-            }
-            for(int i = 0;
-                    i < _server->_clientHandList[_server->_masterID].size();
-                    i++)
-            {
-                cubu[index] = _server->_clientHandList[_server->_masterID][i];
-                index++;
-            }
+            return -1;
+        }
+        needed += cmh[i].size;
+        if(size < needed)
+        {
+            return 0;
         }
     }
-    else if(_server->_threadList.size() > 1)
+
+    const char * messageData = data
+            + numMes * sizeof(struct CollaborativeMessageHeader);
+    for(int i = 0; i < numMes; i++)
     {
-        numToSend = _server->_threadList.size() - 1;
-        culist = new struct ClientUpdate[numToSend];
-        int index = 0;
-        for(int i = 0; i < _server->_threadList.size(); i++)
+        processMessage(client,cmh[i],messageData);
+        messageData += cmh[i].size;
+    }
+
+    return needed;
+}
+
+void CollaborativeServer::packBodies(Client * client)
+{
+    // versions let each delta client get the bodies changed since its last
+    // reply, whatever protocol the body came in with
+    bool reset = client->packed.size() != client->bodies.size();
+    client->packed.resize(client->bodies.size());
+    client->bodyVersions.resize(client->bodies.size());
+
+    for(int i = 0; i < client->bodies.size(); i++)
+    {
+        PackedBodyUpdate pbu;
+        CollaborativeDelta::packBody(client->bodies[i],pbu);
+        if(reset
+                || memcmp(&pbu,&client->packed[i],
+                        sizeof(struct PackedBodyUpdate)))
         {
-            if(_server->_threadList[i]->getID() != _id)
-            {
-                numBodyToSend +=
-                        _server->_clientHeadList[_server->_threadList[i]->getID()].size()
-                                + _server->_clientHandList[_server->_threadList[i]->getID()].size();
-                culist[index] =
-                        _server->_clientMap[_server->_threadList[i]->getID()];
-                index++;
-            }
+            client->packed[i] = pbu;
+            client->bodyVersions[i] = _tick;
         }
+    }
+}
 
-        cubu = new struct BodyUpdate[numBodyToSend];
-        index = 0;
-
-        for(int i = 0; i < _server->_threadList.size(); i++)
+void CollaborativeServer::processMessage(Client * client,
+        CollaborativeMessageHeader & cmh, const char * data)
+{
+    switch(cmh.type)
+    {
+        case SET_MASTER_ID:
         {
-            if(_server->_threadList[i]->getID() == _id)
+            if(cmh.size >= sizeof(int))
             {
-                continue;
-            }
-            for(int j = 0;
-                    j
-                            < _server->_clientHeadList[_server->_threadList[i]->getID()].size();
-                    j++)
-            {
-                cubu[index] =
-                        _server->_clientHeadList[_server->_threadList[i]->getID()][j];
-                index++;
+                memcpy(&_masterID,data,sizeof(int));
+                std::cerr << "Setting master id to " << _masterID
+                        << std::endl;
             }
+            break;
         }
-
-        for(int i = 0; i < _server->_threadList.size(); i++)
+        case SET_COLLAB_MODE:
         {
-            if(_server->_threadList[i]->getID() == _id)
+            if(cmh.size >= sizeof(CollabMode))
             {
-                continue;
+                memcpy(&_currentMode,data,sizeof(CollabMode));
+                std::cerr << "Setting CollabMode to " << _currentMode
+                        << std::endl;
             }
-            for(int j = 0;
-                    j
-                            < _server->_clientHandList[_server->_threadList[i]->getID()].size();
-                    j++)
+            break;
+        }
+        default:
+        {
+            if(getNumActive() > 1)
             {
-                cubu[index] =
-                        _server->_clientHandList[_server->_threadList[i]->getID()][j];
-                index++;
+                char * copy = NULL;
+                if(cmh.size)
+                {
+                    copy = new char[cmh.size];
+                    memcpy(copy,data,cmh.size);
+                }
+                addMessage(new CollaborativeMessage(cmh,copy),client);
             }
+            break;
         }
-        //std::cerr << "Sending " << numBodyToSend << std::endl;
     }
+}
 
-    _server->_clientMap[_id] = cu;
-
-    int bindex = 0;
-    for(int i = 0; i < _server->_clientHeadList[_id].size(); i++)
-    {
-        _server->_clientHeadList[_id][i] = bu[bindex];
-        bindex++;
-    }
-    for(int i = 0; i < _server->_clientHandList[_id].size(); i++)
+void CollaborativeServer::addMessage(CollaborativeMessage * message,
+        Client * skip)
+{
+    message->ref();
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
     {
-        _server->_clientHandList[_id][i] = bu[bindex];
-        bindex++;
+        if(it->second != skip && it->second->active && !it->second->closed)
+        {
+            message->ref();
+            it->second->messages.push_back(message);
+            it->second->messageSize += sizeof(struct CollaborativeMessageHeader)
+                    + message->getHeader().size;
+            checkBacklog(it->second);
+        }
     }
+    message->unref();
+}
 
-    if(bu)
+void CollaborativeServer::buildSnapshot()
+{
+    _snapshot = new ClientSnapshot();
+    _snapshot->ref();
+
+    int numActive = 0;
+    int numHeads = 0;
+    int numHands = 0;
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
     {
-        delete[] bu;
+        if(it->second->active)
+        {
+            numActive++;
+            numHeads += it->second->initInfo.numHeads;
+            numHands += it->second->initInfo.numHands;
+        }
     }
 
-    _server->_serverLock.unlock();
+    _snapshot->_headsStart = numActive * sizeof(struct ClientUpdate);
+    _snapshot->_handsStart = _snapshot->_headsStart
+            + numHeads * sizeof(struct BodyUpdate);
+    _snapshot->_data.resize(
+            _snapshot->_handsStart + numHands * sizeof(struct BodyUpdate));
+    _snapshot->_entries.resize(numActive);
+
+    int index = 0;
+    int headOffset = _snapshot->_headsStart;
+    int handOffset = _snapshot->_handsStart;
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
+    {
+        Client * client = it->second;
+        if(!client->active)
+        {
+            continue;
+        }
 
-    std::queue<CollaborativeMessage *> localQueue;
+        ClientSnapshot::Entry & entry = _snapshot->_entries[index];
+        entry.id = client->id;
+        entry.update = index * sizeof(struct ClientUpdate);
+        entry.heads = headOffset;
+        entry.headsSize = client->initInfo.numHeads * sizeof(struct BodyUpdate);
+        entry.hands = handOffset;
+        entry.handsSize = client->initInfo.numHands * sizeof(struct BodyUpdate);
+
+        memcpy(&_snapshot->_data[entry.update],&client->update,
+                sizeof(struct ClientUpdate));
+        if(entry.headsSize)
+        {
+            memcpy(&_snapshot->_data[entry.heads],&client->bodies[0],
+                    entry.headsSize);
+        }
+        if(entry.handsSize)
+        {
+            memcpy(&_snapshot->_data[entry.hands],
+                    &client->bodies[client->initInfo.numHeads],
+                    entry.handsSize);
+        }
 
-    _messageLock.lock();
+        _snapshot->_entryMap[client->id] = index;
+        headOffset += entry.headsSize;
+        handOffset += entry.handsSize;
+        index++;
+    }
+}
 
-    su.numMes = _messageQueue.size();
+void CollaborativeServer::queueReply(Client * client)
+{
+    if(_snapshot->_entryMap.find(_masterID) == _snapshot->_entryMap.end())
+    {
+        _masterID = -1;
+    }
 
-    CollaborativeMessageHeader * cucmh = NULL;
+    ServerUpdate su;
+    su.numUsers = _snapshot->_entries.size();
+    su.mode = _currentMode;
+    su.masterID = _masterID;
+    su.numMes = client->messages.size();
 
-    if(su.numMes)
+    OutputBuffer * ob = new OutputBuffer();
+    ob->append(&su,sizeof(struct ServerUpdate));
+    for(int i = 0; i < client->messages.size(); i++)
     {
-        cucmh = new CollaborativeMessageHeader[su.numMes];
+        ob->append(&client->messages[i]->getHeader(),
+                sizeof(struct CollaborativeMessageHeader));
     }
+    queueOutput(client,ob,&ob->_data[0],ob->_data.size());
 
-    for(int i = 0; i < su.numMes; i++)
+    for(int i = 0; i < client->messages.size(); i++)
     {
+        CollaborativeMessage * message = client->messages[i];
+        if(message->getHeader().size)
+        {
+            queueOutput(client,message,message->getData(),
+                    message->getHeader().size);
+        }
+        message->unref();
+    }
+    client->messages.clear();
+    client->messageSize = 0;
 
-        localQueue.push(_messageQueue.front());
-        cucmh[i] = _messageQueue.front()->getHeader();
-        _messageQueue.pop();
-        //std::cerr << "Creating message: type: " << cucmh[i].type << " target: " << cucmh[i].target << " size: " << cucmh[i].size << std::endl;
+    if(client->protocol >= COLLAB_PROTOCOL_DELTA)
+    {
+        queueDeltaReply(client);
+        return;
     }
 
-    _messageLock.unlock();
+    ClientSnapshot * snap = _snapshot;
+    const char * base = &snap->_data[0];
 
-    if(!_socket->send(&su,sizeof(struct ServerUpdate)))
+    if(_currentMode == LOCKED)
     {
-        if(culist)
+        if(_masterID >= 0 && _masterID != client->id)
         {
-            delete[] culist;
+            ClientSnapshot::Entry & master =
+                    snap->_entries[snap->_entryMap[_masterID]];
+            queueOutput(client,snap,base + master.update,
+                    sizeof(struct ClientUpdate));
+            queueOutput(client,snap,base + master.heads,master.headsSize);
+            queueOutput(client,snap,base + master.hands,master.handsSize);
         }
-        if(cubu)
-        {
-            delete[] cubu;
-        }
-        if(cucmh)
+    }
+    else if(snap->_entries.size() > 1)
+    {
+        // everything but this client's own entries, in join order
+        std::map<int,int>::iterator it = snap->_entryMap.find(client->id);
+        if(it == snap->_entryMap.end())
         {
-            delete[] cucmh;
+            queueOutput(client,snap,base,snap->_data.size());
+            return;
         }
-        queueCleanup(localQueue);
-        return false;
+
+        ClientSnapshot::Entry & self = snap->_entries[it->second];
+        queueOutput(client,snap,base,self.update);
+        queueOutput(client,snap,base + self.update + sizeof(struct ClientUpdate),
+                snap->_headsStart - self.update - sizeof(struct ClientUpdate));
+        queueOutput(client,snap,base + snap->_headsStart,
+                self.heads - snap->_headsStart);
+        queueOutput(client,snap,base + self.heads + self.headsSize,
+                snap->_handsStart - self.heads - self.headsSize);
+        queueOutput(client,snap,base + snap->_handsStart,
+                self.hands - snap->_handsStart);
+        queueOutput(client,snap,base + self.hands + self.handsSize,
+                snap->_data.size() - self.hands - self.handsSize);
     }
+}
 
-    if(cucmh)
+void CollaborativeServer::queueDeltaReply(Client * client)
+{
+    // same clients as a full reply, but only what changed since this client
+    // last got them
+    std::vector<Client*> sources;
+    if(_currentMode == LOCKED)
     {
-        if(!_socket->send(cucmh,
-                sizeof(struct CollaborativeMessageHeader) * su.numMes))
+        if(_masterID >= 0 && _masterID != client->id)
         {
-            delete[] cucmh;
-            if(culist)
-            {
-                delete[] culist;
-            }
-            if(cubu)
-            {
-                delete[] cubu;
-            }
-            queueCleanup(localQueue);
-            return false;
+            sources.push_back(_clients[_masterID]);
         }
-        delete[] cucmh;
     }
-
-    for(int i = 0; i < su.numMes; i++)
+    else if(_snapshot->_entries.size() > 1)
     {
-        if(localQueue.front()->getHeader().size)
+        for(int i = 0; i < _snapshot->_entries.size(); i++)
         {
-            //std::cerr << "Sending message data of size: " << localQueue.front()->getHeader().size << std::endl;
-            if(!_socket->send(localQueue.front()->getData(),
-                    localQueue.front()->getHeader().size))
+            if(_snapshot->_entries[i].id != client->id)
             {
-                if(culist)
-                {
-                    delete[] culist;
-                }
-                if(cubu)
-                {
-                    delete[] cubu;
-                }
-                queueCleanup(localQueue);
-                return false;
+                sources.push_back(_clients[_snapshot->_entries[i].id]);
             }
         }
-        localQueue.front()->unref();
-        localQueue.pop();
     }
 
-    if(culist)
+    OutputBuffer * ob = new OutputBuffer();
+    ob->_data.resize(sizeof(int));
+
+    std::vector<bool> changed;
+    for(int i = 0; i < sources.size(); i++)
     {
-        if(!_socket->send(culist,sizeof(struct ClientUpdate) * numToSend))
+        Client * source = sources[i];
+        std::map<int,int>::iterator it = client->sentVersions.find(
+                source->id);
+        int sent = it != client->sentVersions.end() ? it->second : -1;
+
+        bool updateChanged = source->updateVersion > sent;
+        bool anyChanged = updateChanged;
+        changed.resize(source->packed.size());
+        for(int j = 0; j < source->packed.size(); j++)
         {
-            delete[] culist;
-            if(cubu)
-            {
-                delete[] cubu;
-            }
-            return false;
+            changed[j] = source->bodyVersions[j] > sent;
+            anyChanged = anyChanged || changed[j];
         }
-        delete[] culist;
-    }
-    if(cubu)
-    {
-        if(!_socket->send(cubu,sizeof(struct BodyUpdate) * numBodyToSend))
+
+        if(anyChanged)
         {
-            delete[] cubu;
-            return false;
+            CollaborativeDelta::writeClient(ob->_data,source->id,
+                    updateChanged ? &source->update : NULL,
+                    source->packed.size(),
+                    source->packed.size() ? &source->packed[0] : NULL,
+                    changed);
         }
-        delete[] cubu;
+
+        client->sentVersions[source->id] = _tick;
     }
 
-    return true;
+    int size = ob->_data.size() - sizeof(int);
+    memcpy(&ob->_data[0],&size,sizeof(int));
+    queueOutput(client,ob,&ob->_data[0],ob->_data.size());
 }
 
-bool SocketThread::processMessage(CollaborativeMessageHeader & cmh)
+void CollaborativeServer::queueOutput(Client * client, SharedData * owner,
+        const char * data, int size)
 {
-    char * data = NULL;
-    if(cmh.size)
+    if(size <= 0)
     {
-        data = new char[cmh.size];
-        if(!_socket->recv(data,cmh.size))
-        {
-            delete[] data;
-            return false;
-        }
+        // queueing takes ownership of an unreferenced buffer
+        owner->ref();
+        owner->unref();
+        return;
     }
 
-    switch(cmh.type)
+    OutputChunk chunk;
+    chunk.owner = owner;
+    chunk.data = data;
+    chunk.size = size;
+    owner->ref();
+    client->output.push_back(chunk);
+    client->outputSize += size;
+    checkBacklog(client);
+}
+
+void CollaborativeServer::checkBacklog(Client * client)
+{
+    if(!client->closed
+            && client->outputSize + client->messageSize > MAX_OUTPUT_SIZE)
     {
-        case SET_MASTER_ID:
+        std::cerr << "Client " << client->initInfo.name << " has "
+                << client->outputSize + client->messageSize
+                << " bytes waiting to be sent, disconnecting." << std::endl;
+        client->closed = true;
+    }
+}
+
+bool CollaborativeServer::flushClient(Client * client)
+{
+    while(client->output.size())
+    {
+        SocketBuffer buffers[MAX_IOVECS];
+        int count = 0;
+        for(std::deque<OutputChunk>::iterator it = client->output.begin();
+                it != client->output.end() && count < MAX_IOVECS; it++)
         {
-            int mid = *((int*)data);
-            std::cerr << "Setting master id to " << mid << std::endl;
-            _server->_serverLock.lock();
-            _server->_masterID = mid;
-            _server->_serverLock.unlock();
-            delete[] data;
-            break;
+            int skip = count ? 0 : client->outputOffset;
+            buffers[count].data = (void*)(it->data + skip);
+            buffers[count].len = it->size - skip;
+            count++;
         }
-        case SET_COLLAB_MODE:
+
+        int sent = client->socket->trySendv(buffers,count,MSG_NOSIGNAL);
+        if(sent < 0)
         {
-            CollabMode cm = *((CollabMode*)data);
-            std::cerr << "Setting CollabMode to " << cm << std::endl;
-            _server->_serverLock.lock();
-            _server->_currentMode = cm;
-            _server->_serverLock.unlock();
-            delete[] data;
-            break;
+            return false;
         }
-        default:
+        if(sent == 0)
         {
-            _server->_serverLock.lock();
+            return true;
+        }
 
-            if(_server->_threadList.size() > 1)
+        client->outputSize -= sent;
+        while(sent > 0)
+        {
+            OutputChunk & chunk = client->output.front();
+            int left = chunk.size - client->outputOffset;
+            if(sent < left)
             {
-                CollaborativeMessage * cm = new CollaborativeMessage(
-                        _server->_threadList.size() - 1,cmh,data);
-                for(int i = 0; i < _server->_threadList.size(); i++)
-                {
-                    if(_server->_threadList[i] != this)
-                    {
-                        _server->_threadList[i]->addMessage(cm);
-                    }
-                }
+                client->outputOffset += sent;
+                break;
             }
 
-            _server->_serverLock.unlock();
-            break;
+            sent -= left;
+            chunk.owner->unref();
+            client->output.pop_front();
+            client->outputOffset = 0;
         }
     }
 
     return true;
 }
 
-void SocketThread::queueCleanup(std::queue<CollaborativeMessage *> & queue)
+void CollaborativeServer::updateEvents(Client * client)
 {
-    while(queue.size())
+    bool wait = client->output.size() > 0;
+    if(wait == client->writeWait)
     {
-        queue.front()->unref();
-        queue.pop();
+        return;
     }
+
+#ifdef COLLAB_USE_EPOLL
+    struct epoll_event event;
+    event.events = EPOLLIN | (wait ? EPOLLOUT : 0);
+    event.data.ptr = client;
+    epoll_ctl(_epollFD,EPOLL_CTL_MOD,client->socket->getSocketFD(),&event);
+#endif
+    client->writeWait = wait;
 }
 
-CollaborativeMessage::CollaborativeMessage(int refs, int type,
-        std::string target, int size, char * data)
+void CollaborativeServer::removeClient(Client * client)
 {
+    std::cerr << "Removing client " << client->initInfo.name << std::endl;
+
+#ifdef COLLAB_USE_EPOLL
+    epoll_ctl(_epollFD,EPOLL_CTL_DEL,client->socket->getSocketFD(),NULL);
+#endif
+    _clients.erase(client->id);
+
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
+    {
+        it->second->sentVersions.erase(client->id);
+    }
+
+    if(client->active)
+    {
+        int * cid = new int[1];
+        cid[0] = client->id;
+        addMessage(new CollaborativeMessage(REMOVE_CLIENT,"Collaborative",
+                sizeof(int),(char*)cid),NULL);
+
+        if(_currentMode == LOCKED && _masterID == client->id)
+        {
+            _currentMode = UNLOCKED;
+            _masterID = -1;
+        }
+    }
+
+    for(int i = 0; i < client->messages.size(); i++)
+    {
+        client->messages[i]->unref();
+    }
+
+    while(client->output.size())
+    {
+        client->output.front().owner->unref();
+        client->output.pop_front();
+    }
+
+    delete client->socket;
+    delete client;
+}
+
+int CollaborativeServer::getNumActive()
+{
+    int count = 0;
+    for(std::map<int,Client*>::iterator it = _clients.begin();
+            it != _clients.end(); it++)
+    {
+        if(it->second->active && !it->second->closed)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+CollaborativeMessage::CollaborativeMessage(int type, std::string target,
+        int size, char * data)
+{
+    memset(&_header,0,sizeof(struct CollaborativeMessageHeader));
     _header.type = type;
     _header.target[255] = '\0';
     strncpy(_header.target,target.c_str(),255);
     _header.size = size;
     _data = data;
-    _refs = refs;
 }
 
-CollaborativeMessage::CollaborativeMessage(int refs,
+CollaborativeMessage::CollaborativeMessage(
         cvr::CollaborativeMessageHeader & cmh, char * data)
 {
     _header = cmh;
     _data = data;
-    _refs = refs;
 }
 
 CollaborativeMessage::~CollaborativeMessage()
@@ -797,20 +1161,6 @@ char * CollaborativeMessage::getData()
     return _data;
 }
 
-void CollaborativeMessage::unref()
-{
-    _refMutex.lock();
-    _refs--;
-
-    if(_refs <= 0)
-    {
-        delete this;
-        return;
-    }
-
-    _refMutex.unlock();
-}
-
 int main(int argc, char ** argv)
 {
     osg::ArgumentParser ap(&argc,argv);
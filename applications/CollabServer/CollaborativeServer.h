@@ -3,11 +3,8 @@
 
 #include <cvrCollaborative/CollaborativeManager.h>
 
-#include <OpenThreads/Thread>
-#include <OpenThreads/Mutex>
-
 #include <map>
-#include <queue>
+#include <deque>
 #include <string>
 #include <vector>
 #include <csignal>
@@ -18,96 +15,215 @@
 namespace cvr
 {
 
-class CollaborativeMessage;
-class SocketThread;
 class MultiListenSocket;
 class CVRSocket;
 
-class CollaborativeServer
+/**
+ * @brief Reference counted data that may be queued to several clients
+ */
+class SharedData
 {
-        friend class SocketThread;
     public:
-        CollaborativeServer(int port);
-        virtual ~CollaborativeServer();
-
-        bool init();
-
-        void run();
+        SharedData()
+        {
+            _refs = 0;
+        }
+
+        void ref()
+        {
+            _refs++;
+        }
+
+        void unref()
+        {
+            if(--_refs <= 0)
+            {
+                delete this;
+            }
+        }
 
     protected:
-        void initConnection(int id, CVRSocket * sock);
-        void checkSockets();
-
-        std::map<int,struct ClientUpdate> _clientMap;
-        std::map<int,struct ClientInitInfo> _clientInitMap;
-        std::map<int,std::vector<struct BodyUpdate> > _clientHandList;
-        std::map<int,std::vector<struct BodyUpdate> > _clientHeadList;
-        std::vector<SocketThread *> _threadList;
-        CollabMode _currentMode;
-        int _masterID;
-        int _port;
-        OpenThreads::Mutex _serverLock;
-        OpenThreads::Mutex _messageAddLock;
-        MultiListenSocket * _listenSocket;
+        virtual ~SharedData()
+        {
+        }
+
+        int _refs;
 };
 
-class SocketThread : public OpenThreads::Thread
+/**
+ * @brief Data made for sending, such as a reply header or init info
+ */
+class OutputBuffer : public SharedData
 {
     public:
-        SocketThread(cvr::CVRSocket * socket, std::string name, int id,
-                CollaborativeServer * server);
-        virtual ~SocketThread();
-
-        virtual void run();
+        void append(const void * data, int size)
+        {
+            _data.insert(_data.end(),(const char*)data,
+                    ((const char*)data) + size);
+        }
 
-        int getID();
-        std::string getName();
-        void quit();
-
-        void addMessage(CollaborativeMessage * message);
-
-    protected:
-        bool checkSocket();
-        bool processEvents();
-        bool processMessage(CollaborativeMessageHeader & cmh);
-
-        void queueCleanup(std::queue<CollaborativeMessage *> & queue);
-
-        CollaborativeServer * _server;
-
-        std::queue<CollaborativeMessage *> _messageQueue;
-        OpenThreads::Mutex _messageLock;
-        OpenThreads::Mutex _quitLock;
-
-        cvr::CVRSocket * _socket;
-        std::string _name;
-        int _id;
+        std::vector<char> _data;
+};
 
-        bool _quit;
+/**
+ * @brief State of all clients encoded once a tick, every reply sends parts
+ * of it
+ *
+ * Holds the ClientUpdate of each client in id order, then the heads of each
+ * client, then the hands of each client.
+ */
+class ClientSnapshot : public OutputBuffer
+{
+    public:
+        struct Entry
+        {
+                int id;
+                int update; ///< offset of the ClientUpdate
+                int heads; ///< offset of the first head
+                int headsSize;
+                int hands; ///< offset of the first hand
+                int handsSize;
+        };
+
+        std::vector<Entry> _entries;
+        std::map<int,int> _entryMap; ///< client id to entry index
+        int _headsStart;
+        int _handsStart;
 };
 
-class CollaborativeMessage
+/**
+ * @brief Message from a client forwarded to the other clients
+ */
+class CollaborativeMessage : public SharedData
 {
     public:
-        CollaborativeMessage(int refs, int type, std::string target, int size,
+        CollaborativeMessage(int type, std::string target, int size,
                 char * data);
-        CollaborativeMessage(int refs, cvr::CollaborativeMessageHeader & cmh,
+        CollaborativeMessage(cvr::CollaborativeMessageHeader & cmh,
                 char * data);
-        virtual ~CollaborativeMessage();
 
         cvr::CollaborativeMessageHeader & getHeader();
         char * getData();
 
-        void unref();
-
     protected:
-        OpenThreads::Mutex _refMutex;
+        virtual ~CollaborativeMessage();
 
-        int _refs;
         cvr::CollaborativeMessageHeader _header;
         char * _data;
 };
 
+/**
+ * @brief Collaborative session server
+ *
+ * All clients are handled on one thread with non-blocking sockets, waiting
+ * on epoll on linux and poll elsewhere.  Each pass of the event loop reads every complete update that has
+ * arrived, then encodes the client state once and queues a reply to each
+ * client that sent an update, made of a small header and references into the
+ * shared snapshot.
+ *
+ * Clients that negotiate delta updates send and get only the quantized bodies
+ * that changed, tracked with the loop pass each value last changed in.
+ *
+ * A client whose update does not fit in the input limit, or that lets too
+ * much data queue up for it, is disconnected.
+ */
+class CollaborativeServer
+{
+    public:
+        CollaborativeServer(int port);
+        virtual ~CollaborativeServer();
+
+        bool init();
+
+        void run();
+
+    protected:
+        /**
+         * @brief Part of a reply waiting to be sent
+         */
+        struct OutputChunk
+        {
+                SharedData * owner; ///< holds a reference while queued
+                const char * data;
+                int size;
+        };
+
+        /**
+         * @brief Connection to a client and its session state
+         */
+        struct Client
+        {
+                CVRSocket * socket;
+                int id;
+                bool active; ///< if the client has finished the init exchange
+                bool closed; ///< if the client is to be removed this tick
+                bool writeWait; ///< if waiting for the socket to be writable
+                ClientInitInfo initInfo;
+                int protocol; ///< protocol version used with the client
+                ClientUpdate update;
+                std::vector<BodyUpdate> bodies; ///< heads first
+                int repliesPending; ///< updates received but not answered
+
+                std::vector<PackedBodyUpdate> packed; ///< quantized bodies
+                std::vector<int> bodyVersions; ///< tick each packed body last changed
+                int updateVersion; ///< tick the object transform last changed
+                std::map<int,int> sentVersions; ///< tick the state of each client was last sent to this one, for delta replies
+
+                std::vector<char> input; ///< received data not yet parsed
+                int inputSize;
+                std::deque<OutputChunk> output;
+                int outputOffset; ///< bytes of the first chunk already sent
+                int outputSize; ///< bytes in output not yet sent
+                std::vector<CollaborativeMessage*> messages; ///< messages for the next reply
+                int messageSize; ///< bytes in messages
+        };
+
+        /**
+         * @brief Socket activity from one event wait
+         */
+        struct ReadyEvent
+        {
+                Client * client; ///< NULL for the listen socket
+                bool read;
+                bool write;
+        };
+
+        bool waitEvents(std::vector<ReadyEvent> & events);
+        bool watchClient(Client * client);
+
+        void acceptClients();
+        bool readClient(Client * client);
+        int parseInit(Client * client, const char * data, int size);
+        int parseUpdate(Client * client, const char * data, int size);
+        int parseDeltaUpdate(Client * client, const char * data, int size);
+        int parseMessages(Client * client, const char * data, int size,
+                int numMes);
+        void packBodies(Client * client);
+        void processMessage(Client * client, CollaborativeMessageHeader & cmh,
+                const char * data);
+        void addMessage(CollaborativeMessage * message, Client * skip);
+        void buildSnapshot();
+        void queueReply(Client * client);
+        void queueDeltaReply(Client * client);
+        void queueOutput(Client * client, SharedData * owner,
+                const char * data, int size);
+        void checkBacklog(Client * client);
+        bool flushClient(Client * client);
+        void updateEvents(Client * client);
+        void removeClient(Client * client);
+        int getNumActive();
+
+        std::map<int,Client*> _clients; ///< all connections by id, ids are in join order
+        ClientSnapshot * _snapshot; ///< state for this tick's replies, NULL until needed
+        CollabMode _currentMode;
+        int _masterID;
+        int _port;
+        int _nextID;
+        int _tick; ///< count of event loop passes, used to version client state
+        int _epollFD; ///< only used on linux
+        MultiListenSocket * _listenSocket;
+};
+
 }
 
 #endif
@@ -0,0 +1,290 @@
+/**
+ * @file CollabLoadTest.cpp
+ *
+ * Load test for the collaborative server.  Connects a number of clients with
+ * the full update protocol, then runs rounds where every client sends an
+ * update and reads its reply, and reports the update rate and round times.
+ */
+
+#include <cvrCollaborative/CollaborativeManager.h>
+#include <cvrUtil/CVRSocket.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+
+using namespace cvr;
+
+namespace
+{
+
+struct LoadClient
+{
+        CVRSocket * socket;
+        int id;
+        std::vector<char> data; ///< update sent each round
+};
+
+bool recvAll(LoadClient & client, void * data, int size)
+{
+    return !size || client.socket->recv(data,size);
+}
+
+bool connectClient(LoadClient & client, std::string host, int port, int num,
+        int numHeads, int numHands)
+{
+    client.socket = new CVRSocket(CONNECT,host,port);
+    if(!client.socket->valid() || !client.socket->connect())
+    {
+        return false;
+    }
+    client.socket->setNoDelay(true);
+
+    if(!recvAll(client,&client.id,sizeof(int)))
+    {
+        return false;
+    }
+
+    ClientInitInfo cii;
+    memset(&cii,0,sizeof(struct ClientInitInfo));
+    std::stringstream ss;
+    ss << "load" << num;
+    strncpy(cii.name,ss.str().c_str(),255);
+    cii.numHeads = numHeads;
+    cii.numHands = numHands;
+    if(!client.socket->send(&cii,sizeof(struct ClientInitInfo)))
+    {
+        return false;
+    }
+
+    ServerInitInfo sii;
+    if(!recvAll(client,&sii,sizeof(struct ServerInitInfo)))
+    {
+        return false;
+    }
+
+    std::vector<ClientInitInfo> others(sii.numUsers);
+    return recvAll(client,others.size() ? &others[0] : NULL,
+            sii.numUsers * sizeof(struct ClientInitInfo));
+}
+
+void makeUpdate(LoadClient & client, int numBodies, int messageSize)
+{
+    ClientUpdate cu;
+    memset(&cu,0,sizeof(struct ClientUpdate));
+    cu.objScale = 1.0;
+    cu.objTrans[0] = cu.objTrans[5] = cu.objTrans[10] = cu.objTrans[15] = 1.0;
+    cu.numMes = messageSize ? 1 : 0;
+
+    client.data.clear();
+    client.data.insert(client.data.end(),(char*)&cu,
+            ((char*)&cu) + sizeof(struct ClientUpdate));
+
+    BodyUpdate bu;
+    bu.pos[0] = bu.pos[1] = bu.pos[2] = (float)client.id;
+    bu.rot[0] = bu.rot[1] = bu.rot[2] = 0.0;
+    bu.rot[3] = 1.0;
+    for(int i = 0; i < numBodies; i++)
+    {
+        client.data.insert(client.data.end(),(char*)&bu,
+                ((char*)&bu) + sizeof(struct BodyUpdate));
+    }
+
+    if(messageSize)
+    {
+        CollaborativeMessageHeader cmh;
+        memset(&cmh,0,sizeof(struct CollaborativeMessageHeader));
+        cmh.type = PLUGIN_MESSAGE;
+        strncpy(cmh.target,"LoadTest",255);
+        cmh.size = messageSize;
+        client.data.insert(client.data.end(),(char*)&cmh,
+                ((char*)&cmh) + sizeof(struct CollaborativeMessageHeader));
+        client.data.resize(client.data.size() + messageSize,'m');
+    }
+}
+
+bool readReply(LoadClient & client, int numBodies, std::vector<char> & buffer)
+{
+    ServerUpdate su;
+    if(!recvAll(client,&su,sizeof(struct ServerUpdate)))
+    {
+        return false;
+    }
+
+    int size = su.numMes * sizeof(struct CollaborativeMessageHeader);
+    buffer.resize(size);
+    if(!recvAll(client,buffer.size() ? &buffer[0] : NULL,size))
+    {
+        return false;
+    }
+
+    size = 0;
+    for(int i = 0; i < su.numMes; i++)
+    {
+        CollaborativeMessageHeader cmh;
+        memcpy(&cmh,&buffer[i * sizeof(struct CollaborativeMessageHeader)],
+                sizeof(struct CollaborativeMessageHeader));
+        size += cmh.size;
+    }
+
+    // every client has the same bodies, so the rest of the reply is a fixed
+    // size per other client
+    if(su.mode == UNLOCKED && su.numUsers > 1)
+    {
+        size += (su.numUsers - 1) * (sizeof(struct ClientUpdate)
+                + numBodies * sizeof(struct BodyUpdate));
+    }
+    else if(su.mode == LOCKED && su.masterID >= 0
+            && su.masterID != client.id)
+    {
+        size += sizeof(struct ClientUpdate)
+                + numBodies * sizeof(struct BodyUpdate);
+    }
+
+    buffer.resize(size);
+    return recvAll(client,buffer.size() ? &buffer[0] : NULL,size);
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " is a load test for the CalVR collaborative server.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--host <host>",
+            "Server to connect to, default: localhost");
+    ap.getApplicationUsage()->addCommandLineOption("--port <port number>",
+            "Server port, default: 11050");
+    ap.getApplicationUsage()->addCommandLineOption("--clients <num>",
+            "Number of clients to connect, default: 32");
+    ap.getApplicationUsage()->addCommandLineOption("--rounds <num>",
+            "Number of update rounds, default: 1000");
+    ap.getApplicationUsage()->addCommandLineOption("--hands <num>",
+            "Tracked hands per client, default: 2");
+    ap.getApplicationUsage()->addCommandLineOption("--messageSize <bytes>",
+            "Size of a plugin message each client sends every round, default: 0");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    std::string host = "localhost";
+    ap.read("--host",host);
+
+    int port = 11050;
+    ap.read("--port",port);
+
+    int numClients = 32;
+    ap.read("--clients",numClients);
+
+    int rounds = 1000;
+    ap.read("--rounds",rounds);
+
+    int numHands = 2;
+    ap.read("--hands",numHands);
+
+    int messageSize = 0;
+    ap.read("--messageSize",messageSize);
+
+    int numBodies = 1 + numHands;
+
+    std::vector<LoadClient> clients(numClients);
+    for(int i = 0; i < numClients; i++)
+    {
+        if(!connectClient(clients[i],host,port,i,1,numHands))
+        {
+            std::cerr << "CollabLoadTest Error: unable to connect client " << i
+                    << std::endl;
+            return 1;
+        }
+        makeUpdate(clients[i],numBodies,messageSize);
+    }
+
+    // joins are announced in the first replies, read them before timing
+    std::vector<char> buffer;
+    for(int i = 0; i < numClients; i++)
+    {
+        if(!clients[i].socket->send(&clients[i].data[0],
+                clients[i].data.size()))
+        {
+            std::cerr << "CollabLoadTest Error: send failed." << std::endl;
+            return 1;
+        }
+    }
+    for(int i = 0; i < numClients; i++)
+    {
+        if(!readReply(clients[i],numBodies,buffer))
+        {
+            std::cerr << "CollabLoadTest Error: reply failed." << std::endl;
+            return 1;
+        }
+    }
+
+    osg::Timer * timer = osg::Timer::instance();
+    double maxRound = 0.0;
+    osg::Timer_t start = timer->tick();
+
+    for(int r = 0; r < rounds; r++)
+    {
+        osg::Timer_t roundStart = timer->tick();
+
+        for(int i = 0; i < numClients; i++)
+        {
+            if(!clients[i].socket->send(&clients[i].data[0],
+                    clients[i].data.size()))
+            {
+                std::cerr << "CollabLoadTest Error: send failed." << std::endl;
+                return 1;
+            }
+        }
+
+        for(int i = 0; i < numClients; i++)
+        {
+            if(!readReply(clients[i],numBodies,buffer))
+            {
+                std::cerr << "CollabLoadTest Error: reply failed." << std::endl;
+                return 1;
+            }
+        }
+
+        double roundTime = timer->delta_s(roundStart,timer->tick());
+        if(roundTime > maxRound)
+        {
+            maxRound = roundTime;
+        }
+    }
+
+    double total = timer->delta_s(start,timer->tick());
+
+    std::cout << "Clients: " << numClients << " rounds: " << rounds
+            << " bodies: " << numBodies << " message size: " << messageSize
+            << std::endl;
+    std::cout << "Total: " << total << " s, "
+            << (total > 0.0 ? (numClients * rounds) / total : 0.0)
+            << " updates/s" << std::endl;
+    std::cout << "Round avg: "
+            << (rounds ? (total / rounds) * 1000.0 : 0.0) << " ms max: "
+            << maxRound * 1000.0 << " ms" << std::endl;
+
+    for(int i = 0; i < numClients; i++)
+    {
+        delete clients[i].socket;
+    }
+
+    return 0;
+}
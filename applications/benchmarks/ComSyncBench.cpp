@@ -0,0 +1,210 @@
+/**
+ * @file ComSyncBench.cpp
+ *
+ * Benchmark of master to render node communication through ComController.
+ * The master writes a MultiPC config for the requested number of nodes,
+ * starts the nodes as local copies of this program, then times rounds of a
+ * sendSlaves broadcast followed by a readSlaves gather over loopback.
+ */
+
+#include <cvrKernel/CalVR.h>
+#include <cvrKernel/ComController.h>
+#include <cvrConfig/ConfigManager.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using namespace cvr;
+
+namespace
+{
+
+const int ACK_SIZE = 64;
+
+bool writeConfig(std::string file, int nodes, int port, int rounds, int size,
+        bool parallel, bool shm)
+{
+    std::ofstream out(file.c_str());
+    if(!out)
+    {
+        return false;
+    }
+
+    out << "<?xml version=\"1.0\"?>" << std::endl;
+    out << "<MultiPC>" << std::endl;
+    out << "  <NumSlaves value=\"" << nodes << "\" />" << std::endl;
+    out << "  <MasterInterface value=\"127.0.0.1\" port=\"" << port << "\" />"
+            << std::endl;
+    for(int i = 0; i < nodes; i++)
+    {
+        out << "  <Startup value=\"CalVR\" name=\"" << i << "\" />"
+                << std::endl;
+    }
+    out << "  <ParallelIO value=\"" << (parallel ? "true" : "false") << "\" />"
+            << std::endl;
+    out << "  <SharedMemory value=\"" << (shm ? "true" : "false") << "\" />"
+            << std::endl;
+    out << "</MultiPC>" << std::endl;
+    out << "<ComSyncBench rounds=\"" << rounds << "\" size=\"" << size
+            << "\" />" << std::endl;
+
+    return true;
+}
+
+void setEnv(const char * name, std::string value)
+{
+#ifndef WIN32
+    setenv(name,value.c_str(),1);
+#else
+    _putenv_s(name,value.c_str());
+#endif
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " times ComController sync rounds between a master and local render nodes.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--nodes <num>",
+            "Number of render nodes to start, default: 4");
+    ap.getApplicationUsage()->addCommandLineOption("--rounds <num>",
+            "Number of sync rounds, default: 1000");
+    ap.getApplicationUsage()->addCommandLineOption("--size <bytes>",
+            "Bytes sent to the nodes each round, default: 65536");
+    ap.getApplicationUsage()->addCommandLineOption("--port <port number>",
+            "Master port, default: 11300");
+    ap.getApplicationUsage()->addCommandLineOption("--serial",
+            "Turn off MultiPC.ParallelIO");
+    ap.getApplicationUsage()->addCommandLineOption("--shm",
+            "Turn on MultiPC.SharedMemory");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    // render nodes are started with --node-number and get the settings from
+    // the config the master wrote, through the inherited environment
+    bool master = ap.find("--node-number") < 0;
+    if(master)
+    {
+        int nodes = 4;
+        ap.read("--nodes",nodes);
+        int rounds = 1000;
+        ap.read("--rounds",rounds);
+        int size = 64 * 1024;
+        ap.read("--size",size);
+        int port = 11300;
+        ap.read("--port",port);
+        bool parallel = !ap.read("--serial");
+        bool shm = ap.read("--shm");
+
+        std::string file = "ComSyncBench-config.xml";
+        if(!writeConfig(file,nodes,port,rounds,size,parallel,shm))
+        {
+            std::cerr << "ComSyncBench Error: unable to write " << file
+                    << std::endl;
+            return 1;
+        }
+
+        setEnv("CALVR_CONFIG_DIR",".");
+        setEnv("CALVR_CONFIG_FILE",file);
+        ComController::application = argv[0];
+    }
+
+    // ComController gets the host name from the CalVR instance
+    new CalVR();
+
+    ConfigManager * config = new ConfigManager();
+    if(!config->init())
+    {
+        std::cerr << "ComSyncBench Error: loading config." << std::endl;
+        return 1;
+    }
+
+    ComController * com = ComController::instance();
+    if(!com->init(&ap))
+    {
+        std::cerr << "ComSyncBench Error: starting ComController." << std::endl;
+        return 1;
+    }
+
+    int rounds = ConfigManager::getInt("rounds","ComSyncBench",1000);
+    int size = ConfigManager::getInt("size","ComSyncBench",64 * 1024);
+    int nodes = com->getNumSlaves();
+
+    std::vector<char> data(size > 0 ? size : 1,'d');
+    std::vector<char> acks(ACK_SIZE * (nodes > 0 ? nodes : 1),'a');
+
+    if(!com->isMaster())
+    {
+        for(int r = 0; r < rounds; r++)
+        {
+            if(!com->readMaster(&data[0],size)
+                    || !com->sendMaster(&acks[0],ACK_SIZE))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    osg::Timer * timer = osg::Timer::instance();
+    double sendTotal = 0.0;
+    double maxRound = 0.0;
+    osg::Timer_t start = timer->tick();
+
+    for(int r = 0; r < rounds; r++)
+    {
+        osg::Timer_t roundStart = timer->tick();
+        if(!com->sendSlaves(&data[0],size))
+        {
+            std::cerr << "ComSyncBench Error: sendSlaves failed." << std::endl;
+            return 1;
+        }
+        osg::Timer_t sent = timer->tick();
+        if(!com->readSlaves(&acks[0],ACK_SIZE))
+        {
+            std::cerr << "ComSyncBench Error: readSlaves failed." << std::endl;
+            return 1;
+        }
+
+        sendTotal += timer->delta_s(roundStart,sent);
+        double roundTime = timer->delta_s(roundStart,timer->tick());
+        if(roundTime > maxRound)
+        {
+            maxRound = roundTime;
+        }
+    }
+
+    double total = timer->delta_s(start,timer->tick());
+
+    std::cout << "Nodes: " << nodes << " rounds: " << rounds << " size: "
+            << size << " parallel io: "
+            << ConfigManager::getBool("value","MultiPC.ParallelIO",true)
+            << " shared memory: "
+            << ConfigManager::getBool("value","MultiPC.SharedMemory",true)
+            << std::endl;
+    std::cout << "Round avg: " << (rounds ? total / rounds * 1000.0 : 0.0)
+            << " ms max: " << maxRound * 1000.0 << " ms send avg: "
+            << (rounds ? sendTotal / rounds * 1000.0 : 0.0) << " ms"
+            << std::endl;
+
+    return 0;
+}
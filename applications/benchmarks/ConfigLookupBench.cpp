@@ -0,0 +1,233 @@
+/**
+ * @file ConfigLookupBench.cpp
+ *
+ * Benchmark of config lookups.  A config file of generated sections is written
+ * and loaded, then the same set of paths, some of them missing, is looked up
+ * by walking the XML tree, through the flattened ConfigIndex, through the
+ * ConfigManager getters and through precompiled ConfigHandles.
+ */
+
+#include <cvrKernel/CalVR.h>
+#include <cvrConfig/ConfigManager.h>
+#include <cvrConfig/ConfigIndex.h>
+#include <cvrConfig/ConfigSnapshot.h>
+#include <cvrConfig/XMLReader.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+using namespace cvr;
+
+namespace
+{
+
+const int GROUPS_PER_SECTION = 4;
+
+bool writeConfig(std::string file, int sections, int entries)
+{
+    std::ofstream out(file.c_str());
+    if(!out)
+    {
+        return false;
+    }
+
+    out << "<?xml version=\"1.0\"?>" << std::endl;
+    for(int i = 0; i < sections; i++)
+    {
+        out << "<Section" << i << ">" << std::endl;
+        for(int j = 0; j < GROUPS_PER_SECTION; j++)
+        {
+            out << "  <Group" << j << ">" << std::endl;
+            for(int k = 0; k < entries; k++)
+            {
+                out << "    <Entry" << k << " value=\"" << i + j + k
+                        << "\" />" << std::endl;
+            }
+            out << "  </Group" << j << ">" << std::endl;
+        }
+        out << "</Section" << i << ">" << std::endl;
+    }
+
+    return true;
+}
+
+void setEnv(const char * name, std::string value)
+{
+#ifndef WIN32
+    setenv(name,value.c_str(),1);
+#else
+    _putenv_s(name,value.c_str());
+#endif
+}
+
+void makePaths(int sections, int entries, int numPaths, int missPercent,
+        std::vector<std::string> & paths)
+{
+    srand(1);
+    for(int i = 0; i < numPaths; i++)
+    {
+        std::stringstream ss;
+        ss << "Section" << rand() % sections << ".Group"
+                << rand() % GROUPS_PER_SECTION << ".Entry";
+        if(rand() % 100 < missPercent)
+        {
+            ss << entries + rand() % entries << "Missing";
+        }
+        else
+        {
+            ss << rand() % entries;
+        }
+        paths.push_back(ss.str());
+    }
+}
+
+void report(const char * name, double seconds, int lookups, int found)
+{
+    std::cout << name << ": " << (seconds / lookups) * 1000000000.0
+            << " ns per lookup, " << found << " found" << std::endl;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " compares config lookups through the XML tree and the index.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--sections <num>",
+            "Top level tags in the config, default: 50");
+    ap.getApplicationUsage()->addCommandLineOption("--entries <num>",
+            "Entries in each of the four groups per section, default: 20");
+    ap.getApplicationUsage()->addCommandLineOption("--paths <num>",
+            "Number of distinct paths looked up, default: 1000");
+    ap.getApplicationUsage()->addCommandLineOption("--lookups <num>",
+            "Lookups timed for each method, default: 200000");
+    ap.getApplicationUsage()->addCommandLineOption("--miss <percent>",
+            "Percent of paths that are not in the config, default: 10");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    int sections = 50;
+    ap.read("--sections",sections);
+    int entries = 20;
+    ap.read("--entries",entries);
+    int numPaths = 1000;
+    ap.read("--paths",numPaths);
+    int lookups = 200000;
+    ap.read("--lookups",lookups);
+    int miss = 10;
+    ap.read("--miss",miss);
+
+    if(sections < 1 || entries < 1 || numPaths < 1 || lookups < 1)
+    {
+        std::cerr << "ConfigLookupBench Error: invalid options." << std::endl;
+        return 1;
+    }
+
+    std::string file = "ConfigLookupBench-config.xml";
+    if(!writeConfig(file,sections,entries))
+    {
+        std::cerr << "ConfigLookupBench Error: unable to write " << file
+                << std::endl;
+        return 1;
+    }
+    setEnv("CALVR_CONFIG_DIR",".");
+    setEnv("CALVR_CONFIG_FILE",file);
+
+    // the index resolves host blocks with the CalVR host name
+    new CalVR();
+
+    ConfigManager * config = new ConfigManager();
+    if(!config->init())
+    {
+        std::cerr << "ConfigLookupBench Error: loading config." << std::endl;
+        return 1;
+    }
+
+    XMLReader reader;
+    ConfigSnapshot snapshot;
+    if(!reader.loadFile(file) || !reader.flatten(&snapshot))
+    {
+        std::cerr << "ConfigLookupBench Error: reading " << file << std::endl;
+        return 1;
+    }
+    osg::ref_ptr<ConfigIndex> index = snapshot.createIndex(
+            CalVR::instance()->getHostName());
+
+    std::vector<std::string> paths;
+    makePaths(sections,entries,numPaths,miss,paths);
+
+    std::vector<ConfigHandle> handles;
+    for(int i = 0; i < numPaths; i++)
+    {
+        handles.push_back(ConfigManager::getHandle(paths[i]));
+    }
+
+    std::cout << "Tags: " << index->getNumTags() << " paths: " << numPaths
+            << " lookups: " << lookups << " missing: " << miss << "%"
+            << std::endl;
+
+    std::string attribute = "value";
+    osg::Timer * timer = osg::Timer::instance();
+
+    int found = 0;
+    osg::Timer_t start = timer->tick();
+    for(int i = 0; i < lookups; i++)
+    {
+        bool hasEntry;
+        reader.getEntry(attribute,paths[i % numPaths],"",&hasEntry);
+        found += hasEntry;
+    }
+    report("XML tree walk",timer->delta_s(start,timer->tick()),lookups,found);
+
+    found = 0;
+    start = timer->tick();
+    for(int i = 0; i < lookups; i++)
+    {
+        found += index->find(attribute,paths[i % numPaths]) != NULL;
+    }
+    report("ConfigIndex::find",timer->delta_s(start,timer->tick()),lookups,
+            found);
+
+    found = 0;
+    start = timer->tick();
+    for(int i = 0; i < lookups; i++)
+    {
+        bool hasEntry;
+        ConfigManager::getInt(attribute,paths[i % numPaths],0,&hasEntry);
+        found += hasEntry;
+    }
+    report("ConfigManager::getInt",timer->delta_s(start,timer->tick()),
+            lookups,found);
+
+    found = 0;
+    start = timer->tick();
+    for(int i = 0; i < lookups; i++)
+    {
+        bool hasEntry;
+        ConfigManager::getInt(handles[i % numPaths],0,&hasEntry);
+        found += hasEntry;
+    }
+    report("ConfigHandle getInt",timer->delta_s(start,timer->tick()),lookups,
+            found);
+
+    return 0;
+}
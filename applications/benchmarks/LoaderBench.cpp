@@ -0,0 +1,309 @@
+/**
+ * @file LoaderBench.cpp
+ *
+ * Benchmark of ThreadedLoader on many small files.  A set of small model and
+ * image files is written, then read serially on one thread the way a list job
+ * used to be loaded, with one thread per file the way single file jobs used
+ * to be loaded, and through the ThreadedLoader pool as one list job and as
+ * one job per file.  The time until every file is loaded is reported.
+ */
+
+#include <cvrKernel/CalVR.h>
+#include <cvrKernel/ComController.h>
+#include <cvrKernel/ThreadedLoader.h>
+#include <cvrConfig/ConfigManager.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osg/Geode>
+#include <osg/ShapeDrawable>
+#include <osg/Image>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+using namespace cvr;
+
+namespace
+{
+
+bool writeConfig(std::string file, int threads)
+{
+    std::ofstream out(file.c_str());
+    if(!out)
+    {
+        return false;
+    }
+
+    out << "<?xml version=\"1.0\"?>" << std::endl;
+    out << "<ThreadedLoader>" << std::endl;
+    out << "  <Threads value=\"" << threads << "\" />" << std::endl;
+    out << "</ThreadedLoader>" << std::endl;
+
+    return true;
+}
+
+void setEnv(const char * name, std::string value)
+{
+#ifndef WIN32
+    setenv(name,value.c_str(),1);
+#else
+    _putenv_s(name,value.c_str());
+#endif
+}
+
+bool writeFiles(std::string dir, int count, bool images,
+        std::vector<std::string> & files)
+{
+    for(int i = 0; i < count; i++)
+    {
+        std::stringstream ss;
+        ss << dir << "/LoaderBench" << i << (images ? ".rgb" : ".osgt");
+        files.push_back(ss.str());
+
+        bool ok;
+        if(images)
+        {
+            osg::ref_ptr<osg::Image> image = new osg::Image();
+            image->allocateImage(64,64,1,GL_RGB,GL_UNSIGNED_BYTE);
+            memset(image->data(),i % 256,image->getTotalSizeInBytes());
+            ok = osgDB::writeImageFile(*image,ss.str());
+        }
+        else
+        {
+            osg::ref_ptr<osg::Geode> geode = new osg::Geode();
+            geode->addDrawable(
+                    new osg::ShapeDrawable(
+                            new osg::Box(osg::Vec3(i,0,0),1.0)));
+            ok = osgDB::writeNodeFile(*geode,ss.str());
+        }
+
+        if(!ok)
+        {
+            std::cerr << "LoaderBench Error: unable to write " << ss.str()
+                    << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readFile(std::string file, bool images)
+{
+    if(images)
+    {
+        return osgDB::readImageFile(file).valid();
+    }
+    return osgDB::readNodeFile(file).valid();
+}
+
+/**
+ * Reads a list of files in order, like a job used to
+ */
+class ReadThread : public OpenThreads::Thread
+{
+    public:
+        ReadThread(std::vector<std::string> files, bool images)
+        {
+            _files = files;
+            _images = images;
+            _ok = true;
+        }
+
+        virtual void run()
+        {
+            for(int i = 0; i < (int)_files.size(); i++)
+            {
+                _ok = readFile(_files[i],_images) && _ok;
+            }
+        }
+
+        bool _ok;
+
+    protected:
+        std::vector<std::string> _files;
+        bool _images;
+};
+
+double readThreads(std::vector<std::string> & files, bool images,
+        bool perFile)
+{
+    osg::Timer * timer = osg::Timer::instance();
+    osg::Timer_t start = timer->tick();
+
+    std::vector<ReadThread*> threads;
+    if(perFile)
+    {
+        for(int i = 0; i < (int)files.size(); i++)
+        {
+            threads.push_back(
+                    new ReadThread(std::vector<std::string>(1,files[i]),
+                            images));
+        }
+    }
+    else
+    {
+        threads.push_back(new ReadThread(files,images));
+    }
+
+    for(int i = 0; i < (int)threads.size(); i++)
+    {
+        threads[i]->start();
+    }
+    for(int i = 0; i < (int)threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    return timer->delta_s(start,timer->tick());
+}
+
+double readLoader(std::vector<std::string> & files, bool images, bool perFile)
+{
+    ThreadedLoader * loader = ThreadedLoader::instance();
+    std::vector<osgDB::ReaderWriter::Options*> options;
+
+    osg::Timer * timer = osg::Timer::instance();
+    osg::Timer_t start = timer->tick();
+
+    // job number and item index for each file
+    std::vector<std::pair<int,int> > items;
+    if(perFile)
+    {
+        for(int i = 0; i < (int)files.size(); i++)
+        {
+            int job =
+                    images ? loader->readImageFile(files[i]) :
+                            loader->readNodeFile(files[i]);
+            items.push_back(std::pair<int,int>(job,0));
+        }
+    }
+    else
+    {
+        int job =
+                images ? loader->readImageFiles(files,options) :
+                        loader->readNodeFiles(files,options);
+        for(int i = 0; i < (int)files.size(); i++)
+        {
+            items.push_back(std::pair<int,int>(job,i));
+        }
+    }
+
+    // job status is only synced in the frame update, so wait on the local
+    // per item progress
+    for(int i = 0; i < (int)items.size(); i++)
+    {
+        while(!loader->isItemDone(items[i].first,items[i].second))
+        {
+            OpenThreads::Thread::microSleep(100);
+        }
+    }
+
+    double seconds = timer->delta_s(start,timer->tick());
+
+    for(int i = 0; i < (int)items.size(); i++)
+    {
+        if(!items[i].second)
+        {
+            loader->remove(items[i].first);
+        }
+    }
+
+    return seconds;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " times ThreadedLoader reads of many small files.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--files <num>",
+            "Number of files to load, default: 500");
+    ap.getApplicationUsage()->addCommandLineOption("--threads <num>",
+            "ThreadedLoader.Threads, default: 4");
+    ap.getApplicationUsage()->addCommandLineOption("--images",
+            "Load images instead of models");
+    ap.getApplicationUsage()->addCommandLineOption("--dir <path>",
+            "Directory to write the files in, default: .");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    int numFiles = 500;
+    ap.read("--files",numFiles);
+    int threads = 4;
+    ap.read("--threads",threads);
+    bool images = ap.read("--images");
+    std::string dir = ".";
+    ap.read("--dir",dir);
+
+    std::string file = "LoaderBench-config.xml";
+    if(!writeConfig(file,threads))
+    {
+        std::cerr << "LoaderBench Error: unable to write " << file
+                << std::endl;
+        return 1;
+    }
+    setEnv("CALVR_CONFIG_DIR",".");
+    setEnv("CALVR_CONFIG_FILE",file);
+
+    // ComController gets the host name from the CalVR instance
+    new CalVR();
+
+    ConfigManager * config = new ConfigManager();
+    if(!config->init())
+    {
+        std::cerr << "LoaderBench Error: loading config." << std::endl;
+        return 1;
+    }
+
+    if(!ComController::instance()->init(&ap)
+            || !ThreadedLoader::instance()->init())
+    {
+        std::cerr << "LoaderBench Error: starting ComController." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    if(!writeFiles(dir,numFiles,images,files))
+    {
+        return 1;
+    }
+
+    // warm the file cache and the reader plugins
+    readThreads(files,images,false);
+
+    std::cout << "Files: " << numFiles << (images ? " images" : " models")
+            << " loader threads: " << threads << std::endl;
+    std::cout << "One thread, in order: "
+            << readThreads(files,images,false) * 1000.0 << " ms" << std::endl;
+    std::cout << "One thread per file: "
+            << readThreads(files,images,true) * 1000.0 << " ms" << std::endl;
+    std::cout << "Pool, one list job: "
+            << readLoader(files,images,false) * 1000.0 << " ms" << std::endl;
+    std::cout << "Pool, one job per file: "
+            << readLoader(files,images,true) * 1000.0 << " ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file PickBench.cpp
+ *
+ * Microbenchmark of pointer picking over registered object bounds.  Random
+ * boxes are placed in a volume that grows with the object count and a ray per
+ * hand is cast into it each frame.  Testing every box against every ray, like
+ * the old SceneManager::updateActiveObject loop, is compared with a
+ * BoundingVolumeHierarchy query, with and without some of the boxes moving.
+ */
+
+#include <cvrUtil/BoundingVolumeHierarchy.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+
+using namespace cvr;
+
+namespace
+{
+
+float random(float min, float max)
+{
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+osg::BoundingBox randomBox(float side)
+{
+    osg::Vec3 center(random(0,side),random(0,side),random(0,side));
+    float size = random(0.1,1.0);
+    osg::Vec3 half(size,size,size);
+    return osg::BoundingBox(center - half,center + half);
+}
+
+/**
+ * Slab test, forward of the start point only
+ */
+bool hitsBox(const osg::BoundingBox & bound, const osg::Vec3 & start,
+        const osg::Vec3 & dir)
+{
+    float tmin = 0.0;
+    float tmax = 1.0e30;
+    for(int i = 0; i < 3; i++)
+    {
+        float inv = 1.0 / dir[i];
+        float t1 = (bound._min[i] - start[i]) * inv;
+        float t2 = (bound._max[i] - start[i]) * inv;
+        if(t1 > t2)
+        {
+            std::swap(t1,t2);
+        }
+        tmin = t1 > tmin ? t1 : tmin;
+        tmax = t2 < tmax ? t2 : tmax;
+        if(tmin > tmax)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Result
+{
+        double build;
+        double linear;
+        double query;
+        double refitQuery;
+        double hits;
+};
+
+void runCount(int count, int hands, int frames, float moving, Result & result)
+{
+    // about one object per 1000 cubic units at every count
+    float side = 10.0 * pow((double)count,1.0 / 3.0);
+
+    std::vector<osg::BoundingBox> boxes(count);
+    for(int i = 0; i < count; i++)
+    {
+        boxes[i] = randomBox(side);
+    }
+
+    std::vector<std::vector<osg::Vec3> > starts(frames);
+    std::vector<std::vector<osg::Vec3> > dirs(frames);
+    for(int f = 0; f < frames; f++)
+    {
+        for(int h = 0; h < hands; h++)
+        {
+            starts[f].push_back(osg::Vec3(random(0,side),random(0,side),0.0));
+            dirs[f].push_back(
+                    osg::Vec3(random(-0.5,0.5),random(-0.5,0.5),1.0));
+        }
+    }
+
+    osg::Timer * timer = osg::Timer::instance();
+
+    osg::Timer_t start = timer->tick();
+    BoundingVolumeHierarchy bvh;
+    for(int i = 0; i < count; i++)
+    {
+        bvh.addItem(&boxes[i],boxes[i]);
+    }
+    bvh.build();
+    result.build = timer->delta_s(start,timer->tick());
+
+    int linearHits = 0;
+    start = timer->tick();
+    for(int f = 0; f < frames; f++)
+    {
+        for(int h = 0; h < hands; h++)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                if(hitsBox(boxes[i],starts[f][h],dirs[f][h]))
+                {
+                    linearHits++;
+                }
+            }
+        }
+    }
+    result.linear = timer->delta_s(start,timer->tick()) / frames;
+
+    int bvhHits = 0;
+    std::vector<std::vector<void*> > hits;
+    start = timer->tick();
+    for(int f = 0; f < frames; f++)
+    {
+        bvh.intersect(starts[f],dirs[f],hits);
+        for(int h = 0; h < hands; h++)
+        {
+            bvhHits += hits[h].size();
+        }
+    }
+    result.query = timer->delta_s(start,timer->tick()) / frames;
+
+    if(bvhHits != linearHits)
+    {
+        std::cerr << "PickBench Error: " << bvhHits << " tree hits, "
+                << linearHits << " linear hits." << std::endl;
+    }
+
+    int numMoving = (int)(count * moving);
+    std::vector<std::vector<std::pair<int,osg::BoundingBox> > > moves(frames);
+    for(int f = 0; f < frames; f++)
+    {
+        for(int i = 0; i < numMoving; i++)
+        {
+            int item = rand() % count;
+            osg::Vec3 offset(random(-0.5,0.5),random(-0.5,0.5),
+                    random(-0.5,0.5));
+            const osg::BoundingBox & bound = boxes[item];
+            moves[f].push_back(
+                    std::pair<int,osg::BoundingBox>(item,
+                            osg::BoundingBox(bound._min + offset,
+                                    bound._max + offset)));
+        }
+    }
+
+    start = timer->tick();
+    for(int f = 0; f < frames; f++)
+    {
+        for(int i = 0; i < (int)moves[f].size(); i++)
+        {
+            bvh.setItemBound(moves[f][i].first,moves[f][i].second);
+        }
+        bvh.refit();
+        bvh.intersect(starts[f],dirs[f],hits);
+    }
+    result.refitQuery = timer->delta_s(start,timer->tick()) / frames;
+
+    result.hits = linearHits / (double)(frames * hands);
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " compares linear and tree pointer picking over object bounds.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--objects <num>",
+            "Only run this object count, default: 10 to 100000");
+    ap.getApplicationUsage()->addCommandLineOption("--hands <num>",
+            "Rays cast each frame, default: 2");
+    ap.getApplicationUsage()->addCommandLineOption("--frames <num>",
+            "Frames timed at each count, default: 200");
+    ap.getApplicationUsage()->addCommandLineOption("--moving <percent>",
+            "Percent of the objects moved each frame, default: 1");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    std::vector<int> counts;
+    int objects;
+    if(ap.read("--objects",objects))
+    {
+        counts.push_back(objects);
+    }
+    else
+    {
+        for(int i = 10; i <= 100000; i *= 10)
+        {
+            counts.push_back(i);
+        }
+    }
+    int hands = 2;
+    ap.read("--hands",hands);
+    int frames = 200;
+    ap.read("--frames",frames);
+    int moving = 1;
+    ap.read("--moving",moving);
+
+    if(hands < 1 || frames < 1 || moving < 0 || moving > 100)
+    {
+        std::cerr << "PickBench Error: invalid options." << std::endl;
+        return 1;
+    }
+
+    srand(1);
+
+    std::cout << "Hands: " << hands << " frames: " << frames << " moving: "
+            << moving << "%" << std::endl;
+    std::cout << "objects  hits/ray  build ms  linear us  tree us"
+            << "  tree+refit us" << std::endl;
+    for(int i = 0; i < (int)counts.size(); i++)
+    {
+        if(counts[i] < 1)
+        {
+            continue;
+        }
+
+        Result result;
+        runCount(counts[i],hands,frames,moving / 100.0,result);
+        std::cout << counts[i] << "  " << result.hits << "  "
+                << result.build * 1000.0 << "  "
+                << result.linear * 1000000.0 << "  "
+                << result.query * 1000000.0 << "  "
+                << result.refitQuery * 1000000.0 << std::endl;
+    }
+
+    return 0;
+}
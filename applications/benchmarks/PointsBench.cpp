@@ -0,0 +1,164 @@
+/**
+ * @file PointsBench.cpp
+ *
+ * Benchmark of PointsNode updates.  A number of points are changed every
+ * frame, one call at a time without a batch, then inside a beginBatch/endBatch
+ * pair, for scattered points and for a block of points.  Each run draws the
+ * points in a viewer window so the buffer uploads are part of the frame time.
+ */
+
+#include <cvrUtil/PointsNode.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <osgViewer/Viewer>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+using namespace cvr;
+
+namespace
+{
+
+enum UpdateMode
+{
+    UPDATE_SINGLE = 0,
+    UPDATE_BATCH,
+    UPDATE_BATCH_BLOCK
+};
+
+float random(float min, float max)
+{
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+void updatePoints(PointsNode * points, UpdateMode mode, int numPoints,
+        int changes, int frame)
+{
+    if(mode != UPDATE_SINGLE)
+    {
+        points->beginBatch();
+    }
+
+    int block = (frame * changes) % numPoints;
+    for(int i = 0; i < changes; i++)
+    {
+        int index =
+                mode == UPDATE_BATCH_BLOCK ? (block + i) % numPoints :
+                        rand() % numPoints;
+        points->setPoint(index,
+                osg::Vec3(random(-1,1),random(-1,1),random(-1,1)),
+                osg::Vec4ub(rand() % 256,rand() % 256,rand() % 256,255),
+                0.01,2.0);
+    }
+
+    if(mode != UPDATE_SINGLE)
+    {
+        points->endBatch();
+    }
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " compares single and batched PointsNode updates.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--points <num>",
+            "Number of points, default: 1000000");
+    ap.getApplicationUsage()->addCommandLineOption("--changes <num>",
+            "Points changed each frame, default: 20000");
+    ap.getApplicationUsage()->addCommandLineOption("--frames <num>",
+            "Frames timed for each mode, default: 300");
+    ap.getApplicationUsage()->addCommandLineOption("--noDraw",
+            "Only time the updates, without a viewer");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    int numPoints = 1000000;
+    ap.read("--points",numPoints);
+    int changes = 20000;
+    ap.read("--changes",changes);
+    int frames = 300;
+    ap.read("--frames",frames);
+    bool draw = !ap.read("--noDraw");
+
+    if(numPoints < 1 || changes < 0 || frames < 1)
+    {
+        std::cerr << "PointsBench Error: invalid options." << std::endl;
+        return 1;
+    }
+
+    srand(1);
+
+    std::cout << "Points: " << numPoints << " changes per frame: " << changes
+            << " frames: " << frames << (draw ? "" : " no draw")
+            << std::endl;
+
+    const char * names[3] = {"single calls","batch, scattered",
+            "batch, block"};
+    for(int mode = UPDATE_SINGLE; mode <= UPDATE_BATCH_BLOCK; mode++)
+    {
+        osg::ref_ptr<PointsNode> points = new PointsNode(
+                PointsNode::POINTS_GL_POINTS,numPoints,2.0,0.01,
+                osg::Vec4ub(255,255,255,255));
+        points->beginBatch();
+        for(int i = 0; i < numPoints; i++)
+        {
+            points->setPointPosition(i,
+                    osg::Vec3(random(-1,1),random(-1,1),random(-1,1)));
+        }
+        points->endBatch();
+
+        osgViewer::Viewer viewer;
+        if(draw)
+        {
+            viewer.setSceneData(points.get());
+            viewer.setUpViewInWindow(50,50,800,600);
+            viewer.realize();
+            // first frames do the full uploads
+            for(int i = 0; i < 5; i++)
+            {
+                viewer.frame();
+            }
+        }
+
+        osg::Timer * timer = osg::Timer::instance();
+        double updateTotal = 0.0;
+        osg::Timer_t start = timer->tick();
+        for(int f = 0; f < frames; f++)
+        {
+            osg::Timer_t updateStart = timer->tick();
+            updatePoints(points.get(),(UpdateMode)mode,numPoints,changes,f);
+            updateTotal += timer->delta_s(updateStart,timer->tick());
+
+            if(draw)
+            {
+                viewer.frame();
+            }
+        }
+        double total = timer->delta_s(start,timer->tick());
+
+        std::cout << names[mode] << ": frame avg: "
+                << (total / frames) * 1000.0 << " ms update avg: "
+                << (updateTotal / frames) * 1000.0 << " ms, "
+                << (updateTotal > 0.0 ? (changes * (double)frames)
+                        / updateTotal : 0.0) << " points/s" << std::endl;
+    }
+
+    return 0;
+}
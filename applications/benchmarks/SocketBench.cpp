@@ -0,0 +1,239 @@
+/**
+ * @file SocketBench.cpp
+ *
+ * Loopback benchmark of CVRSocket multi-part sends.  Each message is a
+ * header, a number of body structs and a payload, like a collaborative
+ * update.  It is sent one part per send call, as one sendv, and one part per
+ * send call while corked, and the message rate and send calls per message are
+ * reported for each.
+ */
+
+#include <cvrUtil/CVRSocket.h>
+#include <cvrUtil/MultiListenSocket.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+using namespace cvr;
+
+namespace
+{
+
+const int HEADER_SIZE = 16;
+const int BODY_SIZE = 28;
+const int CORK_BATCH = 32;
+
+enum SendMode
+{
+    SEND_PARTS = 0,
+    SEND_VECTOR,
+    SEND_CORKED
+};
+
+/**
+ * Reads whole messages until the count is reached
+ */
+class Receiver : public OpenThreads::Thread
+{
+    public:
+        Receiver(CVRSocket * socket, int size, int count)
+        {
+            _socket = socket;
+            _size = size;
+            _count = count;
+            _ok = true;
+        }
+
+        virtual void run()
+        {
+            std::vector<char> buffer(_size);
+            for(int i = 0; i < _count; i++)
+            {
+                if(!_socket->recv(&buffer[0],_size))
+                {
+                    _ok = false;
+                    return;
+                }
+            }
+        }
+
+        bool _ok;
+
+    protected:
+        CVRSocket * _socket;
+        int _size;
+        int _count;
+};
+
+bool connectPair(int port, CVRSocket *& sender, CVRSocket *& receiver)
+{
+    MultiListenSocket listen(port);
+    if(!listen.setup())
+    {
+        return false;
+    }
+
+    sender = new CVRSocket(CONNECT,"127.0.0.1",port);
+    if(!sender->valid() || !sender->connect())
+    {
+        return false;
+    }
+    sender->setNoDelay(true);
+
+    receiver = NULL;
+    while(!receiver)
+    {
+        receiver = listen.accept();
+    }
+    receiver->setNoDelay(true);
+    return true;
+}
+
+bool runMode(SendMode mode, std::vector<SocketBuffer> & parts, int count,
+        int port, double & seconds)
+{
+    CVRSocket * sender;
+    CVRSocket * receiver;
+    if(!connectPair(port,sender,receiver))
+    {
+        std::cerr << "SocketBench Error: unable to connect on port " << port
+                << std::endl;
+        return false;
+    }
+
+    int size = 0;
+    for(int i = 0; i < (int)parts.size(); i++)
+    {
+        size += parts[i].len;
+    }
+
+    Receiver thread(receiver,size,count);
+    thread.start();
+
+    osg::Timer * timer = osg::Timer::instance();
+    osg::Timer_t start = timer->tick();
+
+    bool ok = true;
+    for(int i = 0; i < count && ok; i++)
+    {
+        switch(mode)
+        {
+            case SEND_VECTOR:
+                ok = sender->sendv(&parts[0],parts.size());
+                break;
+            case SEND_CORKED:
+                if(i % CORK_BATCH == 0)
+                {
+                    sender->setCork(true);
+                }
+                // corked messages still go one part per send
+            case SEND_PARTS:
+                for(int j = 0; j < (int)parts.size() && ok; j++)
+                {
+                    ok = sender->send(parts[j].data,parts[j].len);
+                }
+                if(mode == SEND_CORKED
+                        && (i % CORK_BATCH == CORK_BATCH - 1 || i == count - 1))
+                {
+                    sender->setCork(false);
+                }
+                break;
+        }
+    }
+
+    thread.join();
+    seconds = timer->delta_s(start,timer->tick());
+
+    ok = ok && thread._ok;
+    delete sender;
+    delete receiver;
+    return ok;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " compares multi-part CVRSocket sends over loopback.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--bodies <num>",
+            "Body structs per message, default: 8");
+    ap.getApplicationUsage()->addCommandLineOption("--payload <bytes>",
+            "Payload bytes per message, default: 256");
+    ap.getApplicationUsage()->addCommandLineOption("--count <num>",
+            "Messages sent in each mode, default: 100000");
+    ap.getApplicationUsage()->addCommandLineOption("--port <port number>",
+            "First port to use, default: 11400");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    int bodies = 8;
+    ap.read("--bodies",bodies);
+    int payload = 256;
+    ap.read("--payload",payload);
+    int count = 100000;
+    ap.read("--count",count);
+    int port = 11400;
+    ap.read("--port",port);
+
+    std::vector<char> header(HEADER_SIZE,'h');
+    std::vector<char> body(BODY_SIZE * (bodies > 0 ? bodies : 1),'b');
+    std::vector<char> data(payload > 0 ? payload : 1,'p');
+
+    std::vector<SocketBuffer> parts;
+    SocketBuffer buffer;
+    buffer.data = &header[0];
+    buffer.len = HEADER_SIZE;
+    parts.push_back(buffer);
+    for(int i = 0; i < bodies; i++)
+    {
+        buffer.data = &body[i * BODY_SIZE];
+        buffer.len = BODY_SIZE;
+        parts.push_back(buffer);
+    }
+    if(payload > 0)
+    {
+        buffer.data = &data[0];
+        buffer.len = payload;
+        parts.push_back(buffer);
+    }
+
+    int size = HEADER_SIZE + bodies * BODY_SIZE + (payload > 0 ? payload : 0);
+    std::cout << "Message: " << parts.size() << " parts, " << size
+            << " bytes, " << count << " messages" << std::endl;
+
+    const char * names[3] = {"send per part","sendv","corked sends"};
+    for(int mode = SEND_PARTS; mode <= SEND_CORKED; mode++)
+    {
+        double seconds;
+        if(!runMode((SendMode)mode,parts,count,port + mode,seconds))
+        {
+            return 1;
+        }
+
+        int calls = mode == SEND_VECTOR ? 1 : parts.size();
+        std::cout << names[mode] << ": " << count / seconds << " msgs/s, "
+                << (size * (double)count) / (seconds * 1024.0 * 1024.0)
+                << " MB/s, " << calls << " send calls per message"
+                << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+/**
+ * @file TrackerJitterBench.cpp
+ *
+ * Benchmark of the handoff between a threaded tracking system and the frame
+ * update.  A tracking thread polls a synthetic device that takes a set time
+ * per read, while a frame thread reads the bodies at the frame rate.  The
+ * handoff is done with the lock shared over the whole poll, as TrackingManager
+ * used to, and with the triple buffer TrackingManager uses now.  The time the
+ * frame spends reading the tracking state is reported for each.
+ */
+
+#include <cvrInput/TrackerBase.h>
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+using namespace cvr;
+
+namespace
+{
+
+const unsigned int STATE_FRESH = 0x4;
+
+enum HandoffMode
+{
+    HANDOFF_LOCKED = 0,
+    HANDOFF_TRIPLE_BUFFER
+};
+
+/**
+ * Shared state between the tracking thread and the frame thread
+ */
+struct Handoff
+{
+        HandoffMode mode;
+        int numBodies;
+        OpenThreads::Mutex lock; ///< held over the whole poll in locked mode
+        std::vector<TrackerBase::TrackedBody> locked; ///< bodies in locked mode
+        std::vector<TrackerBase::TrackedBody> buffers[3]; ///< triple buffer
+        unsigned int writeIndex; ///< buffer owned by the tracking thread
+        unsigned int readIndex; ///< buffer owned by the frame thread
+        OpenThreads::Atomic pendingIndex; ///< last published buffer, with STATE_FRESH if unread
+        OpenThreads::Atomic quit;
+        OpenThreads::Atomic polls;
+};
+
+void busyWait(double seconds)
+{
+    osg::Timer * timer = osg::Timer::instance();
+    osg::Timer_t start = timer->tick();
+    while(timer->delta_s(start,timer->tick()) < seconds)
+    {
+    }
+}
+
+void readDevice(TrackerBase::TrackedBody * bodies, int numBodies, int poll,
+        double readTime)
+{
+    // stands in for a blocking device or network read
+    busyWait(readTime);
+
+    for(int i = 0; i < numBodies; i++)
+    {
+        bodies[i].x = bodies[i].y = bodies[i].z = (float)poll;
+        bodies[i].qx = bodies[i].qy = bodies[i].qz = 0.0;
+        bodies[i].qw = 1.0;
+    }
+}
+
+/**
+ * Polls the synthetic device at a fixed rate
+ */
+class TrackingThread : public OpenThreads::Thread
+{
+    public:
+        TrackingThread(Handoff * handoff, double readTime, double period)
+        {
+            _handoff = handoff;
+            _readTime = readTime;
+            _period = period;
+        }
+
+        virtual void run()
+        {
+            osg::Timer * timer = osg::Timer::instance();
+            int poll = 0;
+            while(!_handoff->quit)
+            {
+                osg::Timer_t start = timer->tick();
+
+                if(_handoff->mode == HANDOFF_LOCKED)
+                {
+                    _handoff->lock.lock();
+                    readDevice(&_handoff->locked[0],_handoff->numBodies,poll,
+                            _readTime);
+                    _handoff->lock.unlock();
+                }
+                else
+                {
+                    std::vector<TrackerBase::TrackedBody> & state =
+                            _handoff->buffers[_handoff->writeIndex];
+                    readDevice(&state[0],_handoff->numBodies,poll,_readTime);
+                    unsigned int last = _handoff->pendingIndex.exchange(
+                            _handoff->writeIndex | STATE_FRESH);
+                    _handoff->writeIndex = last & ~STATE_FRESH;
+                }
+
+                poll++;
+                ++_handoff->polls;
+
+                double remaining = _period
+                        - timer->delta_s(start,timer->tick());
+                if(remaining > 0.0)
+                {
+                    OpenThreads::Thread::microSleep(
+                            (unsigned int)(remaining * 1000000.0));
+                }
+            }
+        }
+
+    protected:
+        Handoff * _handoff;
+        double _readTime;
+        double _period;
+};
+
+void readState(Handoff & handoff, TrackerBase::TrackedBody * bodies)
+{
+    int size = handoff.numBodies * sizeof(struct TrackerBase::TrackedBody);
+    if(handoff.mode == HANDOFF_LOCKED)
+    {
+        handoff.lock.lock();
+        memcpy(bodies,&handoff.locked[0],size);
+        handoff.lock.unlock();
+        return;
+    }
+
+    if(handoff.pendingIndex & STATE_FRESH)
+    {
+        unsigned int last = handoff.pendingIndex.exchange(handoff.readIndex);
+        handoff.readIndex = last & ~STATE_FRESH;
+    }
+    memcpy(bodies,&handoff.buffers[handoff.readIndex][0],size);
+}
+
+void runMode(HandoffMode mode, int numBodies, int frames, double frameTime,
+        double readTime, double pollPeriod, std::vector<double> & waits,
+        int & polls)
+{
+    Handoff handoff;
+    handoff.mode = mode;
+    handoff.numBodies = numBodies;
+    handoff.locked.resize(numBodies);
+    for(int i = 0; i < 3; i++)
+    {
+        handoff.buffers[i].resize(numBodies);
+    }
+    handoff.writeIndex = 0;
+    handoff.readIndex = 1;
+    handoff.pendingIndex.exchange(2);
+
+    TrackingThread thread(&handoff,readTime,pollPeriod);
+    thread.start();
+
+    std::vector<TrackerBase::TrackedBody> bodies(numBodies);
+    osg::Timer * timer = osg::Timer::instance();
+    waits.clear();
+    for(int f = 0; f < frames; f++)
+    {
+        osg::Timer_t start = timer->tick();
+        readState(handoff,&bodies[0]);
+        waits.push_back(timer->delta_s(start,timer->tick()));
+
+        // the rest of the frame
+        double remaining = frameTime - timer->delta_s(start,timer->tick());
+        if(remaining > 0.0)
+        {
+            OpenThreads::Thread::microSleep(
+                    (unsigned int)(remaining * 1000000.0));
+        }
+    }
+
+    handoff.quit.exchange(1);
+    thread.join();
+    polls = handoff.polls;
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    osg::ArgumentParser ap(&argc,argv);
+
+    ap.getApplicationUsage()->setApplicationName(ap.getApplicationName());
+    ap.getApplicationUsage()->setDescription(
+            ap.getApplicationName()
+                    + " times the frame side read of threaded tracking state.");
+    ap.getApplicationUsage()->setCommandLineUsage(
+            ap.getApplicationName() + " [options]");
+    ap.getApplicationUsage()->addCommandLineOption("--bodies <num>",
+            "Tracked bodies, default: 12");
+    ap.getApplicationUsage()->addCommandLineOption("--frames <num>",
+            "Frames timed in each mode, default: 2000");
+    ap.getApplicationUsage()->addCommandLineOption("--fps <rate>",
+            "Frame rate, default: 90");
+    ap.getApplicationUsage()->addCommandLineOption("--pollRate <rate>",
+            "Tracking thread poll rate, default: 250");
+    ap.getApplicationUsage()->addCommandLineOption("--readTime <us>",
+            "Time of each device read in microseconds, default: 500");
+    ap.getApplicationUsage()->addCommandLineOption("-h or --help",
+            "Display command line parameters");
+
+    if(ap.read("-h") || ap.read("--help"))
+    {
+        ap.getApplicationUsage()->write(std::cout);
+        return 0;
+    }
+
+    int numBodies = 12;
+    ap.read("--bodies",numBodies);
+    int frames = 2000;
+    ap.read("--frames",frames);
+    int fps = 90;
+    ap.read("--fps",fps);
+    int pollRate = 250;
+    ap.read("--pollRate",pollRate);
+    int readTime = 500;
+    ap.read("--readTime",readTime);
+
+    if(numBodies < 1 || frames < 1 || fps < 1 || pollRate < 1)
+    {
+        std::cerr << "TrackerJitterBench Error: invalid options." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Bodies: " << numBodies << " frames: " << frames << " fps: "
+            << fps << " poll rate: " << pollRate << " read time: " << readTime
+            << " us" << std::endl;
+
+    const char * names[2] = {"locked","triple buffer"};
+    for(int mode = HANDOFF_LOCKED; mode <= HANDOFF_TRIPLE_BUFFER; mode++)
+    {
+        std::vector<double> waits;
+        int polls;
+        runMode((HandoffMode)mode,numBodies,frames,1.0 / fps,
+                readTime / 1000000.0,1.0 / pollRate,waits,polls);
+
+        double total = 0.0;
+        for(int i = 0; i < (int)waits.size(); i++)
+        {
+            total += waits[i];
+        }
+        std::sort(waits.begin(),waits.end());
+
+        std::cout << names[mode] << ": read avg: "
+                << (total / waits.size()) * 1000000.0 << " us p99: "
+                << waits[(waits.size() * 99) / 100] * 1000000.0 << " us max: "
+                << waits.back() * 1000000.0 << " us, " << polls << " polls"
+                << std::endl;
+    }
+
+    return 0;
+}
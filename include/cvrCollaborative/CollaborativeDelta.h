@@ -0,0 +1,92 @@
+/**
+ * @file CollaborativeDelta.h
+ */
+#ifndef CVR_COLLABORATIVE_DELTA_H
+#define CVR_COLLABORATIVE_DELTA_H
+
+#include <cvrCollaborative/Export.h>
+#include <cvrCollaborative/CollaborativeManager.h>
+
+#include <vector>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup collab
+ * @{
+ */
+
+/**
+ * @brief Encoding used by delta collaborative updates, shared by the client
+ * and the server
+ *
+ * Positions are quantized to COLLAB_POSITION_STEP and rotations are sent as
+ * the three smallest quaternion components.  A body is only sent when its
+ * packed value changes, so both ends hold the same packed state and error
+ * does not build up.
+ */
+class CVRCOLLAB_EXPORT CollaborativeDelta
+{
+    public:
+        /**
+         * @brief Quantize a body
+         */
+        static void packBody(const BodyUpdate & body,
+                PackedBodyUpdate & packed);
+
+        /**
+         * @brief Expand a quantized body
+         */
+        static void unpackBody(const PackedBodyUpdate & packed,
+                BodyUpdate & body);
+
+        /**
+         * @brief Get the size in bytes of the body mask for a client
+         */
+        static int getMaskSize(int numBodies)
+        {
+            return (numBodies + 7) / 8;
+        }
+
+        /**
+         * @brief Append a client block
+         * @param out buffer to append to
+         * @param id client id
+         * @param update object space transform, NULL if it did not change
+         * @param numBodies number of client bodies
+         * @param bodies packed bodies, heads first
+         * @param changed which bodies to write
+         */
+        static void writeClient(std::vector<char> & out, int id,
+                const ClientUpdate * update, int numBodies,
+                const PackedBodyUpdate * bodies,
+                const std::vector<bool> & changed);
+
+        /**
+         * @brief Read the start of a client block
+         * @param update set if the block has an object space transform
+         * @return bytes used, -1 if the data is too short
+         */
+        static int readClientHeader(const char * data, int size,
+                DeltaClientHeader & header, ClientUpdate & update);
+
+        /**
+         * @brief Read the body mask and bodies of a client block
+         * @param bodies full body state, changed bodies are updated
+         * @param packed if not NULL, changed packed bodies are updated
+         * @param versions if not NULL, set to version for each changed body
+         * @return bytes used, -1 if the data is too short
+         */
+        static int readBodies(const char * data, int size, int numBodies,
+                BodyUpdate * bodies, PackedBodyUpdate * packed = NULL,
+                int * versions = NULL, int version = 0);
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
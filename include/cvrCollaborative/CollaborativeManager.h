@@ -10,6 +10,7 @@
 #include <map>
 #include <vector>
 #include <queue>
+#include <deque>
 
 #include <osg/MatrixTransform>
 
@@ -117,6 +118,68 @@ struct ClientInitInfo
         int numHands; ///< number of tracked hands
 };
 
+/**
+ * @brief Protocol version with delta body updates
+ *
+ * A client that supports it puts COLLAB_PROTOCOL_MAGIC plus its highest
+ * version in the id field of its ClientInitInfo.  A server that accepts sends
+ * the negated version as an int before the ServerInitInfo.  Older servers
+ * ignore the id field and older clients never set the magic, so both fall
+ * back to full updates.
+ */
+#define COLLAB_PROTOCOL_DELTA 2
+#define COLLAB_PROTOCOL_MAGIC 0x43560000
+#define COLLAB_PROTOCOL_MAGIC_MASK 0xffff0000
+
+/**
+ * @brief Step in world units body positions are quantized to in delta updates
+ */
+#define COLLAB_POSITION_STEP 0.1f
+
+/**
+ * @brief Update sent from a client using delta updates, replaces the
+ * ClientUpdate
+ *
+ * Followed by size bytes holding one client block for this client, then the
+ * message headers and data as with a ClientUpdate.
+ */
+struct DeltaUpdate
+{
+        int numMes; ///< number of collaborative messages to follow
+        int size; ///< size of the client block
+};
+
+/**
+ * @brief Flags for a DeltaClientHeader
+ */
+enum DeltaClientFlags
+{
+    DELTA_CLIENT_UPDATE = 1 ///< the object space transform changed, a ClientUpdate follows
+};
+
+/**
+ * @brief Start of a client block in a delta update
+ *
+ * Followed by a ClientUpdate if the flag is set, then a bit mask of the
+ * client's bodies, heads first, and a PackedBodyUpdate for each set bit.
+ * A server reply to a delta client ends with an int size and the blocks of
+ * each client with changes since its last reply.
+ */
+struct DeltaClientHeader
+{
+        int id; ///< client id, ignored from a client
+        int flags; ///< DeltaClientFlags
+};
+
+/**
+ * @brief Quantized position/rotation of a tracked body
+ */
+struct PackedBodyUpdate
+{
+        int pos[3]; ///< position in COLLAB_POSITION_STEP units
+        unsigned int rot; ///< index of the largest component in the top two bits, then the other three in 10 bits each
+};
+
 class CollaborativeThread;
 class CVRSocket;
 
@@ -293,6 +356,34 @@ class CVRCOLLAB_EXPORT CollaborativeManager
          */
         void processMessage(CollaborativeMessageHeader & cmh, char * data);
 
+        /**
+         * @brief Build this frame's data for the render nodes from the finished
+         *        session update and the staged messages, master only
+         */
+        void packFrame();
+
+        /**
+         * @brief Apply a frame's data on any node
+         * @param updated set if the data had a finished session update
+         * @return false if the session has ended or the data is invalid
+         */
+        bool applyFrame(const char * data, int size, bool & updated);
+
+        /**
+         * @brief Free staged messages that have not been passed on
+         */
+        void clearStagedMessages();
+
+        /**
+         * @brief Plugin message waiting to be passed to the render nodes
+         */
+        struct StagedMessage
+        {
+                CollaborativeMessageHeader header;
+                char * data;
+                int received; ///< bytes of data passed to the render nodes so far
+        };
+
         static CollaborativeManager * _myPtr; ///< static self pointer
 
         std::string _myName; ///< name registered with collaborative session
@@ -318,6 +409,13 @@ class CVRCOLLAB_EXPORT CollaborativeManager
         osg::ref_ptr<osg::Node> _headModelNode;
 
         std::queue<std::pair<CollaborativeMessageHeader,char*> > _messageQueue; ///< queue of collaborative messages to send
+
+        std::deque<StagedMessage> _stagedMessages; ///< plugin messages being passed to the render nodes, same on all nodes
+        int _stagedBytes; ///< message data not yet passed to the render nodes
+        int _frameByteBudget; ///< message data passed each frame, no limit if <= 0
+        int _maxStagedBytes; ///< no new session update is started while more than this is staged
+        bool _updateStarted; ///< if the thread has an update in progress, master only
+        std::vector<char> _frameBuffer; ///< per frame data for the render nodes, reused each frame
 };
 
 /**
@@ -7,6 +7,9 @@
 #include <OpenThreads/Thread>
 #include <OpenThreads/Mutex>
 #include <cvrCollaborative/CollaborativeManager.h>
+#include <cvrUtil/CVRSocket.h>
+
+#include <vector>
 
 #ifdef __APPLE__
 #define MSG_NOSIGNAL SO_NOSIGPIPE
@@ -15,8 +18,6 @@
 namespace cvr
 {
 
-class CVRSocket;
-
 /**
  * @addtogroup collab
  * @{
@@ -32,7 +33,7 @@ class CollaborativeThread : public OpenThreads::Thread
                 std::map<int,struct ClientInitInfo> * clientInitMap);
         ~CollaborativeThread();
 
-        void init(cvr::CVRSocket * socket, int id);
+        void init(cvr::CVRSocket * socket, int id, int protocol = 1);
 
         virtual void run();
 
@@ -54,15 +55,41 @@ class CollaborativeThread : public OpenThreads::Thread
                 CollaborativeMessageHeader * & messageHeaders,
                 char ** & messageData);
 
+        /**
+         * @brief Get traffic and encoding cost of the last finished update
+         * @param bytesSent bytes sent to the server
+         * @param bytesReceived bytes received from the server
+         * @param encodeTime seconds spent encoding the delta update
+         * @param decodeTime seconds spent decoding the delta reply
+         */
+        void getUpdateStats(int & bytesSent, int & bytesReceived,
+                double & encodeTime, double & decodeTime);
+
     protected:
         void processMessage(CollaborativeMessageHeader & cmh, char * data);
 
+        void addSendBuffer(void * data, size_t len);
+        void packDeltaUpdate();
+        bool readDeltaUpdate();
+
+        /**
+         * @brief Last known state of another client when using delta updates
+         */
+        struct ClientState
+        {
+                ClientUpdate update;
+                std::vector<BodyUpdate> bodies; ///< heads first
+        };
+
+        ClientState & getClientState(ClientInitInfo & cii);
+
         bool _connected;
         bool _updating;
         bool _updateDone;
         bool _quit;
 
         int _id;
+        int _protocol; ///< protocol version used with the server
 
         struct ClientUpdate _myInfo;
 
@@ -81,6 +108,21 @@ class CollaborativeThread : public OpenThreads::Thread
         struct CollaborativeMessageHeader * _messageHeaderUpdate;
         char ** _messageDataUpdate;
 
+        std::vector<SocketBuffer> _sendBuffers; ///< gathered into one send each update
+        std::vector<SocketBuffer> _recvBuffers;
+        struct DeltaUpdate _deltaUpdate;
+        std::vector<char> _deltaBuffer;
+        std::vector<PackedBodyUpdate> _packedBodies;
+        std::vector<PackedBodyUpdate> _sentBodies; ///< bodies the server has from the last delta update
+        struct ClientUpdate _sentUpdate; ///< object transform the server has from the last delta update
+        bool _sentUpdateValid;
+        std::map<int,ClientState> _clientState;
+
+        int _bytesSent;
+        int _bytesReceived;
+        double _encodeTime;
+        double _decodeTime;
+
         cvr::CVRSocket * _socket;
 
         OpenThreads::Mutex _quitLock;
@@ -18,6 +18,7 @@ namespace cvr
 {
 
 class ConfigManager;
+class ConfigSnapshot;
 
 /**
  * @addtogroup config cvrConfig
@@ -59,6 +60,16 @@ class CVRCONFIG_EXPORT ConfigFileReader
          */
         virtual bool loadFile(std::string file, bool givePriority = false) = 0;
 
+        /**
+         * @brief Add the loaded tags and source files to a snapshot, in priority order
+         * @return false if this reader can not be flattened, lookups then go
+         *         through the reader
+         */
+        virtual bool flatten(ConfigSnapshot * snapshot)
+        {
+            return false;
+        }
+
         /**
          * @brief Looks for a text config file value in tag path, with the default attribute
          *        "value"
@@ -0,0 +1,180 @@
+/**
+ * @file ConfigIndex.h
+ */
+#ifndef CALVR_CONFIG_INDEX_H
+#define CALVR_CONFIG_INDEX_H
+
+#include <cvrConfig/Export.h>
+
+#include <osg/Referenced>
+#include <OpenThreads/Mutex>
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup config cvrConfig
+ * @{
+ */
+
+/**
+ * @brief Flattened copy of all loaded config files
+ *
+ * Tags are added in document order, with the config files in priority order.
+ * finalize() hashes every attribute by its (attribute, Tag1.Tag2.Tag3) key,
+ * keeping the first tag found like the tree walk in the readers does.  Paths
+ * using the Tag:name form are resolved by walking the flattened tags and the
+ * result is remembered, so each path is only walked once.
+ *
+ * The index is reference counted, so a reload can replace it while other
+ * threads are still reading the old one.
+ */
+class CVRCONFIG_EXPORT ConfigIndex : public osg::Referenced
+{
+    public:
+        ConfigIndex();
+
+        /**
+         * @brief Add a tag to the index, not valid after finalize()
+         * @param parent index of the parent tag, -1 for a top level tag
+         * @param name tag name
+         * @return index of the new tag
+         */
+        int addTag(int parent, const std::string & name);
+
+        /**
+         * @brief Add an attribute to a tag, not valid after finalize()
+         */
+        void addAttribute(int tag, const std::string & name,
+                const std::string & value);
+
+        /**
+         * @brief Build the hash index, no tags can be added after this
+         */
+        void finalize();
+
+        /**
+         * @brief Find the value of an attribute in a tag path
+         * @return pointer to the value, valid for the life of the index, NULL
+         *         if not found
+         */
+        const std::string * find(const std::string & attribute,
+                const std::string & path);
+
+        /**
+         * @brief Find the value of an attribute in all tags that match a path
+         * @return true if any values were found
+         */
+        bool findAll(const std::string & attribute, const std::string & path,
+                std::vector<const std::string *> & values);
+
+        /**
+         * @brief Add the names of the children of all tags that match a path
+         */
+        void getChildren(const std::string & path,
+                std::vector<std::string> & destList);
+
+        /**
+         * @brief Find the tags that differ between two indices
+         * @param oldIndex index before a change
+         * @param newIndex index after a change
+         * @param paths set to the Tag1.Tag2.Tag3 path of each tag added, removed
+         *        or with changed attributes
+         */
+        static void getChangedPaths(ConfigIndex * oldIndex,
+                ConfigIndex * newIndex, std::vector<std::string> & paths);
+
+        /**
+         * @brief Get the number of tags in the index
+         */
+        int getNumTags()
+        {
+            return _tags.size();
+        }
+
+        /**
+         * @brief Get the number of hashed attribute entries
+         */
+        int getNumEntries()
+        {
+            return _entries.entries.size();
+        }
+
+    protected:
+        virtual ~ConfigIndex();
+
+        /**
+         * @brief Flattened config tag
+         */
+        struct Tag
+        {
+                std::string name;
+                std::string fullName; ///< name in the Tag:name path form
+                int parent;
+                int firstChild; ///< -1 if none
+                int lastChild;
+                int next; ///< next sibling, -1 if none
+                std::vector<std::pair<std::string,std::string> > attributes;
+        };
+
+        /**
+         * @brief Hashed attribute value
+         */
+        struct Entry
+        {
+                unsigned int hash;
+                std::string attribute;
+                std::string path;
+                const std::string * value; ///< NULL for a remembered miss
+                int next; ///< next entry in the bucket, -1 if none
+        };
+
+        /**
+         * @brief Chained hash table of entries
+         */
+        struct Table
+        {
+                std::vector<int> buckets;
+                std::vector<Entry> entries;
+
+                int find(unsigned int hash, const std::string & attribute,
+                        const std::string & path) const;
+                void insert(unsigned int hash, const std::string & attribute,
+                        const std::string & path, const std::string * value);
+        };
+
+        static unsigned int hashKey(const std::string & attribute,
+                const std::string & path);
+        static bool isPlainPath(const std::string & path);
+        static void splitPath(const std::string & path,
+                std::vector<std::string> & segments);
+
+        const std::string * getAttribute(int tag,
+                const std::string & attribute) const;
+        void getTagContents(
+                std::map<std::string,std::pair<std::string,std::string> > & contents) const;
+        bool matchTags(int tag, const std::vector<std::string> & segments,
+                int depth, const std::string * attribute, bool firstOnly,
+                std::vector<int> & result) const;
+
+        std::vector<Tag> _tags; ///< all tags in document order
+        int _firstTop; ///< first top level tag, -1 if none
+        int _lastTop; ///< last top level tag
+        bool _finalized;
+
+        Table _entries; ///< plain path entries built by finalize
+        Table _resolved; ///< remembered results of Tag:name path lookups
+        OpenThreads::Mutex _resolvedLock; ///< protects _resolved
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
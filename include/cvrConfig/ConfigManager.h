@@ -12,21 +12,82 @@
 #include <osg/Vec4>
 #include <osg/Vec3d>
 #include <osg/Vec4d>
+#include <osg/ref_ptr>
+#include <OpenThreads/Mutex>
 
 #include <string>
 #include <map>
+#include <set>
 #include <vector>
 
 namespace cvr
 {
 
 class CalVR;
+class ConfigIndex;
+class ConfigSnapshot;
 
 /**
  * @addtogroup config cvrConfig
  * @{
  */
 
+/**
+ * @brief Config lookup that is resolved once, for values read often
+ *
+ * Create with ConfigManager::getHandle() and read with the ConfigManager
+ * functions that take a handle.  The value is looked up again only if the
+ * config is reloaded.
+ */
+class CVRCONFIG_EXPORT ConfigHandle
+{
+        friend class ConfigManager;
+    public:
+        ConfigHandle()
+        {
+            _generation = -1;
+            _found = false;
+        }
+
+        const std::string & getAttribute()
+        {
+            return _attribute;
+        }
+
+        const std::string & getPath()
+        {
+            return _path;
+        }
+
+    protected:
+        std::string _attribute; ///< attribute to look up
+        std::string _path; ///< tag path to look up
+        int _generation; ///< config generation the value was resolved in
+        bool _found; ///< if the entry existed
+        std::string _value; ///< resolved value
+};
+
+/**
+ * @brief Interface for classes notified when the config is reloaded
+ *
+ * Register with ConfigManager::addChangeCallback().  The callback is run from
+ * the main thread at the same point of the frame on every node.
+ */
+class CVRCONFIG_EXPORT ConfigChangeCallback
+{
+    public:
+        virtual ~ConfigChangeCallback()
+        {
+        }
+
+        /**
+         * @brief Called after the config has been reloaded
+         * @param paths Tag1.Tag2.Tag3 path of each tag that was added, removed
+         *        or changed, see ConfigManager::isPathChanged()
+         */
+        virtual void configChanged(const std::vector<std::string> & paths) = 0;
+};
+
 /**
  * @brief Used to read values from the config file(s)
  */
@@ -36,6 +97,41 @@ class CVRCONFIG_EXPORT ConfigManager
     public:
         ConfigManager();
 
+        /**
+         * @brief How the config is shared with the other cluster nodes
+         */
+        enum SnapshotMode
+        {
+            SNAPSHOT_OFF = 0, ///< every node parses the config files
+            SNAPSHOT_SEND, ///< parse the files and keep a snapshot to send to other nodes
+            SNAPSHOT_RECEIVE ///< do not parse, wait for a snapshot with loadSnapshot()
+        };
+
+        /**
+         * @brief Set how the config is shared, must be set before init()
+         */
+        static void setSnapshotMode(SnapshotMode mode)
+        {
+            _snapshotMode = mode;
+        }
+
+        static SnapshotMode getSnapshotMode()
+        {
+            return _snapshotMode;
+        }
+
+        /**
+         * @brief Serialize the loaded config, LOCAL blocks are kept so the
+         *        data is valid on any host
+         * @return false if no snapshot was made, see setSnapshotMode()
+         */
+        static bool getSnapshot(std::vector<char> & data);
+
+        /**
+         * @brief Replace the loaded config with a serialized snapshot
+         */
+        static bool loadSnapshot(const char * data, int size);
+
         /**
          * @brief Get the default CalVR config file directory
          */
@@ -46,6 +142,10 @@ class CVRCONFIG_EXPORT ConfigManager
 
         /**
          * @brief Loads the config file(s) specified by the CalVR environment variables
+         *
+         * If CALVR_CONFIG_CACHE is set to a file path, a snapshot of the parsed
+         * config is saved there and used instead of parsing while the source
+         * files are unchanged.
          */
         bool init();
 
@@ -58,8 +158,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static std::string getEntry(std::string path, std::string def = "",
-                bool * found = NULL);
+        static std::string getEntry(const std::string & path,
+                const std::string & def = "", bool * found = NULL);
 
         /**
          * @brief Looks for a text config file value in tag path with the specified attribute
@@ -70,8 +170,9 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static std::string getEntry(std::string attribute, std::string path,
-                std::string def = "", bool * found = NULL);
+        static std::string getEntry(const std::string & attribute,
+                const std::string & path, const std::string & def = "",
+                bool * found = NULL);
 
         /**
          * @brief Looks for a text config file value in tag path with the specified attribute.
@@ -85,9 +186,9 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static std::string getEntryConcat(std::string attribute,
-                std::string path, char separator, std::string def = "",
-                bool * found = NULL);
+        static std::string getEntryConcat(const std::string & attribute,
+                const std::string & path, char separator,
+                const std::string & def = "", bool * found = NULL);
 
         /**
          * @brief Looks for a float config file value in tag path with the default attribute
@@ -98,8 +199,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static float getFloat(std::string path, float def = 0.0, bool * found =
-        NULL);
+        static float getFloat(const std::string & path, float def = 0.0,
+                bool * found = NULL);
 
         /**
          * @brief Looks for a float config file value in tag path with the specified attribute
@@ -110,8 +211,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static float getFloat(std::string attribute, std::string path,
-                float def = 0.0, bool * found = NULL);
+        static float getFloat(const std::string & attribute,
+                const std::string & path, float def = 0.0, bool * found = NULL);
 
         /**
          * @brief Looks for a double config file value in tag path with the default attribute
@@ -122,7 +223,7 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static double getDouble(std::string path, double def = 0.0,
+        static double getDouble(const std::string & path, double def = 0.0,
                 bool * found = NULL);
 
         /**
@@ -134,8 +235,9 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static double getDouble(std::string attribute, std::string path,
-                double def = 0.0, bool * found = NULL);
+        static double getDouble(const std::string & attribute,
+                const std::string & path, double def = 0.0,
+                bool * found = NULL);
 
         /**
          * @brief Looks for a integer config file value in tag path with the default attribute
@@ -146,7 +248,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static int getInt(std::string path, int def = 0, bool * found = NULL);
+        static int getInt(const std::string & path, int def = 0,
+                bool * found = NULL);
 
         /**
          * @brief Looks for a integer config file value in tag path with the specified attribute
@@ -157,8 +260,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static int getInt(std::string attribute, std::string path, int def = 0,
-                bool * found = NULL);
+        static int getInt(const std::string & attribute,
+                const std::string & path, int def = 0, bool * found = NULL);
 
         /**
          * @brief Looks for a boolean config file value in tag path with the default attribute
@@ -169,8 +272,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static bool getBool(std::string path, bool def = false, bool * found =
-        NULL);
+        static bool getBool(const std::string & path, bool def = false,
+                bool * found = NULL);
 
         /**
          * @brief Looks for a boolean config file value in tag path with the specified attribute
@@ -181,8 +284,9 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static bool getBool(std::string attribute, std::string path, bool def =
-                false, bool * found = NULL);
+        static bool getBool(const std::string & attribute,
+                const std::string & path, bool def = false,
+                bool * found = NULL);
 
         /**
          * @brief Looks for a vector of floats in the tag path with default attributes "x","y","z"
@@ -192,7 +296,7 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec3 getVec3(std::string path,
+        static osg::Vec3 getVec3(const std::string & path,
                 osg::Vec3 def = osg::Vec3(0,0,0), bool * found = NULL);
 
         /**
@@ -207,9 +311,10 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec3 getVec3(std::string attributeX, std::string attributeY,
-                std::string attributeZ, std::string path, osg::Vec3 def =
-                        osg::Vec3(0,0,0), bool * found = NULL);
+        static osg::Vec3 getVec3(const std::string & attributeX,
+                const std::string & attributeY, const std::string & attributeZ,
+                const std::string & path, osg::Vec3 def = osg::Vec3(0,0,0),
+                bool * found = NULL);
 
         /**
          * @brief Looks for a vector of floats in the tag path with default attributes "x","y","z","w"
@@ -219,7 +324,7 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec4 getVec4(std::string path,
+        static osg::Vec4 getVec4(const std::string & path,
                 osg::Vec4 def = osg::Vec4(0,0,0,1), bool * found = NULL);
 
         /**
@@ -235,10 +340,10 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec4 getVec4(std::string attributeX, std::string attributeY,
-                std::string attributeZ, std::string attributeW,
-                std::string path, osg::Vec4 def = osg::Vec4(0,0,0,1),
-                bool * found = NULL);
+        static osg::Vec4 getVec4(const std::string & attributeX,
+                const std::string & attributeY, const std::string & attributeZ,
+                const std::string & attributeW, const std::string & path,
+                osg::Vec4 def = osg::Vec4(0,0,0,1), bool * found = NULL);
 
         /**
          * @brief Looks for a vector of doubles in the tag path with default attributes "x","y","z"
@@ -248,8 +353,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec3d getVec3d(std::string path, osg::Vec3d def =
-                osg::Vec3d(0,0,0), bool * found = NULL);
+        static osg::Vec3d getVec3d(const std::string & path,
+                osg::Vec3d def = osg::Vec3d(0,0,0), bool * found = NULL);
 
         /**
          * @brief Looks for a vector of doubles in the tag path with the specifed attributes for
@@ -263,9 +368,9 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec3d getVec3d(std::string attributeX,
-                std::string attributeY, std::string attributeZ,
-                std::string path, osg::Vec3d def = osg::Vec3d(0,0,0),
+        static osg::Vec3d getVec3d(const std::string & attributeX,
+                const std::string & attributeY, const std::string & attributeZ,
+                const std::string & path, osg::Vec3d def = osg::Vec3d(0,0,0),
                 bool * found = NULL);
 
         /**
@@ -276,8 +381,8 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec4d getVec4d(std::string path, osg::Vec4d def =
-                osg::Vec4d(0,0,0,1), bool * found = NULL);
+        static osg::Vec4d getVec4d(const std::string & path,
+                osg::Vec4d def = osg::Vec4d(0,0,0,1), bool * found = NULL);
 
         /**
          * @brief Looks for a vector of floats in the tag path with the specifed attributes for
@@ -292,10 +397,10 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec4d getVec4d(std::string attributeX,
-                std::string attributeY, std::string attributeZ,
-                std::string attributeW, std::string path, osg::Vec4d def =
-                        osg::Vec4d(0,0,0,1), bool * found = NULL);
+        static osg::Vec4d getVec4d(const std::string & attributeX,
+                const std::string & attributeY, const std::string & attributeZ,
+                const std::string & attributeW, const std::string & path,
+                osg::Vec4d def = osg::Vec4d(0,0,0,1), bool * found = NULL);
 
         /**
          * @brief Looks for a color vector in the tag path with default attributes "r","g","b","a"
@@ -305,7 +410,7 @@ class CVRCONFIG_EXPORT ConfigManager
          * @param found If valid, *found is set to true if the tag existed and false
          *              if the default value was returned
          */
-        static osg::Vec4 getColor(std::string path,
+        static osg::Vec4 getColor(const std::string & path,
                 osg::Vec4 def = osg::Vec4(1,1,1,1), bool * found = NULL);
 
         /**
@@ -317,13 +422,138 @@ class CVRCONFIG_EXPORT ConfigManager
          * Searches through all loaded xml files for the given tag.  If the tag exists
          * in more then one place, the result is a concatination of all children.
          */
-        static void getChildren(std::string path,
+        static void getChildren(const std::string & path,
                 std::vector<std::string> & destList);
 
+        /**
+         * @brief Create a handle for a config value, with the default attribute "value"
+         * @param path Tag to search for in the Tag1.Tag2.Tag3.Tag4 format, where Tag3
+         *             is the parent of Tag4 and Tag2 is the parent of Tag3 etc.
+         */
+        static ConfigHandle getHandle(const std::string & path);
+
+        /**
+         * @brief Create a handle for a config value with the specified attribute
+         * @param attribute Attribute value within the tag to return
+         * @param path Tag to search for in the Tag1.Tag2.Tag3.Tag4 format, where Tag3
+         *             is the parent of Tag4 and Tag2 is the parent of Tag3 etc.
+         */
+        static ConfigHandle getHandle(const std::string & attribute,
+                const std::string & path);
+
+        /**
+         * @brief Get a text config file value through a handle
+         * @param handle handle from getHandle()
+         * @param def The default value to return if the tag is not found
+         * @param found If valid, *found is set to true if the tag existed and false
+         *              if the default value was returned
+         */
+        static std::string getEntry(ConfigHandle & handle,
+                const std::string & def = "", bool * found = NULL);
+
+        /**
+         * @brief Get a float config file value through a handle
+         */
+        static float getFloat(ConfigHandle & handle, float def = 0.0,
+                bool * found = NULL);
+
+        /**
+         * @brief Get a double config file value through a handle
+         */
+        static double getDouble(ConfigHandle & handle, double def = 0.0,
+                bool * found = NULL);
+
+        /**
+         * @brief Get an integer config file value through a handle
+         */
+        static int getInt(ConfigHandle & handle, int def = 0, bool * found =
+                NULL);
+
+        /**
+         * @brief Get a boolean config file value through a handle
+         */
+        static bool getBool(ConfigHandle & handle, bool def = false,
+                bool * found = NULL);
+
+        /**
+         * @brief Register a callback to run when the config is reloaded
+         */
+        static void addChangeCallback(ConfigChangeCallback * callback);
+
+        /**
+         * @brief Remove a registered reload callback
+         */
+        static void removeChangeCallback(ConfigChangeCallback * callback);
+
+        /**
+         * @brief Check if a tag, or any tag below it, is in a changed path list
+         * @param paths list given to ConfigChangeCallback::configChanged()
+         * @param path Tag to check in the Tag1.Tag2.Tag3 format
+         */
+        static bool isPathChanged(const std::vector<std::string> & paths,
+                const std::string & path);
+
+        /**
+         * @brief Start watching the loaded config files for changes, only
+         *        supported on linux
+         */
+        static bool startWatching();
+
+        /**
+         * @brief Check if a watched config file has new contents, does not block
+         */
+        static bool checkForChanges();
+
+        /**
+         * @brief Parse the config files again and replace the loaded config
+         * @param update set to the data other nodes need to make the same
+         *        change with applyUpdate()
+         * @return false if the files could not be parsed, the current config is
+         *         kept
+         *
+         * The callbacks are not run until notifyChanges() is called.
+         */
+        static bool reload(std::vector<char> & update);
+
+        /**
+         * @brief Replace the loaded config with update data from reload() on
+         *        the master
+         */
+        static bool applyUpdate(const char * data, int size);
+
+        /**
+         * @brief Run the change callbacks for any reload since the last call
+         */
+        static void notifyChanges();
+
     protected:
         virtual ~ConfigManager();
 
+        static bool loadFiles(bool keepLocalBlocks,
+                std::vector<ConfigFileReader*> & readers);
+        static ConfigSnapshot * makeSnapshot(
+                std::vector<ConfigFileReader*> & readers);
+        static void findChanges(ConfigIndex * oldIndex, ConfigIndex * newIndex);
+        static osg::ref_ptr<ConfigIndex> buildIndex(ConfigSnapshot * snapshot);
+        static osg::ref_ptr<ConfigIndex> getIndex();
+        static void resolveHandle(ConfigHandle & handle);
+        static bool findEntry(const std::string & attribute,
+                const std::string & path, std::string & result);
+
         static std::vector<ConfigFileReader*> _configFileList; ///< list of all loaded config files
+        static osg::ref_ptr<ConfigIndex> _index; ///< flattened config files, NULL if a reader can not be flattened
+        static OpenThreads::Mutex _indexLock; ///< protects replacing _index, readers take a reference under it
+        static ConfigSnapshot * _snapshot; ///< parsed config the index was made from
+        static SnapshotMode _snapshotMode; ///< how the config is shared with other nodes
+        static int _generation; ///< incremented when the loaded config changes
+        static std::vector<std::string> _fileList; ///< config files given in CALVR_CONFIG_FILE
+        static std::string _key; ///< identifies the requested config for cached snapshots
+        static bool _snapshotShared; ///< if the other nodes have the current snapshot
+        static std::vector<ConfigChangeCallback*> _changeCallbacks;
+        static std::vector<std::string> _changedPaths; ///< changes not yet given to the callbacks
+        static int _watchFD; ///< inotify descriptor, -1 if not watching
+        static std::map<int,std::string> _watchDirs; ///< watched directory for each watch descriptor
+        static std::set<std::string> _watchFiles; ///< config files in the watched directories
         static std::string _configDir; ///< CalVR config file directory
         static bool _debugOutput;
 };
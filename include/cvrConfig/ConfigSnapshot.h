@@ -0,0 +1,178 @@
+/**
+ * @file ConfigSnapshot.h
+ */
+#ifndef CALVR_CONFIG_SNAPSHOT_H
+#define CALVR_CONFIG_SNAPSHOT_H
+
+#include <cvrConfig/Export.h>
+
+#include <string>
+#include <vector>
+
+namespace cvr
+{
+
+class ConfigIndex;
+
+/**
+ * @addtogroup config cvrConfig
+ * @{
+ */
+
+/**
+ * @brief Parsed config tags in a form that can be saved and sent to other nodes
+ *
+ * Holds the tags of all loaded config files, with INCLUDE and GLOBAL blocks
+ * already resolved.  LOCAL blocks are kept, so the same snapshot is valid on
+ * every host and is resolved for a host when the lookup index is created.
+ * Each top level tag is the root of a loaded file, its children are the top
+ * level config tags.
+ */
+class CVRCONFIG_EXPORT ConfigSnapshot
+{
+    public:
+        ConfigSnapshot();
+        virtual ~ConfigSnapshot();
+
+        /**
+         * @brief Add a tag in document order
+         * @param parent index of the parent tag, -1 for a file root
+         * @param name tag name
+         * @return index of the new tag
+         */
+        int addTag(int parent, const std::string & name);
+
+        /**
+         * @brief Add an attribute to a tag
+         */
+        void addAttribute(int tag, const std::string & name,
+                const std::string & value);
+
+        /**
+         * @brief Record a file the config was read from, with a hash of its
+         * contents
+         * @return false if the file could not be read
+         */
+        bool addSourceFile(const std::string & file);
+
+        /**
+         * @brief Set the string identifying the requested config, a cached
+         * snapshot is only used if its key matches
+         */
+        void setKey(const std::string & key)
+        {
+            _key = key;
+        }
+
+        const std::string & getKey()
+        {
+            return _key;
+        }
+
+        /**
+         * @brief Check if all source files still have the recorded contents
+         */
+        bool isCurrent();
+
+        /**
+         * @brief Get the paths of the files the config was read from
+         */
+        void getSourceFiles(std::vector<std::string> & files);
+
+        /**
+         * @brief Get a hash of the serialized snapshot
+         */
+        unsigned long long getHash();
+
+        /**
+         * @brief Create a lookup index with the LOCAL blocks resolved for a host
+         */
+        ConfigIndex * createIndex(const std::string & host);
+
+        /**
+         * @brief Serialize the snapshot
+         */
+        void write(std::vector<char> & data);
+
+        /**
+         * @brief Replace the contents with serialized data
+         * @return false if the data is not a valid snapshot
+         */
+        bool read(const char * data, int size);
+
+        /**
+         * @brief Make the data needed to turn a base snapshot into this one
+         * @param base snapshot the receiver has, NULL to send all of this one
+         * @param data set to the update
+         *
+         * Only the tags between the unchanged start and end of the two
+         * snapshots are sent.
+         */
+        void makeUpdate(ConfigSnapshot * base, std::vector<char> & data);
+
+        /**
+         * @brief Apply update data made by makeUpdate() with this snapshot as
+         *        the base
+         * @return false if the data is invalid or was made from a different base
+         */
+        bool applyUpdate(const char * data, int size);
+
+        /**
+         * @brief Save the snapshot to a file
+         */
+        bool writeFile(const std::string & file);
+
+        /**
+         * @brief Load the snapshot from a file
+         */
+        bool readFile(const std::string & file);
+
+        /**
+         * @brief Get if a LOCAL block host list contains a host
+         * @param hosts comma separated host list
+         * @param host host name to look for
+         */
+        static bool hostMatches(const std::string & hosts,
+                const std::string & host);
+
+    protected:
+        /**
+         * @brief Config tag as parsed
+         */
+        struct Tag
+        {
+                int parent;
+                std::string name;
+                std::vector<std::pair<std::string,std::string> > attributes;
+        };
+
+        /**
+         * @brief File the config was read from
+         */
+        struct SourceFile
+        {
+                std::string file;
+                unsigned long long hash; ///< hash of the file contents
+        };
+
+        static bool hashFile(const std::string & file,
+                unsigned long long & hash);
+        static bool tagEqual(const Tag & first, const Tag & second);
+
+        void addTags(ConfigIndex * index,
+                const std::vector<std::vector<int> > & children,
+                const std::vector<int> & tags, int parent,
+                const std::string & host);
+
+        std::string _key; ///< identifies the requested config
+        std::vector<SourceFile> _sourceFiles; ///< files read to make the snapshot
+        std::vector<Tag> _tags; ///< all tags in document order
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
@@ -28,6 +28,20 @@ class CVRCONFIG_EXPORT XMLReader : public ConfigFileReader
 
         bool loadFile(std::string file, bool givePriority = false);
 
+        bool flatten(ConfigSnapshot * snapshot);
+
+        /**
+         * @brief Keep LOCAL blocks in the loaded tree instead of resolving them
+         *        for this host, used to make a snapshot valid on all hosts
+         *
+         * Must be set before loading.  Lookups through this reader do not see
+         * the contents of kept LOCAL blocks.
+         */
+        void setKeepLocalBlocks(bool b)
+        {
+            _keepLocalBlocks = b;
+        }
+
         std::string getEntry(std::string path, std::string def = "",
                 bool * found = NULL);
 
@@ -96,6 +110,8 @@ class CVRCONFIG_EXPORT XMLReader : public ConfigFileReader
         void getChildren(std::string path, std::vector<std::string> & destList);
     protected:
         std::vector<mxml_node_t *> _configRootList; ///< List of the roots of all loaded xml files
+        std::vector<std::string> _sourceFiles; ///< paths of all loaded xml files
+        bool _keepLocalBlocks; ///< leave LOCAL blocks in the tree
 };
 
 /**
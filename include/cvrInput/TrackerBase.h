@@ -148,6 +148,44 @@ class TrackerBase
             return true;
         }
 
+        /**
+         * @brief Write the current state of this system into the tracking snapshot
+         * @param bodies array to fill with numBodies bodies
+         * @param numBodies number of bodies configured for this system
+         * @param buttonMask location for the button mask
+         * @param vals array to fill with numVals values
+         * @param numVals number of valuators configured for this system
+         *
+         * Bodies that are not available are written at the origin with no rotation.
+         * Systems that keep their state in contiguous arrays can override this
+         * to copy it in bulk
+         */
+        virtual void writeSnapshot(TrackedBody * bodies, int numBodies,
+                unsigned int * buttonMask, float * vals, int numVals)
+        {
+            for(int i = 0; i < numBodies; i++)
+            {
+                TrackedBody * tb = getBody(i);
+                if(tb)
+                {
+                    bodies[i] = *tb;
+                }
+                else
+                {
+                    bodies[i].x = bodies[i].y = bodies[i].z = 0.0;
+                    bodies[i].qx = bodies[i].qy = bodies[i].qz = 0.0;
+                    bodies[i].qw = 1.0;
+                }
+            }
+
+            *buttonMask = getButtonMask();
+
+            for(int i = 0; i < numVals; i++)
+            {
+                vals[i] = getValuator(i);
+            }
+        }
+
         virtual TrackedButtonInteractionEvent * getNewBaseEvent(int body)
         {
             return new TrackedButtonInteractionEvent();
@@ -38,6 +38,9 @@ class TrackerSlave : public TrackerBase
         virtual void update(
                 std::map<int,std::list<InteractionEvent*> > & eventMap);
 
+        virtual void writeSnapshot(TrackedBody * bodies, int numBodies,
+                unsigned int * buttonMask, float * vals, int numVals);
+
         void readValues(TrackedBody * tb, unsigned int * buttons, float * vals);
     protected:
         int _numBodies; ///< number of bodies
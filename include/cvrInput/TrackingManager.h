@@ -11,11 +11,13 @@
 #include <cvrKernel/CalVR.h>
 #include <cvrKernel/Navigation.h>
 #include <cvrKernel/SceneManager.h>
+#include <cvrConfig/ConfigManager.h>
 
 #include <osg/Matrix>
 #include <osg/Vec3>
 #include <OpenThreads/Thread>
 #include <OpenThreads/Mutex>
+#include <OpenThreads/Atomic>
 
 #include <vector>
 #include <queue>
@@ -46,7 +48,8 @@ class GenComplexTrackingEvents;
  *  Generates button interaction events.
  *  Can poll tracking values in a thread.
  */
-class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
+class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread,
+        public ConfigChangeCallback
 {
         friend class GenComplexTrackingEvents;
         friend class CalVR;
@@ -74,7 +77,9 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
          * @brief Driving function for threaded operation.
          *
          * Polls the tracking systems and pushes all tracking events into a queue to be used in the next
-         * update call.  Sleeps to hit a target updates per second.
+         * update call.  State is handed off through a triple buffer, so update never waits on
+         * device reads.  Sleeps until absolute deadlines on a monotonic clock, optionally
+         * phase locked to the frame start.
          */
         virtual void run();
 
@@ -128,6 +133,41 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
          */
         osg::Matrix & getUnfrozenHeadMat(int head = 0);
 
+        /**
+         * @brief Set if tracked bodies are extrapolated to the prediction time
+         *
+         * Only has an effect on the master node, the predicted bodies are
+         * what gets distributed
+         */
+        void setPredictionEnabled(bool b);
+
+        /**
+         * @brief Get if tracked bodies are extrapolated to the prediction time
+         */
+        bool getPredictionEnabled();
+
+        /**
+         * @brief Set the time, in seconds after the frame start, that tracked
+         * bodies are predicted for
+         *
+         * This should be about the time the frame reaches the display
+         */
+        void setPredictionTime(double time);
+
+        /**
+         * @brief Get the time, in seconds after the frame start, that tracked
+         * bodies are predicted for
+         */
+        double getPredictionTime();
+
+        /**
+         * @brief Get the time a tracking system was last sampled
+         * @param system Tracking system number
+         * @return seconds relative to the start of the current frame, negative
+         * if sampled before the frame start
+         */
+        double getSampleTime(int system);
+
         /**
          * @brief Get the head id for a given hand
          */
@@ -221,6 +261,12 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
         void getHandButtonFromSystemButton(int system, int systemButton,
                 int & hand, int & handButton);
 
+        /**
+         * @brief Read the tracking system and body offsets again when the
+         *        config is reloaded
+         */
+        virtual void configChanged(const std::vector<std::string> & paths);
+
     protected:
         TrackingManager();
         virtual ~TrackingManager();
@@ -235,6 +281,48 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
          */
         void updateThreadHandMask();
 
+        /**
+         * @brief Write the threaded systems' state into the thread's buffer and
+         * hand it off to update
+         */
+        void publishThreadState();
+
+        /**
+         * @brief Move events generated in the tracking thread into the event ring
+         *
+         * Events that do not fit are kept and retried on the next poll
+         */
+        void queueThreadEvents();
+
+        /**
+         * @brief Take the newest state published by the tracking thread and copy
+         * the threaded systems into the current snapshot
+         */
+        void readThreadState();
+
+        /**
+         * @brief Move events from the tracking thread's ring into the event map
+         */
+        void readThreadEvents();
+
+        /**
+         * @brief Pass the current frame start and frame period to the tracking thread
+         * @param frameStart monotonic time of the frame start
+         */
+        void updateThreadPhase(double frameStart);
+
+        /**
+         * @brief Get the tracking thread's next poll deadline
+         * @param last the last deadline
+         * @param now current monotonic time
+         */
+        double getNextThreadDeadline(double last, double now);
+
+        /**
+         * @brief Extrapolate the bodies in the current snapshot to the prediction time
+         */
+        void predictBodies(double frameStart);
+
         /**
          * @brief Generate button events based on button and tracking info
          */
@@ -308,11 +396,49 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
                 bool thread; ///< should this system be polled in a thread
         };
 
+        /**
+         * @brief Read the system and body offsets of a tracking system from
+         *        the config
+         */
+        void readSystemTransforms(const std::string & configStr,
+                TrackingSystemInfo * tsi);
+
         enum ValuatorType
         {
             NON_ZERO, CHANGE
         };
 
+        /**
+         * @brief Tracker state for all systems for one frame
+         *
+         * Bodies, button masks and valuators are kept in separate arrays inside
+         * one allocation so the whole snapshot is distributed as a single block
+         */
+        struct TrackingSnapshot
+        {
+                char * data; ///< backing store for the arrays
+                int dataSize; ///< size of the backing store
+                TrackerBase::TrackedBody * bodies; ///< bodies for all systems, in system order
+                unsigned int * buttons; ///< raw button mask for each system
+                float * valuators; ///< valuators for all systems, in system order
+                float * sampleTimes; ///< sample time of each system, relative to the frame start
+        };
+
+        /**
+         * @brief Threaded system state handed from the tracking thread to update
+         */
+        struct ThreadState
+        {
+                TrackingSnapshot snapshot; ///< state of the threaded systems, same layout as a frame snapshot
+                unsigned int * handButtonMasks; ///< hand button masks from the threaded systems
+                std::vector<double> sampleTimes; ///< monotonic sample time of each system
+        };
+
+        /**
+         * @brief Flag set in the pending thread state index when it has not been read
+         */
+        static const unsigned int THREAD_STATE_FRESH = 0x4;
+
         static TrackingManager * _myPtr; ///< Static self pointer
 
         std::vector<TrackerBase*> _systems; ///< List of all tracking systems
@@ -324,8 +450,21 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
         bool _threaded; ///< is there a thread polling the tracker
         float _threadFPS; ///< target frames per second of thread polling a tracking system
         bool _threadQuit; ///< quit flag for thread
+        bool _threadPhaseLock; ///< should thread polls line up with the frame start
+        double _threadPhaseOffset; ///< time before the frame start to poll, in seconds
+        OpenThreads::Atomic _threadFrameStart; ///< frame start monotonic time in microseconds, truncated
+        OpenThreads::Atomic _threadFramePeriod; ///< last frame duration in microseconds
         OpenThreads::Mutex _quitLock; ///< lock to protect quit flag
-        OpenThreads::Mutex _updateLock; ///< lock to protect multi-threaded operations
+        OpenThreads::Mutex _transformLock; ///< protects the system transforms read by the thread
+        ThreadState _threadState[3]; ///< triple buffer between the tracking thread and update
+        int _threadWriteIndex; ///< state buffer owned by the tracking thread
+        int _threadReadIndex; ///< state buffer owned by update
+        OpenThreads::Atomic _threadPendingIndex; ///< last published state buffer, with THREAD_STATE_FRESH if unread
+        OpenThreads::Atomic _threadStateSerial; ///< count of states published by the tracking thread
+        std::map<int,std::list<InteractionEvent*> > _threadEventMap; ///< events generated in the tracking thread, not yet queued
+        std::vector<InteractionEvent*> _threadEventRing; ///< single producer/consumer event queue, size is a power of two
+        OpenThreads::Atomic _threadEventHead; ///< count of events taken from the ring by update
+        OpenThreads::Atomic _threadEventTail; ///< count of events put in the ring by the tracking thread
         std::vector<unsigned int> _threadHandButtonMasks; ///< list of button mask for each hand in threaded update
         std::vector<unsigned int> _threadLastHandButtonMask; ///< list of last sampled button mask for each hand in threaded update
         std::vector<osg::Matrix> _threadHandMatList; ///< list of hand transforms for each hand in threaded update
@@ -359,12 +498,29 @@ class CVRINPUT_EXPORT TrackingManager : public OpenThreads::Thread
         std::vector<std::vector<float> > _eventValuators; ///< current value of each valuator
         std::vector<std::vector<double> > _eventValuatorTime; ///< time since last valuator event was created
         std::vector<std::map<int,float> > _lastEventValuators; ///< previous value of valuator, used for CHANGE type
+        std::vector<std::map<int,float> > _threadLastEventValuators; ///< previous value of threaded valuator, used for CHANGE type
 
         std::vector<std::vector<bool> > _genHandDefaultButtonEvents; ///< lookup to see if a hand button should have default events generated
 
         GenComplexTrackingEvents * genComTrackEvents; ///< class used to create complex interaction events by processing simple ones
 
         std::map<int,std::list<InteractionEvent*> > _eventMap; ///< map of events generated by the tracking system, used for cluster distribution
+        std::vector<char> _eventData; ///< persistent buffer for event distribution
+
+        TrackingSnapshot _snapshot[2]; ///< double buffered tracker state
+        int _snapshotIndex; ///< snapshot holding the current frame's state
+        std::vector<int> _systemBodyOffset; ///< index of each system's first body in a snapshot
+        std::vector<int> _systemValOffset; ///< index of each system's first valuator in a snapshot
+        std::vector<double> _systemSampleTime; ///< monotonic time each system was last sampled
+
+        bool _predict; ///< should bodies be extrapolated
+        double _predictionTime; ///< time after frame start bodies are predicted for
+        double _predictionMax; ///< longest extrapolation allowed, in seconds
+        std::vector<TrackerBase::TrackedBody> _lastSampleBodies; ///< last distinct sample of each body
+        std::vector<TrackerBase::TrackedBody> _prevSampleBodies; ///< sample before the last for each body
+        std::vector<double> _lastSampleTime; ///< time of the last distinct sample of each system
+        std::vector<double> _prevSampleTime; ///< time of the sample before the last for each system
+        TrackerBase::TrackedBody _zeroBody; ///< body used for missing tracking data
 
         std::vector<int> _handToHeadMap; ///< map of hand number to head number
         std::vector<std::vector<int> > _headToHandsMap; ///< map of head number to hand numbers
@@ -0,0 +1,165 @@
+/**
+ * @file AssetCache.h
+ */
+#ifndef CALVR_ASSET_CACHE_H
+#define CALVR_ASSET_CACHE_H
+
+#include <cvrKernel/Export.h>
+
+#include <osg/Node>
+#include <osg/Image>
+#include <osgDB/ReaderWriter>
+#include <OpenThreads/Mutex>
+
+#include <string>
+#include <map>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup kernel
+ * @{
+ */
+
+/**
+ * @brief On disk cache of loaded models and images in osg binary format
+ *
+ * Entries are named by a hash of the source file's path, size, modification
+ * time and load options.  For models the sizes and modification times of the
+ * other files in the model's directory are included, to pick up changed
+ * textures and sub-files.  A directory is only listed again after files are
+ * added to or removed from it, so a sibling file changed in place while
+ * running, or a referenced file in another directory, is not noticed.  Touch
+ * the model file to refresh its entry after changing them.
+ *
+ * The master node fills the cache, holding a lock file next to each entry
+ * while it loads.  Render nodes never write entries.  For a missing entry a
+ * render node waits a short time for the master's lock, then for the entry
+ * while the lock is held, and otherwise loads the source file itself.  The
+ * cache directory should be on storage all nodes can see.
+ */
+class CVRKERNEL_EXPORT AssetCache
+{
+        friend class CalVR;
+    public:
+        /**
+         * @brief get a static pointer to the instance of the class
+         */
+        static AssetCache * instance();
+
+        /**
+         * @brief Read config values and set up the cache directory
+         */
+        bool init();
+
+        /**
+         * @brief Returns if files are being read through the cache
+         */
+        bool isEnabled()
+        {
+            return _enabled;
+        }
+
+        /**
+         * @brief Read a model file, using the cached copy if there is one
+         *
+         * Works like osgDB::readNodeFile, falls back to it when the cache is
+         * disabled.  Safe to call from loading threads.
+         */
+        osg::Node * readNodeFile(const std::string & file,
+                osgDB::ReaderWriter::Options * options = NULL);
+
+        /**
+         * @brief Read an image file, using the cached copy if there is one
+         *
+         * Works like osgDB::readImageFile, falls back to it when the cache is
+         * disabled.  Safe to call from loading threads.
+         */
+        osg::Image * readImageFile(const std::string & file,
+                osgDB::ReaderWriter::Options * options = NULL);
+
+        /**
+         * @brief Cache usage counters
+         */
+        struct CacheStats
+        {
+                int hits; ///< reads served from the cache
+                int misses; ///< reads that went to the source file
+                int writes; ///< entries added to the cache
+        };
+
+        /**
+         * @brief Get the usage counters since the last reset
+         */
+        CacheStats getStats();
+
+        /**
+         * @brief Zero the usage counters
+         */
+        void resetStats();
+
+    protected:
+        AssetCache();
+        virtual ~AssetCache();
+
+        /**
+         * @brief Get the cache entry path for a file, empty if the file does
+         * not exist
+         */
+        std::string getEntryName(const std::string & file,
+                osgDB::ReaderWriter::Options * options, bool model);
+
+        /**
+         * @brief Get the part of a model key made from the files in its
+         * directory, the listing is reused until the directory changes
+         */
+        std::string getDirectoryKey(const std::string & dir);
+
+        /**
+         * @brief Take the lock used to mark an entry as being written
+         * @return false if some other thread or node holds it
+         */
+        bool lockEntry(const std::string & entry);
+        void unlockEntry(const std::string & entry);
+
+        /**
+         * @brief Mark an entry the master could not write, so render nodes
+         * stop waiting for it
+         */
+        void failEntry(const std::string & entry);
+
+        /**
+         * @brief Wait for the master to write a missing entry, if it is
+         * loading it
+         * @return true if the entry exists
+         */
+        bool waitForEntry(const std::string & entry);
+
+        static AssetCache * _myPtr; ///< static self pointer
+
+        bool _enabled; ///< is the cache used
+        std::string _directory; ///< directory holding the entries
+        int _waitTime; ///< max time a render node waits for the master to start on an entry, in ms
+        int _loadWaitTime; ///< max time a render node waits for an entry the master is loading, in ms
+        osg::ref_ptr<osgDB::ReaderWriter::Options> _writeOptions; ///< options used to write entries
+
+        struct DirectoryKey
+        {
+                long long mtime; ///< directory modification time when listed
+                std::string key; ///< names, sizes and times of its files
+        };
+        std::map<std::string,DirectoryKey> _dirKeys; ///< model directory listings by path
+        OpenThreads::Mutex _dirLock; ///< protects the directory listings
+
+        OpenThreads::Mutex _statsLock; ///< protects the counters
+        CacheStats _stats; ///< usage counters
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
@@ -27,6 +27,8 @@ class MenuManager;
 class FileHandler;
 class PluginManager;
 class ThreadedLoader;
+class AssetCache;
+class FrameScheduler;
 
 /**
  * @addtogroup kernel cvrKernel
@@ -94,6 +96,9 @@ class CVRKERNEL_EXPORT CalVR
 
         bool setupDirectories();
         bool syncClusterInitStatus();
+        void updateConfig();
+        void updateScreens();
+        void setupFrameStages();
 
         enum CVRInitStatus
         {
@@ -107,6 +112,7 @@ class CVRKERNEL_EXPORT CalVR
         std::string _configDir;
         std::string _pluginsHomeDir;
         std::string _hostName; ///< node's host name
+        bool _configReload; ///< if config file changes are applied while running
 
         ConfigManager * _config;
         ComController * _communication;
@@ -121,6 +127,8 @@ class CVRKERNEL_EXPORT CalVR
         FileHandler * _file;
         PluginManager * _plugins;
         ThreadedLoader * _threadedLoader;
+        AssetCache * _assetCache;
+        FrameScheduler * _scheduler;
 };
 
 /**
@@ -19,6 +19,7 @@ namespace cvr
 
 class CVRSocket;
 class CVRMulticastSocket;
+class CVRSharedMemoryLink;
 class MultiListenSocket;
 
 /**
@@ -36,6 +37,23 @@ class CVRKERNEL_EXPORT ComController
         friend class CalVR;
     public:
 
+        /**
+         * @brief Section ids for the per-frame sync message
+         *
+         * Plugins may use ids starting at FSS_USER_START
+         */
+        enum FrameSyncSectionType
+        {
+            FSS_FRAME_START = 0,
+            FSS_VIEWER_EVENT_INFO,
+            FSS_VIEWER_EVENTS,
+            FSS_TRACKING_DATA,
+            FSS_TRACKING_EVENTS,
+            FSS_CONFIG_UPDATE,
+            FSS_COLLABORATIVE,
+            FSS_USER_START = 64
+        };
+
         /**
          * @brief Sets up node sockets based on command line arguments
          * @param ap The arguments from the command line
@@ -97,6 +115,59 @@ class CVRKERNEL_EXPORT ComController
          */
         bool sendMaster(void * data, int size);
 
+        /**
+         * @brief Append a section to the coalesced frame sync message
+         * @param section id of the section, see FrameSyncSectionType
+         * @param data section data, copied into the message buffer
+         * @param size size of the section data
+         *
+         * Only valid if called by master node.  All pending sections are sent to
+         * the slaves as a single message on flushFrameSync(), or before any other
+         * master/slave communication.  Adding a section id that is already pending
+         * flushes the pending message first.
+         */
+        bool addFrameSyncSection(int section, void * data, int size);
+
+        /**
+         * @brief Read a section of the coalesced frame sync message
+         * @param section id of the section, see FrameSyncSectionType
+         * @param data buffer to receive the section data
+         * @param size expected size of the section
+         *
+         * Only valid if called by slave node.  The message is received from the
+         * master on the first section read after a flush boundary.
+         */
+        bool readFrameSyncSection(int section, void * data, int size);
+
+        /**
+         * @brief Get a pointer to a section of the coalesced frame sync message
+         * @param section id of the section, see FrameSyncSectionType
+         * @param size set to the size of the section data
+         * @return pointer into the message buffer, valid until the next message
+         *      is received, or NULL on error
+         *
+         * Only valid if called by slave node.  The section is taken from the
+         * message the master sent in the same frame, messages from earlier
+         * frames that were never read are skipped.
+         */
+        char * getFrameSyncSection(int section, int & size);
+
+        /**
+         * @brief Send all pending frame sync sections to the slave nodes in one message
+         *
+         * Must be called by all nodes at the same point in the frame
+         */
+        bool flushFrameSync();
+
+        /**
+         * @brief Set the frame number stamped on the frame sync messages
+         * @param frame number of the frame being started
+         *
+         * Must be called by all nodes at the start of every frame.  Sections
+         * still pending from the last frame are sent first.
+         */
+        bool startFrameSync(unsigned int frame);
+
         /**
          * @brief Sync the cluster to this call
          *
@@ -104,6 +175,56 @@ class CVRKERNEL_EXPORT ComController
          */
         bool sync();
 
+        /**
+         * @brief Barrier implementation used by sync()
+         */
+        enum SyncTopology
+        {
+            SYNC_FLAT = 0, ///< master reads from and releases every slave
+            SYNC_TREE ///< k-ary tree over master and peer slave sockets
+        };
+
+        /**
+         * @brief Get the barrier implementation used by sync()
+         */
+        SyncTopology getSyncTopology()
+        {
+            return _syncTopology;
+        }
+
+        /**
+         * @brief Get the counts of barrier wait times on this node
+         *
+         * Bucket i counts waits less than getSyncWaitBucketBounds()[i] ms,
+         * the last bucket counts everything above the last bound
+         */
+        const std::vector<int> & getSyncWaitHistogram()
+        {
+            return _syncWaitHistogram;
+        }
+
+        /**
+         * @brief Get the upper bound, in ms, of each barrier wait bucket
+         */
+        const std::vector<double> & getSyncWaitBucketBounds()
+        {
+            return _syncWaitBounds;
+        }
+
+        /**
+         * @brief Get the time this node spent in the last sync() call
+         * @return time in seconds
+         */
+        double getLastSyncWait()
+        {
+            return _lastSyncWait;
+        }
+
+        /**
+         * @brief Clear the barrier wait histogram
+         */
+        void resetSyncWaitHistogram();
+
         /**
          * @brief Returns true if this node is the master node
          */
@@ -123,6 +244,38 @@ class CVRKERNEL_EXPORT ComController
             return _CCError;
         }
 
+        /**
+         * @brief Counters for multicast traffic
+         */
+        struct MulticastStats
+        {
+                int messages; ///< number of multicast messages
+                int bytes; ///< total payload bytes
+                int fragments; ///< number of datagrams sent/received
+                int repaired; ///< fragments resent over tcp after a nack
+        };
+
+        /**
+         * @brief Get the multicast counters accumulated since the last reset
+         */
+        const MulticastStats & getMulticastStats()
+        {
+            return _mcStats;
+        }
+
+        /**
+         * @brief Reset the multicast counters, called once per frame by the viewer
+         */
+        void resetMulticastStats();
+
+        /**
+         * @brief Returns true if multicast is set up with sequencing and repair
+         */
+        bool getMulticastReliable()
+        {
+            return _multicastUsable && _multicastReliable;
+        }
+
         /**
          * @brief Returns a pointer to the instance of this class
          */
@@ -137,8 +290,150 @@ class CVRKERNEL_EXPORT ComController
 
         bool setupConnections();
         bool connectMaster();
+
+        /**
+         * @brief Send the master's config snapshot to the slaves, slaves load it
+         */
+        bool syncConfigSnapshot();
+
         void setupMulticast();
 
+        /**
+         * @brief Replace the master/slave sockets with shared memory links
+         * for nodes on the same host as the master
+         */
+        bool setupSharedMemory();
+
+        /**
+         * @brief Offer a shared memory link to the other end of a socket, if it
+         * is on this host
+         * @param socket connection to negotiate over
+         * @param link set to the new link, or NULL if the socket is still used
+         * @return false if the socket failed
+         */
+        bool offerSharedMemory(cvr::CVRSocket * socket,
+                cvr::CVRSharedMemoryLink *& link);
+
+        /**
+         * @brief Open a shared memory link offered by the other end of a socket
+         * @param socket connection to negotiate over
+         * @param link set to the new link, or NULL if the socket is still used
+         * @return false if the socket failed
+         */
+        bool acceptSharedMemory(cvr::CVRSocket * socket,
+                cvr::CVRSharedMemoryLink *& link);
+
+        /**
+         * @brief Sent by the node accepting a shared memory link
+         */
+        struct SharedMemoryHello
+        {
+                char host[256]; ///< host name of the node
+        };
+
+        /**
+         * @brief Sent by the node creating a shared memory link
+         */
+        struct SharedMemoryOffer
+        {
+                char name[64]; ///< segment name, empty if no link is offered
+                unsigned int key; ///< key of the created link
+        };
+
+        /**
+         * @brief Send the pending frame sync message, if any, or mark the end
+         * of the current message on slave nodes
+         * @param multicastSend true if called for a multicast send, which does
+         *        not need the pending multicast repairs done first
+         */
+        bool frameSyncBoundary(bool multicastSend = false);
+
+        /**
+         * @brief Receive the next frame sync message from the master
+         */
+        bool recvFrameSync();
+
+        /**
+         * @brief Multicast a fragmented, sequenced message, fragments the
+         * slaves report missing are repaired in collectMulticastAcks()
+         */
+        bool sendSlavesReliableMulticast(char * data, int size);
+
+        /**
+         * @brief Receive a fragmented, sequenced message and request repair of
+         * any missing fragments
+         */
+        bool readMasterReliableMulticast(char * data, int size);
+
+        /**
+         * @brief Read the slaves' missing fragment reports for the multicast
+         * messages sent since the last call, and resend those fragments
+         */
+        bool collectMulticastAcks();
+
+        /**
+         * @brief Header placed in front of each reliable multicast datagram
+         */
+        struct MCFragmentHeader
+        {
+                unsigned int seq; ///< message sequence number
+                unsigned int fragment; ///< fragment index in message
+                unsigned int totalSize; ///< size of the full message
+        };
+
+        /**
+         * @brief Set up the barrier topology chosen in MultiPC.SyncBarrier
+         */
+        bool setupBarrier();
+
+        /**
+         * @brief Tree barrier, gather up to the master and release back down
+         */
+        bool treeSync();
+
+        /**
+         * @brief Address a slave node listens on for barrier children
+         */
+        struct BarrierAddress
+        {
+                char host[256]; ///< host name of the node
+                int port; ///< listen port, 0 if node has no slave children
+        };
+
+        /**
+         * @brief Setup event polling used for concurrent slave socket operations
+         */
+        void setupParallelIO();
+
+        /**
+         * @brief Send to/read from all slave sockets concurrently
+         * @param sending true to send data to all slaves, false to read size
+         *      bytes from each slave into consecutive blocks of data
+         * @param data buffer to send from or read into
+         * @param size ammount of data per slave
+         */
+        bool parallelSlaveIO(bool sending, char * data, int size);
+
+        /**
+         * @brief Header for the coalesced frame sync message
+         */
+        struct FrameSyncHeader
+        {
+                int size; ///< size of the message following the header
+                int numSections; ///< number of entries in the section table
+                unsigned int frame; ///< frame number of the master when sent
+        };
+
+        /**
+         * @brief Section table entry in the frame sync message
+         */
+        struct FrameSyncSection
+        {
+                int type; ///< section id
+                int offset; ///< offset of the section data from the end of the table
+                int size; ///< size of the section data
+        };
+
         /**
          * Message passed during multinode startup
          */
@@ -156,17 +451,64 @@ class CVRKERNEL_EXPORT ComController
 
         cvr::CVRSocket * _masterSocket; ///< socket to talk to master with
         std::map<int,cvr::CVRSocket *> _slaveSockets; ///< list of slave node sockets
+        std::vector<cvr::CVRSocket *> _slaveSocketList; ///< slave node sockets in node order
+        std::vector<int> _slaveNodeList; ///< node number for each entry in _slaveSocketList
         cvr::MultiListenSocket * _listenSocket; ///< sock that listens for slave node connections
         std::map<int,std::string> _startupMap; ///< startup commands indexed by node number
 
+        cvr::CVRSharedMemoryLink * _masterShm; ///< link to master used in place of _masterSocket, NULL if on another host
+        std::vector<cvr::CVRSharedMemoryLink *> _slaveShmList; ///< link used in place of each entry in _slaveSocketList, NULL for nodes on other hosts
+        bool _shmEnabled; ///< offer shared memory links to nodes on this host
+        unsigned int _shmRingSize; ///< bytes buffered in each direction of a link
+        int _shmSpinCount; ///< polls before a blocked link sleeps, -1 for the default
+        int _shmCount; ///< number of links created, used to name the segments
+
         bool _multicastUsable; ///< is a multicast socket set up
         CVRMulticastSocket * _masterMCSocket; ///< multicast socket for master node
         CVRMulticastSocket * _slaveMCSocket; ///< multicast socket for render node
+        bool _multicastReliable; ///< use sequencing, fragmentation and nack repair
+        int _mcFragmentSize; ///< max payload per multicast datagram
+        int _mcRepairTimeout; ///< ms to wait for remaining fragments before sending a nack
+        int _mcLossTimeout; ///< ms to wait for the first fragment of a message
+        unsigned int _mcSeq; ///< sequence number of the last multicast message
+        std::vector<char> _mcPacketBuffer; ///< buffer for a single datagram
+        std::vector<bool> _mcFragmentReceived; ///< received flags for the current message, slave only
+        std::vector<int> _mcMissing; ///< list of missing fragments
+        std::vector<std::vector<char> > _mcPending; ///< messages sent without their reports collected yet, master only
+        int _mcNumPending; ///< number of entries of _mcPending in use
+        std::vector<std::vector<char> > _mcEarlyPackets; ///< datagrams of the next message read while finishing the current one, slave only
+        MulticastStats _mcStats; ///< multicast counters
+
+        SyncTopology _syncTopology; ///< barrier implementation
+        int _barrierArity; ///< number of children per node in tree barrier
+        std::vector<cvr::CVRSocket *> _barrierChildren; ///< sockets to barrier children
+        cvr::CVRSocket * _barrierParent; ///< socket to barrier parent, NULL on master
+        std::vector<cvr::CVRSocket *> _barrierPeerSockets; ///< slave to slave sockets owned by the barrier
+        std::vector<cvr::CVRSharedMemoryLink *> _barrierChildShm; ///< link used in place of each barrier child socket, or NULL
+        cvr::CVRSharedMemoryLink * _barrierParentShm; ///< link used in place of the barrier parent socket, or NULL
+        std::vector<cvr::CVRSharedMemoryLink *> _barrierPeerShm; ///< slave to slave links owned by the barrier
+        std::vector<double> _syncWaitBounds; ///< histogram bucket bounds in ms
+        std::vector<int> _syncWaitHistogram; ///< barrier wait counts
+        double _lastSyncWait; ///< last barrier wait in seconds
 
         static ComController * _myPtr; ///< static self pointer
 
         bool _CCError; ///< error state of ComController
 
+        std::vector<FrameSyncSection> _frameSyncSections; ///< pending (master) or received (slave) section table
+        std::vector<bool> _frameSyncSectionRead; ///< which sections have been read, slave only
+        std::vector<char> _frameSyncData; ///< pending section data, master only
+        std::vector<char> _frameSyncMessage; ///< assembled/received frame sync message buffer
+        bool _frameSyncReceived; ///< has the current frame sync message been received, slave only
+        unsigned int _frameSyncFrame; ///< current frame number, stamped on sent messages (master) or expected on received ones (slave)
+        unsigned int _frameSyncMessageFrame; ///< frame stamped on the received message, slave only
+
+        bool _parallelIO; ///< should slave sockets be written/read concurrently
+        int _epollFD; ///< event poll descriptor for the slave sockets
+        std::vector<int> _slaveIOProgress; ///< bytes transfered per slave in current parallel operation
+        std::vector<bool> _slaveIOReady; ///< if the slave socket may make progress without blocking
+        std::vector<char> _slaveRecvBuffer; ///< persistent buffer for discarded slave reads
+
 };
 
 /**
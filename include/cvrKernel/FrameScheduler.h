@@ -0,0 +1,186 @@
+/**
+ * @file FrameScheduler.h
+ */
+#ifndef CALVR_FRAME_SCHEDULER_H
+#define CALVR_FRAME_SCHEDULER_H
+
+#include <cvrKernel/Export.h>
+
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup kernel
+ * @{
+ */
+
+/**
+ * @brief Runs the per frame update stages in dependency order
+ *
+ * Each stage names the stages it must run after.  Stages that send or read
+ * cluster data must run in the same order on every node, so they run on the
+ * main thread in a fixed order worked out from the dependencies, with ties
+ * going to the stage added first.  Other stages run on a worker thread as soon
+ * as their dependencies are done, alongside the main thread stages.
+ *
+ * Stages must be added in the same order on every node.
+ */
+class CVRKERNEL_EXPORT FrameScheduler
+{
+        friend class CalVR;
+    public:
+
+        /**
+         * @brief Interface for the work done by a stage
+         */
+        class StageCallback
+        {
+            public:
+                virtual ~StageCallback()
+                {
+                }
+
+                /**
+                 * @brief Called once a frame when the stage runs
+                 */
+                virtual void runStage() = 0;
+        };
+
+        /**
+         * @brief Stage callback that calls a class member function, any
+         *        return value is ignored
+         */
+        template<class T, class R = void>
+        class MethodCallback : public StageCallback
+        {
+            public:
+                MethodCallback(T * object, R (T::*method)())
+                {
+                    _object = object;
+                    _method = method;
+                }
+
+                virtual void runStage()
+                {
+                    (_object->*_method)();
+                }
+
+            protected:
+                T * _object;
+                R (T::*_method)();
+        };
+
+        /**
+         * @brief Get static self pointer
+         */
+        static FrameScheduler * instance();
+
+        /**
+         * @brief Read config values and start the worker threads
+         */
+        bool init();
+
+        /**
+         * @brief Add a stage to the frame, must not be called while a frame is
+         *        running
+         * @param name unique stage name
+         * @param callback work done by the stage, owned by the scheduler
+         * @param after comma separated list of stages that must finish first,
+         *        names of stages that do not exist are ignored
+         * @param clusterSync true if the stage sends or reads cluster data, or
+         *        changes state other stages use without locking, and must run on
+         *        the main thread in the fixed order
+         * @param statsName if not empty, the stage time is added to the viewer
+         *        stats as "<statsName> begin time" etc.
+         * @return false if a stage with the name already exists
+         */
+        bool addStage(const std::string & name, StageCallback * callback,
+                const std::string & after, bool clusterSync,
+                const std::string & statsName = "");
+
+        /**
+         * @brief Remove a stage, must not be called while a frame is running
+         */
+        void removeStage(const std::string & name);
+
+        /**
+         * @brief Run all stages for the frame, returns when all are done
+         */
+        void runFrame();
+
+        /**
+         * @brief Get the number of worker threads
+         */
+        int getNumThreads()
+        {
+            return _threads.size();
+        }
+
+    protected:
+        FrameScheduler();
+        virtual ~FrameScheduler();
+
+        static FrameScheduler * _myPtr; ///< static self pointer
+
+        /**
+         * @brief Thread that runs the stages that are not cluster synced
+         */
+        class WorkerThread : public OpenThreads::Thread
+        {
+            public:
+                WorkerThread(FrameScheduler * scheduler);
+                virtual ~WorkerThread();
+                virtual void run();
+
+            protected:
+                FrameScheduler * _scheduler;
+        };
+
+        struct Stage
+        {
+                std::string name;
+                StageCallback * callback;
+                std::string after;
+                bool clusterSync;
+                std::string statsName;
+                std::vector<int> dependents; ///< stages waiting on this one
+                int numDependencies;
+                bool onMain; ///< if the stage runs on the main thread
+                int waiting; ///< dependencies not yet done this frame
+                double beginTime;
+                double endTime;
+        };
+
+        bool buildSchedule();
+        void runStage(int stage);
+        void stageDone(int stage);
+        bool runReadyStage();
+
+        std::vector<Stage> _stages; ///< stages in the order added
+        std::vector<int> _mainOrder; ///< fixed order of the cluster synced stages
+        bool _scheduleValid; ///< if the order matches the stage list
+
+        std::vector<WorkerThread*> _threads;
+        OpenThreads::Mutex _lock; ///< protects the frame state below
+        OpenThreads::Condition _workCondition; ///< signaled when a worker stage is ready or on quit
+        OpenThreads::Condition _doneCondition; ///< signaled when a stage finishes
+        std::deque<int> _readyQueue; ///< worker stages ready to run
+        int _stagesLeft; ///< stages not done this frame
+        bool _quit;
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
@@ -84,6 +84,19 @@ class InteractionEvent
         {
         }
 
+        /**
+         * @brief Allocate events from a shared block pool
+         *
+         * Events are created and deleted every frame, the pool keeps this
+         * from hitting the heap once it has grown to the working set size
+         */
+        static void * operator new(size_t size);
+
+        /**
+         * @brief Return an event to the shared block pool
+         */
+        static void operator delete(void * ptr);
+
         /**
          * @brief Get the interaction value for this event
          */
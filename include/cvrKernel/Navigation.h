@@ -8,6 +8,7 @@
 #include <cvrKernel/Export.h>
 #include <cvrKernel/InteractionManager.h>
 #include <cvrKernel/CalVR.h>
+#include <cvrConfig/ConfigManager.h>
 
 #include <osg/Matrix>
 #include <osg/Vec3>
@@ -38,7 +39,7 @@ class NavDeviceBase;
 /**
  * @brief Uses tracking events to interact with object space
  */
-class CVRKERNEL_EXPORT Navigation
+class CVRKERNEL_EXPORT Navigation : public ConfigChangeCallback
 {
         friend class CalVR;
     public:
@@ -137,6 +138,11 @@ class CVRKERNEL_EXPORT Navigation
             NONE_NAV
         };
 
+        /**
+         * @brief Read the navigation settings again when the config is reloaded
+         */
+        virtual void configChanged(const std::vector<std::string> & paths);
+
     protected:
         Navigation();
         virtual ~Navigation();
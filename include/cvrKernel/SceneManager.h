@@ -7,6 +7,7 @@
 
 #include <cvrKernel/Export.h>
 #include <cvrUtil/DepthPartitionNode.h>
+#include <cvrUtil/BoundingVolumeHierarchy.h>
 
 #include <osg/ClipNode>
 #include <osg/MatrixTransform>
@@ -295,6 +296,7 @@ class CVRKERNEL_EXPORT SceneManager
         void getNodeWorldCorners(osg::BoundingBoxf& bound);
 
         void updateActiveObject();
+        void updateObjectBVH();
         SceneObject * findChildActiveObject(SceneObject * object,
                 osg::Vec3 & start, osg::Vec3 & end,
                 VectorWithPosition<SceneObject*> & nodeList);
@@ -336,6 +338,22 @@ class CVRKERNEL_EXPORT SceneManager
         bool _uniqueMapInUse;
         std::map<std::string,std::vector<SceneObject*> > _pluginObjectMap; ///< set of all registered SceneObjects grouped by plugin name
 
+        /**
+         * @brief Pick tree state of an attached, registered SceneObject
+         */
+        struct PickEntry
+        {
+                SceneObject * object;
+                bool nav; ///< is the object in the navigation tree
+                int item; ///< item index in its tree
+                osg::Matrix mat; ///< object to tree space transform of the item bounds
+                osg::BoundingBox bound; ///< object bounds used for the item
+        };
+
+        std::vector<PickEntry> _pickEntries; ///< objects in the pick trees, in registration order
+        BoundingVolumeHierarchy _worldObjectBVH; ///< world space bounds of objects without navigation
+        BoundingVolumeHierarchy _navObjectBVH; ///< object space bounds of objects with navigation
+
         float _menuScale;
         float _menuMinDistance;
         float _menuMaxDistance;
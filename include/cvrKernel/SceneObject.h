@@ -364,19 +364,18 @@ class CVRKERNEL_EXPORT SceneObject : public MenuCallback
         /**
          * @brief Get the bounding box for the object
          *
-         * If the BoundsCalcMode is set the AUTO and the bounds is dirty, this will compute the new bounds
+         * If the BoundsCalcMode is set the AUTO, the box is cached.  Only child nodes whose
+         * osg bounding sphere changed and child objects that moved or changed are recomputed.
          */
         const osg::BoundingBox & getOrComputeBoundingBox();
 
         /**
-         * @brief Flag the bounding box to be updated on the next getOrComputeBoundingBox() call
+         * @brief Flag the bounding box to be fully recomputed on the next getOrComputeBoundingBox() call
          *
+         * Only needed if child node data changed without the node's bounds being dirtied.
          * This is only valid if the BoundsCalcMode is set to AUTO
          */
-        void dirtyBounds()
-        {
-            _boundsDirty = true;
-        }
+        void dirtyBounds();
 
         /**
          * @brief Set if the bounding box should be manually or automatically computed
@@ -384,6 +383,7 @@ class CVRKERNEL_EXPORT SceneObject : public MenuCallback
         void setBoundsCalcMode(BoundsCalcMode bcm)
         {
             _boundsCalcMode = bcm;
+            dirtyBounds();
         }
 
         /**
@@ -421,6 +421,7 @@ class CVRKERNEL_EXPORT SceneObject : public MenuCallback
         virtual void moveCleanup();
 
         void computeBoundingBox();
+        void dirtyParentBounds();
 
         bool intersectsFast(osg::Vec3 & start, osg::Vec3 & end);
         bool intersects(osg::Vec3 & start, osg::Vec3 & end,
@@ -471,7 +472,12 @@ class CVRKERNEL_EXPORT SceneObject : public MenuCallback
         osg::Matrix _lastobj2world;
 
         osg::BoundingBox _bb, _bbLocal;
-        bool _boundsDirty;
+        bool _boundsDirty; ///< child node boxes must be recomputed
+        bool _childBoundsDirty; ///< some child object below has dirty bounds
+        std::vector<unsigned int> _childNodeRevisions; ///< osg bound revision of each child node when its box was computed
+        std::vector<osg::BoundingBox> _childNodeBounds; ///< box of each child node
+        std::vector<unsigned int> _childObjectRevisions; ///< osg bound revision of each child object root when its box was taken
+        std::vector<osg::BoundingBox> _childObjectBounds; ///< box of each child object in this object's space
         BoundsCalcMode _boundsCalcMode;
 
         std::vector<osg::ref_ptr<osg::Node> > _childrenNodes;
@@ -7,6 +7,7 @@
 
 #include <cvrKernel/Export.h>
 #include <cvrKernel/CalVR.h>
+#include <cvrConfig/ConfigManager.h>
 
 #include <osg/Vec3>
 #include <osg/Camera>
@@ -91,7 +92,7 @@ struct ScreenInfo
  * @brief Reads screen information from config file and creates the needed \c ScreenBase
  *        instances
  */
-class CVRKERNEL_EXPORT ScreenConfig
+class CVRKERNEL_EXPORT ScreenConfig : public ConfigChangeCallback
 {
         friend class CalVR;
     public:
@@ -187,6 +188,12 @@ class CVRKERNEL_EXPORT ScreenConfig
         int getCudaDevice(int context);
         int getNumContexts(int cudaDevice);
 
+        /**
+         * @brief Read the stereo and background settings again when the config
+         *        is reloaded, screen and window layout changes need a restart
+         */
+        virtual void configChanged(const std::vector<std::string> & paths);
+
     protected:
         virtual ~ScreenConfig();
 
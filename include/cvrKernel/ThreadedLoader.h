@@ -10,10 +10,12 @@
 #include <osgDB/ReadFile>
 #include <OpenThreads/Thread>
 #include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
 
 #include <string>
 #include <map>
 #include <vector>
+#include <queue>
 
 namespace cvr
 {
@@ -24,67 +26,128 @@ namespace cvr
  */
 
 /**
- * @brief Class that allows loading of files using a background thread and allows job status to be queried.  
+ * @brief Class that allows loading of files using a pool of background threads and allows job status to be queried.  
  * Progress is synced across the graphics cluster
+ *
+ * Each file in a job is a separate work item, so the items of a list job are loaded in parallel.
+ * Items from jobs with a higher priority are loaded first.
+ *
+ * With streaming enabled, model and image files are only read on the master node.  The loaded
+ * data is serialized and sent to the render nodes a chunk at a time each frame.
  */
 class CVRKERNEL_EXPORT ThreadedLoader
 {
         friend class CalVR;
     public:
+
+        /**
+         * @brief Interface for getting notified when a job finishes
+         */
+        class JobCallback
+        {
+            public:
+                virtual ~JobCallback()
+                {
+                }
+
+                /**
+                 * @brief Called from the main thread once the job has finished on all nodes
+                 * @param job job number
+                 * @param error true if the job was cancelled
+                 */
+                virtual void jobFinished(int job, bool error) = 0;
+        };
+
         /**
          * @brief get a static pointer to the instance of the class
          */
         static ThreadedLoader * instance();
 
+        /**
+         * @brief Read config values
+         */
+        bool init();
+
+        /**
+         * @brief Returns if file loads are done on the master and streamed to the render nodes
+         */
+        bool getStreaming()
+        {
+            return _stream;
+        }
+
         /**
          * @brief Open a model file with a background thread
          * @param filename name of file to open
          * @param options osg options structure to use with the readNodeFile call
+         * @param priority jobs with a higher priority are loaded first
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
         int readNodeFile(std::string filename,
-                osgDB::ReaderWriter::Options * options = NULL);
+                osgDB::ReaderWriter::Options * options = NULL,
+                int priority = 0, JobCallback * callback = NULL);
 
         /**
          * @brief Open a list of model files with a background thread
          * @param filenames list of files to open
          * @param options list of osg options to use with the readNodeFile call, ignored if not present or NULL
+         * @param priority jobs with a higher priority are loaded first
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
         int readNodeFiles(std::vector<std::string> & filenames,
-                std::vector<osgDB::ReaderWriter::Options *> & options);
+                std::vector<osgDB::ReaderWriter::Options *> & options,
+                int priority = 0, JobCallback * callback = NULL);
 
         /**
          * @brief Open an image file with a background thread
          * @param filename name of file to open
          * @param options osg options structure to use with the readImageFile call
+         * @param priority jobs with a higher priority are loaded first
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
         int readImageFile(std::string & filename,
-                osgDB::ReaderWriter::Options * options = NULL);
+                osgDB::ReaderWriter::Options * options = NULL,
+                int priority = 0, JobCallback * callback = NULL);
 
         /**
          * @brief Open a list of image files with a background thread
          * @param filenames list of files to open
          * @param options list of osg options to use with the readImageFile call, ignored if not present or NULL
+         * @param priority jobs with a higher priority are loaded first
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
         int readImageFiles(std::vector<std::string> & filenames,
-                std::vector<osgDB::ReaderWriter::Options *> & options);
+                std::vector<osgDB::ReaderWriter::Options *> & options,
+                int priority = 0, JobCallback * callback = NULL);
 
         /**
          * @brief Runs a system command in a background thread over all nodes
          * @param command command to execute
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
-        int systemCommand(std::string command);
+        int systemCommand(std::string command, JobCallback * callback = NULL);
 
         /**
          * @brief Runs a system command in a background thread on the master node only
          * @param command command to execute
+         * @param callback called when the job finishes, may be NULL
          * @return job number for this operation
          */
-        int systemCommandMasterOnly(std::string command);
+        int systemCommandMasterOnly(std::string command,
+                JobCallback * callback = NULL);
+
+        /**
+         * @brief Stop a job, items not yet started are skipped
+         *
+         * Items already being loaded run to completion, but the job ends in error.
+         * The job must still be removed.
+         */
+        void cancel(int job);
 
         /**
          * @brief Returns if there was an error executing the job
@@ -109,6 +172,20 @@ class CVRKERNEL_EXPORT ThreadedLoader
          */
         float getProgress(int job);
 
+        /**
+         * @brief Get the number of files in a job
+         *
+         * Returns 0 if job does not exist
+         */
+        int getNumItems(int job);
+
+        /**
+         * @brief Returns if a single file of a job has been loaded on this node
+         *
+         * Unlike the job status, this is not synced across the cluster
+         */
+        bool isItemDone(int job, int item);
+
         /**
          * @brief Removes a job, finished or not, from the threaded loader
          */
@@ -147,8 +224,17 @@ class CVRKERNEL_EXPORT ThreadedLoader
     protected:
         ThreadedLoader();
         virtual ~ThreadedLoader();
+
+        /**
+         * @brief Sync job status across the cluster, does not run callbacks
+         */
         void update();
 
+        /**
+         * @brief Run the callbacks of the jobs that finished in the last update()
+         */
+        void runCallbacks();
+
         static ThreadedLoader * _myPtr; ///< static self pointer
 
         enum JobType
@@ -161,51 +247,112 @@ class CVRKERNEL_EXPORT ThreadedLoader
             SYSTEM_MASTER
         };
 
+        /**
+         * @brief Job state shared with the loader threads, protected by the queue lock
+         */
         struct ThreadedJob
         {
                 JobType type;
+                int priority;
                 std::vector<std::string> strs;
                 std::vector<osgDB::ReaderWriter::Options *> options;
+                std::vector<void*> ptrs; ///< result for each item, reffed
+                std::vector<bool> itemDone; ///< if each item has been processed
+                int itemsDone; ///< number of items processed
+                int itemsRunning; ///< number of items being processed by a thread
+                bool cancel; ///< if remaining items should be skipped
+                bool removed; ///< if the job can be deleted once no items are running
+                JobCallback * callback;
+                bool stream; ///< if items are loaded on the master and sent to the render nodes
+                std::vector<std::vector<char> > streamData; ///< serialized item data
+                std::vector<int> streamSize; ///< size of the serialized item, -1 if the load failed
+                std::vector<int> streamSent; ///< bytes of each item sent or received
         };
 
-        struct ThreadResult
+        /**
+         * @brief Header for a piece of a serialized item in a stream message
+         */
+        struct StreamChunk
         {
-                JobType type;
-                int ret;
-                std::vector<void*> ptrs;
+                int job;
+                int item;
+                int totalSize; ///< size of the serialized item, -1 if the load failed
+                int offset; ///< offset of this piece in the item data
+                int size; ///< size of the data following the header
+        };
+
+        /**
+         * @brief A single file of a job waiting to be loaded
+         */
+        struct WorkItem
+        {
+                int priority;
+                int job;
+                int item;
+
+                bool operator<(const WorkItem & other) const
+                {
+                    // highest priority first, then oldest job, then list order
+                    if(priority != other.priority)
+                    {
+                        return priority < other.priority;
+                    }
+                    if(job != other.job)
+                    {
+                        return job > other.job;
+                    }
+                    return item > other.item;
+                }
         };
 
+        /**
+         * @brief Thread in the loader pool, processes work items until the loader is destroyed
+         */
         class LoaderThread : public OpenThreads::Thread
         {
             public:
-                LoaderThread(ThreadedJob * job);
+                LoaderThread(ThreadedLoader * loader);
                 virtual ~LoaderThread();
                 virtual void run();
 
-                void quit();
-
-                char getStatus();
-                ThreadResult * getResult()
-                {
-                    return &_result;
-                }
-
             protected:
-                ThreadedJob * _job;
-                ThreadResult _result;
-                char _status;
-
-                bool _quit;
-                OpenThreads::Mutex _quitLock;
-
-                OpenThreads::Mutex _statusLock;
+                ThreadedLoader * _loader;
         };
 
+        int addJob(ThreadedJob * job);
+        void startThreads();
+        void * processItem(ThreadedJob * job, int item);
+        void serializeItem(ThreadedJob * job, int item, void * result);
+        void * deserializeItem(ThreadedJob * job, int item);
+        void streamItems();
+        char getLocalStatus(ThreadedJob * job);
+        void syncStatus(std::vector<int> & jobs, std::vector<char> & status);
+        void deleteJob(ThreadedJob * job);
+
         int _jobID;
 
-        std::map<int,ThreadedJob*> _jobs;
-        std::map<int,LoaderThread*> _threads;
-        std::map<int,char> _jobStatus;
+        std::map<int,ThreadedJob*> _jobs; ///< jobs with status still being synced
+        std::map<int,char> _jobStatus; ///< cluster synced status of each job
+        std::map<int,char> _reportedStatus; ///< local status of each job last sent for syncing
+
+        struct FinishedJob
+        {
+                int job;
+                JobCallback * callback;
+                bool error;
+        };
+        std::vector<FinishedJob> _finishedJobs; ///< jobs finished in the last update with callbacks still to run
+
+        OpenThreads::Mutex _queueLock; ///< protects the queue, the job list and the job states
+        OpenThreads::Condition _queueCondition; ///< signaled when work is added
+        std::priority_queue<WorkItem> _queue; ///< items waiting to be processed
+        std::map<int,ThreadedJob*> _jobList; ///< all jobs not yet deleted
+        std::vector<LoaderThread*> _threads; ///< loader thread pool
+        bool _quit; ///< tells loader threads to exit
+
+        bool _stream; ///< load on the master and stream to the render nodes
+        int _streamChunkSize; ///< max bytes of item data sent each frame
+        int _streamBytes; ///< item data bytes sent or received this frame
 };
 
 /**
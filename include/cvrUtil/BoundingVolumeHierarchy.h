@@ -0,0 +1,130 @@
+/**
+ * @file BoundingVolumeHierarchy.h
+ */
+#ifndef CALVR_BOUNDING_VOLUME_HIERARCHY_H
+#define CALVR_BOUNDING_VOLUME_HIERARCHY_H
+
+#include <cvrUtil/Export.h>
+
+#include <osg/BoundingBox>
+#include <osg/Vec3>
+
+#include <vector>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+/**
+ * @brief Axis aligned bounding box tree over a set of items, used to find the
+ * items a group of rays may hit
+ *
+ * Items are added, then the tree is built.  Changing an item's bounds only
+ * refits the boxes above it, the tree is rebuilt once refits have worn it down.
+ */
+class CVRUTIL_EXPORT BoundingVolumeHierarchy
+{
+    public:
+        BoundingVolumeHierarchy();
+        virtual ~BoundingVolumeHierarchy();
+
+        /**
+         * @brief Remove all items and nodes
+         */
+        void clear();
+
+        /**
+         * @brief Add an item, the tree must be built before it can be found
+         * @param data user pointer returned by intersect
+         * @param bound bounds of the item
+         * @return item index
+         */
+        int addItem(void * data, const osg::BoundingBox & bound);
+
+        /**
+         * @brief Get the number of items
+         */
+        int getNumItems()
+        {
+            return _items.size();
+        }
+
+        /**
+         * @brief Get the bounds of an item
+         */
+        const osg::BoundingBox & getItemBound(int item)
+        {
+            return _items[item].bound;
+        }
+
+        /**
+         * @brief Change the bounds of an item, takes effect on the next refit
+         */
+        void setItemBound(int item, const osg::BoundingBox & bound);
+
+        /**
+         * @brief Build the tree from the current items
+         */
+        void build();
+
+        /**
+         * @brief Update the node bounds above items that changed
+         */
+        void refit();
+
+        /**
+         * @brief Find the items whose bounds are hit by each ray
+         * @param starts ray start points
+         * @param dirs ray directions, need not be normalized
+         * @param hits set to the user pointers of the items hit by each ray
+         *
+         * Rays only go forward from the start point.  All rays are walked down
+         * the tree together.
+         */
+        void intersect(const std::vector<osg::Vec3> & starts,
+                const std::vector<osg::Vec3> & dirs,
+                std::vector<std::vector<void*> > & hits);
+
+    protected:
+        struct Item
+        {
+                void * data;
+                osg::BoundingBox bound;
+                int leaf; ///< node holding this item
+        };
+
+        struct Node
+        {
+                osg::BoundingBox bound;
+                int parent;
+                int left; ///< first child, -1 for a leaf
+                int right;
+                int first; ///< start of the leaf's items in the item index list
+                int count; ///< number of items in the leaf
+                bool dirty; ///< leaf has an item with changed bounds
+        };
+
+        int buildNode(int parent, int first, int count,
+                const std::vector<osg::Vec3> & centroids);
+        static bool hitsBox(const osg::BoundingBox & bound,
+                const osg::Vec3 & start, const osg::Vec3 & invDir);
+
+        std::vector<Item> _items;
+        std::vector<Node> _nodes;
+        std::vector<int> _itemIndex; ///< item indices ordered by leaf
+        std::vector<int> _dirtyLeaves; ///< leaves to refit
+        int _refits; ///< leaf refits since the last build
+        bool _built; ///< is the tree current with the item list
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
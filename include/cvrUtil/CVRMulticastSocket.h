@@ -76,6 +76,16 @@ class CVRMulticastSocket
          */
         bool recv(void * buf, size_t len, int flags = 0);
 
+        /**
+         * @brief Receive a single datagram from the socket
+         * @param buf buffer to write data to
+         * @param len size of the buffer
+         * @param timeout time to wait for a datagram in milliseconds, negative
+         *      waits forever
+         * @return size of the datagram, 0 on timeout, -1 on error
+         */
+        int recvDatagram(void * buf, size_t len, int timeout = -1);
+
         /**
          * @brief Set the socket descriptor
          */
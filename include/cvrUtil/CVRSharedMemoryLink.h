@@ -0,0 +1,125 @@
+/**
+ * @file CVRSharedMemoryLink.h
+ */
+#ifndef CVR_SHARED_MEMORY_LINK_H
+#define CVR_SHARED_MEMORY_LINK_H
+
+#include <cvrUtil/Export.h>
+#include <cvrUtil/CVRSocket.h>
+
+#include <string>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+/**
+ * @brief Two way byte stream between processes on the same host, using a
+ *        pair of ring buffers in shared memory
+ *
+ * One process creates the link, the other opens it by name.  send and recv
+ * block like a tcp socket.  A blocked side spins for a short time, then
+ * sleeps until the other side makes progress.
+ *
+ * Note: currently only supported on linux, create/open fail elsewhere
+ */
+class CVRUTIL_EXPORT CVRSharedMemoryLink
+{
+    public:
+        CVRSharedMemoryLink();
+        ~CVRSharedMemoryLink();
+
+        /**
+         * @brief Create a new shared memory segment for the link
+         * @param name name of the segment, must start with '/'
+         * @param ringSize bytes buffered in each direction, rounded up to a
+         *        power of two
+         */
+        bool create(std::string name, unsigned int ringSize);
+
+        /**
+         * @brief Open a link created by another process
+         * @param name name of the segment
+         * @param key value of getKey() in the creating process, used to make
+         *        sure this is the same segment
+         */
+        bool open(std::string name, unsigned int key);
+
+        /**
+         * @brief Remove the segment name, the link stays usable while mapped
+         *
+         * Call once both sides have the link open, so the segment does not
+         * outlive the processes
+         */
+        void unlink();
+
+        /**
+         * @brief Random value set by the creator of the link
+         */
+        unsigned int getKey();
+
+        /**
+         * @brief Send data through the link
+         * @param buf data to send
+         * @param len length of the data
+         */
+        bool send(void * buf, size_t len);
+
+        /**
+         * @brief Receive data from the link
+         * @param buf buffer to store data in
+         * @param len length of data to read from the link
+         */
+        bool recv(void * buf, size_t len);
+
+        /**
+         * @brief Send several buffers in order
+         */
+        bool sendv(SocketBuffer * buffers, int count);
+
+        /**
+         * @brief Set how many times to poll the ring before sleeping
+         */
+        void setSpinCount(int count)
+        {
+            _spinCount = count;
+        }
+
+        /**
+         * @brief Returns if the link is set up and the other side has not
+         *        closed it
+         */
+        bool valid();
+
+    protected:
+        bool map(int fd, size_t size);
+        void close();
+        bool wait(volatile unsigned int * value, unsigned int old,
+                volatile unsigned int * waiting);
+        bool peerAlive();
+
+        std::string _name; ///< segment name
+        bool _creator; ///< did this process create the segment
+        bool _linked; ///< does the segment name still exist
+        void * _segment; ///< mapped segment
+        size_t _segmentSize; ///< size of the mapped segment
+        void * _sendRing; ///< header of the ring this side writes
+        void * _recvRing; ///< header of the ring this side reads
+        char * _sendData; ///< data of the ring this side writes
+        char * _recvData; ///< data of the ring this side reads
+        unsigned int _ringSize; ///< size of each ring, a power of two
+        int _spinCount; ///< polls before sleeping on a blocked ring
+        bool _error; ///< the other side has gone away
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
@@ -1,168 +1,250 @@
-/**
- * @file CVRSocket.h
- */
-
-#ifndef CVR_SOCKET_H
-#define CVR_SOCKET_H
-
-#include <cvrUtil/Export.h>
-
-#include <string>
-
-#ifndef WIN32
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#else
-#include <WS2tcpip.h>
-#endif
-
-namespace cvr
-{
-
-/**
- * @addtogroup util
- * @{
- */
-
-/**
- * @brief Will this socket connect to another, or listen for a connection
- */
-enum SocketType
-{
-    LISTEN, CONNECT
-};
-
-/**
- * @brief Cross platform (windows not yet tested) socket class
- *
- * Note: currenly only tcp is supported
- */
-class CVRUTIL_EXPORT CVRSocket
-{
-    public:
-        /**
-         * @brief Constructor
-         * @param socket socket descriptor to use instead of creating a connection
-         */
-        CVRSocket(int socket);
-
-        /**
-         * @brief Constructor
-         * @param type socket type
-         * @param host host to connect to or interface to bind to
-         * @param port port to connect to or port to bind to
-         * @param family socket family
-         * @param sockType socket type
-         */
-        CVRSocket(SocketType type, std::string host, int port, int family =
-        AF_INET, int sockType = SOCK_STREAM);
-        ~CVRSocket();
-
-        /**
-         * @brief Bind to a port
-         *
-         * Only needed for a LISTEN type socket
-         */
-        bool bind();
-
-        /**
-         * @brief Listen for an incomming connection
-         * @param backlog listen backlog queue size
-         * 
-         * Only needed for LISTEN type socket
-         */
-        bool listen(int backlog = 5);
-
-        /**
-         * @brief Accept an incomming connection
-         *
-         * Only needed for LISTEN type socket
-         */
-        bool accept();
-
-        /**
-         * @brief Connect to a remote host
-         * @param timeout connect timeout in sec
-         *
-         * Only needed for CONNECT type socket
-         */
-        bool connect(int timeout = 0);
-
-        /**
-         * @brief Wrapper for setsockopt call
-         */
-        int setsockopt(int level, int optname, void * val, socklen_t len);
-
-        /**
-         * @brief Set the socket option to enable/disable nagle algorithm
-         *
-         * Algorithm can delay the sending of small packets
-         */
-        void setNoDelay(bool b);
-
-        /**
-         * @brief Set the socket option to enable/disable rebinding an address/port combo
-         *
-         * Will let you rebind even if an old socket has not fully closed
-         */
-        void setReuseAddress(bool b);
-
-        /**
-         * @brief Set the blocking state of the socket
-         */
-        void setBlocking(bool b);
-
-        /**
-         * @brief Send data through the socket
-         * @param buf data to send
-         * @param len length of the data
-         * @param flags flags to use in the send call
-         */
-        bool send(void * buf, size_t len, int flags = 0);
-
-        /**
-         * @brief Receive data from the socket
-         * @param buf buffer to store data in
-         * @param len length of data to read from the socket
-         * @param flags flags to use in the recv call
-         */
-        bool recv(void * buf, size_t len, int flags = 0);
-
-        /**
-         * @brief Returns if the socket descriptor is valid
-         */
-        bool valid();
-
-        /**
-         * @brief Set the descriptor for the socket
-         */
-        void setSocketFD(int socket);
-
-        /**
-         * @brief Get the descriptor for the socket
-         */
-        int getSocketFD();
-
-    protected:
-        int _socket; ///< socket descriptor
-        SocketType _type; ///< socket connection type
-        int _family; ///< socket family
-        int _sockType; ///< socket type
-        std::string _host; ///< remote/local interface
-        int _port; ///< socket port
-        struct addrinfo * _res;
-
-        fd_set _connectTest;
-        bool _blockingState; ///< socket current blocking state
-        bool _printErrors; ///< should socket errors be printed
-};
-
-/**
- * @}
- */
-
-}
-
-#endif
-
+/**
+ * @file CVRSocket.h
+ */
+
+#ifndef CVR_SOCKET_H
+#define CVR_SOCKET_H
+
+#include <cvrUtil/Export.h>
+
+#include <string>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#else
+#include <WS2tcpip.h>
+#endif
+
+namespace cvr
+{
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+/**
+ * @brief Will this socket connect to another, or listen for a connection
+ */
+enum SocketType
+{
+    LISTEN, CONNECT
+};
+
+/**
+ * @brief Part of a scatter/gather transfer
+ */
+struct SocketBuffer
+{
+        void * data;
+        size_t len;
+};
+
+/**
+ * @brief Cross platform (windows not yet tested) socket class
+ *
+ * Note: currenly only tcp is supported
+ */
+class CVRUTIL_EXPORT CVRSocket
+{
+    public:
+        /**
+         * @brief Constructor
+         * @param socket socket descriptor to use instead of creating a connection
+         */
+        CVRSocket(int socket);
+
+        /**
+         * @brief Constructor
+         * @param type socket type
+         * @param host host to connect to or interface to bind to
+         * @param port port to connect to or port to bind to
+         * @param family socket family
+         * @param sockType socket type
+         */
+        CVRSocket(SocketType type, std::string host, int port, int family =
+        AF_INET, int sockType = SOCK_STREAM);
+        ~CVRSocket();
+
+        /**
+         * @brief Bind to a port
+         *
+         * Only needed for a LISTEN type socket
+         */
+        bool bind();
+
+        /**
+         * @brief Listen for an incomming connection
+         * @param backlog listen backlog queue size
+         * 
+         * Only needed for LISTEN type socket
+         */
+        bool listen(int backlog = 5);
+
+        /**
+         * @brief Accept an incomming connection
+         *
+         * Only needed for LISTEN type socket
+         */
+        bool accept();
+
+        /**
+         * @brief Connect to a remote host
+         * @param timeout connect timeout in sec
+         *
+         * Only needed for CONNECT type socket
+         */
+        bool connect(int timeout = 0);
+
+        /**
+         * @brief Wrapper for setsockopt call
+         */
+        int setsockopt(int level, int optname, void * val, socklen_t len);
+
+        /**
+         * @brief Set the socket option to enable/disable nagle algorithm
+         *
+         * Algorithm can delay the sending of small packets
+         */
+        void setNoDelay(bool b);
+
+        /**
+         * @brief Set the socket option to enable/disable rebinding an address/port combo
+         *
+         * Will let you rebind even if an old socket has not fully closed
+         */
+        void setReuseAddress(bool b);
+
+        /**
+         * @brief Set the blocking state of the socket
+         */
+        void setBlocking(bool b);
+
+        /**
+         * @brief Send data through the socket
+         * @param buf data to send
+         * @param len length of the data
+         * @param flags flags to use in the send call
+         */
+        bool send(void * buf, size_t len, int flags = 0);
+
+        /**
+         * @brief Receive data from the socket
+         * @param buf buffer to store data in
+         * @param len length of data to read from the socket
+         * @param flags flags to use in the recv call
+         */
+        bool recv(void * buf, size_t len, int flags = 0);
+
+        /**
+         * @brief Send several buffers in order, with one system call when
+         *        the socket allows it
+         * @param buffers buffers to send
+         * @param count number of buffers
+         * @param flags flags to use in the send call
+         * @param timeout ms to wait each time the socket is not ready, -1 waits
+         *        until ready
+         *
+         * If this returns false part of the data may have been sent
+         */
+        bool sendv(SocketBuffer * buffers, int count, int flags = 0,
+                int timeout = -1);
+
+        /**
+         * @brief Receive into several buffers in order, with one system call
+         *        when the data is available
+         * @param buffers buffers to fill
+         * @param count number of buffers
+         * @param flags flags to use in the recv call
+         * @param timeout ms to wait each time no data is ready, -1 waits until
+         *        ready
+         */
+        bool recvv(SocketBuffer * buffers, int count, int flags = 0,
+                int timeout = -1);
+
+        /**
+         * @brief Send as much of the buffers as possible without blocking
+         * @return bytes sent, 0 if the socket is not ready, -1 on error
+         *
+         * Makes one system call.  On windows the socket must be set
+         * non-blocking.
+         */
+        int trySendv(SocketBuffer * buffers, int count, int flags = 0);
+
+        /**
+         * @brief Receive as much as is available without blocking
+         * @return bytes received, 0 if nothing is ready, -1 on error or if the
+         *         connection was closed
+         *
+         * Makes one system call.  On windows the socket must be set
+         * non-blocking.
+         */
+        int tryRecvv(SocketBuffer * buffers, int count, int flags = 0);
+
+        /**
+         * @brief Hold back partial packets until uncorked, so several sends go
+         *        out together
+         *
+         * Uses TCP_CORK on linux and TCP_NOPUSH on apple, does nothing
+         * elsewhere
+         */
+        void setCork(bool b);
+
+        /**
+         * @brief Send large transfers from sendv without copying them into the
+         *        kernel
+         * @param minSize smallest transfer to send this way, 0 to disable
+         * @return false if not supported
+         *
+         * Linux only.  sendv returns once the kernel is done with the data,
+         * which for tcp is after the remote end has acknowledged it, so this is
+         * only a gain for transfers large enough that the copy costs more.
+         * Not enabled for connections within this host, where the data is
+         * copied anyway.
+         */
+        bool setZeroCopy(size_t minSize);
+
+        /**
+         * @brief Returns if the socket descriptor is valid
+         */
+        bool valid();
+
+        /**
+         * @brief Set the descriptor for the socket
+         */
+        void setSocketFD(int socket);
+
+        /**
+         * @brief Get the descriptor for the socket
+         */
+        int getSocketFD();
+
+    protected:
+        bool waitReady(bool read, int timeout);
+        bool waitZeroCopy();
+
+        int _socket; ///< socket descriptor
+        SocketType _type; ///< socket connection type
+        int _family; ///< socket family
+        int _sockType; ///< socket type
+        std::string _host; ///< remote/local interface
+        int _port; ///< socket port
+        struct addrinfo * _res;
+
+        fd_set _connectTest;
+        bool _blockingState; ///< socket current blocking state
+        bool _printErrors; ///< should socket errors be printed
+        size_t _zeroCopyMin; ///< smallest sendv sent with zero copy, 0 if disabled
+        unsigned int _zeroCopyPending; ///< zero copy sends not yet released by the kernel
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
+
@@ -14,6 +14,8 @@
 #include <OpenThreads/Mutex>
 
 #include <cstdio>
+#include <map>
+#include <vector>
 
 /**********************************************************
  * Ravi Mathur
@@ -77,6 +79,69 @@ class CVRUTIL_EXPORT DepthPartitionNode : public osg::Group
 
         void removeNodesFromCameras();
 
+        /** Set/get how far the view may move before a context's partition is
+         recomputed, as a fraction of each modelview and projection value.
+         0 only reuses the partition for an unchanged view, a negative value
+         always recomputes. Defaults to -1, reuse is off.
+         A tracked head never holds perfectly still, so reuse needs a small
+         positive tolerance, such as 0.001, to take effect. */
+        void setReuseTolerance(double tolerance)
+        {
+            _reuseTolerance = tolerance;
+        }
+        inline double getReuseTolerance() const
+        {
+            return _reuseTolerance;
+        }
+
+        /** Set/get the number of frames a partition may be reused before it
+         is recomputed, 0 for no limit. Defaults to 3.
+         Only the bounds of this node's children are checked for reuse, so
+         geometry moving inside an unchanged bound keeps the old near/far
+         splits until the limit is hit or dirtyPartition() is called. A
+         larger limit saves more cull time on still scenes but leaves
+         animated ones with wrong splits for longer. */
+        void setMaxReuseFrames(unsigned int frames)
+        {
+            _maxReuseFrames = frames;
+        }
+        inline unsigned int getMaxReuseFrames() const
+        {
+            return _maxReuseFrames;
+        }
+
+        /** Mark the scene as changed, so every context recomputes its
+         partition on the next cull. */
+        void dirtyPartition()
+        {
+            _sceneRevision++;
+        }
+
+        /** Set/get the number of threads used to collect distances in each
+         context, and the number of children a group needs for its
+         traversal to be split between them. */
+        void setNumThreads(unsigned int threads);
+        inline unsigned int getNumThreads() const
+        {
+            return _numThreads;
+        }
+        void setParallelThreshold(unsigned int children);
+        inline unsigned int getParallelThreshold() const
+        {
+            return _parallelThreshold;
+        }
+
+        /** Totals over all culls since the stats were last reset */
+        struct PartitionStats
+        {
+                unsigned int cameras; // Cameras used
+                unsigned int reused; // Culls that reused the last partition
+                double time; // Seconds spent partitioning
+        };
+
+        PartitionStats getStats();
+        void resetStats();
+
         protected:
         typedef std::vector<osg::ref_ptr<osg::Camera> > CameraList;
 
@@ -102,6 +167,32 @@ class CVRUTIL_EXPORT DepthPartitionNode : public osg::Group
 
         std::map<int,osg::ref_ptr<DistanceAccumulator> > _daMap;
 
+        // Last partition computed in a context, and the inputs used to
+        // compute it
+        struct PartitionCache
+        {
+                bool valid;
+                osg::Matrix modelview;
+                osg::Matrix projection;
+                unsigned int revision;
+                unsigned int frames; // Frames the partition has been reused
+                std::vector<osg::BoundingSphere> bounds; // Child bounds
+                DistanceAccumulator::PairList cameraPairs;
+        };
+
+        bool canReusePartition(PartitionCache &cache,
+                const osg::Matrix &modelview, const osg::Matrix &projection);
+
+        std::map<int,PartitionCache> _partitionCache;
+        double _reuseTolerance;
+        unsigned int _maxReuseFrames;
+        unsigned int _sceneRevision;
+        unsigned int _numThreads;
+        unsigned int _parallelThreshold;
+
+        PartitionStats _stats;
+        OpenThreads::Mutex _statsLock;
+
         bool _forwardOtherTraversals;
         OpenThreads::Mutex _lock;
     };
@@ -12,6 +12,10 @@
 #include <osg/Polytope>
 #include <osg/fast_back_stack>
 #include <OpenThreads/Mutex>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Block>
+
+#include <vector>
 
 /**********************************************************
  * Ravi Mathur
@@ -78,9 +82,56 @@ class DistanceAccumulator : public osg::NodeVisitor
             return _maxDepth;
         }
 
+        // Set/get the number of threads used to traverse groups with many
+        // children, including the calling thread. Defaults to 1.
+        void setNumThreads(unsigned int threads);
+        inline unsigned int getNumThreads() const
+        {
+            return _threads.size() + 1;
+        }
+
+        // Set/get the number of children a group needs for its traversal to
+        // be split between threads
+        inline void setParallelThreshold(unsigned int children)
+        {
+            _parallelThreshold = children;
+        }
+        inline unsigned int getParallelThreshold() const
+        {
+            return _parallelThreshold;
+        }
+
     protected:
         virtual ~DistanceAccumulator();
 
+        // Thread that collects distance pairs for part of a group's children
+        class AccumulateThread : public OpenThreads::Thread
+        {
+            public:
+                AccumulateThread();
+                virtual ~AccumulateThread();
+                virtual void run();
+
+                void quit();
+
+                // Start traversing children [first, first + count) of group
+                void startWork(DistanceAccumulator * parent, osg::Group * group,
+                        unsigned int first, unsigned int count,
+                        OpenThreads::BlockCount * done);
+
+                osg::ref_ptr<DistanceAccumulator> _accumulator;
+
+            protected:
+                OpenThreads::Block _start;
+                OpenThreads::BlockCount * _done;
+                osg::Group * _group;
+                unsigned int _first, _count;
+                bool _quit;
+        };
+
+        // Traverse a node's children, splitting large groups between threads
+        void traverseChildren(osg::Node &node);
+
         void pushLocalFrustum();
         void pushDistancePair(double zNear, double zFar);
         bool shouldContinueTraversal(osg::Node &node);
@@ -113,6 +164,13 @@ class DistanceAccumulator : public osg::NodeVisitor
 
         // Maximum depth to traverse to
         unsigned int _maxDepth, _currentDepth;
+
+        // Threads helping with large groups, and the number of children
+        // needed to use them
+        std::vector<AccumulateThread*> _threads;
+        unsigned int _parallelThreshold;
+        bool _splitting;
+        OpenThreads::BlockCount _threadsDone;
 };
 
 #endif
@@ -5,7 +5,12 @@
 #define MENU_ISECT_H
 
 #include <cvrUtil/Export.h>
-#include <osgUtil/IntersectVisitor>
+
+#include <osg/Node>
+#include <osg/Geode>
+#include <osg/Vec3>
+
+#include <vector>
 
 /**
  * @addtogroup util
@@ -26,17 +31,32 @@ class IsectInfo
         osg::Geode *geode;              ///< intersected Geode
 };
 
-//TODO: modify this call to take a vector reference to remove the return copies
 /**
  * @brief Finds all the intersections between a line segment and the geometry under a node
  * @param root scenegraph to seach under
  * @param wPointerStart start point of the line segment
  * @param wPointerEnd end point of the line segment
- * @return list of all geometry intersections
+ * @return list of all geometry intersections, nearest first
  */
 CVRUTIL_EXPORT std::vector<IsectInfo> getObjectIntersection(osg::Node *root,
         osg::Vec3& wPointerStart, osg::Vec3& wPointerEnd);
 
+/**
+ * @brief Finds the intersections between a line segment and the geometry under a node
+ * @param root scenegraph to seach under
+ * @param wPointerStart start point of the line segment
+ * @param wPointerEnd end point of the line segment
+ * @param isecvec set to the geometry intersections, nearest first
+ * @param nearestOnly only find the nearest intersection
+ * @return true if there was an intersection
+ *
+ * Uses the shared cvr::RayQuery, which serializes queries from different
+ * threads
+ */
+CVRUTIL_EXPORT bool getObjectIntersection(osg::Node *root,
+        const osg::Vec3& wPointerStart, const osg::Vec3& wPointerEnd,
+        std::vector<IsectInfo> & isecvec, bool nearestOnly = false);
+
 /**
  * @}
  */
@@ -50,6 +50,14 @@ class CVRUTIL_EXPORT MultiListenSocket
          */
         CVRSocket * accept();
 
+        /**
+         * @brief Get the listening socket descriptor, -1 if not set up
+         */
+        int getSocketFD()
+        {
+            return _valid ? _socket : -1;
+        }
+
     protected:
         int _port; ///< port to listen on
         int _queue; ///< size of listen queue
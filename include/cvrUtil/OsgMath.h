@@ -7,6 +7,8 @@
 #include <cvrUtil/Export.h>
 
 #include <osg/Vec3>
+#include <osg/Matrix>
+#include <osg/BoundingBox>
 
 namespace cvr
 {
@@ -172,6 +174,15 @@ CVRUTIL_EXPORT void planePointClosestPointRef(const osg::Vec3 & planePoint,
         const osg::Vec3 & planeNormal, const osg::Vec3 & point,
         osg::Vec3 & closestPoint);
 
+/**
+ * @brief Find the axis aligned box containing a transformed box
+ * @param bb box to transform
+ * @param mat transform
+ * @return box around the eight transformed corners, invalid if bb is invalid
+ */
+CVRUTIL_EXPORT osg::BoundingBox transformBoundingBox(const osg::BoundingBox & bb,
+        const osg::Matrix & mat);
+
 /**
  * @}
  */
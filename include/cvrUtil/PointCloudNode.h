@@ -0,0 +1,341 @@
+/**
+ * @file PointCloudNode.h
+ */
+#ifndef CALVR_POINT_CLOUD_NODE_H
+#define CALVR_POINT_CLOUD_NODE_H
+
+#include <cvrUtil/PointsNode.h>
+
+#include <osg/Group>
+#include <osg/BoundingBox>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <OpenThreads/Atomic>
+
+#include <string>
+#include <vector>
+#include <queue>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+/**
+ * @brief OpenSceneGraph Node that draws a point cloud too large to keep in memory
+ *
+ * Points are stored in an octree file, each octree node holds a sample of the
+ * points in its box and its children add detail.  The file is memory mapped
+ * and node chunks are read by background threads as the view needs them.
+ * Each frame, nodes are refined while their point spacing covers more than the
+ * allowed number of pixels and the point budget is not used up.  Loaded chunks
+ * are drawn with a PointsNode, so all of its rendering modes can be used.
+ * The chunk PointsNodes are managed as children of this node.
+ */
+class PointCloudNode : public osg::Group
+{
+    public:
+        /**
+         * @brief Constructor
+         * @param mode Point rendering mode
+         * @param pointSize Point size used by the points and sprite modes
+         * @param radius Radius used by the shaded sphere mode
+         */
+        PointCloudNode(PointsNode::PointsMode mode =
+                PointsNode::POINTS_GL_POINTS, float pointSize = 1.0,
+                float radius = 1.0);
+
+        /**
+         * @brief Open an octree point file, replaces any file already open
+         * @return false if the file could not be opened or is not a point octree
+         */
+        bool open(std::string file);
+
+        /**
+         * @brief Close the current file and drop all loaded chunks
+         */
+        void close();
+
+        /**
+         * @brief Get if a file is open
+         */
+        bool isOpen()
+        {
+            return _data != NULL;
+        }
+
+        /**
+         * @brief Write a set of points to an octree point file
+         * @param file file to write
+         * @param vertArray point positions
+         * @param colorArray point colors, one per point or one for all
+         * @param maxNodePoints max number of points in an octree node
+         * @return false if the file could not be written
+         */
+        static bool writeFile(std::string file, osg::Vec3Array * vertArray,
+                osg::Vec4ubArray * colorArray, int maxNodePoints = 20000);
+
+        /**
+         * @brief Get the total number of points in the file
+         */
+        unsigned long long getTotalPoints()
+        {
+            return _totalPoints;
+        }
+
+        /**
+         * @brief Get the bounds of all points in the file
+         */
+        const osg::BoundingBox & getPointBound()
+        {
+            return _pointBound;
+        }
+
+        /**
+         * @brief Set the max number of points drawn in a view
+         */
+        void setPointBudget(int budget)
+        {
+            _pointBudget = budget;
+        }
+
+        int getPointBudget()
+        {
+            return _pointBudget;
+        }
+
+        /**
+         * @brief Set the max number of points kept loaded, defaults to four
+         * times the point budget
+         *
+         * Chunks not drawn recently are released past this limit.  A value less
+         * than 0 uses the default.
+         */
+        void setCachePoints(int points)
+        {
+            _cachePoints = points;
+        }
+
+        /**
+         * @brief Set the screen space error in pixels, nodes are refined while
+         * their point spacing is larger than this
+         */
+        void setMaxPixelError(float error)
+        {
+            _maxPixelError = error;
+        }
+
+        float getMaxPixelError()
+        {
+            return _maxPixelError;
+        }
+
+        /**
+         * @brief Set the number of threads used to read chunks, takes effect
+         * on the next open
+         */
+        void setNumLoadThreads(int threads)
+        {
+            _numThreads = threads;
+        }
+
+        /**
+         * @brief Set the point rendering mode for all chunks
+         */
+        void setPointsMode(PointsNode::PointsMode mode);
+
+        PointsNode::PointsMode getPointsMode()
+        {
+            return _mode;
+        }
+
+        /**
+         * @brief Set the point size for all chunks
+         */
+        void setPointSize(float size);
+
+        /**
+         * @brief Set the point radius for all chunks
+         */
+        void setRadius(float radius);
+
+        /**
+         * @brief Set the texture used by the point sprite mode for all chunks
+         */
+        void setSpriteTexture(osg::Texture2D * texture);
+
+        /**
+         * @brief Get the number of points drawn in the last view culled
+         */
+        int getNumPointsDrawn()
+        {
+            return (int)(unsigned int)_pointsDrawn;
+        }
+
+        /**
+         * @brief Get the number of points in loaded chunks
+         */
+        int getNumPointsLoaded()
+        {
+            return _pointsLoaded;
+        }
+
+        virtual void traverse(osg::NodeVisitor & nv);
+        virtual osg::BoundingSphere computeBound() const;
+
+    protected:
+        virtual ~PointCloudNode();
+
+        /**
+         * @brief Octree node as stored in the file
+         */
+        struct FileNode
+        {
+                float min[3];
+                float max[3];
+                float spacing; ///< average distance between the node's points
+                unsigned int numPoints;
+                unsigned long long offset; ///< file offset of the first point
+                int children[8]; ///< node index of each child, -1 if none
+        };
+
+        /**
+         * @brief Point record as stored in the file
+         */
+        struct FilePoint
+        {
+                float position[3];
+                unsigned char color[4];
+        };
+
+        /**
+         * @brief Runtime state of an octree node
+         */
+        struct Chunk
+        {
+                osg::BoundingBox bound;
+                int loadState; ///< 0 not loaded, 1 queued or loading, 2 loaded
+                int lastRequested; ///< last frame the chunk was wanted but not loaded
+                osg::ref_ptr<PointsNode> points;
+                osg::ref_ptr<osg::Vec3Array> loadedVerts; ///< read by a load thread, not yet drawn
+                osg::ref_ptr<osg::Vec4ubArray> loadedColors;
+        };
+
+        /**
+         * @brief Chunk waiting to be loaded
+         */
+        struct LoadRequest
+        {
+                float priority;
+                int node;
+
+                bool operator<(const LoadRequest & other) const
+                {
+                    return priority < other.priority;
+                }
+        };
+
+        /**
+         * @brief Reads requested chunks until the file is closed
+         */
+        class LoadThread : public OpenThreads::Thread
+        {
+            public:
+                LoadThread(PointCloudNode * pcn);
+                virtual ~LoadThread();
+                virtual void run();
+
+            protected:
+                PointCloudNode * _pointCloud;
+        };
+
+        /**
+         * @brief Node callback used to catch the update traversal
+         */
+        class PointCloudUpdateCallback : public osg::NodeCallback
+        {
+            public:
+                PointCloudUpdateCallback(PointCloudNode * pcn)
+                {
+                    _pointCloud = pcn;
+                }
+                virtual void operator()(osg::Node * node, osg::NodeVisitor * nv)
+                {
+                    _pointCloud->update(
+                            nv->getFrameStamp() ?
+                                    nv->getFrameStamp()->getFrameNumber() : 0);
+                    traverse(node,nv);
+                }
+            protected:
+                PointCloudNode * _pointCloud;
+        };
+
+        /**
+         * @brief Called during the update traversal to finish loads and
+         * release unused chunks
+         */
+        void update(int frame);
+
+        /**
+         * @brief Pick the chunks to draw for a view and request missing ones
+         */
+        void cull(osg::NodeVisitor & nv);
+
+        void requestLoad(int node, float priority, int frame);
+        void loadChunk(int node);
+        void releaseChunks(int frame);
+        PointsNode * makePoints(Chunk & chunk);
+
+        osg::ref_ptr<PointCloudUpdateCallback> _updateCallback; ///< callback to catch update traversal
+
+        std::string _file; ///< open file name
+        char * _data; ///< mapped file data
+        unsigned long long _dataSize; ///< size of the mapped data
+#ifdef WIN32
+        void * _fileHandle;
+        void * _mapHandle;
+#else
+        int _fd;
+#endif
+
+        const FileNode * _nodes; ///< octree nodes in the mapped file
+        int _numNodes;
+        unsigned long long _totalPoints;
+        osg::BoundingBox _pointBound;
+
+        std::vector<Chunk> _chunks; ///< state of each octree node
+        std::vector<int> _loaded; ///< nodes with a PointsNode child
+        OpenThreads::Atomic * _lastUsed; ///< last frame each chunk was drawn, set by all cull threads
+
+        OpenThreads::Mutex _loadLock; ///< protects the request queue and chunk load states
+        OpenThreads::Condition _loadCondition; ///< signaled when a request is added
+        std::priority_queue<LoadRequest> _requests; ///< chunks waiting to be read
+        std::vector<int> _finished; ///< chunks read by a load thread
+        std::vector<LoadThread*> _threads; ///< load thread pool
+        int _numThreads; ///< threads to start on open
+        bool _quit; ///< tells load threads to exit
+
+        PointsNode::PointsMode _mode; ///< point rendering mode
+        float _pointSize; ///< point size for all chunks
+        float _radius; ///< point radius for all chunks
+        osg::ref_ptr<osg::Texture2D> _spriteTexture; ///< sprite texture for all chunks
+
+        int _pointBudget; ///< max points drawn in a view
+        int _cachePoints; ///< max points kept loaded, default if less than 0
+        float _maxPixelError; ///< allowed point spacing in pixels
+        OpenThreads::Atomic _pointsDrawn; ///< points drawn in the last view culled
+        int _pointsLoaded; ///< points in loaded chunks
+        int _lastUpdateFrame; ///< frame of the last update traversal
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
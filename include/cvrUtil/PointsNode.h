@@ -17,6 +17,9 @@
 #include <osg/Texture2D>
 #include <OpenThreads/Mutex>
 
+#include <vector>
+#include <map>
+
 namespace cvr
 {
 
@@ -32,10 +35,14 @@ namespace cvr
  * Points are set with a radius, size and color value.  The user may set and change the
  * point rendering mode.  For modes that use a physical size, the radius value is used.
  * Otherwise, the point size is used.
+ *
+ * Only the range of points changed in each array is sent to the graphics card.  Many
+ * changes can be grouped between beginBatch and endBatch so they are uploaded together.
  */
 class PointsNode : public osg::Group
 {
         friend class PointsUpdateCallback;
+        friend class PointsDrawCallback;
     public:
         /**
          * @brief Used to describe the binding for a point attribute
@@ -276,6 +283,28 @@ class PointsNode : public osg::Group
          */
         void removePoints(int startPoint, int numPoints);
 
+        /**
+         * @brief Remove the point at the given index by moving the last point into its place
+         *
+         * Unlike removePoint, the points after the index are not shifted, so the
+         * order of the set is not kept
+         */
+        void swapRemovePoint(int pointIndex);
+
+        /**
+         * @brief Start a group of point changes
+         *
+         * Until the matching endBatch, changes only record the range of points
+         * changed in each array.  Batches may be nested.
+         */
+        void beginBatch();
+
+        /**
+         * @brief End a group of point changes, the changed ranges are queued for upload
+         * and the point count is updated
+         */
+        void endBatch();
+
         /**
          * @brief Clear all points and attributes from this set
          */
@@ -355,6 +384,49 @@ class PointsNode : public osg::Group
          */
         void refreshGeometry();
 
+        /**
+         * @brief Point attribute arrays, used to track changed ranges
+         */
+        enum PointsAttribute
+        {
+            ATTRIB_VERTEX = 0, ATTRIB_COLOR, ATTRIB_SIZE, ATTRIB_RADIUS,
+            ATTRIB_COUNT
+        };
+
+        /**
+         * @brief Range of an attribute array to upload
+         */
+        struct UploadRange
+        {
+                unsigned int serial; ///< upload number, contexts apply each once
+                int attribute;
+                int start;
+                int end;
+        };
+
+        osg::Array * getAttributeArray(int attribute);
+
+        /**
+         * @brief Note a changed range of points in an attribute array
+         */
+        void markDirty(int attribute, int start, int end);
+
+        /**
+         * @brief Queue a changed range for upload, merged with nearby queued ranges,
+         * or dirty the whole array if it has grown past its buffer or most of it is queued
+         */
+        void commitRange(int attribute, int start, int end);
+
+        /**
+         * @brief Dirty all arrays for a full upload and drop queued ranges
+         */
+        void dirtyAll();
+
+        /**
+         * @brief Called in the draw thread to upload queued ranges for a context
+         */
+        void uploadRanges(osg::RenderInfo & renderInfo);
+
         /**
          * @brief Node callback used to catch the update traveral
          */
@@ -373,9 +445,30 @@ class PointsNode : public osg::Group
                 PointsNode * _pointsNode;
         };
 
+        /**
+         * @brief Draw callback used to upload changed ranges before drawing
+         */
+        class PointsDrawCallback : public osg::Drawable::DrawCallback
+        {
+            public:
+                PointsDrawCallback(PointsNode * pn)
+                {
+                    _pointsNode = pn;
+                }
+                virtual void drawImplementation(osg::RenderInfo & renderInfo,
+                        const osg::Drawable * drawable) const
+                {
+                    _pointsNode->uploadRanges(renderInfo);
+                    drawable->drawImplementation(renderInfo);
+                }
+            protected:
+                PointsNode * _pointsNode;
+        };
+
         //void makeTexture();
 
         osg::ref_ptr<PointsUpdateCallback> _updateCallback; ///< callback to catch update traveral
+        osg::ref_ptr<PointsDrawCallback> _drawCallback; ///< callback to upload changed ranges
 
         int _size; ///< current number of valid points in the set
         PointsMode _mode; ///< current point rendering mode
@@ -405,6 +498,16 @@ class PointsNode : public osg::Group
         osg::ref_ptr<osg::DrawArrays> _primitive; ///< points primitive
 
         osg::ref_ptr<osg::Texture2D> _spriteTexture; ///< texture for point sprites
+
+        int _batchDepth; ///< number of open batches
+        int _dirtyStart[ATTRIB_COUNT]; ///< start of the range changed in the current batch
+        int _dirtyEnd[ATTRIB_COUNT]; ///< end of the range changed in the current batch
+        unsigned int _uploadedSize[ATTRIB_COUNT]; ///< array sizes at the last full upload
+
+        OpenThreads::Mutex _uploadLock; ///< protects the upload queue
+        std::vector<UploadRange> _uploads; ///< ranges not yet uploaded by all contexts
+        unsigned int _uploadSerial; ///< serial of the last queued range
+        std::map<unsigned int,unsigned int> _contextSerial; ///< last serial uploaded by each context
         //static osg::ref_ptr<osg::Texture2D> _sphereTexture;
 };
 
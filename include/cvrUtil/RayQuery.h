@@ -0,0 +1,146 @@
+/**
+ * @file RayQuery.h
+ */
+#ifndef CALVR_RAY_QUERY_H
+#define CALVR_RAY_QUERY_H
+
+#include <cvrUtil/Export.h>
+#include <cvrUtil/Intersection.h>
+
+#include <osg/Node>
+#include <osg/Drawable>
+#include <osg/observer_ptr>
+
+#include <OpenThreads/Mutex>
+
+#include <vector>
+#include <map>
+
+namespace cvr
+{
+
+/**
+ * @addtogroup util
+ * @{
+ */
+
+/**
+ * @brief Intersects line segments with the geometry under a node
+ *
+ * Subgraphs are skipped using their bounds.  The triangles of each drawable
+ * are kept in a box tree that is reused until the drawable's vertex or
+ * primitive data is dirtied.  Several segments can be tested in one
+ * traversal.  Queries on one instance are serialized, so the shared
+ * instance may be used from any thread.
+ */
+class CVRUTIL_EXPORT RayQuery
+{
+    public:
+        RayQuery();
+        virtual ~RayQuery();
+
+        /**
+         * @brief Get a shared instance
+         */
+        static RayQuery * instance();
+
+        /**
+         * @brief Set the node mask used to select nodes to test, defaults to
+         * INTERSECT_MASK
+         */
+        void setTraversalMask(unsigned int mask)
+        {
+            _traversalMask = mask;
+        }
+
+        unsigned int getTraversalMask()
+        {
+            return _traversalMask;
+        }
+
+        /**
+         * @brief Find intersections between a line segment and the geometry
+         * under a node
+         * @param root scenegraph to search under
+         * @param start start of the segment, in the root's parent space
+         * @param end end of the segment
+         * @param hits set to the intersections, nearest first
+         * @param nearestOnly only find the nearest intersection
+         * @return true if there was an intersection
+         */
+        bool intersect(osg::Node * root, const osg::Vec3 & start,
+                const osg::Vec3 & end, std::vector<IsectInfo> & hits,
+                bool nearestOnly = false);
+
+        /**
+         * @brief Find intersections for a group of line segments with one
+         * traversal of the scenegraph
+         * @param root scenegraph to search under
+         * @param starts start of each segment
+         * @param ends end of each segment
+         * @param hits set to the intersections of each segment, nearest first
+         * @param nearestOnly only find the nearest intersection of each segment
+         */
+        void intersect(osg::Node * root, const std::vector<osg::Vec3> & starts,
+                const std::vector<osg::Vec3> & ends,
+                std::vector<std::vector<IsectInfo> > & hits,
+                bool nearestOnly = false);
+
+        /**
+         * @brief Drop all cached triangle trees
+         */
+        void clearCache();
+
+        /**
+         * @brief Get the number of drawables with a cached triangle tree
+         */
+        int getCacheSize()
+        {
+            return _cache.size();
+        }
+
+    protected:
+        class QueryVisitor;
+        friend class QueryVisitor;
+
+        /**
+         * @brief Triangles of a drawable in a box tree
+         */
+        struct TriangleTree
+        {
+                struct Node
+                {
+                        osg::BoundingBox bound;
+                        int left; ///< first child, -1 for a leaf
+                        int right;
+                        int first; ///< first triangle of a leaf
+                        int count; ///< number of triangles in a leaf
+                };
+
+                osg::observer_ptr<osg::Drawable> drawable; ///< drawable the tree was built from
+                std::vector<size_t> version; ///< array and primitive set pointers, sizes and modified counts when built
+                std::vector<osg::Vec3> vertices; ///< three per triangle, in leaf order
+                std::vector<Node> nodes;
+        };
+
+        TriangleTree * getTriangleTree(osg::Drawable * drawable,
+                TriangleTree * scratch);
+        void buildTriangleTree(TriangleTree * tree);
+        int buildTriangleNode(TriangleTree * tree, int first, int count);
+        void removeExpired();
+
+        unsigned int _traversalMask; ///< node mask for nodes to test
+        std::map<const osg::Drawable*,TriangleTree*> _cache; ///< triangle trees by drawable
+        int _queries; ///< queries since the cache was checked for deleted drawables
+        OpenThreads::Mutex _lock; ///< held for each query, protects the cache
+
+        static RayQuery * _myPtr; ///< static self pointer
+};
+
+/**
+ * @}
+ */
+
+}
+
+#endif
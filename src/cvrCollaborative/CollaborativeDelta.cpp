@@ -0,0 +1,215 @@
+#include <cvrCollaborative/CollaborativeDelta.h>
+
+#include <cmath>
+#include <cstring>
+#include <climits>
+
+using namespace cvr;
+
+namespace
+{
+
+const int ROT_BITS = 10;
+const unsigned int ROT_MAX = (1 << ROT_BITS) - 1;
+// the smaller three components of a unit quaternion are within this
+const float ROT_RANGE = 0.70710678f;
+
+int packPos(float pos)
+{
+    double steps = floor(pos / COLLAB_POSITION_STEP + 0.5);
+    if(steps > INT_MAX)
+    {
+        return INT_MAX;
+    }
+    if(steps < INT_MIN)
+    {
+        return INT_MIN;
+    }
+    return (int)steps;
+}
+
+}
+
+void CollaborativeDelta::packBody(const BodyUpdate & body,
+        PackedBodyUpdate & packed)
+{
+    for(int i = 0; i < 3; i++)
+    {
+        packed.pos[i] = packPos(body.pos[i]);
+    }
+
+    int largest = 0;
+    for(int i = 1; i < 4; i++)
+    {
+        if(fabs(body.rot[i]) > fabs(body.rot[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // q and -q are the same rotation, keep the dropped component positive
+    float sign = body.rot[largest] < 0.0 ? -1.0 : 1.0;
+
+    packed.rot = ((unsigned int)largest) << (3 * ROT_BITS);
+    int shift = 2 * ROT_BITS;
+    for(int i = 0; i < 4; i++)
+    {
+        if(i == largest)
+        {
+            continue;
+        }
+
+        float value = (sign * body.rot[i] / ROT_RANGE + 1.0) * 0.5;
+        if(value < 0.0)
+        {
+            value = 0.0;
+        }
+        else if(value > 1.0)
+        {
+            value = 1.0;
+        }
+
+        packed.rot |= ((unsigned int)(value * ROT_MAX + 0.5)) << shift;
+        shift -= ROT_BITS;
+    }
+}
+
+void CollaborativeDelta::unpackBody(const PackedBodyUpdate & packed,
+        BodyUpdate & body)
+{
+    for(int i = 0; i < 3; i++)
+    {
+        body.pos[i] = packed.pos[i] * COLLAB_POSITION_STEP;
+    }
+
+    int largest = packed.rot >> (3 * ROT_BITS);
+    int shift = 2 * ROT_BITS;
+    float sum = 0.0;
+    for(int i = 0; i < 4; i++)
+    {
+        if(i == largest)
+        {
+            continue;
+        }
+
+        unsigned int value = (packed.rot >> shift) & ROT_MAX;
+        body.rot[i] = (((float)value / ROT_MAX) * 2.0 - 1.0) * ROT_RANGE;
+        sum += body.rot[i] * body.rot[i];
+        shift -= ROT_BITS;
+    }
+
+    body.rot[largest] = sum < 1.0 ? sqrt(1.0 - sum) : 0.0;
+}
+
+void CollaborativeDelta::writeClient(std::vector<char> & out, int id,
+        const ClientUpdate * update, int numBodies,
+        const PackedBodyUpdate * bodies, const std::vector<bool> & changed)
+{
+    int numChanged = 0;
+    for(int i = 0; i < numBodies; i++)
+    {
+        if(changed[i])
+        {
+            numChanged++;
+        }
+    }
+
+    int maskSize = getMaskSize(numBodies);
+    int start = out.size();
+    out.resize(
+            start + sizeof(struct DeltaClientHeader)
+                    + (update ? sizeof(struct ClientUpdate) : 0) + maskSize
+                    + numChanged * sizeof(struct PackedBodyUpdate));
+    char * data = &out[start];
+
+    DeltaClientHeader header;
+    header.id = id;
+    header.flags = update ? DELTA_CLIENT_UPDATE : 0;
+    memcpy(data,&header,sizeof(struct DeltaClientHeader));
+    data += sizeof(struct DeltaClientHeader);
+
+    if(update)
+    {
+        memcpy(data,update,sizeof(struct ClientUpdate));
+        data += sizeof(struct ClientUpdate);
+    }
+
+    unsigned char * mask = (unsigned char*)data;
+    memset(mask,0,maskSize);
+    data += maskSize;
+
+    for(int i = 0; i < numBodies; i++)
+    {
+        if(changed[i])
+        {
+            mask[i / 8] |= 1 << (i % 8);
+            memcpy(data,&bodies[i],sizeof(struct PackedBodyUpdate));
+            data += sizeof(struct PackedBodyUpdate);
+        }
+    }
+}
+
+int CollaborativeDelta::readClientHeader(const char * data, int size,
+        DeltaClientHeader & header, ClientUpdate & update)
+{
+    if(size < sizeof(struct DeltaClientHeader))
+    {
+        return -1;
+    }
+
+    memcpy(&header,data,sizeof(struct DeltaClientHeader));
+    int used = sizeof(struct DeltaClientHeader);
+
+    if(header.flags & DELTA_CLIENT_UPDATE)
+    {
+        if(size - used < sizeof(struct ClientUpdate))
+        {
+            return -1;
+        }
+        memcpy(&update,data + used,sizeof(struct ClientUpdate));
+        used += sizeof(struct ClientUpdate);
+    }
+
+    return used;
+}
+
+int CollaborativeDelta::readBodies(const char * data, int size, int numBodies,
+        BodyUpdate * bodies, PackedBodyUpdate * packed, int * versions,
+        int version)
+{
+    int used = getMaskSize(numBodies);
+    if(size < used)
+    {
+        return -1;
+    }
+
+    const unsigned char * mask = (const unsigned char*)data;
+    for(int i = 0; i < numBodies; i++)
+    {
+        if(!(mask[i / 8] & (1 << (i % 8))))
+        {
+            continue;
+        }
+
+        if(size - used < sizeof(struct PackedBodyUpdate))
+        {
+            return -1;
+        }
+
+        PackedBodyUpdate pbu;
+        memcpy(&pbu,data + used,sizeof(struct PackedBodyUpdate));
+        used += sizeof(struct PackedBodyUpdate);
+
+        unpackBody(pbu,bodies[i]);
+        if(packed)
+        {
+            packed[i] = pbu;
+        }
+        if(versions)
+        {
+            versions[i] = version;
+        }
+    }
+
+    return used;
+}
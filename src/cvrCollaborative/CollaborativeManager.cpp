@@ -17,6 +17,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 #include <osg/Matrix>
 #include <osg/ShapeDrawable>
@@ -29,6 +30,43 @@
 
 using namespace cvr;
 
+namespace
+{
+
+enum CollabFrameFlags
+{
+    COLLAB_FRAME_RUNNING = 1, ///< the session connection is up
+    COLLAB_FRAME_UPDATE = 2 ///< a session update finished this frame
+};
+
+/**
+ * Start of the per frame data sent to the render nodes.  Followed by the
+ * ClientUpdates and BodyUpdates of the finished session update, each session
+ * message header and its data, the headers of the plugin messages staged this
+ * frame, then dataSize bytes of staged message data.
+ */
+struct CollabFrameHeader
+{
+        int flags;
+        ServerUpdate su;
+        int numClients;
+        int numBodies;
+        int numSessionMessages;
+        int numStagedMessages;
+        int dataSize;
+};
+
+void appendData(std::vector<char> & buffer, const void * data, int size)
+{
+    if(size > 0)
+    {
+        buffer.insert(buffer.end(),(const char*)data,
+                ((const char*)data) + size);
+    }
+}
+
+}
+
 osg::Vec3 makeColor(float f)
 {
     if(f < 0)
@@ -85,6 +123,10 @@ CollaborativeManager::CollaborativeManager()
     _connected = false;
     _mode = UNLOCKED;
     _masterID = -1;
+    _stagedBytes = 0;
+    _frameByteBudget = 0;
+    _maxStagedBytes = 0;
+    _updateStarted = false;
     if(ComController::instance()->isMaster())
     {
         _thread = new CollaborativeThread(&_clientInitMap);
@@ -112,6 +154,14 @@ bool CollaborativeManager::init()
 {
     _collabRoot = new osg::MatrixTransform();
     SceneManager::instance()->getObjectsRoot()->addChild(_collabRoot.get());
+
+    // large plugin messages are passed to the render nodes a part at a time
+    _frameByteBudget = ConfigManager::getInt("value",
+            "Collaborative.FrameByteBudget",256 * 1024);
+    _maxStagedBytes = ConfigManager::getInt("value",
+            "Collaborative.MaxStagedBytes",64 * 1024 * 1024);
+    _frameBuffer.reserve(64 * 1024);
+
     return true;
 }
 
@@ -125,6 +175,7 @@ bool CollaborativeManager::connect(std::string host, int port)
     bool res = true;
     int id;
     int numUsers;
+    int protocol = 1;
     ClientInitInfo * ciiList;
     _clientInitMap.clear();
 
@@ -143,6 +194,16 @@ bool CollaborativeManager::connect(std::string host, int port)
         cii.numHeads = TrackingManager::instance()->getNumHeads();
         cii.numHands = TrackingManager::instance()->getNumHands();
 
+        // offer delta updates, servers that do not know them ignore the id
+        if(ConfigManager::getBool("value","Collaborative.DeltaUpdates",true))
+        {
+            cii.id = COLLAB_PROTOCOL_MAGIC | COLLAB_PROTOCOL_DELTA;
+        }
+        else
+        {
+            cii.id = 0;
+        }
+
         if(_socket)
         {
             delete _socket;
@@ -190,12 +251,31 @@ bool CollaborativeManager::connect(std::string host, int port)
                 res = false;
             }
 
-            ServerInitInfo sii;
-            if(!_socket->recv(&sii,sizeof(struct ServerInitInfo)))
+            // a negative value is the protocol version the server accepted,
+            // followed by the init info
+            int accepted;
+            if(!_socket->recv(&accepted,sizeof(int)))
             {
                 res = false;
             }
 
+            ServerInitInfo sii;
+            if(accepted < 0)
+            {
+                protocol = -accepted;
+                if(!_socket->recv(&sii,sizeof(struct ServerInitInfo)))
+                {
+                    res = false;
+                }
+            }
+            else
+            {
+                sii.numUsers = accepted;
+            }
+
+            std::cerr << "Using collaborative protocol version " << protocol
+                    << std::endl;
+
             std::cerr << "There are " << sii.numUsers
                     << " other users connected to collab server." << std::endl;
             numUsers = sii.numUsers;
@@ -211,7 +291,7 @@ bool CollaborativeManager::connect(std::string host, int port)
                 }
             }
 
-            _thread->init(_socket,id);
+            _thread->init(_socket,id,protocol);
             _thread->start();
 
             //startUpdate();
@@ -348,6 +428,8 @@ void CollaborativeManager::disconnect()
     _collabHeads.clear();
     _handBodyMap.clear();
     _headBodyMap.clear();
+    clearStagedMessages();
+    _updateStarted = false;
     _connected = false;
 }
 
@@ -451,6 +533,7 @@ void CollaborativeManager::startUpdate()
         }
     }
 
+    _updateStarted = true;
     _thread->startUpdate(cu,numBodies,bodies,cu.numMes,mheaders,mData);
 }
 
@@ -472,309 +555,358 @@ void CollaborativeManager::update()
                 osg::Timer::instance()->tick());
     }
 
-    if(!_connected || ComController::instance()->getIsSyncError())
+    int frameBytes = 0;
+    int bytesSent = 0, bytesReceived = 0;
+    double encodeTime = 0.0, decodeTime = 0.0;
+
+    if(_connected && !ComController::instance()->getIsSyncError())
     {
-        if(stats)
+        // everything for the render nodes goes out as one frame sync section
+        const char * frameData;
+        if(ComController::instance()->isMaster())
         {
-            endTime = osg::Timer::instance()->delta_s(
-                    CVRViewer::instance()->getStartTick(),
-                    osg::Timer::instance()->tick());
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative begin time",startTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative end time",endTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative time taken",endTime - startTime);
+            if(stats && _updateStarted && _thread->updateDone())
+            {
+                _thread->getUpdateStats(bytesSent,bytesReceived,encodeTime,
+                        decodeTime);
+            }
+
+            packFrame();
+            frameData = &_frameBuffer[0];
+            frameBytes = _frameBuffer.size();
+            ComController::instance()->addFrameSyncSection(
+                    ComController::FSS_COLLABORATIVE,&_frameBuffer[0],
+                    frameBytes);
+            ComController::instance()->flushFrameSync();
+        }
+        else
+        {
+            ComController::instance()->flushFrameSync();
+            frameData = ComController::instance()->getFrameSyncSection(
+                    ComController::FSS_COLLABORATIVE,frameBytes);
         }
-        return;
-    }
 
-    bool toUpdate[2];
-    if(ComController::instance()->isMaster())
-    {
-        toUpdate[0] = _thread->updateDone();
-        toUpdate[1] = _thread->isRunning();
-        ComController::instance()->sendSlaves(toUpdate,sizeof(bool) * 2);
-    }
-    else
-    {
-        ComController::instance()->readMaster(toUpdate,sizeof(bool) * 2);
+        bool updated = false;
+        if(frameData && applyFrame(frameData,frameBytes,updated))
+        {
+            if(updated)
+            {
+                updateCollabNodes();
+            }
+
+            if(ComController::instance()->isMaster() && !_updateStarted
+                    && (_maxStagedBytes <= 0 || _stagedBytes <= _maxStagedBytes))
+            {
+                startUpdate();
+            }
+        }
+        else
+        {
+            disconnect();
+        }
     }
 
-    if(!toUpdate[1])
+    if(stats)
     {
-        disconnect();
+        int frame =
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber();
+        endTime = osg::Timer::instance()->delta_s(
+                CVRViewer::instance()->getStartTick(),
+                osg::Timer::instance()->tick());
+        stats->setAttribute(frame,"Collaborative begin time",startTime);
+        stats->setAttribute(frame,"Collaborative end time",endTime);
+        stats->setAttribute(frame,"Collaborative time taken",
+                endTime - startTime);
+        stats->setAttribute(frame,"Collaborative frame bytes",frameBytes);
+        stats->setAttribute(frame,"Collaborative staged bytes",_stagedBytes);
 
-        if(stats)
+        if(_thread)
         {
-            endTime = osg::Timer::instance()->delta_s(
-                    CVRViewer::instance()->getStartTick(),
-                    osg::Timer::instance()->tick());
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative begin time",startTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative end time",endTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative time taken",endTime - startTime);
+            stats->setAttribute(frame,"Collaborative bytes sent",bytesSent);
+            stats->setAttribute(frame,"Collaborative bytes received",
+                    bytesReceived);
+            stats->setAttribute(frame,"Collaborative encode time",encodeTime);
+            stats->setAttribute(frame,"Collaborative decode time",decodeTime);
         }
-        return;
     }
+}
+
+void CollaborativeManager::packFrame()
+{
+    CollabFrameHeader fh;
+    memset(&fh,0,sizeof(struct CollabFrameHeader));
+
+    // the buffer keeps its capacity, so steady state frames do not allocate
+    _frameBuffer.resize(sizeof(struct CollabFrameHeader));
 
-    if(!toUpdate[0])
+    if(!_thread->isRunning())
     {
-        if(stats)
-        {
-            endTime = osg::Timer::instance()->delta_s(
-                    CVRViewer::instance()->getStartTick(),
-                    osg::Timer::instance()->tick());
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative begin time",startTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative end time",endTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "Collaborative time taken",endTime - startTime);
-        }
+        memcpy(&_frameBuffer[0],&fh,sizeof(struct CollabFrameHeader));
         return;
     }
+    fh.flags = COLLAB_FRAME_RUNNING;
 
-    struct ServerUpdate su;
-    struct ClientUpdate * culist = NULL;
-    struct BodyUpdate * bodies = NULL;
-    struct CollaborativeMessageHeader * cmh = NULL;
-    char ** messageData = NULL;
+    std::vector<StagedMessage> newStaged;
 
-    if(ComController::instance()->isMaster())
+    if(_updateStarted && _thread->updateDone())
     {
+        _updateStarted = false;
+        fh.flags |= COLLAB_FRAME_UPDATE;
+
         ServerUpdate * sup;
+        ClientUpdate * culist;
+        BodyUpdate * bodies;
+        CollaborativeMessageHeader * cmh;
+        char ** messageData;
         _thread->getUpdate(sup,culist,bodies,cmh,messageData);
-        su = *sup;
-
-        ComController::instance()->sendSlaves(&su,sizeof(struct ServerUpdate));
-    }
-    else
-    {
-        ComController::instance()->readMaster(&su,sizeof(struct ServerUpdate));
-    }
+        fh.su = *sup;
 
-    if(su.numMes)
-    {
-        if(ComController::instance()->isMaster())
+        if(fh.su.mode == LOCKED)
         {
-            ComController::instance()->sendSlaves(cmh,
-                    sizeof(struct CollaborativeMessageHeader) * su.numMes);
-            for(int i = 0; i < su.numMes; i++)
+            if(fh.su.masterID >= 0 && fh.su.masterID != _id)
             {
-                if(cmh[i].size)
-                {
-                    ComController::instance()->sendSlaves(messageData[i],
-                            cmh[i].size);
-                }
-            }
-        }
-        else
-        {
-            cmh = new CollaborativeMessageHeader[su.numMes];
-            ComController::instance()->readMaster(cmh,
-                    sizeof(struct CollaborativeMessageHeader) * su.numMes);
-            messageData = new char*[su.numMes];
-            for(int i = 0; i < su.numMes; i++)
-            {
-                if(cmh[i].size)
-                {
-                    messageData[i] = new char[cmh[i].size];
-                    ComController::instance()->readMaster(messageData[i],
-                            cmh[i].size);
-                }
-                else
-                {
-                    messageData[i] = NULL;
-                }
+                fh.numClients = 1;
             }
         }
-
-        for(int i = 0; i < su.numMes; i++)
+        else if(fh.su.numUsers > 1)
         {
-            processMessage(cmh[i],messageData[i]);
+            fh.numClients = fh.su.numUsers - 1;
         }
 
-        if(!ComController::instance()->isMaster())
+        for(int i = 0; i < fh.numClients; i++)
         {
-            delete[] cmh;
-            delete[] messageData;
+            fh.numBodies += _clientInitMap[culist[i].numMes].numHeads
+                    + _clientInitMap[culist[i].numMes].numHands;
         }
-    }
 
-    _mode = su.mode;
-    _masterID = su.masterID;
+        appendData(_frameBuffer,culist,
+                fh.numClients * sizeof(struct ClientUpdate));
+        appendData(_frameBuffer,bodies,
+                fh.numBodies * sizeof(struct BodyUpdate));
 
-    if(su.mode == LOCKED)
-    {
-        SceneManager::instance()->getObjectsRoot()->removeChild(
-                _collabRoot.get());
-        if(_masterID >= 0 && _masterID != _id)
+        // session messages are small and change the client list, they are
+        // passed on right away, plugin messages wait their turn
+        for(int i = 0; i < fh.su.numMes; i++)
         {
-            int numBodies;
-            if(ComController::instance()->isMaster())
+            if(cmh[i].type == PLUGIN_MESSAGE)
             {
-                ComController::instance()->sendSlaves(culist,
-                        sizeof(struct ClientUpdate));
-                _clientMap[culist[0].numMes] = culist[0];
-                numBodies = _clientInitMap[culist[0].numMes].numHeads
-                        + _clientInitMap[culist[0].numMes].numHands;
-                ComController::instance()->sendSlaves(bodies,
-                        sizeof(struct BodyUpdate) * numBodies);
+                StagedMessage sm;
+                sm.header = cmh[i];
+                sm.data = messageData[i];
+                sm.received = 0;
+                newStaged.push_back(sm);
+                continue;
             }
-            else
+
+            appendData(_frameBuffer,&cmh[i],
+                    sizeof(struct CollaborativeMessageHeader));
+            appendData(_frameBuffer,messageData[i],cmh[i].size);
+            if(messageData[i])
             {
-                culist = new ClientUpdate[1];
-                ComController::instance()->readMaster(culist,
-                        sizeof(struct ClientUpdate));
-                _clientMap[culist[0].numMes] = culist[0];
-                numBodies = _clientInitMap[culist[0].numMes].numHeads
-                        + _clientInitMap[culist[0].numMes].numHands;
-                bodies = new BodyUpdate[numBodies];
-                ComController::instance()->readMaster(bodies,
-                        sizeof(struct BodyUpdate) * numBodies);
+                delete[] messageData[i];
             }
+            fh.numSessionMessages++;
+        }
 
-            int bindex = 0;
+        for(int i = 0; i < newStaged.size(); i++)
+        {
+            appendData(_frameBuffer,&newStaged[i].header,
+                    sizeof(struct CollaborativeMessageHeader));
+            _stagedMessages.push_back(newStaged[i]);
+            _stagedBytes += newStaged[i].header.size;
+        }
+        fh.numStagedMessages = newStaged.size();
+    }
 
-            for(int i = 0; i < _clientInitMap[culist[0].numMes].numHeads; i++)
-            {
-                _headBodyMap[culist[0].numMes][i] = bodies[bindex];
-                bindex++;
-            }
+    // pass on as much message data as the budget allows, in queue order
+    fh.dataSize = _stagedBytes;
+    if(_frameByteBudget > 0 && fh.dataSize > _frameByteBudget)
+    {
+        fh.dataSize = _frameByteBudget;
+    }
 
-            for(int i = 0; i < _clientInitMap[culist[0].numMes].numHands; i++)
-            {
-                _handBodyMap[culist[0].numMes][i] = bodies[bindex];
-                bindex++;
-            }
+    int left = fh.dataSize;
+    for(int i = 0; i < _stagedMessages.size() && left; i++)
+    {
+        StagedMessage & sm = _stagedMessages[i];
+        int bytes = std::min(left,sm.header.size - sm.received);
+        appendData(_frameBuffer,sm.data + sm.received,bytes);
+        left -= bytes;
+    }
 
-            if(!ComController::instance()->isMaster())
-            {
-                delete[] culist;
-                if(numBodies)
-                {
-                    delete[] bodies;
-                }
-            }
+    memcpy(&_frameBuffer[0],&fh,sizeof(struct CollabFrameHeader));
+}
+
+bool CollaborativeManager::applyFrame(const char * data, int size,
+        bool & updated)
+{
+    updated = false;
+
+    if(size < sizeof(struct CollabFrameHeader))
+    {
+        std::cerr << "CollaborativeManager: Error: short frame data."
+                << std::endl;
+        return false;
+    }
+
+    CollabFrameHeader fh;
+    memcpy(&fh,data,sizeof(struct CollabFrameHeader));
+    if(!(fh.flags & COLLAB_FRAME_RUNNING))
+    {
+        return false;
+    }
+
+    bool isMaster = ComController::instance()->isMaster();
+    const char * dataPtr = data + sizeof(struct CollabFrameHeader);
+    const char * dataEnd = data + size;
+
+    const ClientUpdate * culist = (const ClientUpdate*)dataPtr;
+    dataPtr += fh.numClients * sizeof(struct ClientUpdate);
+    const BodyUpdate * bodies = (const BodyUpdate*)dataPtr;
+    dataPtr += fh.numBodies * sizeof(struct BodyUpdate);
+
+    for(int i = 0; i < fh.numSessionMessages && dataPtr <= dataEnd; i++)
+    {
+        CollaborativeMessageHeader cmh;
+        memcpy(&cmh,dataPtr,sizeof(struct CollaborativeMessageHeader));
+        dataPtr += sizeof(struct CollaborativeMessageHeader);
+
+        char * messageData = NULL;
+        if(cmh.size)
+        {
+            messageData = new char[cmh.size];
+            memcpy(messageData,dataPtr,cmh.size);
+            dataPtr += cmh.size;
         }
+        processMessage(cmh,messageData);
     }
-    else
+
+    for(int i = 0; i < fh.numStagedMessages && dataPtr <= dataEnd; i++)
     {
-        if(_collabRoot->getNumParents() == 0)
+        if(!isMaster)
         {
-            SceneManager::instance()->getObjectsRoot()->addChild(
-                    _collabRoot.get());
+            StagedMessage sm;
+            memcpy(&sm.header,dataPtr,
+                    sizeof(struct CollaborativeMessageHeader));
+            sm.data = sm.header.size ? new char[sm.header.size] : NULL;
+            sm.received = 0;
+            _stagedMessages.push_back(sm);
+            _stagedBytes += sm.header.size;
         }
+        dataPtr += sizeof(struct CollaborativeMessageHeader);
+    }
 
-        _clientMap.clear();
+    if(dataPtr + fh.dataSize != dataEnd)
+    {
+        std::cerr << "CollaborativeManager: Error: frame data size mismatch."
+                << std::endl;
+        return false;
+    }
 
-        if(su.numUsers > 1)
+    // messages are handled once all of their data has been passed on
+    int left = fh.dataSize;
+    while(_stagedMessages.size())
+    {
+        StagedMessage & sm = _stagedMessages.front();
+        int bytes = std::min(left,sm.header.size - sm.received);
+        if(!isMaster && bytes)
         {
-            int numBodies;
-            if(ComController::instance()->isMaster())
-            {
-                ComController::instance()->sendSlaves(culist,
-                        sizeof(struct ClientUpdate) * (su.numUsers - 1));
-                numBodies = 0;
+            memcpy(sm.data + sm.received,dataPtr,bytes);
+        }
+        dataPtr += bytes;
+        left -= bytes;
+        sm.received += bytes;
+        _stagedBytes -= bytes;
 
-                for(int i = 0; i < su.numUsers - 1; i++)
-                {
-                    numBodies += _clientInitMap[culist[i].numMes].numHeads
-                            + _clientInitMap[culist[i].numMes].numHands;
-                }
+        if(sm.received < sm.header.size)
+        {
+            break;
+        }
 
-                if(numBodies)
-                {
-                    ComController::instance()->sendSlaves(bodies,
-                            sizeof(struct BodyUpdate) * numBodies);
-                }
-            }
-            else
-            {
-                culist = new struct ClientUpdate[su.numUsers - 1];
-                ComController::instance()->readMaster(culist,
-                        sizeof(struct ClientUpdate) * (su.numUsers - 1));
+        CollaborativeMessageHeader header = sm.header;
+        char * messageData = sm.data;
+        _stagedMessages.pop_front();
+        processMessage(header,messageData);
+    }
 
-                numBodies = 0;
+    if(!(fh.flags & COLLAB_FRAME_UPDATE))
+    {
+        return true;
+    }
 
-                for(int i = 0; i < su.numUsers - 1; i++)
-                {
-                    numBodies += _clientInitMap[culist[i].numMes].numHeads
-                            + _clientInitMap[culist[i].numMes].numHands;
-                }
+    updated = true;
+    _mode = fh.su.mode;
+    _masterID = fh.su.masterID;
 
-                if(numBodies)
-                {
-                    bodies = new BodyUpdate[numBodies];
-                    ComController::instance()->readMaster(bodies,
-                            sizeof(struct BodyUpdate) * numBodies);
-                }
-            }
+    // the section may not be aligned, so structs are copied out
+    int numBodies = 0;
+    for(int i = 0; i < fh.numClients; i++)
+    {
+        ClientUpdate cu;
+        memcpy(&cu,&culist[i],sizeof(struct ClientUpdate));
+        numBodies += getClientNumHeads(cu.numMes) + getClientNumHands(cu.numMes);
+    }
 
-            int bindex = 0;
+    if(numBodies != fh.numBodies)
+    {
+        std::cerr << "CollaborativeManager: Error: body count mismatch, "
+                << "skipping update." << std::endl;
+        return true;
+    }
 
-            for(int i = 0; i < su.numUsers - 1; i++)
-            {
-                _clientMap[culist[i].numMes] = culist[i];
+    if(_mode == LOCKED)
+    {
+        SceneManager::instance()->getObjectsRoot()->removeChild(
+                _collabRoot.get());
+    }
+    else
+    {
+        if(_collabRoot->getNumParents() == 0)
+        {
+            SceneManager::instance()->getObjectsRoot()->addChild(
+                    _collabRoot.get());
+        }
 
-                for(int j = 0; j < _clientInitMap[culist[i].numMes].numHeads;
-                        j++)
-                {
-                    _headBodyMap[culist[i].numMes][j] = bodies[bindex];
-                    bindex++;
-                }
+        _clientMap.clear();
+    }
 
-                for(int j = 0; j < _clientInitMap[culist[i].numMes].numHands;
-                        j++)
-                {
-                    _handBodyMap[culist[i].numMes][j] = bodies[bindex];
-                    bindex++;
-                }
-            }
+    int bindex = 0;
+    for(int i = 0; i < fh.numClients; i++)
+    {
+        ClientUpdate cu;
+        memcpy(&cu,&culist[i],sizeof(struct ClientUpdate));
+        int id = cu.numMes;
+        _clientMap[id] = cu;
 
-            if(!ComController::instance()->isMaster())
-            {
-                delete[] culist;
-                if(numBodies)
-                {
-                    delete[] bodies;
-                }
-            }
+        for(int j = 0; j < _clientInitMap[id].numHeads; j++)
+        {
+            memcpy(&_headBodyMap[id][j],&bodies[bindex],
+                    sizeof(struct BodyUpdate));
+            bindex++;
+        }
 
+        for(int j = 0; j < _clientInitMap[id].numHands; j++)
+        {
+            memcpy(&_handBodyMap[id][j],&bodies[bindex],
+                    sizeof(struct BodyUpdate));
+            bindex++;
         }
     }
 
-    updateCollabNodes();
-
-    startUpdate();
+    return true;
+}
 
-    if(stats)
+void CollaborativeManager::clearStagedMessages()
+{
+    for(int i = 0; i < _stagedMessages.size(); i++)
     {
-        endTime = osg::Timer::instance()->delta_s(
-                CVRViewer::instance()->getStartTick(),
-                osg::Timer::instance()->tick());
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "Collaborative begin time",startTime);
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "Collaborative end time",endTime);
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "Collaborative time taken",endTime - startTime);
+        if(_stagedMessages[i].data)
+        {
+            delete[] _stagedMessages[i].data;
+        }
     }
+    _stagedMessages.clear();
+    _stagedBytes = 0;
 }
 
 void CollaborativeManager::setMode(CollabMode mode)
@@ -1,7 +1,11 @@
 #include <cvrCollaborative/CollaborativeThread.h>
+#include <cvrCollaborative/CollaborativeDelta.h>
 #include <cvrUtil/CVRSocket.h>
 
+#include <osg/Timer>
+
 #include <iostream>
+#include <cstring>
 
 #ifndef MSG_NOSIGNAL
 #define MSG_NOSIGNAL 0
@@ -17,7 +21,7 @@ CollaborativeThread::CollaborativeThread(
     _numBodies = 0;
 }
 
-void CollaborativeThread::init(CVRSocket * socket, int id)
+void CollaborativeThread::init(CVRSocket * socket, int id, int protocol)
 {
     _socket = socket;
     _connected = _socket ? _socket->valid() : false;
@@ -30,6 +34,12 @@ void CollaborativeThread::init(CVRSocket * socket, int id)
     _serverUpdate = new ServerUpdate;
     _quit = false;
     _id = id;
+    _protocol = protocol;
+    _sentUpdateValid = false;
+    _sentBodies.clear();
+    _clientState.clear();
+    _bytesSent = _bytesReceived = 0;
+    _encodeTime = _decodeTime = 0.0;
 }
 
 CollaborativeThread::~CollaborativeThread()
@@ -58,38 +68,45 @@ void CollaborativeThread::run()
         {
             //std::cerr << "Updating" << std::endl;
             _statusLock.unlock();
-            if(!_socket->send(&_myInfo,sizeof(ClientUpdate),MSG_NOSIGNAL))
+            _bytesSent = _bytesReceived = 0;
+            _encodeTime = _decodeTime = 0.0;
+
+            // gather the whole update so it goes out in one send
+            _sendBuffers.clear();
+            if(_protocol >= COLLAB_PROTOCOL_DELTA)
             {
-                return;
+                packDeltaUpdate();
             }
-
-            if(!_socket->send(_myTrackedBodies,sizeof(BodyUpdate) * _numBodies,
-            MSG_NOSIGNAL))
+            else
             {
-                return;
+                addSendBuffer(&_myInfo,sizeof(ClientUpdate));
+                addSendBuffer(_myTrackedBodies,
+                        sizeof(BodyUpdate) * _numBodies);
             }
 
             if(_numMessages)
             {
-                if(!_socket->send(_messageHeaders,
-                        sizeof(CollaborativeMessageHeader) * _numMessages,
-                        MSG_NOSIGNAL))
+                addSendBuffer(_messageHeaders,
+                        sizeof(CollaborativeMessageHeader) * _numMessages);
+                for(int i = 0; i < _numMessages; i++)
                 {
-                    return;
+                    addSendBuffer(_messageData[i],_messageHeaders[i].size);
                 }
+            }
+
+            if(!_socket->sendv(&_sendBuffers[0],_sendBuffers.size(),
+                    MSG_NOSIGNAL))
+            {
+                return;
+            }
+
+            if(_numMessages)
+            {
                 for(int i = 0; i < _numMessages; i++)
                 {
-                    if(_messageHeaders[i].size)
+                    if(_messageHeaders[i].size && _messageHeaders[i].deleteData)
                     {
-                        if(!_socket->send(_messageData[i],
-                                _messageHeaders[i].size,MSG_NOSIGNAL))
-                        {
-                            return;
-                        }
-                        if(_messageHeaders[i].deleteData)
-                        {
-                            delete[] _messageData[i];
-                        }
+                        delete[] _messageData[i];
                     }
                 }
                 // clean up message meta data after send
@@ -106,6 +123,7 @@ void CollaborativeThread::run()
             {
                 return;
             }
+            _bytesReceived += sizeof(ServerUpdate);
 
             //std::cerr << "Got server update." << std::endl;
             //std::cerr << "Num Messages: " << _serverUpdate->numMes << std::endl;
@@ -121,7 +139,11 @@ void CollaborativeThread::run()
                 {
                     return;
                 }
+                _bytesReceived += sizeof(struct CollaborativeMessageHeader)
+                        * _serverUpdate->numMes;
 
+                // read all the message data together
+                _recvBuffers.clear();
                 for(int i = 0; i < _serverUpdate->numMes; i++)
                 {
                     std::cerr << "type: " << _messageHeaderUpdate[i].type
@@ -132,17 +154,24 @@ void CollaborativeThread::run()
                     {
                         _messageDataUpdate[i] =
                                 new char[_messageHeaderUpdate[i].size];
-                        if(!_socket->recv(_messageDataUpdate[i],
-                                _messageHeaderUpdate[i].size))
-                        {
-                            return;
-                        }
+                        SocketBuffer sb;
+                        sb.data = _messageDataUpdate[i];
+                        sb.len = _messageHeaderUpdate[i].size;
+                        _recvBuffers.push_back(sb);
+                        _bytesReceived += _messageHeaderUpdate[i].size;
                     }
                     else
                     {
                         _messageDataUpdate[i] = NULL;
                     }
                 }
+
+                if(_recvBuffers.size()
+                        && !_socket->recvv(&_recvBuffers[0],
+                                _recvBuffers.size()))
+                {
+                    return;
+                }
             }
 
             //std::cerr << "Got messages." << std::endl;
@@ -153,7 +182,14 @@ void CollaborativeThread::run()
                 processMessage(_messageHeaderUpdate[i],_messageDataUpdate[i]);
             }
 
-            if(_serverUpdate->mode == LOCKED)
+            if(_protocol >= COLLAB_PROTOCOL_DELTA)
+            {
+                if(!readDeltaUpdate())
+                {
+                    return;
+                }
+            }
+            else if(_serverUpdate->mode == LOCKED)
             {
                 if(_serverUpdate->masterID >= 0
                         && _serverUpdate->masterID != _id)
@@ -173,6 +209,8 @@ void CollaborativeThread::run()
                     {
                         return;
                     }
+                    _bytesReceived += sizeof(struct ClientUpdate)
+                            + sizeof(struct BodyUpdate) * numBodies;
                 }
             }
             else if(_serverUpdate->numUsers > 1)
@@ -203,6 +241,9 @@ void CollaborativeThread::run()
                         return;
                     }
                 }
+                _bytesReceived += sizeof(struct ClientUpdate)
+                        * (_serverUpdate->numUsers - 1)
+                        + sizeof(struct BodyUpdate) * numBodies;
                 //std::cerr << "Num Users: " << _serverUpdate->numUsers << " NumBodies: " << numBodies << std::endl;
             }
 
@@ -300,6 +341,230 @@ void CollaborativeThread::getUpdate(ServerUpdate * & su,
     messageData = _messageDataUpdate;
 }
 
+void CollaborativeThread::getUpdateStats(int & bytesSent, int & bytesReceived,
+        double & encodeTime, double & decodeTime)
+{
+    bytesSent = _bytesSent;
+    bytesReceived = _bytesReceived;
+    encodeTime = _encodeTime;
+    decodeTime = _decodeTime;
+}
+
+void CollaborativeThread::addSendBuffer(void * data, size_t len)
+{
+    if(!len)
+    {
+        return;
+    }
+
+    SocketBuffer sb;
+    sb.data = data;
+    sb.len = len;
+    _sendBuffers.push_back(sb);
+    _bytesSent += len;
+}
+
+void CollaborativeThread::packDeltaUpdate()
+{
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    // the server keeps the last values sent, so only send what changed
+    bool updateChanged = !_sentUpdateValid
+            || _sentUpdate.objScale != _myInfo.objScale;
+    for(int i = 0; i < 16 && !updateChanged; i++)
+    {
+        updateChanged = _sentUpdate.objTrans[i] != _myInfo.objTrans[i];
+    }
+
+    bool allChanged = _sentBodies.size() != _numBodies;
+    _packedBodies.resize(_numBodies);
+    _sentBodies.resize(_numBodies);
+    std::vector<bool> changed(_numBodies);
+    for(int i = 0; i < _numBodies; i++)
+    {
+        CollaborativeDelta::packBody(_myTrackedBodies[i],_packedBodies[i]);
+        changed[i] = allChanged
+                || memcmp(&_packedBodies[i],&_sentBodies[i],
+                        sizeof(struct PackedBodyUpdate));
+        if(changed[i])
+        {
+            _sentBodies[i] = _packedBodies[i];
+        }
+    }
+
+    _deltaBuffer.clear();
+    CollaborativeDelta::writeClient(_deltaBuffer,_id,
+            updateChanged ? &_myInfo : NULL,_numBodies,
+            _numBodies ? &_packedBodies[0] : NULL,changed);
+
+    _sentUpdate = _myInfo;
+    _sentUpdateValid = true;
+
+    _deltaUpdate.numMes = _myInfo.numMes;
+    _deltaUpdate.size = _deltaBuffer.size();
+
+    _encodeTime = osg::Timer::instance()->delta_s(startTick,
+            osg::Timer::instance()->tick());
+
+    addSendBuffer(&_deltaUpdate,sizeof(struct DeltaUpdate));
+    addSendBuffer(&_deltaBuffer[0],_deltaUpdate.size);
+}
+
+bool CollaborativeThread::readDeltaUpdate()
+{
+    int size;
+    if(!_socket->recv(&size,sizeof(int)))
+    {
+        return false;
+    }
+
+    if(size < 0)
+    {
+        std::cerr << "CollaborativeThread: Error: invalid delta update size "
+                << size << std::endl;
+        return false;
+    }
+
+    _deltaBuffer.resize(size);
+    if(size && !_socket->recv(&_deltaBuffer[0],size))
+    {
+        return false;
+    }
+    _bytesReceived += sizeof(int) + size;
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    int offset = 0;
+    while(offset < size)
+    {
+        DeltaClientHeader header;
+        ClientUpdate cu;
+        int used = CollaborativeDelta::readClientHeader(&_deltaBuffer[offset],
+                size - offset,header,cu);
+        if(used < 0)
+        {
+            std::cerr << "CollaborativeThread: Error: short delta update."
+                    << std::endl;
+            return false;
+        }
+        offset += used;
+
+        std::map<int,struct ClientInitInfo>::iterator it =
+                _clientInitMap->find(header.id);
+        if(it == _clientInitMap->end())
+        {
+            std::cerr << "CollaborativeThread: Error: delta update for "
+                    << "unknown client " << header.id << std::endl;
+            return false;
+        }
+
+        ClientState & state = getClientState(it->second);
+        if(header.flags & DELTA_CLIENT_UPDATE)
+        {
+            state.update = cu;
+            state.update.numMes = header.id;
+        }
+
+        used = CollaborativeDelta::readBodies(&_deltaBuffer[offset],
+                size - offset,state.bodies.size(),
+                state.bodies.size() ? &state.bodies[0] : NULL);
+        if(used < 0)
+        {
+            std::cerr << "CollaborativeThread: Error: short delta update."
+                    << std::endl;
+            return false;
+        }
+        offset += used;
+    }
+
+    // hand the full state on in the same layout as a full update
+    std::vector<ClientState*> clients;
+    if(_serverUpdate->mode == LOCKED)
+    {
+        if(_serverUpdate->masterID >= 0 && _serverUpdate->masterID != _id)
+        {
+            std::map<int,struct ClientInitInfo>::iterator it =
+                    _clientInitMap->find(_serverUpdate->masterID);
+            if(it != _clientInitMap->end())
+            {
+                clients.push_back(&getClientState(it->second));
+            }
+            else
+            {
+                _serverUpdate->masterID = -1;
+            }
+        }
+    }
+    else
+    {
+        for(std::map<int,struct ClientInitInfo>::iterator it =
+                _clientInitMap->begin(); it != _clientInitMap->end(); it++)
+        {
+            if(it->first != _id)
+            {
+                clients.push_back(&getClientState(it->second));
+            }
+        }
+        _serverUpdate->numUsers = clients.size() + 1;
+    }
+
+    int numBodies = 0;
+    for(int i = 0; i < clients.size(); i++)
+    {
+        numBodies += clients[i]->bodies.size();
+    }
+
+    if(clients.size())
+    {
+        _clientUpdate = new struct ClientUpdate[clients.size()];
+    }
+    if(numBodies)
+    {
+        _bodiesUpdate = new BodyUpdate[numBodies];
+    }
+
+    int bindex = 0;
+    for(int i = 0; i < clients.size(); i++)
+    {
+        _clientUpdate[i] = clients[i]->update;
+        for(int j = 0; j < clients[i]->bodies.size(); j++)
+        {
+            _bodiesUpdate[bindex] = clients[i]->bodies[j];
+            bindex++;
+        }
+    }
+
+    _decodeTime = osg::Timer::instance()->delta_s(startTick,
+            osg::Timer::instance()->tick());
+
+    return true;
+}
+
+CollaborativeThread::ClientState & CollaborativeThread::getClientState(
+        ClientInitInfo & cii)
+{
+    std::map<int,ClientState>::iterator it = _clientState.find(cii.id);
+    if(it != _clientState.end())
+    {
+        return it->second;
+    }
+
+    ClientState & state = _clientState[cii.id];
+    memset(&state.update,0,sizeof(struct ClientUpdate));
+    state.update.objScale = 1.0;
+    state.update.objTrans[0] = state.update.objTrans[5] =
+            state.update.objTrans[10] = state.update.objTrans[15] = 1.0;
+    state.update.numMes = cii.id;
+
+    BodyUpdate bu;
+    bu.pos[0] = bu.pos[1] = bu.pos[2] = 0.0;
+    bu.rot[0] = bu.rot[1] = bu.rot[2] = 0.0;
+    bu.rot[3] = 1.0;
+    state.bodies.resize(cii.numHeads + cii.numHands,bu);
+
+    return state;
+}
+
 void CollaborativeThread::processMessage(CollaborativeMessageHeader & cmh,
         char * data)
 {
@@ -315,6 +580,7 @@ void CollaborativeThread::processMessage(CollaborativeMessageHeader & cmh,
         {
             int id = *((int*)data);
             _clientInitMap->erase(id);
+            _clientState.erase(id);
             break;
         }
         default:
@@ -0,0 +1,422 @@
+#include <cvrConfig/ConfigIndex.h>
+
+#include <OpenThreads/ScopedLock>
+
+#include <set>
+#include <sstream>
+
+using namespace cvr;
+
+ConfigIndex::ConfigIndex()
+{
+    _firstTop = -1;
+    _lastTop = -1;
+    _finalized = false;
+}
+
+ConfigIndex::~ConfigIndex()
+{
+}
+
+int ConfigIndex::addTag(int parent, const std::string & name)
+{
+    if(_finalized)
+    {
+        return -1;
+    }
+
+    Tag tag;
+    tag.name = name;
+    tag.fullName = name + ":";
+    tag.parent = parent;
+    tag.firstChild = -1;
+    tag.lastChild = -1;
+    tag.next = -1;
+
+    int index = _tags.size();
+    _tags.push_back(tag);
+
+    if(parent < 0)
+    {
+        if(_lastTop >= 0)
+        {
+            _tags[_lastTop].next = index;
+        }
+        else
+        {
+            _firstTop = index;
+        }
+        _lastTop = index;
+    }
+    else
+    {
+        if(_tags[parent].lastChild >= 0)
+        {
+            _tags[_tags[parent].lastChild].next = index;
+        }
+        else
+        {
+            _tags[parent].firstChild = index;
+        }
+        _tags[parent].lastChild = index;
+    }
+
+    return index;
+}
+
+void ConfigIndex::addAttribute(int tag, const std::string & name,
+        const std::string & value)
+{
+    if(_finalized || tag < 0 || tag >= _tags.size())
+    {
+        return;
+    }
+
+    // the first name attribute is the one the Tag:name form matches
+    if(name == "name" && !getAttribute(tag,name))
+    {
+        _tags[tag].fullName = _tags[tag].name + ":" + value;
+    }
+
+    _tags[tag].attributes.push_back(
+            std::pair<std::string,std::string>(name,value));
+}
+
+void ConfigIndex::finalize()
+{
+    if(_finalized)
+    {
+        return;
+    }
+    _finalized = true;
+
+    // tags are in document order, so the first entry for a key is the one
+    // the tree walk would find
+    std::vector<std::string> paths(_tags.size());
+    for(int i = 0; i < _tags.size(); i++)
+    {
+        if(_tags[i].parent < 0)
+        {
+            paths[i] = _tags[i].name;
+        }
+        else
+        {
+            paths[i] = paths[_tags[i].parent] + "." + _tags[i].name;
+        }
+
+        for(int j = 0; j < _tags[i].attributes.size(); j++)
+        {
+            const std::string & attribute = _tags[i].attributes[j].first;
+            unsigned int hash = hashKey(attribute,paths[i]);
+            if(_entries.find(hash,attribute,paths[i]) < 0)
+            {
+                _entries.insert(hash,attribute,paths[i],
+                        &_tags[i].attributes[j].second);
+            }
+        }
+    }
+}
+
+const std::string * ConfigIndex::find(const std::string & attribute,
+        const std::string & path)
+{
+    if(path.empty())
+    {
+        return NULL;
+    }
+
+    unsigned int hash = hashKey(attribute,path);
+
+    if(isPlainPath(path))
+    {
+        int entry = _entries.find(hash,attribute,path);
+        return entry >= 0 ? _entries.entries[entry].value : NULL;
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_resolvedLock);
+
+    int entry = _resolved.find(hash,attribute,path);
+    if(entry >= 0)
+    {
+        return _resolved.entries[entry].value;
+    }
+
+    std::vector<std::string> segments;
+    splitPath(path,segments);
+
+    std::vector<int> tags;
+    const std::string * value = NULL;
+    if(matchTags(_firstTop,segments,0,&attribute,true,tags))
+    {
+        value = getAttribute(tags[0],attribute);
+    }
+
+    _resolved.insert(hash,attribute,path,value);
+    return value;
+}
+
+bool ConfigIndex::findAll(const std::string & attribute,
+        const std::string & path, std::vector<const std::string *> & values)
+{
+    if(path.empty())
+    {
+        return false;
+    }
+
+    std::vector<std::string> segments;
+    splitPath(path,segments);
+
+    std::vector<int> tags;
+    matchTags(_firstTop,segments,0,&attribute,false,tags);
+
+    for(int i = 0; i < tags.size(); i++)
+    {
+        values.push_back(getAttribute(tags[i],attribute));
+    }
+
+    return tags.size();
+}
+
+void ConfigIndex::getChildren(const std::string & path,
+        std::vector<std::string> & destList)
+{
+    if(path.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> segments;
+    splitPath(path,segments);
+
+    std::vector<int> tags;
+    matchTags(_firstTop,segments,0,NULL,false,tags);
+
+    for(int i = 0; i < tags.size(); i++)
+    {
+        for(int child = _tags[tags[i]].firstChild; child >= 0;
+                child = _tags[child].next)
+        {
+            destList.push_back(_tags[child].name);
+        }
+    }
+}
+
+void ConfigIndex::getChangedPaths(ConfigIndex * oldIndex,
+        ConfigIndex * newIndex, std::vector<std::string> & paths)
+{
+    std::map<std::string,std::pair<std::string,std::string> > oldContents;
+    std::map<std::string,std::pair<std::string,std::string> > newContents;
+    if(oldIndex)
+    {
+        oldIndex->getTagContents(oldContents);
+    }
+    if(newIndex)
+    {
+        newIndex->getTagContents(newContents);
+    }
+
+    std::set<std::string> changed;
+    std::map<std::string,std::pair<std::string,std::string> >::iterator it,
+            other;
+    for(it = oldContents.begin(); it != oldContents.end(); it++)
+    {
+        other = newContents.find(it->first);
+        if(other == newContents.end()
+                || other->second.second != it->second.second)
+        {
+            changed.insert(it->second.first);
+        }
+    }
+    for(it = newContents.begin(); it != newContents.end(); it++)
+    {
+        if(oldContents.find(it->first) == oldContents.end())
+        {
+            changed.insert(it->second.first);
+        }
+    }
+
+    paths.insert(paths.end(),changed.begin(),changed.end());
+}
+
+int ConfigIndex::Table::find(unsigned int hash, const std::string & attribute,
+        const std::string & path) const
+{
+    if(buckets.empty())
+    {
+        return -1;
+    }
+
+    int entry = buckets[hash & (buckets.size() - 1)];
+    while(entry >= 0)
+    {
+        const Entry & e = entries[entry];
+        if(e.hash == hash && e.path == path && e.attribute == attribute)
+        {
+            return entry;
+        }
+        entry = e.next;
+    }
+    return -1;
+}
+
+void ConfigIndex::Table::insert(unsigned int hash,
+        const std::string & attribute, const std::string & path,
+        const std::string * value)
+{
+    // keep at most one entry per bucket on average, size is a power of 2
+    if(entries.size() >= buckets.size())
+    {
+        int size = buckets.size() ? buckets.size() * 2 : 64;
+        buckets.clear();
+        buckets.resize(size,-1);
+        for(int i = 0; i < entries.size(); i++)
+        {
+            int bucket = entries[i].hash & (size - 1);
+            entries[i].next = buckets[bucket];
+            buckets[bucket] = i;
+        }
+    }
+
+    Entry e;
+    e.hash = hash;
+    e.attribute = attribute;
+    e.path = path;
+    e.value = value;
+
+    int bucket = hash & (buckets.size() - 1);
+    e.next = buckets[bucket];
+    buckets[bucket] = entries.size();
+    entries.push_back(e);
+}
+
+unsigned int ConfigIndex::hashKey(const std::string & attribute,
+        const std::string & path)
+{
+    // FNV-1a over attribute, a separator and path
+    unsigned int hash = 2166136261u;
+    for(int i = 0; i < attribute.size(); i++)
+    {
+        hash = (hash ^ (unsigned char)attribute[i]) * 16777619u;
+    }
+    hash = (hash ^ '\n') * 16777619u;
+    for(int i = 0; i < path.size(); i++)
+    {
+        hash = (hash ^ (unsigned char)path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool ConfigIndex::isPlainPath(const std::string & path)
+{
+    // Tag:name segments and a trailing separator need the walk
+    return path.find(':') == std::string::npos && path[path.size() - 1] != '.';
+}
+
+void ConfigIndex::splitPath(const std::string & path,
+        std::vector<std::string> & segments)
+{
+    // matches the readers, a trailing separator is ignored
+    size_t start = 0;
+    while(true)
+    {
+        size_t location = path.find('.',start);
+        if(location == std::string::npos)
+        {
+            segments.push_back(path.substr(start));
+            break;
+        }
+        segments.push_back(path.substr(start,location - start));
+        start = location + 1;
+        if(start >= path.size())
+        {
+            break;
+        }
+    }
+}
+
+const std::string * ConfigIndex::getAttribute(int tag,
+        const std::string & attribute) const
+{
+    const std::vector<std::pair<std::string,std::string> > & attributes =
+            _tags[tag].attributes;
+    for(int i = 0; i < attributes.size(); i++)
+    {
+        if(attributes[i].first == attribute)
+        {
+            return &attributes[i].second;
+        }
+    }
+    return NULL;
+}
+
+void ConfigIndex::getTagContents(
+        std::map<std::string,std::pair<std::string,std::string> > & contents) const
+{
+    // tags are keyed by their Tag:name path and how many tags came before
+    // with the same path, mapped to their plain path and attributes
+    std::vector<std::string> fullPaths(_tags.size());
+    std::vector<std::string> paths(_tags.size());
+    std::map<std::string,int> occurrences;
+    for(int i = 0; i < _tags.size(); i++)
+    {
+        if(_tags[i].parent < 0)
+        {
+            fullPaths[i] = _tags[i].fullName;
+            paths[i] = _tags[i].name;
+        }
+        else
+        {
+            fullPaths[i] = fullPaths[_tags[i].parent] + "." + _tags[i].fullName;
+            paths[i] = paths[_tags[i].parent] + "." + _tags[i].name;
+        }
+
+        std::stringstream key;
+        key << fullPaths[i] << "#" << occurrences[fullPaths[i]]++;
+
+        std::string attributes;
+        for(int j = 0; j < _tags[i].attributes.size(); j++)
+        {
+            attributes += _tags[i].attributes[j].first + "="
+                    + _tags[i].attributes[j].second + "\n";
+        }
+
+        contents[key.str()] = std::pair<std::string,std::string>(paths[i],
+                attributes);
+    }
+}
+
+bool ConfigIndex::matchTags(int tag, const std::vector<std::string> & segments,
+        int depth, const std::string * attribute, bool firstOnly,
+        std::vector<int> & result) const
+{
+    const std::string & segment = segments[depth];
+    bool fullName = segment.find(':') != std::string::npos;
+    bool last = depth + 1 == segments.size();
+
+    for(; tag >= 0; tag = _tags[tag].next)
+    {
+        if(segment != (fullName ? _tags[tag].fullName : _tags[tag].name))
+        {
+            continue;
+        }
+
+        if(last)
+        {
+            if(!attribute || getAttribute(tag,*attribute))
+            {
+                result.push_back(tag);
+                if(firstOnly)
+                {
+                    return true;
+                }
+            }
+        }
+        else if(matchTags(_tags[tag].firstChild,segments,depth + 1,attribute,
+                firstOnly,result) && firstOnly)
+        {
+            return true;
+        }
+    }
+
+    return result.size() && firstOnly;
+}
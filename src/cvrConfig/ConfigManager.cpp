@@ -1,9 +1,10 @@
 #include <cvrConfig/ConfigManager.h>
 #include <cvrConfig/XMLReader.h>
+#include <cvrConfig/ConfigIndex.h>
+#include <cvrConfig/ConfigSnapshot.h>
 #include <cvrKernel/CalVR.h>
 
 #include <iostream>
-#include <sstream>
 
 #include <mxml.h>
 #include <cstdio>
@@ -12,11 +13,30 @@
 
 #include <mxml.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 using namespace cvr;
 
 std::vector<ConfigFileReader*> ConfigManager::_configFileList;
 std::string ConfigManager::_configDir;
 bool ConfigManager::_debugOutput = false;
+osg::ref_ptr<ConfigIndex> ConfigManager::_index;
+OpenThreads::Mutex ConfigManager::_indexLock;
+ConfigSnapshot * ConfigManager::_snapshot = NULL;
+ConfigManager::SnapshotMode ConfigManager::_snapshotMode =
+        ConfigManager::SNAPSHOT_OFF;
+int ConfigManager::_generation = 0;
+std::vector<std::string> ConfigManager::_fileList;
+std::string ConfigManager::_key;
+bool ConfigManager::_snapshotShared = false;
+std::vector<ConfigChangeCallback*> ConfigManager::_changeCallbacks;
+std::vector<std::string> ConfigManager::_changedPaths;
+int ConfigManager::_watchFD = -1;
+std::map<int,std::string> ConfigManager::_watchDirs;
+std::set<std::string> ConfigManager::_watchFiles;
 
 ConfigManager::ConfigManager()
 {
@@ -29,6 +49,24 @@ ConfigManager::~ConfigManager()
         delete _configFileList[i];
     }
     _configFileList.clear();
+
+    _indexLock.lock();
+    _index = NULL;
+    _indexLock.unlock();
+
+#ifdef __linux__
+    if(_watchFD >= 0)
+    {
+        close(_watchFD);
+        _watchFD = -1;
+    }
+#endif
+
+    if(_snapshot)
+    {
+        delete _snapshot;
+        _snapshot = NULL;
+    }
 }
 
 bool ConfigManager::init()
@@ -43,6 +81,12 @@ bool ConfigManager::init()
         _configDir = CalVR::instance()->getConfigDir();
     }
 
+    // config arrives from the master with loadSnapshot()
+    if(_snapshotMode == SNAPSHOT_RECEIVE)
+    {
+        return true;
+    }
+
     std::string file;
     char * confFile = getenv("CALVR_CONFIG_FILE");
     if(confFile)
@@ -62,13 +106,15 @@ bool ConfigManager::init()
         return false;
     }
 
-    std::vector<std::string> fileList;
+    _key = _configDir + ";" + file;
+
+    _fileList.clear();
     size_t pos = 0;
     while((pos = file.find_first_of(':')) != std::string::npos)
     {
         if(pos)
         {
-            fileList.push_back(file.substr(0,pos));
+            _fileList.push_back(file.substr(0,pos));
         }
 
         if(pos + 1 < file.size())
@@ -83,67 +129,48 @@ bool ConfigManager::init()
 
     if(file.size())
     {
-        fileList.push_back(file);
+        _fileList.push_back(file);
     }
 
-    if(!fileList.size())
+    if(!_fileList.size())
     {
         std::cerr << "Error: no valid config file in CALVR_CONFIG_FILE"
                 << std::endl;
         return false;
     }
 
-    for(int i = 0; i < fileList.size(); i++)
+    char * cacheFile = getenv("CALVR_CONFIG_CACHE");
+    if(cacheFile)
     {
-        size_t pos = fileList[i].find_last_of('.');
-        if(pos == std::string::npos || pos + 1 == fileList[i].size())
+        ConfigSnapshot * snapshot = new ConfigSnapshot();
+        if(snapshot->readFile(cacheFile) && snapshot->getKey() == _key
+                && snapshot->isCurrent())
         {
-            std::cerr
-                    << "ConfigManager: Error: Unable to find extension for file: "
-                    << fileList[i] << std::endl;
-            return false;
+            std::cerr << "ConfigManager: Using cached config: " << cacheFile
+                    << std::endl;
+            buildIndex(snapshot);
+            _snapshotShared = _snapshotMode == SNAPSHOT_SEND;
+            _debugOutput = getBool("ConfigDebug",false);
+            return true;
         }
-        std::string extension = fileList[i].substr(pos + 1,
-                fileList[i].size() - (pos + 1));
-        std::transform(extension.begin(),extension.end(),extension.begin(),
-                ::tolower);
+        delete snapshot;
+    }
 
-        ConfigFileReader * cfr = NULL;
-        if(extension == "xml")
-        {
-            cfr = new XMLReader();
-        }
-        else
-        {
-            std::cerr
-                    << "ConfigManager: Error: No reader could be identified for file: "
-                    << fileList[i] << std::endl;
-            return false;
-        }
+    // a snapshot to share or cache must be valid on every host
+    bool keepLocalBlocks = _snapshotMode == SNAPSHOT_SEND || cacheFile;
 
-        if(cfr)
-        {
-            cfr->setDebugOutput(true);
-            if(cfr->loadFile(fileList[i]))
-            {
-                _configFileList.push_back(cfr);
-            }
-            else
-            {
-                std::cerr << "ConfigManager: Error loading config files."
-                        << std::endl;
-                delete cfr;
-                return false;
-            }
-            cfr->setDebugOutput(false);
-        }
-        else
-        {
-            std::cerr
-                    << "ConfigManager: Error: ConfigFileReader pointer is NULL. file: "
-                    << fileList[i] << std::endl;
-            return false;
-        }
+    if(!loadFiles(keepLocalBlocks,_configFileList))
+    {
+        return false;
+    }
+
+    ConfigSnapshot * snapshot = makeSnapshot(_configFileList);
+    buildIndex(snapshot);
+    _snapshotShared = snapshot && _snapshotMode == SNAPSHOT_SEND;
+
+    if(snapshot && cacheFile)
+    {
+        snapshot->writeFile(cacheFile);
     }
 
     _debugOutput = getBool("ConfigDebug",false);
@@ -155,14 +182,14 @@ bool ConfigManager::init()
     return true;
 }
 
-std::string ConfigManager::getEntry(std::string path, std::string def,
-        bool * found)
+std::string ConfigManager::getEntry(const std::string & path,
+        const std::string & def, bool * found)
 {
     return getEntry("value",path,def,found);
 }
 
-std::string ConfigManager::getEntry(std::string attribute, std::string path,
-        std::string def, bool * found)
+std::string ConfigManager::getEntry(const std::string & attribute,
+        const std::string & path, const std::string & def, bool * found)
 {
     if(path.empty())
     {
@@ -173,17 +200,8 @@ std::string ConfigManager::getEntry(std::string attribute, std::string path,
         return def;
     }
 
-    bool wasFound = false;
     std::string result;
-
-    for(int i = 0; i < _configFileList.size(); i++)
-    {
-        result = _configFileList[i]->getEntry(attribute,path,def,&wasFound);
-        if(wasFound)
-        {
-            break;
-        }
-    }
+    bool wasFound = findEntry(attribute,path,result);
 
     if(found)
     {
@@ -210,8 +228,9 @@ std::string ConfigManager::getEntry(std::string attribute, std::string path,
     }
 }
 
-std::string ConfigManager::getEntryConcat(std::string attribute,
-        std::string path, char separator, std::string def, bool * found)
+std::string ConfigManager::getEntryConcat(const std::string & attribute,
+        const std::string & path, char separator, const std::string & def,
+        bool * found)
 {
     if(path.empty())
     {
@@ -225,7 +244,22 @@ std::string ConfigManager::getEntryConcat(std::string attribute,
     bool wasFound = false;
     std::string result;
 
-    for(int i = 0; i < _configFileList.size(); i++)
+    osg::ref_ptr<ConfigIndex> index = getIndex();
+    if(index)
+    {
+        std::vector<const std::string *> values;
+        wasFound = index->findAll(attribute,path,values);
+        for(int i = 0; i < values.size(); i++)
+        {
+            if(i)
+            {
+                result += separator;
+            }
+            result += *values[i];
+        }
+    }
+
+    for(int i = 0; !index && i < _configFileList.size(); i++)
     {
         bool tempFound = false;
         std::string tempResult;
@@ -271,18 +305,16 @@ std::string ConfigManager::getEntryConcat(std::string attribute,
     }
 }
 
-float ConfigManager::getFloat(std::string path, float def, bool * found)
+float ConfigManager::getFloat(const std::string & path, float def, bool * found)
 {
     return getFloat("value",path,def,found);
 }
 
-float ConfigManager::getFloat(std::string attribute, std::string path,
-        float def, bool * found)
+float ConfigManager::getFloat(const std::string & attribute,
+        const std::string & path, float def, bool * found)
 {
     bool hasEntry = false;
-    std::stringstream ss;
-    ss << def;
-    std::string result = getEntry(attribute,path,ss.str(),&hasEntry);
+    std::string result = getEntry(attribute,path,"",&hasEntry);
     if(hasEntry)
     {
         if(found)
@@ -298,18 +330,17 @@ float ConfigManager::getFloat(std::string attribute, std::string path,
     return def;
 }
 
-double ConfigManager::getDouble(std::string path, double def, bool * found)
+double ConfigManager::getDouble(const std::string & path, double def,
+        bool * found)
 {
     return getDouble("value",path,def,found);
 }
 
-double ConfigManager::getDouble(std::string attribute, std::string path,
-        double def, bool * found)
+double ConfigManager::getDouble(const std::string & attribute,
+        const std::string & path, double def, bool * found)
 {
     bool hasEntry = false;
-    std::stringstream ss;
-    ss << def;
-    std::string result = getEntry(attribute,path,ss.str(),&hasEntry);
+    std::string result = getEntry(attribute,path,"",&hasEntry);
     if(hasEntry)
     {
         if(found)
@@ -325,18 +356,16 @@ double ConfigManager::getDouble(std::string attribute, std::string path,
     return def;
 }
 
-int ConfigManager::getInt(std::string path, int def, bool * found)
+int ConfigManager::getInt(const std::string & path, int def, bool * found)
 {
     return getInt("value",path,def,found);
 }
 
-int ConfigManager::getInt(std::string attribute, std::string path, int def,
-        bool * found)
+int ConfigManager::getInt(const std::string & attribute,
+        const std::string & path, int def, bool * found)
 {
     bool hasEntry = false;
-    std::stringstream ss;
-    ss << def;
-    std::string result = getEntry(attribute,path,ss.str(),&hasEntry);
+    std::string result = getEntry(attribute,path,"",&hasEntry);
     if(hasEntry)
     {
         if(found)
@@ -352,18 +381,16 @@ int ConfigManager::getInt(std::string attribute, std::string path, int def,
     return def;
 }
 
-bool ConfigManager::getBool(std::string path, bool def, bool * found)
+bool ConfigManager::getBool(const std::string & path, bool def, bool * found)
 {
     return getBool("value",path,def,found);
 }
 
-bool ConfigManager::getBool(std::string attribute, std::string path, bool def,
-        bool * found)
+bool ConfigManager::getBool(const std::string & attribute,
+        const std::string & path, bool def, bool * found)
 {
     bool hasEntry = false;
-    std::stringstream ss;
-    ss << def;
-    std::string result = getEntry(attribute,path,ss.str(),&hasEntry);
+    std::string result = getEntry(attribute,path,"",&hasEntry);
     if(hasEntry)
     {
         if(found)
@@ -387,13 +414,15 @@ bool ConfigManager::getBool(std::string attribute, std::string path, bool def,
     return def;
 }
 
-osg::Vec3 ConfigManager::getVec3(std::string path, osg::Vec3 def, bool * found)
+osg::Vec3 ConfigManager::getVec3(const std::string & path, osg::Vec3 def,
+        bool * found)
 {
     return getVec3("x","y","z",path,def,found);
 }
 
-osg::Vec3 ConfigManager::getVec3(std::string attributeX, std::string attributeY,
-        std::string attributeZ, std::string path, osg::Vec3 def, bool * found)
+osg::Vec3 ConfigManager::getVec3(const std::string & attributeX,
+        const std::string & attributeY, const std::string & attributeZ,
+        const std::string & path, osg::Vec3 def, bool * found)
 {
     bool hasEntry = false;
     bool isFound;
@@ -422,14 +451,16 @@ osg::Vec3 ConfigManager::getVec3(std::string attributeX, std::string attributeY,
     return result;
 }
 
-osg::Vec4 ConfigManager::getVec4(std::string path, osg::Vec4 def, bool * found)
+osg::Vec4 ConfigManager::getVec4(const std::string & path, osg::Vec4 def,
+        bool * found)
 {
     return getVec4("x","y","z","w",path,def,found);
 }
 
-osg::Vec4 ConfigManager::getVec4(std::string attributeX, std::string attributeY,
-        std::string attributeZ, std::string attributeW, std::string path,
-        osg::Vec4 def, bool * found)
+osg::Vec4 ConfigManager::getVec4(const std::string & attributeX,
+        const std::string & attributeY, const std::string & attributeZ,
+        const std::string & attributeW, const std::string & path, osg::Vec4 def,
+        bool * found)
 {
     bool hasEntry = false;
     bool isFound;
@@ -463,15 +494,15 @@ osg::Vec4 ConfigManager::getVec4(std::string attributeX, std::string attributeY,
     return result;
 }
 
-osg::Vec3d ConfigManager::getVec3d(std::string path, osg::Vec3d def,
+osg::Vec3d ConfigManager::getVec3d(const std::string & path, osg::Vec3d def,
         bool * found)
 {
     return getVec3d("x","y","z",path,def,found);
 }
 
-osg::Vec3d ConfigManager::getVec3d(std::string attributeX,
-        std::string attributeY, std::string attributeZ, std::string path,
-        osg::Vec3d def, bool * found)
+osg::Vec3d ConfigManager::getVec3d(const std::string & attributeX,
+        const std::string & attributeY, const std::string & attributeZ,
+        const std::string & path, osg::Vec3d def, bool * found)
 {
     bool hasEntry = false;
     bool isFound;
@@ -500,15 +531,16 @@ osg::Vec3d ConfigManager::getVec3d(std::string attributeX,
     return result;
 }
 
-osg::Vec4d ConfigManager::getVec4d(std::string path, osg::Vec4d def,
+osg::Vec4d ConfigManager::getVec4d(const std::string & path, osg::Vec4d def,
         bool * found)
 {
     return getVec4d("x","y","z","w",path,def,found);
 }
 
-osg::Vec4d ConfigManager::getVec4d(std::string attributeX,
-        std::string attributeY, std::string attributeZ, std::string attributeW,
-        std::string path, osg::Vec4d def, bool * found)
+osg::Vec4d ConfigManager::getVec4d(const std::string & attributeX,
+        const std::string & attributeY, const std::string & attributeZ,
+        const std::string & attributeW, const std::string & path, osg::Vec4d def,
+        bool * found)
 {
     bool hasEntry = false;
     bool isFound;
@@ -542,12 +574,13 @@ osg::Vec4d ConfigManager::getVec4d(std::string attributeX,
     return result;
 }
 
-osg::Vec4 ConfigManager::getColor(std::string path, osg::Vec4 def, bool * found)
+osg::Vec4 ConfigManager::getColor(const std::string & path, osg::Vec4 def,
+        bool * found)
 {
     return getVec4("r","g","b","a",path,def,found);
 }
 
-void ConfigManager::getChildren(std::string path,
+void ConfigManager::getChildren(const std::string & path,
         std::vector<std::string> & destList)
 {
     if(path.empty())
@@ -555,6 +588,13 @@ void ConfigManager::getChildren(std::string path,
         return;
     }
 
+    osg::ref_ptr<ConfigIndex> index = getIndex();
+    if(index)
+    {
+        index->getChildren(path,destList);
+        return;
+    }
+
     for(int i = 0; i < _configFileList.size(); i++)
     {
         _configFileList[i]->getChildren(path,destList);
@@ -562,3 +602,517 @@ void ConfigManager::getChildren(std::string path,
 
     return;
 }
+
+ConfigHandle ConfigManager::getHandle(const std::string & path)
+{
+    return getHandle("value",path);
+}
+
+ConfigHandle ConfigManager::getHandle(const std::string & attribute,
+        const std::string & path)
+{
+    ConfigHandle handle;
+    handle._attribute = attribute;
+    handle._path = path;
+    resolveHandle(handle);
+    return handle;
+}
+
+std::string ConfigManager::getEntry(ConfigHandle & handle,
+        const std::string & def, bool * found)
+{
+    if(handle._generation != _generation)
+    {
+        resolveHandle(handle);
+    }
+
+    if(found)
+    {
+        *found = handle._found;
+    }
+    return handle._found ? handle._value : def;
+}
+
+float ConfigManager::getFloat(ConfigHandle & handle, float def, bool * found)
+{
+    bool hasEntry = false;
+    std::string result = getEntry(handle,"",&hasEntry);
+    if(found)
+    {
+        *found = hasEntry;
+    }
+    return hasEntry ? atof(result.c_str()) : def;
+}
+
+double ConfigManager::getDouble(ConfigHandle & handle, double def,
+        bool * found)
+{
+    bool hasEntry = false;
+    std::string result = getEntry(handle,"",&hasEntry);
+    if(found)
+    {
+        *found = hasEntry;
+    }
+    return hasEntry ? atof(result.c_str()) : def;
+}
+
+int ConfigManager::getInt(ConfigHandle & handle, int def, bool * found)
+{
+    bool hasEntry = false;
+    std::string result = getEntry(handle,"",&hasEntry);
+    if(found)
+    {
+        *found = hasEntry;
+    }
+    return hasEntry ? atoi(result.c_str()) : def;
+}
+
+bool ConfigManager::getBool(ConfigHandle & handle, bool def, bool * found)
+{
+    bool hasEntry = false;
+    std::string result = getEntry(handle,"",&hasEntry);
+    if(found)
+    {
+        *found = hasEntry;
+    }
+    if(!hasEntry)
+    {
+        return def;
+    }
+
+    std::transform(result.begin(),result.end(),result.begin(),::tolower);
+    return result == "on" || result == "true";
+}
+
+bool ConfigManager::getSnapshot(std::vector<char> & data)
+{
+    if(!_snapshot)
+    {
+        return false;
+    }
+
+    _snapshot->write(data);
+    return true;
+}
+
+bool ConfigManager::loadSnapshot(const char * data, int size)
+{
+    ConfigSnapshot * snapshot = new ConfigSnapshot();
+    if(!snapshot->read(data,size))
+    {
+        delete snapshot;
+        return false;
+    }
+
+    buildIndex(snapshot);
+    _debugOutput = getBool("ConfigDebug",false);
+    return true;
+}
+
+void ConfigManager::addChangeCallback(ConfigChangeCallback * callback)
+{
+    if(!callback)
+    {
+        return;
+    }
+
+    for(int i = 0; i < _changeCallbacks.size(); i++)
+    {
+        if(_changeCallbacks[i] == callback)
+        {
+            return;
+        }
+    }
+    _changeCallbacks.push_back(callback);
+}
+
+void ConfigManager::removeChangeCallback(ConfigChangeCallback * callback)
+{
+    for(std::vector<ConfigChangeCallback*>::iterator it =
+            _changeCallbacks.begin(); it != _changeCallbacks.end(); it++)
+    {
+        if(*it == callback)
+        {
+            _changeCallbacks.erase(it);
+            return;
+        }
+    }
+}
+
+bool ConfigManager::isPathChanged(const std::vector<std::string> & paths,
+        const std::string & path)
+{
+    for(int i = 0; i < paths.size(); i++)
+    {
+        if(paths[i].compare(0,path.size(),path) == 0
+                && (paths[i].size() == path.size()
+                        || paths[i][path.size()] == '.'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ConfigManager::startWatching()
+{
+#ifdef __linux__
+    if(_watchFD >= 0)
+    {
+        return true;
+    }
+
+    if(!_snapshot || _fileList.empty())
+    {
+        std::cerr << "ConfigManager: Error: no config files to watch."
+                << std::endl;
+        return false;
+    }
+
+    _watchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(_watchFD < 0)
+    {
+        perror("inotify_init1");
+        return false;
+    }
+
+    // watch the directories, editors often replace the file when saving
+    std::vector<std::string> files;
+    _snapshot->getSourceFiles(files);
+    for(int i = 0; i < files.size(); i++)
+    {
+        std::string dir = ".";
+        std::string name = files[i];
+        size_t pos = files[i].find_last_of('/');
+        if(pos != std::string::npos)
+        {
+            dir = pos ? files[i].substr(0,pos) : "/";
+            name = files[i].substr(pos + 1);
+        }
+
+        bool watched = false;
+        for(std::map<int,std::string>::iterator it = _watchDirs.begin();
+                it != _watchDirs.end(); it++)
+        {
+            if(it->second == dir)
+            {
+                watched = true;
+                break;
+            }
+        }
+
+        if(!watched)
+        {
+            int wd = inotify_add_watch(_watchFD,dir.c_str(),
+                    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if(wd < 0)
+            {
+                std::cerr << "ConfigManager: Error: unable to watch directory: "
+                        << dir << std::endl;
+                continue;
+            }
+            _watchDirs[wd] = dir;
+        }
+        _watchFiles.insert(dir + "/" + name);
+    }
+
+    return true;
+#else
+    std::cerr << "ConfigManager: config file watching is only supported on linux."
+            << std::endl;
+    return false;
+#endif
+}
+
+bool ConfigManager::checkForChanges()
+{
+#ifdef __linux__
+    if(_watchFD < 0)
+    {
+        return false;
+    }
+
+    bool changed = false;
+    char buffer[4096]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while((length = read(_watchFD,buffer,sizeof(buffer))) > 0)
+    {
+        for(char * ptr = buffer; ptr < buffer + length;
+                ptr += sizeof(struct inotify_event)
+                        + ((struct inotify_event *)ptr)->len)
+        {
+            struct inotify_event * event = (struct inotify_event *)ptr;
+            if(event->len && _watchDirs.find(event->wd) != _watchDirs.end()
+                    && _watchFiles.count(
+                            _watchDirs[event->wd] + "/" + event->name))
+            {
+                changed = true;
+            }
+        }
+    }
+
+    // a save that does not change the contents is not a change
+    return changed && _snapshot && !_snapshot->isCurrent();
+#else
+    return false;
+#endif
+}
+
+bool ConfigManager::reload(std::vector<char> & update)
+{
+    update.clear();
+
+    if(_fileList.empty())
+    {
+        return false;
+    }
+
+    std::vector<ConfigFileReader*> readers;
+    bool ok = loadFiles(true,readers);
+
+    ConfigSnapshot * snapshot = ok ? makeSnapshot(readers) : NULL;
+    if(!snapshot)
+    {
+        std::cerr << "ConfigManager: Error reloading config, keeping the "
+                << "current config." << std::endl;
+        for(int i = 0; i < readers.size(); i++)
+        {
+            delete readers[i];
+        }
+        return false;
+    }
+
+    std::cerr << "ConfigManager: Config reloaded." << std::endl;
+
+    // slaves only have our snapshot as a base if it was shared with them
+    snapshot->makeUpdate(_snapshotShared ? _snapshot : NULL,update);
+    _snapshotShared = true;
+
+    for(int i = 0; i < _configFileList.size(); i++)
+    {
+        delete _configFileList[i];
+    }
+    _configFileList = readers;
+
+    osg::ref_ptr<ConfigIndex> oldIndex = buildIndex(snapshot);
+    findChanges(oldIndex.get(),_index.get());
+
+    char * cacheFile = getenv("CALVR_CONFIG_CACHE");
+    if(cacheFile)
+    {
+        snapshot->writeFile(cacheFile);
+    }
+
+    _debugOutput = getBool("ConfigDebug",false);
+    for(int i = 0; i < _configFileList.size(); i++)
+    {
+        _configFileList[i]->setDebugOutput(_debugOutput);
+    }
+
+    return true;
+}
+
+bool ConfigManager::applyUpdate(const char * data, int size)
+{
+    ConfigSnapshot * snapshot = new ConfigSnapshot();
+    if(_snapshot)
+    {
+        *snapshot = *_snapshot;
+    }
+
+    if(!snapshot->applyUpdate(data,size))
+    {
+        delete snapshot;
+        return false;
+    }
+
+    osg::ref_ptr<ConfigIndex> oldIndex = buildIndex(snapshot);
+    findChanges(oldIndex.get(),_index.get());
+    _debugOutput = getBool("ConfigDebug",false);
+    return true;
+}
+
+void ConfigManager::notifyChanges()
+{
+    if(_changedPaths.empty())
+    {
+        return;
+    }
+
+    std::vector<std::string> paths;
+    paths.swap(_changedPaths);
+
+    // callbacks may remove themselves
+    std::vector<ConfigChangeCallback*> callbacks = _changeCallbacks;
+    for(int i = 0; i < callbacks.size(); i++)
+    {
+        callbacks[i]->configChanged(paths);
+    }
+}
+
+bool ConfigManager::loadFiles(bool keepLocalBlocks,
+        std::vector<ConfigFileReader*> & readers)
+{
+    for(int i = 0; i < _fileList.size(); i++)
+    {
+        size_t pos = _fileList[i].find_last_of('.');
+        if(pos == std::string::npos || pos + 1 == _fileList[i].size())
+        {
+            std::cerr
+                    << "ConfigManager: Error: Unable to find extension for file: "
+                    << _fileList[i] << std::endl;
+            return false;
+        }
+        std::string extension = _fileList[i].substr(pos + 1,
+                _fileList[i].size() - (pos + 1));
+        std::transform(extension.begin(),extension.end(),extension.begin(),
+                ::tolower);
+
+        ConfigFileReader * cfr = NULL;
+        if(extension == "xml")
+        {
+            XMLReader * xmlReader = new XMLReader();
+            xmlReader->setKeepLocalBlocks(keepLocalBlocks);
+            cfr = xmlReader;
+        }
+        else
+        {
+            std::cerr
+                    << "ConfigManager: Error: No reader could be identified for file: "
+                    << _fileList[i] << std::endl;
+            return false;
+        }
+
+        if(cfr)
+        {
+            cfr->setDebugOutput(true);
+            if(cfr->loadFile(_fileList[i]))
+            {
+                readers.push_back(cfr);
+            }
+            else
+            {
+                std::cerr << "ConfigManager: Error loading config files."
+                        << std::endl;
+                delete cfr;
+                return false;
+            }
+            cfr->setDebugOutput(false);
+        }
+        else
+        {
+            std::cerr
+                    << "ConfigManager: Error: ConfigFileReader pointer is NULL. file: "
+                    << _fileList[i] << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ConfigSnapshot * ConfigManager::makeSnapshot(
+        std::vector<ConfigFileReader*> & readers)
+{
+    ConfigSnapshot * snapshot = new ConfigSnapshot();
+    snapshot->setKey(_key);
+    for(int i = 0; i < readers.size(); i++)
+    {
+        if(!readers[i]->flatten(snapshot))
+        {
+            delete snapshot;
+            return NULL;
+        }
+    }
+    return snapshot;
+}
+
+void ConfigManager::findChanges(ConfigIndex * oldIndex,
+        ConfigIndex * newIndex)
+{
+    std::vector<std::string> paths;
+    ConfigIndex::getChangedPaths(oldIndex,newIndex,paths);
+    _changedPaths.insert(_changedPaths.end(),paths.begin(),paths.end());
+}
+
+osg::ref_ptr<ConfigIndex> ConfigManager::buildIndex(ConfigSnapshot * snapshot)
+{
+    osg::ref_ptr<ConfigIndex> index;
+    if(snapshot)
+    {
+        index = snapshot->createIndex(CalVR::instance()->getHostName());
+    }
+
+    // threads still reading the old index hold a reference, it is deleted
+    // when the last one lets go
+    osg::ref_ptr<ConfigIndex> oldIndex;
+    _indexLock.lock();
+    oldIndex = _index;
+    _index = index;
+    _indexLock.unlock();
+
+    if(_snapshot && _snapshot != snapshot)
+    {
+        delete _snapshot;
+    }
+    _snapshot = snapshot;
+
+    _generation++;
+
+    return oldIndex;
+}
+
+osg::ref_ptr<ConfigIndex> ConfigManager::getIndex()
+{
+    _indexLock.lock();
+    osg::ref_ptr<ConfigIndex> index = _index;
+    _indexLock.unlock();
+    return index;
+}
+
+void ConfigManager::resolveHandle(ConfigHandle & handle)
+{
+    handle._found = false;
+    handle._value.clear();
+    if(!handle._path.empty())
+    {
+        handle._found = findEntry(handle._attribute,handle._path,
+                handle._value);
+    }
+    handle._generation = _generation;
+
+    if(_debugOutput)
+    {
+        std::cerr << "Handle Path: " << handle._path << " Attr: "
+                << handle._attribute << " value: "
+                << (handle._found ? handle._value : "(default)") << std::endl;
+    }
+}
+
+bool ConfigManager::findEntry(const std::string & attribute,
+        const std::string & path, std::string & result)
+{
+    osg::ref_ptr<ConfigIndex> index = getIndex();
+    if(index)
+    {
+        const std::string * value = index->find(attribute,path);
+        if(value)
+        {
+            result = *value;
+            return true;
+        }
+        return false;
+    }
+
+    bool wasFound = false;
+    for(int i = 0; i < _configFileList.size(); i++)
+    {
+        result = _configFileList[i]->getEntry(attribute,path,"",&wasFound);
+        if(wasFound)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,601 @@
+#include <cvrConfig/ConfigSnapshot.h>
+#include <cvrConfig/ConfigIndex.h>
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+using namespace cvr;
+
+#define CONFIG_SNAPSHOT_MAGIC "CVRCSNP"
+#define CONFIG_UPDATE_MAGIC "CVRCUPD"
+#define CONFIG_SNAPSHOT_VERSION 1
+
+namespace
+{
+
+void appendData(std::vector<char> & data, const void * ptr, int size)
+{
+    data.insert(data.end(),(const char*)ptr,((const char*)ptr) + size);
+}
+
+void appendString(std::vector<char> & data, const std::string & str)
+{
+    unsigned int size = str.size();
+    appendData(data,&size,sizeof(unsigned int));
+    appendData(data,str.c_str(),size);
+}
+
+void appendTag(std::vector<char> & data, int parent, const std::string & name,
+        const std::vector<std::pair<std::string,std::string> > & attributes)
+{
+    appendData(data,&parent,sizeof(int));
+    appendString(data,name);
+    unsigned int count = attributes.size();
+    appendData(data,&count,sizeof(unsigned int));
+    for(int i = 0; i < attributes.size(); i++)
+    {
+        appendString(data,attributes[i].first);
+        appendString(data,attributes[i].second);
+    }
+}
+
+unsigned long long hashData(const unsigned char * data, size_t size,
+        unsigned long long hash = 14695981039346656037ULL)
+{
+    // FNV-1a
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+struct DataReader
+{
+        const char * data;
+        int size;
+        int pos;
+
+        bool read(void * ptr, int bytes)
+        {
+            if(bytes < 0 || pos + bytes > size)
+            {
+                return false;
+            }
+            memcpy(ptr,data + pos,bytes);
+            pos += bytes;
+            return true;
+        }
+
+        bool readString(std::string & str)
+        {
+            unsigned int length;
+            if(!read(&length,sizeof(unsigned int)) || length > size - pos)
+            {
+                return false;
+            }
+            str.assign(data + pos,length);
+            pos += length;
+            return true;
+        }
+
+        bool readTag(int & parent, std::string & name,
+                std::vector<std::pair<std::string,std::string> > & attributes)
+        {
+            unsigned int count;
+            if(!read(&parent,sizeof(int)) || !readString(name)
+                    || !read(&count,sizeof(unsigned int)))
+            {
+                return false;
+            }
+            for(unsigned int i = 0; i < count; i++)
+            {
+                std::pair<std::string,std::string> attribute;
+                if(!readString(attribute.first)
+                        || !readString(attribute.second))
+                {
+                    return false;
+                }
+                attributes.push_back(attribute);
+            }
+            return true;
+        }
+};
+
+}
+
+ConfigSnapshot::ConfigSnapshot()
+{
+}
+
+ConfigSnapshot::~ConfigSnapshot()
+{
+}
+
+int ConfigSnapshot::addTag(int parent, const std::string & name)
+{
+    Tag tag;
+    tag.parent = parent;
+    tag.name = name;
+    _tags.push_back(tag);
+    return _tags.size() - 1;
+}
+
+void ConfigSnapshot::addAttribute(int tag, const std::string & name,
+        const std::string & value)
+{
+    if(tag < 0 || tag >= _tags.size())
+    {
+        return;
+    }
+
+    _tags[tag].attributes.push_back(
+            std::pair<std::string,std::string>(name,value));
+}
+
+bool ConfigSnapshot::addSourceFile(const std::string & file)
+{
+    SourceFile sf;
+    sf.file = file;
+    if(!hashFile(file,sf.hash))
+    {
+        return false;
+    }
+    _sourceFiles.push_back(sf);
+    return true;
+}
+
+bool ConfigSnapshot::isCurrent()
+{
+    if(!_sourceFiles.size())
+    {
+        return false;
+    }
+
+    for(int i = 0; i < _sourceFiles.size(); i++)
+    {
+        unsigned long long hash;
+        if(!hashFile(_sourceFiles[i].file,hash)
+                || hash != _sourceFiles[i].hash)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ConfigSnapshot::getSourceFiles(std::vector<std::string> & files)
+{
+    for(int i = 0; i < _sourceFiles.size(); i++)
+    {
+        files.push_back(_sourceFiles[i].file);
+    }
+}
+
+unsigned long long ConfigSnapshot::getHash()
+{
+    std::vector<char> data;
+    write(data);
+    return hashData((const unsigned char*)&data[0],data.size());
+}
+
+ConfigIndex * ConfigSnapshot::createIndex(const std::string & host)
+{
+    std::vector<std::vector<int> > children(_tags.size());
+    std::vector<int> roots;
+    for(int i = 0; i < _tags.size(); i++)
+    {
+        if(_tags[i].parent < 0)
+        {
+            roots.push_back(i);
+        }
+        else
+        {
+            children[_tags[i].parent].push_back(i);
+        }
+    }
+
+    ConfigIndex * index = new ConfigIndex();
+    for(int i = 0; i < roots.size(); i++)
+    {
+        addTags(index,children,children[roots[i]],-1,host);
+    }
+    index->finalize();
+
+    return index;
+}
+
+void ConfigSnapshot::write(std::vector<char> & data)
+{
+    data.clear();
+
+    appendData(data,CONFIG_SNAPSHOT_MAGIC,8);
+    int version = CONFIG_SNAPSHOT_VERSION;
+    appendData(data,&version,sizeof(int));
+
+    appendString(data,_key);
+
+    unsigned int count = _sourceFiles.size();
+    appendData(data,&count,sizeof(unsigned int));
+    for(int i = 0; i < _sourceFiles.size(); i++)
+    {
+        appendString(data,_sourceFiles[i].file);
+        appendData(data,&_sourceFiles[i].hash,sizeof(unsigned long long));
+    }
+
+    count = _tags.size();
+    appendData(data,&count,sizeof(unsigned int));
+    for(int i = 0; i < _tags.size(); i++)
+    {
+        appendTag(data,_tags[i].parent,_tags[i].name,_tags[i].attributes);
+    }
+}
+
+bool ConfigSnapshot::read(const char * data, int size)
+{
+    DataReader reader;
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
+
+    char magic[8];
+    int version;
+    if(!reader.read(magic,8) || strncmp(magic,CONFIG_SNAPSHOT_MAGIC,8)
+            || !reader.read(&version,sizeof(int))
+            || version != CONFIG_SNAPSHOT_VERSION)
+    {
+        std::cerr << "ConfigSnapshot: Error: data is not a config snapshot."
+                << std::endl;
+        return false;
+    }
+
+    std::string key;
+    std::vector<SourceFile> sourceFiles;
+    std::vector<Tag> tags;
+
+    bool ok = reader.readString(key);
+
+    unsigned int count = 0;
+    ok = ok && reader.read(&count,sizeof(unsigned int));
+    for(unsigned int i = 0; ok && i < count; i++)
+    {
+        SourceFile sf;
+        ok = reader.readString(sf.file)
+                && reader.read(&sf.hash,sizeof(unsigned long long));
+        sourceFiles.push_back(sf);
+    }
+
+    count = 0;
+    ok = ok && reader.read(&count,sizeof(unsigned int));
+    for(unsigned int i = 0; ok && i < count; i++)
+    {
+        Tag tag;
+        ok = reader.readTag(tag.parent,tag.name,tag.attributes);
+
+        // tags are in document order, so a parent always comes first
+        ok = ok && tag.parent < (int)i;
+        tags.push_back(tag);
+    }
+
+    if(!ok)
+    {
+        std::cerr << "ConfigSnapshot: Error: snapshot data is truncated."
+                << std::endl;
+        return false;
+    }
+
+    _key = key;
+    _sourceFiles.swap(sourceFiles);
+    _tags.swap(tags);
+    return true;
+}
+
+void ConfigSnapshot::makeUpdate(ConfigSnapshot * base,
+        std::vector<char> & data)
+{
+    data.clear();
+
+    appendData(data,CONFIG_UPDATE_MAGIC,8);
+    int version = CONFIG_SNAPSHOT_VERSION;
+    appendData(data,&version,sizeof(int));
+
+    unsigned char full = base ? 0 : 1;
+    appendData(data,&full,sizeof(unsigned char));
+    if(full)
+    {
+        std::vector<char> snapshot;
+        write(snapshot);
+        data.insert(data.end(),snapshot.begin(),snapshot.end());
+        return;
+    }
+
+    unsigned long long baseHash = base->getHash();
+    appendData(data,&baseHash,sizeof(unsigned long long));
+
+    int baseCount = base->_tags.size();
+    int count = _tags.size();
+    int delta = count - baseCount;
+
+    // unchanged tags at the start
+    int start = 0;
+    while(start < baseCount && start < count
+            && _tags[start].parent == base->_tags[start].parent
+            && tagEqual(_tags[start],base->_tags[start]))
+    {
+        start++;
+    }
+
+    // unchanged tags at the end, parents past the start move with the tags
+    int baseEnd = baseCount;
+    while(baseEnd > start && baseEnd + delta > start)
+    {
+        const Tag & baseTag = base->_tags[baseEnd - 1];
+        const Tag & tag = _tags[baseEnd - 1 + delta];
+        int parent =
+                baseTag.parent < start ? baseTag.parent : baseTag.parent + delta;
+        if(tag.parent != parent || !tagEqual(tag,baseTag))
+        {
+            break;
+        }
+        baseEnd--;
+    }
+
+    int changed = baseEnd + delta - start;
+    appendData(data,&baseCount,sizeof(int));
+    appendData(data,&start,sizeof(int));
+    appendData(data,&baseEnd,sizeof(int));
+    appendData(data,&changed,sizeof(int));
+    for(int i = start; i < start + changed; i++)
+    {
+        appendTag(data,_tags[i].parent,_tags[i].name,_tags[i].attributes);
+    }
+
+    appendString(data,_key);
+    unsigned int files = _sourceFiles.size();
+    appendData(data,&files,sizeof(unsigned int));
+    for(int i = 0; i < _sourceFiles.size(); i++)
+    {
+        appendString(data,_sourceFiles[i].file);
+        appendData(data,&_sourceFiles[i].hash,sizeof(unsigned long long));
+    }
+}
+
+bool ConfigSnapshot::applyUpdate(const char * data, int size)
+{
+    DataReader reader;
+    reader.data = data;
+    reader.size = size;
+    reader.pos = 0;
+
+    char magic[8];
+    int version;
+    unsigned char full;
+    if(!reader.read(magic,8) || strncmp(magic,CONFIG_UPDATE_MAGIC,8)
+            || !reader.read(&version,sizeof(int))
+            || version != CONFIG_SNAPSHOT_VERSION
+            || !reader.read(&full,sizeof(unsigned char)))
+    {
+        std::cerr << "ConfigSnapshot: Error: data is not a config update."
+                << std::endl;
+        return false;
+    }
+
+    if(full)
+    {
+        return read(data + reader.pos,size - reader.pos);
+    }
+
+    unsigned long long baseHash;
+    int baseCount, start, baseEnd, changed;
+    if(!reader.read(&baseHash,sizeof(unsigned long long))
+            || !reader.read(&baseCount,sizeof(int))
+            || !reader.read(&start,sizeof(int))
+            || !reader.read(&baseEnd,sizeof(int))
+            || !reader.read(&changed,sizeof(int)))
+    {
+        std::cerr << "ConfigSnapshot: Error: config update is truncated."
+                << std::endl;
+        return false;
+    }
+
+    if(baseCount != _tags.size() || baseHash != getHash())
+    {
+        std::cerr << "ConfigSnapshot: Error: config update was made from a "
+                << "different snapshot." << std::endl;
+        return false;
+    }
+
+    if(start < 0 || start > baseEnd || baseEnd > baseCount || changed < 0)
+    {
+        std::cerr << "ConfigSnapshot: Error: invalid config update."
+                << std::endl;
+        return false;
+    }
+
+    int delta = start + changed - baseEnd;
+
+    std::vector<Tag> tags(_tags.begin(),_tags.begin() + start);
+    bool ok = true;
+    for(int i = 0; ok && i < changed; i++)
+    {
+        Tag tag;
+        ok = reader.readTag(tag.parent,tag.name,tag.attributes)
+                && tag.parent < start + i;
+        tags.push_back(tag);
+    }
+
+    for(int i = baseEnd; ok && i < baseCount; i++)
+    {
+        tags.push_back(_tags[i]);
+        if(tags.back().parent >= start)
+        {
+            tags.back().parent += delta;
+        }
+    }
+
+    std::string key;
+    unsigned int files = 0;
+    std::vector<SourceFile> sourceFiles;
+    ok = ok && reader.readString(key)
+            && reader.read(&files,sizeof(unsigned int));
+    for(unsigned int i = 0; ok && i < files; i++)
+    {
+        SourceFile sf;
+        ok = reader.readString(sf.file)
+                && reader.read(&sf.hash,sizeof(unsigned long long));
+        sourceFiles.push_back(sf);
+    }
+
+    if(!ok)
+    {
+        std::cerr << "ConfigSnapshot: Error: config update is truncated."
+                << std::endl;
+        return false;
+    }
+
+    _key = key;
+    _sourceFiles.swap(sourceFiles);
+    _tags.swap(tags);
+    return true;
+}
+
+bool ConfigSnapshot::writeFile(const std::string & file)
+{
+    std::vector<char> data;
+    write(data);
+
+    FILE * fp = fopen(file.c_str(),"wb");
+    if(!fp)
+    {
+        std::cerr << "ConfigSnapshot: Error: unable to open file: " << file
+                << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(&data[0],1,data.size(),fp) == data.size();
+    fclose(fp);
+
+    if(!ok)
+    {
+        std::cerr << "ConfigSnapshot: Error: unable to write file: " << file
+                << std::endl;
+        remove(file.c_str());
+    }
+    return ok;
+}
+
+bool ConfigSnapshot::readFile(const std::string & file)
+{
+    FILE * fp = fopen(file.c_str(),"rb");
+    if(!fp)
+    {
+        return false;
+    }
+
+    std::vector<char> data;
+    char buffer[65536];
+    size_t bytes;
+    while((bytes = fread(buffer,1,sizeof(buffer),fp)) > 0)
+    {
+        data.insert(data.end(),buffer,buffer + bytes);
+    }
+    fclose(fp);
+
+    if(data.empty())
+    {
+        return false;
+    }
+
+    return read(&data[0],data.size());
+}
+
+bool ConfigSnapshot::hostMatches(const std::string & hosts,
+        const std::string & host)
+{
+    if(hosts.empty() || host.empty())
+    {
+        return false;
+    }
+
+    size_t startpos = 0;
+    while((startpos = hosts.find(host,startpos)) != std::string::npos)
+    {
+        if((startpos == 0 || hosts[startpos - 1] == ',')
+                && (startpos + host.length() == hosts.length()
+                        || hosts[startpos + host.length()] == ','))
+        {
+            return true;
+        }
+        startpos++;
+    }
+    return false;
+}
+
+bool ConfigSnapshot::hashFile(const std::string & file,
+        unsigned long long & hash)
+{
+    FILE * fp = fopen(file.c_str(),"rb");
+    if(!fp)
+    {
+        return false;
+    }
+
+    hash = hashData(NULL,0);
+    unsigned char buffer[65536];
+    size_t bytes;
+    while((bytes = fread(buffer,1,sizeof(buffer),fp)) > 0)
+    {
+        hash = hashData(buffer,bytes,hash);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool ConfigSnapshot::tagEqual(const Tag & first, const Tag & second)
+{
+    return first.name == second.name && first.attributes == second.attributes;
+}
+
+void ConfigSnapshot::addTags(ConfigIndex * index,
+        const std::vector<std::vector<int> > & children,
+        const std::vector<int> & tags, int parent, const std::string & host)
+{
+    // the children of a LOCAL block for this host are moved to the end of
+    // its parent, the same as when the file is parsed on the host
+    std::vector<int> localBlocks;
+
+    for(int i = 0; i < tags.size(); i++)
+    {
+        const Tag & tag = _tags[tags[i]];
+        if(tag.name == "LOCAL")
+        {
+            for(int j = 0; j < tag.attributes.size(); j++)
+            {
+                if(tag.attributes[j].first == "host")
+                {
+                    if(hostMatches(tag.attributes[j].second,host))
+                    {
+                        localBlocks.push_back(tags[i]);
+                    }
+                    break;
+                }
+            }
+            continue;
+        }
+
+        int indexTag = index->addTag(parent,tag.name);
+        for(int j = 0; j < tag.attributes.size(); j++)
+        {
+            index->addAttribute(indexTag,tag.attributes[j].first,
+                    tag.attributes[j].second);
+        }
+        addTags(index,children,children[tags[i]],indexTag,host);
+    }
+
+    for(int i = 0; i < localBlocks.size(); i++)
+    {
+        addTags(index,children,children[localBlocks[i]],parent,host);
+    }
+}
@@ -1,5 +1,6 @@
 #include <cvrConfig/XMLReader.h>
 #include <cvrConfig/ConfigManager.h>
+#include <cvrConfig/ConfigSnapshot.h>
 #include <cvrKernel/CalVR.h>
 
 #include <iostream>
@@ -14,9 +15,81 @@
 
 using namespace cvr;
 
+namespace
+{
+
+void flattenTags(ConfigSnapshot * snapshot, mxml_node_t * xmlNode, int parent)
+{
+    for(; xmlNode; xmlNode = xmlNode->next)
+    {
+        // skip text and comment tags, lookups never match them
+        if(xmlNode->type != MXML_ELEMENT
+                || !strncmp(xmlNode->value.element.name,"!--",3))
+        {
+            continue;
+        }
+
+        int tag = snapshot->addTag(parent,xmlNode->value.element.name);
+        for(int i = 0; i < xmlNode->value.element.num_attrs; i++)
+        {
+            snapshot->addAttribute(tag,xmlNode->value.element.attrs[i].name,
+                    xmlNode->value.element.attrs[i].value ?
+                            xmlNode->value.element.attrs[i].value : "");
+        }
+        flattenTags(snapshot,xmlNode->child,tag);
+    }
+}
+
+// an INCLUDE inside kept LOCAL blocks only applies to those hosts, so the
+// included file is moved into the same LOCAL blocks
+void wrapInLocalBlocks(mxml_node_t * include, mxml_node_t * root)
+{
+    std::vector<const char *> hosts;
+    for(mxml_node_t * node = include->parent; node; node = node->parent)
+    {
+        if(node->type == MXML_ELEMENT
+                && !strcmp(node->value.element.name,"LOCAL"))
+        {
+            hosts.push_back(mxmlElementGetAttr(node,"host"));
+        }
+    }
+
+    if(hosts.empty())
+    {
+        return;
+    }
+
+    mxml_node_t * outer = NULL;
+    mxml_node_t * inner = NULL;
+    for(int i = hosts.size() - 1; i >= 0; i--)
+    {
+        inner = mxmlNewElement(inner ? inner : MXML_NO_PARENT,"LOCAL");
+        if(hosts[i])
+        {
+            mxmlElementSetAttr(inner,"host",hosts[i]);
+        }
+        if(!outer)
+        {
+            outer = inner;
+        }
+    }
+
+    mxml_node_t * tempnode = root->child;
+    while(tempnode)
+    {
+        mxmlRemove(tempnode);
+        mxmlAdd(inner,MXML_ADD_AFTER,NULL,tempnode);
+        tempnode = root->child;
+    }
+    mxmlAdd(root,MXML_ADD_AFTER,NULL,outer);
+}
+
+}
+
 XMLReader::XMLReader() :
         ConfigFileReader()
 {
+    _keepLocalBlocks = false;
 }
 
 XMLReader::~XMLReader()
@@ -50,7 +123,9 @@ bool XMLReader::loadFile(std::string file, bool givePriority)
             std::cerr << "Unable to open file: " << file << std::endl;
             return false;
         }
+        cfile = file;
     }
+    _sourceFiles.push_back(cfile);
     tree = mxmlLoadFile(NULL,fp,MXML_TEXT_CALLBACK);
     fclose(fp);
 
@@ -85,47 +160,24 @@ bool XMLReader::loadFile(std::string file, bool givePriority)
         }
     }
 
-    while((xmlNode = mxmlFindElement(tree,tree,"LOCAL",NULL,NULL,MXML_DESCEND)))
+    while(!_keepLocalBlocks
+            && (xmlNode = mxmlFindElement(tree,tree,"LOCAL",NULL,NULL,
+                    MXML_DESCEND)))
     {
         if(xmlNode->parent)
         {
-            std::string blockHost;
             const char * attr = mxmlElementGetAttr(xmlNode,"host");
 
-            std::string myHost = CalVR::instance()->getHostName();
-
-            if(attr && !myHost.empty() && attr[0] != '\0')
+            if(attr
+                    && ConfigSnapshot::hostMatches(attr,
+                            CalVR::instance()->getHostName()))
             {
-                blockHost = attr;
-                bool hostfound = false;
-                size_t startpos = 0;
-
-                while((startpos = blockHost.find(myHost,startpos))
-                        != std::string::npos)
-                {
-                    if((startpos == 0 || blockHost[startpos - 1] == ',')
-                            && (startpos + myHost.length() == blockHost.length()
-                                    || blockHost[startpos + myHost.length()]
-                                            == ','))
-                    {
-                        hostfound = true;
-                        break;
-                    }
-                    else
-                    {
-                        startpos++;
-                    }
-                }
-
-                if(hostfound)
+                mxml_node_t * tempnode = xmlNode->child;
+                while(tempnode)
                 {
-                    mxml_node_t * tempnode = xmlNode->child;
-                    while(tempnode)
-                    {
-                        mxmlRemove(tempnode);
-                        mxmlAdd(xmlNode->parent,MXML_ADD_AFTER,NULL,tempnode);
-                        tempnode = xmlNode->child;
-                    }
+                    mxmlRemove(tempnode);
+                    mxmlAdd(xmlNode->parent,MXML_ADD_AFTER,NULL,tempnode);
+                    tempnode = xmlNode->child;
                 }
             }
             mxmlDelete(xmlNode);
@@ -149,10 +201,18 @@ bool XMLReader::loadFile(std::string file, bool givePriority)
             {
                 if(tempnode->type == MXML_TEXT)
                 {
+                    int firstRoot = _configRootList.size();
                     if(!loadFile(tempnode->value.text.string))
                     {
                         return false;
                     }
+                    if(_keepLocalBlocks)
+                    {
+                        for(int i = firstRoot; i < _configRootList.size(); i++)
+                        {
+                            wrapInLocalBlocks(xmlNode,_configRootList[i]);
+                        }
+                    }
                     break;
                 }
                 tempnode = tempnode->next;
@@ -169,6 +229,29 @@ bool XMLReader::loadFile(std::string file, bool givePriority)
     return true;
 }
 
+bool XMLReader::flatten(ConfigSnapshot * snapshot)
+{
+    for(int i = 0; i < _sourceFiles.size(); i++)
+    {
+        if(!snapshot->addSourceFile(_sourceFiles[i]))
+        {
+            std::cerr << "Unable to read config file: " << _sourceFiles[i]
+                    << std::endl;
+            return false;
+        }
+    }
+
+    // each file root is a tag, lookups start at its children
+    for(int i = 0; i < _configRootList.size(); i++)
+    {
+        int root = snapshot->addTag(-1,
+                _configRootList[i]->type == MXML_ELEMENT ?
+                        _configRootList[i]->value.element.name : "");
+        flattenTags(snapshot,_configRootList[i]->child,root);
+    }
+    return true;
+}
+
 std::string XMLReader::getEntry(std::string path, std::string def, bool * found)
 {
     return getEntry("value",path,def,found);
@@ -78,6 +78,26 @@ void TrackerSlave::update(
 {
 }
 
+void TrackerSlave::writeSnapshot(TrackedBody * bodies, int numBodies,
+        unsigned int * buttonMask, float * vals, int numVals)
+{
+    if(numBodies != _numBodies || numVals != _numVals)
+    {
+        TrackerBase::writeSnapshot(bodies,numBodies,buttonMask,vals,numVals);
+        return;
+    }
+
+    if(_numBodies)
+    {
+        memcpy(bodies,_bodyArray,_numBodies * sizeof(struct TrackedBody));
+    }
+    *buttonMask = _buttonMask;
+    if(_numVals)
+    {
+        memcpy(vals,_valArray,_numVals * sizeof(float));
+    }
+}
+
 void TrackerSlave::readValues(TrackedBody * tb, unsigned int * buttons,
         float * vals)
 {
@@ -17,11 +17,19 @@
 #include <cvrKernel/ComController.h>
 #include <cvrKernel/InteractionManager.h>
 
+#include <OpenThreads/ScopedLock>
+
 #include <iostream>
 #include <sstream>
+#include <cstring>
+#include <cmath>
+#include <cerrno>
+#include <ctime>
 
 #include <osg/Vec3>
 #include <osg/Vec4>
+#include <osg/Quat>
+#include <osg/Timer>
 
 #ifdef WIN32
 #define M_PI 3.141592653589793238462643
@@ -36,6 +44,48 @@
 
 using namespace cvr;
 
+namespace
+{
+
+// time in seconds on a clock that does not jump with wall time changes
+double getMonotonicTime()
+{
+#ifndef WIN32
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((double)ts.tv_sec) + ((double)ts.tv_nsec) / 1000000000.0;
+#else
+    return osg::Timer::instance()->time_s();
+#endif
+}
+
+void sleepUntil(double deadline)
+{
+#ifndef WIN32
+    timespec ts;
+    ts.tv_sec = (time_t)deadline;
+    ts.tv_nsec = (long int)((deadline - ((double)ts.tv_sec)) * 1000000000.0);
+    while(clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR)
+    {
+    }
+#else
+    //TODO: do this sub-milisecond
+    double interval = deadline - getMonotonicTime();
+    if(interval > 0.0)
+    {
+        Sleep((DWORD)(interval * 1000.0));
+    }
+#endif
+}
+
+unsigned int toMicroseconds(double time)
+{
+    // truncated to 32 bits, only differences are used
+    return (unsigned int)((unsigned long long)(time * 1000000.0));
+}
+
+}
+
 struct TrackingSystemInit
 {
         Navigation::NavImplementation nav;
@@ -48,15 +98,31 @@ struct TrackingSystemInit
 
 TrackingManager * TrackingManager::_myPtr = NULL;
 
-TrackingManager::TrackingManager()
+TrackingManager::TrackingManager() :
+        _threadPendingIndex(1)
 {
     _debugOutput = false;
     _threadQuit = false;
     genComTrackEvents = NULL;
+    _snapshot[0].data = _snapshot[1].data = NULL;
+    _snapshotIndex = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        _threadState[i].snapshot.data = NULL;
+    }
+    _threadWriteIndex = 0;
+    _threadReadIndex = 2;
+    _threadPhaseLock = false;
+    _threadPhaseOffset = 0.0;
+    _predict = false;
+    _predictionTime = 0.0;
+    _predictionMax = 0.0;
 }
 
 TrackingManager::~TrackingManager()
 {
+    ConfigManager::removeChangeCallback(this);
+
     if(ComController::instance()->isMaster() && isThreaded())
     {
         quitThread();
@@ -73,6 +139,22 @@ TrackingManager::~TrackingManager()
         delete _systemInfo[i];
     }
 
+    for(int i = 0; i < 2; i++)
+    {
+        if(_snapshot[i].data)
+        {
+            delete[] _snapshot[i].data;
+        }
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        if(_threadState[i].snapshot.data)
+        {
+            delete[] _threadState[i].snapshot.data;
+        }
+    }
+
     for(int i = 0; i < _systems.size(); i++)
     {
         if(_systems[i])
@@ -116,40 +198,7 @@ bool TrackingManager::init()
         tsi->numVal = ConfigManager::getInt("value",configStr + ".NumValuators",
                 0);
 
-        float x, y, z, h, p, r;
-        x = ConfigManager::getFloat("x",configStr + ".Offset",0.0);
-        y = ConfigManager::getFloat("y",configStr + ".Offset",0.0);
-        z = ConfigManager::getFloat("z",configStr + ".Offset",0.0);
-        h = ConfigManager::getFloat("h",configStr + ".Orientation",0.0);
-        p = ConfigManager::getFloat("p",configStr + ".Orientation",0.0);
-        r = ConfigManager::getFloat("r",configStr + ".Orientation",0.0);
-        osg::Matrix m;
-        m.makeRotate(r * M_PI / 180.0,osg::Vec3(0,1,0),p * M_PI / 180.0,
-                osg::Vec3(1,0,0),h * M_PI / 180.0,osg::Vec3(0,0,1));
-        m.setTrans(osg::Vec3(x,y,z));
-        tsi->systemTransform = m;
-
-        for(int i = 0; i < tsi->numBodies; i++)
-        {
-            std::stringstream bodyss;
-            bodyss << ".Body" << i;
-            x = ConfigManager::getFloat("x",
-                    configStr + bodyss.str() + ".Offset",0.0);
-            y = ConfigManager::getFloat("y",
-                    configStr + bodyss.str() + ".Offset",0.0);
-            z = ConfigManager::getFloat("z",
-                    configStr + bodyss.str() + ".Offset",0.0);
-            h = ConfigManager::getFloat("h",
-                    configStr + bodyss.str() + ".Orientation",0.0);
-            p = ConfigManager::getFloat("p",
-                    configStr + bodyss.str() + ".Orientation",0.0);
-            r = ConfigManager::getFloat("r",
-                    configStr + bodyss.str() + ".Orientation",0.0);
-            m.makeRotate(r * M_PI / 180.0,osg::Vec3(0,1,0),p * M_PI / 180.0,
-                    osg::Vec3(1,0,0),h * M_PI / 180.0,osg::Vec3(0,0,1));
-            tsi->bodyTranslations.push_back(osg::Vec3(x,y,z));
-            tsi->bodyRotations.push_back(m);
-        }
+        readSystemTransforms(configStr,tsi);
 
         TrackingSystemInit trackInit;
         TrackerBase * tracker;
@@ -270,8 +319,28 @@ bool TrackingManager::init()
     if(_threaded)
     {
         _threadFPS = ConfigManager::getFloat("FPS","Input.Threaded",60.0);
+
+        int queueSize = ConfigManager::getInt("eventQueueSize",
+                "Input.Threaded",1024);
+        int ringSize = 16;
+        while(ringSize < queueSize)
+        {
+            ringSize = ringSize << 1;
+        }
+        _threadEventRing.resize(ringSize,NULL);
+
+        _threadPhaseLock = ConfigManager::getBool("phaseLock","Input.Threaded",
+                false,NULL);
+        _threadPhaseOffset = ConfigManager::getDouble("phaseOffset",
+                "Input.Threaded",0.0) / 1000.0;
     }
 
+    _predict = ConfigManager::getBool("value","Input.Prediction",false,NULL);
+    _predictionTime = ConfigManager::getDouble("time","Input.Prediction",16.0)
+            / 1000.0;
+    _predictionMax = ConfigManager::getDouble("max","Input.Prediction",50.0)
+            / 1000.0;
+
     _numHands = ConfigManager::getInt("Input.NumHands",1);
     _numHeads = ConfigManager::getInt("Input.NumHeads",1);
     if(_numHands < 0)
@@ -402,6 +471,7 @@ bool TrackingManager::init()
         _eventValuators.push_back(std::vector<float>());
         _eventValuatorTime.push_back(std::vector<double>());
         _lastEventValuators.push_back(std::map<int,float>());
+        _threadLastEventValuators.push_back(std::map<int,float>());
         _numEventValuators.push_back(0);
 
         valFound = false;
@@ -492,6 +562,85 @@ bool TrackingManager::init()
         _rawButtonMask.push_back(0);
     }
 
+    for(int i = 0; i < _systemInfo.size(); i++)
+    {
+        _systemBodyOffset.push_back(
+                i ? _systemBodyOffset[i - 1] + _systemInfo[i - 1]->numBodies :
+                        0);
+        _systemValOffset.push_back(
+                i ? _systemValOffset[i - 1] + _systemInfo[i - 1]->numVal : 0);
+        _systemSampleTime.push_back(0.0);
+        _lastSampleTime.push_back(0.0);
+        _prevSampleTime.push_back(0.0);
+    }
+
+    _zeroBody.x = _zeroBody.y = _zeroBody.z = 0.0;
+    _zeroBody.qx = _zeroBody.qy = _zeroBody.qz = 0.0;
+    _zeroBody.qw = 1.0;
+
+    _lastSampleBodies.resize(_totalBodies,_zeroBody);
+    _prevSampleBodies.resize(_totalBodies,_zeroBody);
+
+    // bodies, button masks and valuators each packed in their own array,
+    // sent to the render nodes as one block
+    for(int i = 0; i < 2; i++)
+    {
+        TrackingSnapshot & snapshot = _snapshot[i];
+        snapshot.dataSize = _totalBodies
+                * sizeof(struct TrackerBase::TrackedBody)
+                + _systemInfo.size() * sizeof(unsigned int)
+                + _totalValuators * sizeof(float)
+                + _systemInfo.size() * sizeof(float);
+        snapshot.data = snapshot.dataSize ? new char[snapshot.dataSize] : NULL;
+        snapshot.bodies = (TrackerBase::TrackedBody*)snapshot.data;
+        snapshot.buttons = (unsigned int *)(snapshot.data
+                + _totalBodies * sizeof(struct TrackerBase::TrackedBody));
+        snapshot.valuators = (float *)(((char*)snapshot.buttons)
+                + _systemInfo.size() * sizeof(unsigned int));
+        snapshot.sampleTimes = snapshot.valuators + _totalValuators;
+        for(int j = 0; j < _totalBodies; j++)
+        {
+            snapshot.bodies[j] = _zeroBody;
+        }
+        for(int j = 0; j < _systemInfo.size(); j++)
+        {
+            snapshot.buttons[j] = 0;
+        }
+        for(int j = 0; j < _totalValuators; j++)
+        {
+            snapshot.valuators[j] = 0.0;
+        }
+        for(int j = 0; j < _systemInfo.size(); j++)
+        {
+            snapshot.sampleTimes[j] = 0.0;
+        }
+    }
+    _snapshotIndex = 0;
+
+    // same layout for the thread's triple buffer, with the thread's hand
+    // button masks at the end
+    for(int i = 0; i < 3; i++)
+    {
+        TrackingSnapshot & snapshot = _threadState[i].snapshot;
+        snapshot.dataSize = _snapshot[0].dataSize;
+        int handMaskSize = _numHands * sizeof(unsigned int);
+        snapshot.data = new char[snapshot.dataSize + handMaskSize];
+        if(snapshot.dataSize)
+        {
+            memcpy(snapshot.data,_snapshot[0].data,snapshot.dataSize);
+        }
+        memset(snapshot.data + snapshot.dataSize,0,handMaskSize);
+        snapshot.bodies = (TrackerBase::TrackedBody*)snapshot.data;
+        snapshot.buttons = (unsigned int *)(snapshot.data
+                + _totalBodies * sizeof(struct TrackerBase::TrackedBody));
+        snapshot.valuators = (float *)(((char*)snapshot.buttons)
+                + _systemInfo.size() * sizeof(unsigned int));
+        snapshot.sampleTimes = snapshot.valuators + _totalValuators;
+        _threadState[i].handButtonMasks = (unsigned int *)(snapshot.data
+                + snapshot.dataSize);
+        _threadState[i].sampleTimes.resize(_systemInfo.size(),0.0);
+    }
+
     float vx, vy, vz, vh, vp, vr;
     osg::Matrix vTrans, vRot;
     //if(_numHeads)
@@ -537,6 +686,7 @@ bool TrackingManager::init()
     for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
     {
         _eventMap[i] = std::list<InteractionEvent*>();
+        _threadEventMap[i] = std::list<InteractionEvent*>();
     }
 
     setHandButtonMaps();
@@ -552,6 +702,8 @@ bool TrackingManager::init()
         printInitDebug();
     }
 
+    ConfigManager::addChangeCallback(this);
+
     return true;
 }
 
@@ -578,100 +730,86 @@ void TrackingManager::update()
                 osg::Timer::instance()->tick());
     }
 
-    _updateLock.lock();
-
-    int totalData = _totalBodies * sizeof(struct TrackerBase::TrackedBody)
-            + _systemInfo.size() * sizeof(unsigned int)
-            + _totalValuators * sizeof(float);
-    char * data = NULL;
-    if(totalData)
-    {
-        data = new char[totalData];
-    }
+    // swap snapshots, the last frame's state stays in the other buffer
+    _snapshotIndex = 1 - _snapshotIndex;
+    TrackingSnapshot & snapshot = _snapshot[_snapshotIndex];
 
     //std::cerr << "Update Called." << std::endl;
     if(ComController::instance()->isMaster())
     {
-        static TrackerBase::TrackedBody * zeroBody = NULL;
-        if(!zeroBody)
+        // frame start on the monotonic clock
+        double frameStart = getMonotonicTime()
+                - (osg::Timer::instance()->delta_s(
+                        CVRViewer::instance()->getStartTick(),
+                        osg::Timer::instance()->tick())
+                        - CVRViewer::instance()->getProgramDuration());
+
+        if(_threaded)
         {
-            zeroBody = new TrackerBase::TrackedBody;
-            zeroBody->x = 0;
-            zeroBody->y = 0;
-            zeroBody->z = 0;
-            osg::Quat q;
-            zeroBody->qx = q.x();
-            zeroBody->qy = q.y();
-            zeroBody->qz = q.z();
-            zeroBody->qw = q.w();
-        }
-
-        TrackerBase::TrackedBody * tbptr = (TrackerBase::TrackedBody*)data;
-        unsigned int * buttonptr = (unsigned int *)(data
-                + (_totalBodies * sizeof(struct TrackerBase::TrackedBody)));
-        float * valptr = (float *)(data
-                + (_totalBodies * sizeof(struct TrackerBase::TrackedBody)
-                        + _systemInfo.size() * sizeof(unsigned int)));
+            updateThreadPhase(frameStart);
+            readThreadState();
+            readThreadEvents();
+        }
+
+        TrackerBase::TrackedBody * tbptr = snapshot.bodies;
+        unsigned int * buttonptr = snapshot.buttons;
+        float * valptr = snapshot.valuators;
         for(int i = 0; i < _systems.size(); i++)
         {
             if(_systems[i])
             {
+                // threaded systems were filled in from the thread's state
                 if(!_systemInfo[i]->thread)
                 {
                     _systems[i]->update(_eventMap);
+                    _systemSampleTime[i] = getMonotonicTime();
+                    _systems[i]->writeSnapshot(tbptr,
+                            _systemInfo[i]->numBodies,buttonptr,valptr,
+                            _systemInfo[i]->numVal);
                 }
-                for(int j = 0; j < _systemInfo[i]->numBodies; j++)
-                {
-                    TrackerBase::TrackedBody * tb = _systems[i]->getBody(j);
-                    if(tb)
-                    {
-                        *tbptr = *tb;
-                    }
-                    else
-                    {
-                        *tbptr = *zeroBody;
-                    }
-                    tbptr++;
-                }
-
-                *buttonptr = _systems[i]->getButtonMask();
-                buttonptr++;
-
-                for(int j = 0; j < _systemInfo[i]->numVal; j++)
-                {
-                    *valptr = _systems[i]->getValuator(j);
-                    valptr++;
-                }
+                snapshot.sampleTimes[i] = (float)(_systemSampleTime[i]
+                        - frameStart);
             }
             else
             {
                 for(int j = 0; j < _systemInfo[i]->numBodies; j++)
                 {
-                    *tbptr = *zeroBody;
-                    tbptr++;
+                    tbptr[j] = _zeroBody;
                 }
 
                 *buttonptr = 0;
-                buttonptr++;
 
                 for(int j = 0; j < _systemInfo[i]->numVal; j++)
                 {
-                    *valptr = 0.0;
-                    valptr++;
+                    valptr[j] = 0.0;
                 }
+
+                snapshot.sampleTimes[i] = 0.0;
             }
+            tbptr += _systemInfo[i]->numBodies;
+            buttonptr++;
+            valptr += _systemInfo[i]->numVal;
         }
-        ComController::instance()->sendSlaves(data,totalData);
+
+        if(_predict)
+        {
+            predictBodies(frameStart);
+        }
+
+        ComController::instance()->addFrameSyncSection(
+                ComController::FSS_TRACKING_DATA,snapshot.data,
+                snapshot.dataSize);
     }
     else
     {
-        ComController::instance()->readMaster(data,totalData);
-        TrackerBase::TrackedBody * tbptr = (TrackerBase::TrackedBody*)data;
-        unsigned int * buttonptr = (unsigned int *)(data
-                + (_totalBodies * sizeof(struct TrackerBase::TrackedBody)));
-        float * valptr = (float *)(data
-                + (_totalBodies * sizeof(struct TrackerBase::TrackedBody)
-                        + _systemInfo.size() * sizeof(unsigned int)));
+        // reports a size mismatch and flags it as a sync error
+        ComController::instance()->readFrameSyncSection(
+                ComController::FSS_TRACKING_DATA,snapshot.data,
+                snapshot.dataSize);
+
+        TrackerBase::TrackedBody * tbptr = snapshot.bodies;
+        unsigned int * buttonptr = snapshot.buttons;
+        float * valptr = snapshot.valuators;
 
         for(int i = 0; i < _systems.size(); i++)
         {
@@ -687,11 +825,8 @@ void TrackingManager::update()
         }
     }
 
-    if(data)
-    {
-        delete[] data;
-    }
-
+    // all values come from the snapshot so threaded trackers are never read
+    // while the tracking thread is polling them
     TrackerBase::TrackedBody * tb;
     for(int i = 0; i < _numHeads; i++)
     {
@@ -701,28 +836,25 @@ void TrackingManager::update()
             continue;
         }
 
-        if(_systems[_headAddress[i].first]
-                && _systems[_headAddress[i].first]->getBody(
-                        _headAddress[i].second))
+        if(_systems[_headAddress[i].first] && _headAddress[i].second >= 0
+                && _headAddress[i].second
+                        < _systemInfo[_headAddress[i].first]->numBodies)
         {
-            tb = _systems[_headAddress[i].first]->getBody(
-                    _headAddress[i].second);
-            if(tb)
+            tb = snapshot.bodies + _systemBodyOffset[_headAddress[i].first]
+                    + _headAddress[i].second;
+            osg::Vec3 pos(tb->x,tb->y,tb->z);
+            osg::Matrix rot;
+            rot.makeRotate(osg::Quat(tb->qx,tb->qy,tb->qz,tb->qw));
+            _headMatList[i] =
+                    _systemInfo[_headAddress[i].first]->bodyRotations[_headAddress[i].second]
+                            * rot * osg::Matrix::translate(pos)
+                            * _systemInfo[_headAddress[i].first]->systemTransform
+                            * osg::Matrix::translate(
+                                    _systemInfo[_headAddress[i].first]->bodyTranslations[_headAddress[i].second]);
+
+            if(_updateHeadTracking)
             {
-                osg::Vec3 pos(tb->x,tb->y,tb->z);
-                osg::Matrix rot;
-                rot.makeRotate(osg::Quat(tb->qx,tb->qy,tb->qz,tb->qw));
-                _headMatList[i] =
-                        _systemInfo[_headAddress[i].first]->bodyRotations[_headAddress[i].second]
-                                * rot * osg::Matrix::translate(pos)
-                                * _systemInfo[_headAddress[i].first]->systemTransform
-                                * osg::Matrix::translate(
-                                        _systemInfo[_headAddress[i].first]->bodyTranslations[_headAddress[i].second]);
-
-                if(_updateHeadTracking)
-                {
-                    _lastUpdatedHeadMatList[i] = _headMatList[i];
-                }
+                _lastUpdatedHeadMatList[i] = _headMatList[i];
             }
         }
     }
@@ -735,24 +867,21 @@ void TrackingManager::update()
             continue;
         }
 
-        if(_systems[_handAddress[i].first]
-                && _systems[_handAddress[i].first]->getBody(
-                        _handAddress[i].second))
+        if(_systems[_handAddress[i].first] && _handAddress[i].second >= 0
+                && _handAddress[i].second
+                        < _systemInfo[_handAddress[i].first]->numBodies)
         {
-            tb = _systems[_handAddress[i].first]->getBody(
-                    _handAddress[i].second);
-            if(tb)
-            {
-                osg::Vec3 pos(tb->x,tb->y,tb->z);
-                osg::Matrix rot;
-                rot.makeRotate(osg::Quat(tb->qx,tb->qy,tb->qz,tb->qw));
-                _handMatList[i] =
-                        _systemInfo[_handAddress[i].first]->bodyRotations[_handAddress[i].second]
-                                * rot * osg::Matrix::translate(pos)
-                                * _systemInfo[_handAddress[i].first]->systemTransform
-                                * osg::Matrix::translate(
-                                        _systemInfo[_handAddress[i].first]->bodyTranslations[_handAddress[i].second]);
-            }
+            tb = snapshot.bodies + _systemBodyOffset[_handAddress[i].first]
+                    + _handAddress[i].second;
+            osg::Vec3 pos(tb->x,tb->y,tb->z);
+            osg::Matrix rot;
+            rot.makeRotate(osg::Quat(tb->qx,tb->qy,tb->qz,tb->qw));
+            _handMatList[i] =
+                    _systemInfo[_handAddress[i].first]->bodyRotations[_handAddress[i].second]
+                            * rot * osg::Matrix::translate(pos)
+                            * _systemInfo[_handAddress[i].first]->systemTransform
+                            * osg::Matrix::translate(
+                                    _systemInfo[_handAddress[i].first]->bodyTranslations[_handAddress[i].second]);
         }
     }
 
@@ -760,7 +889,7 @@ void TrackingManager::update()
     {
         if(_systems[i])
         {
-            _rawButtonMask[i] = _systems[i]->getButtonMask();
+            _rawButtonMask[i] = snapshot.buttons[i];
         }
         else
         {
@@ -774,7 +903,8 @@ void TrackingManager::update()
         {
             if(_systems[i])
             {
-                _valuatorList[i][j] = _systems[i]->getValuator(j);
+                _valuatorList[i][j] = snapshot.valuators[_systemValOffset[i]
+                        + j];
             }
             else
             {
@@ -790,13 +920,13 @@ void TrackingManager::update()
     flushEvents();
 
     // merge threaded and non-threaded hand masks
+    unsigned int * threadHandMasks =
+            _threadState[_threadReadIndex].handButtonMasks;
     for(int i = 0; i < _handButtonMask.size(); i++)
     {
-        _handButtonMask[i] |= _threadHandButtonMasks[i];
+        _handButtonMask[i] |= threadHandMasks[i];
     }
 
-    _updateLock.unlock();
-
     if(stats)
     {
         endTime = osg::Timer::instance()->delta_s(
@@ -816,22 +946,21 @@ void TrackingManager::update()
 
 void TrackingManager::run()
 {
-    struct timeval start, end;
-    float target = 1.0 / _threadFPS;
+    ThreadState * state;
+    double now = getMonotonicTime();
+    double deadline = now;
 
-    struct timeval printStart, printEnd;
+    double printStart = now;
     int readings = 0;
-    gettimeofday(&printStart,NULL);
     while(1)
     {
-        gettimeofday(&start,NULL);
-        _updateLock.lock();
-
+        state = &_threadState[_threadWriteIndex];
         for(int i = 0; i < _systems.size(); i++)
         {
             if(_systems[i] && _systemInfo[i]->thread)
             {
-                _systems[i]->update(_eventMap);
+                _systems[i]->update(_threadEventMap);
+                state->sampleTimes[i] = getMonotonicTime();
             }
         }
 
@@ -841,7 +970,8 @@ void TrackingManager::run()
         generateThreadValuatorEvents();
         generateThreadPositionEvents();
 
-        _updateLock.unlock();
+        publishThreadState();
+        queueThreadEvents();
 
         _quitLock.lock();
         if(_threadQuit)
@@ -850,41 +980,222 @@ void TrackingManager::run()
             break;
         }
         _quitLock.unlock();
-        gettimeofday(&end,NULL);
 
-        float interval = (end.tv_sec - start.tv_sec)
-                + ((end.tv_usec - start.tv_usec) / 1000000.0);
-        if(interval < target)
-        {
-#ifndef WIN32
-            timespec ts;
-            interval = target - interval;
-            ts.tv_sec = (int)interval;
-            interval -= ((float)((int)interval));
-            ts.tv_nsec = (long int)(interval * 1000000000.0 * 0.95);
-            nanosleep(&ts,NULL);
-#else
-            //TODO: do this sub-milisecond
-            interval = target - interval;
-            DWORD sleeptime = (DWORD)(interval * 1000.0 * 0.95);
-            Sleep(sleeptime);
-#endif
-        }
+        // sleep to an absolute deadline so the poll rate does not drift
+        now = getMonotonicTime();
+        deadline = getNextThreadDeadline(deadline,now);
+        sleepUntil(deadline);
         readings++;
 
         //TODO: add to debug
-        gettimeofday(&printEnd,NULL);
-        interval = (printEnd.tv_sec - printStart.tv_sec)
-                + ((printEnd.tv_usec - printStart.tv_usec) / 1000000.0);
-        if(interval > 10.0)
+        now = getMonotonicTime();
+        if(now - printStart > 10.0)
         {
-            printStart = printEnd;
-            //std::cerr << "Tracking FPS: " << ((float)readings) / interval << std::endl;
+            //std::cerr << "Tracking FPS: " << ((float)readings) / (now - printStart) << std::endl;
+            printStart = now;
             readings = 0;
         }
     }
 }
 
+void TrackingManager::updateThreadPhase(double frameStart)
+{
+    _threadFrameStart.exchange(toMicroseconds(frameStart));
+    _threadFramePeriod.exchange(
+            toMicroseconds(CVRViewer::instance()->getLastFrameDuration()));
+}
+
+double TrackingManager::getNextThreadDeadline(double last, double now)
+{
+    double period = 1.0 / _threadFPS;
+    unsigned int framePeriod = _threadFramePeriod;
+
+    if(_threadPhaseLock && framePeriod)
+    {
+        // put a whole number of polls in each frame, lined up so one lands
+        // the phase offset before each frame start
+        unsigned int sinceFrame = toMicroseconds(now)
+                - ((unsigned int)_threadFrameStart);
+        double anchor = now - (((double)sinceFrame) / 1000000.0)
+                - _threadPhaseOffset;
+        double frameTime = ((double)framePeriod) / 1000000.0;
+        int polls = (int)(frameTime / period + 0.5);
+        if(polls < 1)
+        {
+            polls = 1;
+        }
+        double step = frameTime / ((double)polls);
+        return anchor + (floor((now - anchor) / step) + 1.0) * step;
+    }
+
+    double next = last + period;
+    if(next <= now)
+    {
+        // skip missed deadlines instead of polling to catch up
+        next += (floor((now - next) / period) + 1.0) * period;
+    }
+    return next;
+}
+
+void TrackingManager::predictBodies(double frameStart)
+{
+    TrackingSnapshot & snapshot = _snapshot[_snapshotIndex];
+    double target = frameStart + _predictionTime;
+
+    for(int i = 0; i < _systems.size(); i++)
+    {
+        int numBodies = _systemInfo[i]->numBodies;
+        if(!_systems[i] || !numBodies)
+        {
+            continue;
+        }
+
+        TrackerBase::TrackedBody * bodies = snapshot.bodies
+                + _systemBodyOffset[i];
+        TrackerBase::TrackedBody * last =
+                &_lastSampleBodies[_systemBodyOffset[i]];
+        TrackerBase::TrackedBody * prev =
+                &_prevSampleBodies[_systemBodyOffset[i]];
+
+        // only count samples with new data, trackers may be polled faster than
+        // they report
+        if(memcmp(bodies,last,numBodies * sizeof(TrackerBase::TrackedBody)))
+        {
+            memcpy(prev,last,numBodies * sizeof(TrackerBase::TrackedBody));
+            memcpy(last,bodies,numBodies * sizeof(TrackerBase::TrackedBody));
+            _prevSampleTime[i] = _lastSampleTime[i];
+            _lastSampleTime[i] = _systemSampleTime[i];
+        }
+
+        double interval = _lastSampleTime[i] - _prevSampleTime[i];
+        double ahead = target - _lastSampleTime[i];
+        // no velocity yet, or the data is stale
+        if(_prevSampleTime[i] <= 0.0 || interval <= 0.0 || ahead <= 0.0
+                || ahead > _predictionMax)
+        {
+            continue;
+        }
+
+        double t = ahead / interval;
+        for(int j = 0; j < numBodies; j++)
+        {
+            bodies[j].x = last[j].x + (last[j].x - prev[j].x) * t;
+            bodies[j].y = last[j].y + (last[j].y - prev[j].y) * t;
+            bodies[j].z = last[j].z + (last[j].z - prev[j].z) * t;
+
+            osg::Quat q;
+            q.slerp(1.0 + t,
+                    osg::Quat(prev[j].qx,prev[j].qy,prev[j].qz,prev[j].qw),
+                    osg::Quat(last[j].qx,last[j].qy,last[j].qz,last[j].qw));
+            bodies[j].qx = q.x();
+            bodies[j].qy = q.y();
+            bodies[j].qz = q.z();
+            bodies[j].qw = q.w();
+        }
+    }
+}
+
+void TrackingManager::publishThreadState()
+{
+    ThreadState & state = _threadState[_threadWriteIndex];
+
+    for(int i = 0; i < _systems.size(); i++)
+    {
+        if(_systems[i] && _systemInfo[i]->thread)
+        {
+            _systems[i]->writeSnapshot(
+                    state.snapshot.bodies + _systemBodyOffset[i],
+                    _systemInfo[i]->numBodies,state.snapshot.buttons + i,
+                    state.snapshot.valuators + _systemValOffset[i],
+                    _systemInfo[i]->numVal);
+        }
+    }
+
+    for(int i = 0; i < _numHands; i++)
+    {
+        state.handButtonMasks[i] = _threadHandButtonMasks[i];
+    }
+
+    // the increment is a full barrier, so the state writes are visible
+    // before the buffer is swapped in as the pending one
+    ++_threadStateSerial;
+    unsigned int last = _threadPendingIndex.exchange(
+            _threadWriteIndex | THREAD_STATE_FRESH);
+    _threadWriteIndex = last & ~THREAD_STATE_FRESH;
+}
+
+void TrackingManager::readThreadState()
+{
+    if(_threadPendingIndex & THREAD_STATE_FRESH)
+    {
+        unsigned int last = _threadPendingIndex.exchange(_threadReadIndex);
+        _threadReadIndex = last & ~THREAD_STATE_FRESH;
+    }
+
+    TrackingSnapshot & snapshot = _snapshot[_snapshotIndex];
+    TrackingSnapshot & threadSnapshot =
+            _threadState[_threadReadIndex].snapshot;
+    for(int i = 0; i < _systems.size(); i++)
+    {
+        if(!_systems[i] || !_systemInfo[i]->thread)
+        {
+            continue;
+        }
+
+        memcpy(snapshot.bodies + _systemBodyOffset[i],
+                threadSnapshot.bodies + _systemBodyOffset[i],
+                _systemInfo[i]->numBodies
+                        * sizeof(struct TrackerBase::TrackedBody));
+        snapshot.buttons[i] = threadSnapshot.buttons[i];
+        memcpy(snapshot.valuators + _systemValOffset[i],
+                threadSnapshot.valuators + _systemValOffset[i],
+                _systemInfo[i]->numVal * sizeof(float));
+        _systemSampleTime[i] = _threadState[_threadReadIndex].sampleTimes[i];
+    }
+}
+
+void TrackingManager::queueThreadEvents()
+{
+    unsigned int mask = _threadEventRing.size() - 1;
+    unsigned int tail = _threadEventTail;
+    unsigned int head = _threadEventHead;
+
+    for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
+    {
+        std::list<InteractionEvent*> & events = _threadEventMap[i];
+        while(events.size())
+        {
+            // ring full, keep the rest for the next poll
+            if(tail - head > mask)
+            {
+                return;
+            }
+
+            _threadEventRing[tail & mask] = events.front();
+            events.pop_front();
+            tail++;
+            // publish the slot, the increment is a full barrier
+            ++_threadEventTail;
+        }
+    }
+}
+
+void TrackingManager::readThreadEvents()
+{
+    unsigned int mask = _threadEventRing.size() - 1;
+    unsigned int head = _threadEventHead;
+    unsigned int tail = _threadEventTail;
+
+    while(head != tail)
+    {
+        InteractionEvent * event = _threadEventRing[head & mask];
+        _eventMap[event->getEventType()].push_back(event);
+        head++;
+        // hand the slot back to the tracking thread
+        ++_threadEventHead;
+    }
+}
+
 void TrackingManager::quitThread()
 {
     _quitLock.lock();
@@ -955,6 +1266,35 @@ osg::Matrix & TrackingManager::getUnfrozenHeadMat(int head)
     return _headMatList[head];
 }
 
+void TrackingManager::setPredictionEnabled(bool b)
+{
+    _predict = b;
+}
+
+bool TrackingManager::getPredictionEnabled()
+{
+    return _predict;
+}
+
+void TrackingManager::setPredictionTime(double time)
+{
+    _predictionTime = time;
+}
+
+double TrackingManager::getPredictionTime()
+{
+    return _predictionTime;
+}
+
+double TrackingManager::getSampleTime(int system)
+{
+    if(system >= 0 && system < _systemInfo.size())
+    {
+        return _snapshot[_snapshotIndex].sampleTimes[system];
+    }
+    return 0.0;
+}
+
 int TrackingManager::getHeadForHand(int hand)
 {
     if(hand >= 0 && hand < _handToHeadMap.size())
@@ -1557,17 +1897,17 @@ void TrackingManager::generateThreadValuatorEvents()
                     vie->setValuator(i);
                     vie->setHand(j);
                     vie->setValue(_eventValuators[j][i]);
-                    _eventMap[vie->getEventType()].push_back(vie);
+                    _threadEventMap[vie->getEventType()].push_back(vie);
                 }
             }
             else if(_eventValuatorType[j][i] == CHANGE)
             {
-                if(_lastEventValuators[j].find(i)
-                        == _lastEventValuators[j].end())
+                if(_threadLastEventValuators[j].find(i)
+                        == _threadLastEventValuators[j].end())
                 {
-                    _lastEventValuators[j][i] = value;
+                    _threadLastEventValuators[j][i] = value;
                 }
-                if(_eventValuators[j][i] != _lastEventValuators[j][i])
+                if(_eventValuators[j][i] != _threadLastEventValuators[j][i])
                 {
                     ValuatorInteractionEvent * vie =
                             new ValuatorInteractionEvent();
@@ -1575,10 +1915,10 @@ void TrackingManager::generateThreadValuatorEvents()
                     vie->setValuator(i);
                     vie->setHand(j);
                     vie->setValue(_eventValuators[j][i]);
-                    _eventMap[vie->getEventType()].push_back(vie);
+                    _threadEventMap[vie->getEventType()].push_back(vie);
                 }
 
-                _lastEventValuators[j][i] = _eventValuators[j][i];
+                _threadLastEventValuators[j][i] = _eventValuators[j][i];
             }
         }
     }
@@ -1614,7 +1954,66 @@ void TrackingManager::generateThreadPositionEvents()
         pie->setInteraction(cvr::MOVE);
         pie->setPosition(_threadHandMatList[i].getTrans());
         pie->setHand(i);
-        _eventMap[pie->getEventType()].push_back(pie);
+        _threadEventMap[pie->getEventType()].push_back(pie);
+    }
+}
+
+void TrackingManager::configChanged(const std::vector<std::string> & paths)
+{
+    for(int i = 0; i < _systemInfo.size(); i++)
+    {
+        std::stringstream ss;
+        ss << "Input.TrackingSystem" << i;
+        if(!_systemInfo[i] || !ConfigManager::isPathChanged(paths,ss.str()))
+        {
+            continue;
+        }
+
+        // the number of bodies, buttons and the tracker type need a restart
+        _transformLock.lock();
+        readSystemTransforms(ss.str(),_systemInfo[i]);
+        _transformLock.unlock();
+    }
+}
+
+void TrackingManager::readSystemTransforms(const std::string & configStr,
+        TrackingSystemInfo * tsi)
+{
+    float x, y, z, h, p, r;
+    x = ConfigManager::getFloat("x",configStr + ".Offset",0.0);
+    y = ConfigManager::getFloat("y",configStr + ".Offset",0.0);
+    z = ConfigManager::getFloat("z",configStr + ".Offset",0.0);
+    h = ConfigManager::getFloat("h",configStr + ".Orientation",0.0);
+    p = ConfigManager::getFloat("p",configStr + ".Orientation",0.0);
+    r = ConfigManager::getFloat("r",configStr + ".Orientation",0.0);
+    osg::Matrix m;
+    m.makeRotate(r * M_PI / 180.0,osg::Vec3(0,1,0),p * M_PI / 180.0,
+            osg::Vec3(1,0,0),h * M_PI / 180.0,osg::Vec3(0,0,1));
+    m.setTrans(osg::Vec3(x,y,z));
+    tsi->systemTransform = m;
+
+    tsi->bodyTranslations.resize(tsi->numBodies);
+    tsi->bodyRotations.resize(tsi->numBodies);
+    for(int i = 0; i < tsi->numBodies; i++)
+    {
+        std::stringstream bodyss;
+        bodyss << ".Body" << i;
+        x = ConfigManager::getFloat("x",configStr + bodyss.str() + ".Offset",
+                0.0);
+        y = ConfigManager::getFloat("y",configStr + bodyss.str() + ".Offset",
+                0.0);
+        z = ConfigManager::getFloat("z",configStr + bodyss.str() + ".Offset",
+                0.0);
+        h = ConfigManager::getFloat("h",
+                configStr + bodyss.str() + ".Orientation",0.0);
+        p = ConfigManager::getFloat("p",
+                configStr + bodyss.str() + ".Orientation",0.0);
+        r = ConfigManager::getFloat("r",
+                configStr + bodyss.str() + ".Orientation",0.0);
+        m.makeRotate(r * M_PI / 180.0,osg::Vec3(0,1,0),p * M_PI / 180.0,
+                osg::Vec3(1,0,0),h * M_PI / 180.0,osg::Vec3(0,0,1));
+        tsi->bodyTranslations[i] = osg::Vec3(x,y,z);
+        tsi->bodyRotations[i] = m;
     }
 }
 
@@ -1638,6 +2037,8 @@ void TrackingManager::updateThreadMats()
      }
      }*/
 
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_transformLock);
+
     for(int i = 0; i < _numHands; i++)
     {
         if(_systems[_handAddress[i].first]
@@ -1669,44 +2070,26 @@ void TrackingManager::updateThreadMats()
 
 void TrackingManager::flushEvents()
 {
-    int * numEvents = new int[NUM_INTER_EVENT_TYPES];
+    // counts and event data go out as one frame sync section
     if(ComController::instance()->isMaster())
     {
+        int eventsDataSize = NUM_INTER_EVENT_TYPES * sizeof(int);
         for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
         {
-            numEvents[i] = _eventMap[i].size();
+            eventsDataSize += _eventMap[i].size()
+                    * getEventSize((InteractionEventType)i);
         }
-        ComController::instance()->sendSlaves(numEvents,
-                NUM_INTER_EVENT_TYPES * sizeof(int));
-    }
-    else
-    {
-        ComController::instance()->readMaster(numEvents,
-                NUM_INTER_EVENT_TYPES * sizeof(int));
-    }
 
-    int eventsDataSize = 0;
-
-    for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
-    {
-        if(numEvents[i])
+        if(_eventData.size() < eventsDataSize)
         {
-            eventsDataSize += numEvents[i]
-                    * getEventSize((InteractionEventType)i);
+            _eventData.resize(eventsDataSize);
         }
-    }
-
-    //std::cerr << "eventsDataSize: " << eventsDataSize << std::endl;
-    char * data = NULL;
-    if(eventsDataSize > 0)
-    {
-        data = new char[eventsDataSize];
-    }
-    if(ComController::instance()->isMaster())
-    {
-        char * eventptr = data;
+        char * data = &_eventData[0];
+        int * numEvents = (int*)data;
+        char * eventptr = data + NUM_INTER_EVENT_TYPES * sizeof(int);
         for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
         {
+            numEvents[i] = _eventMap[i].size();
             for(std::list<InteractionEvent*>::iterator it =
                     _eventMap[i].begin(); it != _eventMap[i].end(); it++)
             {
@@ -1714,13 +2097,25 @@ void TrackingManager::flushEvents()
                 eventptr += getEventSize((InteractionEventType)i);
                 InteractionManager::instance()->addEvent(*it);
             }
+            _eventMap[i].clear();
         }
-        ComController::instance()->sendSlaves(data,eventsDataSize);
+
+        ComController::instance()->addFrameSyncSection(
+                ComController::FSS_TRACKING_EVENTS,data,eventsDataSize);
     }
     else
     {
-        ComController::instance()->readMaster(data,eventsDataSize);
-        char * eventptr = data;
+        int eventsDataSize;
+        char * data = ComController::instance()->getFrameSyncSection(
+                ComController::FSS_TRACKING_EVENTS,eventsDataSize);
+        if(!data
+                || eventsDataSize < (int)(NUM_INTER_EVENT_TYPES * sizeof(int)))
+        {
+            return;
+        }
+
+        int * numEvents = (int*)data;
+        char * eventptr = data + NUM_INTER_EVENT_TYPES * sizeof(int);
         for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
         {
             for(int j = 0; j < numEvents[i]; j++)
@@ -1735,24 +2130,6 @@ void TrackingManager::flushEvents()
             }
         }
     }
-
-    if(ComController::instance()->isMaster())
-    {
-        for(int i = 0; i < NUM_INTER_EVENT_TYPES; i++)
-        {
-            _eventMap[i].clear();
-        }
-    }
-
-    if(data)
-    {
-        delete[] data;
-    }
-
-    if(numEvents)
-    {
-        delete[] numEvents;
-    }
 }
 
 void TrackingManager::setGenHandDefaultButtonEvents()
@@ -2015,12 +2392,12 @@ void GenComplexTrackingEvents::processEvent(TrackedButtonInteractionEvent * tie)
             }
         }
 
-        TrackingManager::instance()->_eventMap[tie->getEventType()].push_back(
+        TrackingManager::instance()->_threadEventMap[tie->getEventType()].push_back(
                 tie);
     }
     else
     {
-        TrackingManager::instance()->_eventMap[tie->getEventType()].push_back(
+        TrackingManager::instance()->_threadEventMap[tie->getEventType()].push_back(
                 tie);
     }
 }
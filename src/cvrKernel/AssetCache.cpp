@@ -0,0 +1,431 @@
+#include <cvrKernel/AssetCache.h>
+#include <cvrKernel/CalVR.h>
+#include <cvrKernel/ComController.h>
+#include <cvrConfig/ConfigManager.h>
+
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+using namespace cvr;
+
+namespace
+{
+
+// 64 bit FNV-1a
+unsigned long long hashString(const std::string & str)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for(int i = 0; i < str.size(); i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// the single argument reads use the registry's default options
+osg::Node * readNode(const std::string & file,
+        osgDB::ReaderWriter::Options * options)
+{
+    if(options)
+    {
+        return osgDB::readNodeFile(file,options);
+    }
+    return osgDB::readNodeFile(file);
+}
+
+osg::Image * readImage(const std::string & file,
+        osgDB::ReaderWriter::Options * options)
+{
+    if(options)
+    {
+        return osgDB::readImageFile(file,options);
+    }
+    return osgDB::readImageFile(file);
+}
+
+}
+
+AssetCache * AssetCache::_myPtr = NULL;
+
+AssetCache::AssetCache()
+{
+    _enabled = false;
+    _waitTime = 0;
+    _loadWaitTime = 0;
+    resetStats();
+}
+
+AssetCache::~AssetCache()
+{
+}
+
+AssetCache * AssetCache::instance()
+{
+    if(!_myPtr)
+    {
+        _myPtr = new AssetCache();
+    }
+    return _myPtr;
+}
+
+bool AssetCache::init()
+{
+    _enabled = ConfigManager::getBool("value","AssetCache",false,NULL);
+    _directory = ConfigManager::getEntry("dir","AssetCache",
+            CalVR::instance()->getHomeDir() + "/cache/assets");
+    _waitTime = ConfigManager::getInt("wait","AssetCache",2000);
+    _loadWaitTime = ConfigManager::getInt("loadWait","AssetCache",30000);
+
+    // embed textures so entries do not depend on the source directory
+    _writeOptions = new osgDB::ReaderWriter::Options(
+            "WriteImageHint=IncludeData");
+
+    if(_enabled && ComController::instance()->isMaster())
+    {
+        if(!osgDB::makeDirectory(_directory))
+        {
+            std::cerr << "AssetCache: unable to create directory " << _directory
+                    << ", cache disabled." << std::endl;
+            _enabled = false;
+        }
+        else
+        {
+            // clear locks left by a master that did not exit cleanly,
+            // and failure marks, so failed entries are tried again
+            osgDB::DirectoryContents contents = osgDB::getDirectoryContents(
+                    _directory);
+            for(int i = 0; i < contents.size(); i++)
+            {
+                std::string ext = osgDB::getFileExtension(contents[i]);
+                if(ext == "lock" || ext == "failed")
+                {
+                    ::remove((_directory + "/" + contents[i]).c_str());
+                }
+            }
+        }
+    }
+
+    // every node has to agree on using the cache
+    if(ComController::instance()->isMaster())
+    {
+        ComController::instance()->sendSlaves(&_enabled,sizeof(bool));
+    }
+    else
+    {
+        ComController::instance()->readMaster(&_enabled,sizeof(bool));
+    }
+
+    return true;
+}
+
+osg::Node * AssetCache::readNodeFile(const std::string & file,
+        osgDB::ReaderWriter::Options * options)
+{
+    if(!_enabled)
+    {
+        return readNode(file,options);
+    }
+
+    std::string entry = getEntryName(file,options,true);
+    if(entry.empty())
+    {
+        return readNode(file,options);
+    }
+
+    bool master = ComController::instance()->isMaster();
+    if(osgDB::fileExists(entry) || (!master && waitForEntry(entry)))
+    {
+        osg::ref_ptr<osg::Node> node = osgDB::readNodeFile(entry);
+        if(node)
+        {
+            _statsLock.lock();
+            _stats.hits++;
+            _statsLock.unlock();
+            return node.release();
+        }
+    }
+
+    _statsLock.lock();
+    _stats.misses++;
+    _statsLock.unlock();
+
+    if(!master || !lockEntry(entry))
+    {
+        return readNode(file,options);
+    }
+
+    osg::ref_ptr<osg::Node> node = readNode(file,options);
+    if(node)
+    {
+        // write then rename, so readers never see a partial entry, the
+        // entry lock makes the temp name unique
+        std::stringstream tempss;
+        tempss << entry << ".tmp.osgb";
+        if(osgDB::writeNodeFile(*node,tempss.str(),_writeOptions.get())
+                && !::rename(tempss.str().c_str(),entry.c_str()))
+        {
+            _statsLock.lock();
+            _stats.writes++;
+            _statsLock.unlock();
+        }
+        else
+        {
+            ::remove(tempss.str().c_str());
+            failEntry(entry);
+        }
+    }
+    else
+    {
+        failEntry(entry);
+    }
+    unlockEntry(entry);
+
+    return node.release();
+}
+
+osg::Image * AssetCache::readImageFile(const std::string & file,
+        osgDB::ReaderWriter::Options * options)
+{
+    if(!_enabled)
+    {
+        return readImage(file,options);
+    }
+
+    std::string entry = getEntryName(file,options,false);
+    if(entry.empty())
+    {
+        return readImage(file,options);
+    }
+
+    bool master = ComController::instance()->isMaster();
+    if(osgDB::fileExists(entry) || (!master && waitForEntry(entry)))
+    {
+        osg::ref_ptr<osg::Image> image = osgDB::readImageFile(entry);
+        if(image)
+        {
+            // keep the name the image was asked for
+            image->setFileName(file);
+            _statsLock.lock();
+            _stats.hits++;
+            _statsLock.unlock();
+            return image.release();
+        }
+    }
+
+    _statsLock.lock();
+    _stats.misses++;
+    _statsLock.unlock();
+
+    if(!master || !lockEntry(entry))
+    {
+        return readImage(file,options);
+    }
+
+    osg::ref_ptr<osg::Image> image = readImage(file,options);
+    if(image)
+    {
+        // the entry lock makes this name unique
+        std::stringstream tempss;
+        tempss << entry << ".tmp.osgb";
+        if(osgDB::writeImageFile(*image,tempss.str(),_writeOptions.get())
+                && !::rename(tempss.str().c_str(),entry.c_str()))
+        {
+            _statsLock.lock();
+            _stats.writes++;
+            _statsLock.unlock();
+        }
+        else
+        {
+            ::remove(tempss.str().c_str());
+            failEntry(entry);
+        }
+    }
+    else
+    {
+        failEntry(entry);
+    }
+    unlockEntry(entry);
+
+    return image.release();
+}
+
+AssetCache::CacheStats AssetCache::getStats()
+{
+    _statsLock.lock();
+    CacheStats stats = _stats;
+    _statsLock.unlock();
+    return stats;
+}
+
+void AssetCache::resetStats()
+{
+    _statsLock.lock();
+    _stats.hits = _stats.misses = _stats.writes = 0;
+    _statsLock.unlock();
+}
+
+std::string AssetCache::getEntryName(const std::string & file,
+        osgDB::ReaderWriter::Options * options, bool model)
+{
+    std::string path = osgDB::findDataFile(file,options);
+    if(path.empty())
+    {
+        return "";
+    }
+    path = osgDB::getRealPath(path);
+
+    struct stat st;
+    if(stat(path.c_str(),&st))
+    {
+        return "";
+    }
+
+    // hashing the file contents would mean every node reading the whole
+    // file from shared storage, which is what the cache is avoiding
+    std::stringstream keyss;
+    keyss << path << "|" << ((long long)st.st_size) << "|"
+            << ((long long)st.st_mtime);
+    if(options)
+    {
+        keyss << "|" << options->getOptionString();
+    }
+
+    // textures and sub-files usually sit next to the model
+    if(model)
+    {
+        keyss << "|" << getDirectoryKey(osgDB::getFilePath(path));
+    }
+
+    char name[17];
+    snprintf(name,17,"%016llx",hashString(keyss.str()));
+
+    return _directory + "/" + name + ".osgb";
+}
+
+std::string AssetCache::getDirectoryKey(const std::string & dir)
+{
+    std::string dirName = dir.empty() ? "." : dir;
+
+    // the directory time changes when files are added, removed or renamed,
+    // so the listing is only read and stat'd again after that
+    struct stat dst;
+    if(stat(dirName.c_str(),&dst))
+    {
+        return "";
+    }
+
+    _dirLock.lock();
+    std::map<std::string,DirectoryKey>::iterator it = _dirKeys.find(dirName);
+    if(it != _dirKeys.end() && it->second.mtime == (long long)dst.st_mtime)
+    {
+        std::string key = it->second.key;
+        _dirLock.unlock();
+        return key;
+    }
+    _dirLock.unlock();
+
+    osgDB::DirectoryContents contents = osgDB::getDirectoryContents(dirName);
+    std::sort(contents.begin(),contents.end());
+    std::stringstream keyss;
+    for(int i = 0; i < contents.size(); i++)
+    {
+        struct stat fst;
+        std::string sub = dirName + "/" + contents[i];
+        if(stat(sub.c_str(),&fst) || (fst.st_mode & S_IFMT) != S_IFREG)
+        {
+            continue;
+        }
+        keyss << contents[i] << ":" << ((long long)fst.st_size) << ":"
+                << ((long long)fst.st_mtime) << "|";
+    }
+
+    _dirLock.lock();
+    DirectoryKey & dk = _dirKeys[dirName];
+    dk.mtime = (long long)dst.st_mtime;
+    dk.key = keyss.str();
+    _dirLock.unlock();
+
+    return keyss.str();
+}
+
+bool AssetCache::lockEntry(const std::string & entry)
+{
+    std::string lockFile = entry + ".lock";
+#ifndef WIN32
+    int fd = open(lockFile.c_str(),O_CREAT | O_EXCL | O_WRONLY,0644);
+    if(fd < 0)
+    {
+        return false;
+    }
+    close(fd);
+#else
+    int fd = _open(lockFile.c_str(),_O_CREAT | _O_EXCL | _O_WRONLY,
+            _S_IREAD | _S_IWRITE);
+    if(fd < 0)
+    {
+        return false;
+    }
+    _close(fd);
+#endif
+    return true;
+}
+
+void AssetCache::unlockEntry(const std::string & entry)
+{
+    ::remove((entry + ".lock").c_str());
+}
+
+void AssetCache::failEntry(const std::string & entry)
+{
+    FILE * file = fopen((entry + ".failed").c_str(),"w");
+    if(file)
+    {
+        fclose(file);
+    }
+}
+
+bool AssetCache::waitForEntry(const std::string & entry)
+{
+    // the master may not have started on the entry yet, so wait a short
+    // time for its lock to show up.  Once it has the lock, wait until the
+    // entry is written or the master gives up on it.
+    std::string lockFile = entry + ".lock";
+    std::string failFile = entry + ".failed";
+    bool loading = false;
+    int waited = 0;
+    while(!osgDB::fileExists(entry) && !osgDB::fileExists(failFile))
+    {
+        if(!loading && osgDB::fileExists(lockFile))
+        {
+            loading = true;
+        }
+
+        if(waited >= (loading ? _loadWaitTime : _waitTime))
+        {
+            break;
+        }
+
+        OpenThreads::Thread::microSleep(50000);
+        waited += 50;
+    }
+
+    return osgDB::fileExists(entry);
+}
@@ -13,6 +13,7 @@
 
 #include <cvrKernel/CVRStatsHandler.h>
 #include <cvrKernel/CalVR.h>
+#include <cvrKernel/ComController.h>
 #include <cvrKernel/PluginManager.h>
 #include <cvrUtil/Bounds.h>
 
@@ -62,6 +63,56 @@ CVRStatsHandler::CVRStatsHandler(osgViewer::ViewerBase * viewer) :
     svi->advanced = false;
     _defaultViewerValues.push_back(svi);
 
+    svi = new StatValueInfo;
+    svi->label = "MC Repairs:";
+    svi->color = colorAdvanced;
+    svi->colorAlpha = colorAdvancedAlpha;
+    svi->name = "Multicast repaired fragments";
+    svi->average = true;
+    svi->collectName = "CalVRStatsAdvanced";
+    svi->advanced = true;
+    _defaultViewerValues.push_back(svi);
+
+    svi = new StatValueInfo;
+    svi->label = "Cache Hits:";
+    svi->color = colorAdvanced;
+    svi->colorAlpha = colorAdvancedAlpha;
+    svi->name = "Asset cache hits";
+    svi->average = false;
+    svi->collectName = "CalVRStatsAdvanced";
+    svi->advanced = true;
+    _defaultViewerValues.push_back(svi);
+
+    svi = new StatValueInfo;
+    svi->label = "Cache Misses:";
+    svi->color = colorAdvanced;
+    svi->colorAlpha = colorAdvancedAlpha;
+    svi->name = "Asset cache misses";
+    svi->average = false;
+    svi->collectName = "CalVRStatsAdvanced";
+    svi->advanced = true;
+    _defaultViewerValues.push_back(svi);
+
+    svi = new StatValueInfo;
+    svi->label = "DPart Cameras:";
+    svi->color = colorAdvanced;
+    svi->colorAlpha = colorAdvancedAlpha;
+    svi->name = "Depth partition cameras";
+    svi->average = true;
+    svi->collectName = "CalVRStatsAdvanced";
+    svi->advanced = true;
+    _defaultViewerValues.push_back(svi);
+
+    svi = new StatValueInfo;
+    svi->label = "DPart ms:";
+    svi->color = colorAdvanced;
+    svi->colorAlpha = colorAdvancedAlpha;
+    svi->name = "Depth partition time ms";
+    svi->average = true;
+    svi->collectName = "CalVRStatsAdvanced";
+    svi->advanced = true;
+    _defaultViewerValues.push_back(svi);
+
     StatTimeBarInfo * barInfo = new StatTimeBarInfo;
     barInfo->label = "Event:";
     barInfo->color = osg::Vec4(0.0,1.0,0.5,1.0);
@@ -128,6 +179,17 @@ CVRStatsHandler::CVRStatsHandler(osgViewer::ViewerBase * viewer) :
     barInfo->advanced = true;
     _defaultViewerTimeBars.push_back(barInfo);
 
+    barInfo = new StatTimeBarInfo;
+    barInfo->label = "Screens:";
+    barInfo->color = colorAdvanced;
+    barInfo->colorAlpha = colorAdvancedAlpha;
+    barInfo->nameDuration = "Screens time taken";
+    barInfo->nameTimeStart = "Screens begin time";
+    barInfo->nameTimeEnd = "Screens end time";
+    barInfo->collectName = "CalVRStatsAdvanced";
+    barInfo->advanced = true;
+    _defaultViewerTimeBars.push_back(barInfo);
+
     barInfo = new StatTimeBarInfo;
     barInfo->label = "Collaborative:";
     barInfo->color = colorAdvanced;
@@ -287,6 +349,15 @@ CVRStatsHandler::CVRStatsHandler(osgViewer::ViewerBase * viewer) :
     sli->advanced = false;
     _defaultViewerLines.push_back(sli);
 
+    sli = new StatLineInfo;
+    sli->color = osg::Vec4(1.0,0.0,0.0,1.0);
+    sli->colorAlpha = osg::Vec4(1.0,0.0,0.0,0.5);
+    sli->max = 0.016;
+    sli->name = "Cluster Sync time taken";
+    sli->collectName = "CalVRStats";
+    sli->advanced = true;
+    _defaultViewerLines.push_back(sli);
+
     sli = new StatLineInfo;
     sli->color = osg::Vec4(0.0,1.0,1.0,1.0);
     sli->colorAlpha = osg::Vec4(0.0,1.0,1.0,0.5);
@@ -491,6 +562,26 @@ bool CVRStatsHandler::handle(const osgGA::GUIEventAdapter& ea,
                         osg::notify(osg::NOTICE) << std::endl;
                     }
 
+                    const std::vector<int> & hist =
+                            ComController::instance()->getSyncWaitHistogram();
+                    const std::vector<double> & bounds =
+                            ComController::instance()->getSyncWaitBucketBounds();
+                    osg::notify(osg::NOTICE) << "Cluster sync wait histogram:"
+                            << std::endl;
+                    for(int i = 0; i < hist.size(); i++)
+                    {
+                        if(i < bounds.size())
+                        {
+                            osg::notify(osg::NOTICE) << "    < " << bounds[i]
+                                    << " ms: " << hist[i] << std::endl;
+                        }
+                        else
+                        {
+                            osg::notify(osg::NOTICE) << "    >= "
+                                    << bounds.back() << " ms: " << hist[i]
+                                    << std::endl;
+                        }
+                    }
                 }
                 return true;
             }
@@ -937,7 +937,9 @@ void CVRViewer::eventTraversal()
         }
         ei.numEvents = eventList.size();
         //std::cerr << "found " << ei.numEvents << " events." << std::endl;
-        ComController::instance()->sendSlaves(&ei,sizeof(struct eventInfo));
+        ComController::instance()->addFrameSyncSection(
+                ComController::FSS_VIEWER_EVENT_INFO,&ei,
+                sizeof(struct eventInfo));
         if(ei.numEvents)
         {
             events = new event[eventList.size()];
@@ -945,19 +947,23 @@ void CVRViewer::eventTraversal()
             {
                 events[i] = eventList[i];
             }
-            ComController::instance()->sendSlaves(events,
+            ComController::instance()->addFrameSyncSection(
+                    ComController::FSS_VIEWER_EVENTS,events,
                     eventList.size() * sizeof(struct event));
         }
     }
     else
     {
         //std::cerr << "doing event sync." << std::endl;
-        ComController::instance()->readMaster(&ei,sizeof(struct eventInfo));
+        ComController::instance()->readFrameSyncSection(
+                ComController::FSS_VIEWER_EVENT_INFO,&ei,
+                sizeof(struct eventInfo));
         //std::cerr << "got " << ei.numEvents << " events." << std::endl;
         if(ei.numEvents)
         {
             events = new event[ei.numEvents];
-            ComController::instance()->readMaster(events,
+            ComController::instance()->readFrameSyncSection(
+                    ComController::FSS_VIEWER_EVENTS,events,
                     ei.numEvents * sizeof(struct event));
         }
     }
@@ -1426,7 +1432,19 @@ void CVRViewer::renderingTraversals()
                 "Cluster Sync end time",endTime);
         stats->setAttribute(getViewerFrameStamp()->getFrameNumber(),
                 "Cluster Sync time taken",endTime - startTime);
+
+        const ComController::MulticastStats & mcs =
+                ComController::instance()->getMulticastStats();
+        stats->setAttribute(getViewerFrameStamp()->getFrameNumber(),
+                "Multicast messages",mcs.messages);
+        stats->setAttribute(getViewerFrameStamp()->getFrameNumber(),
+                "Multicast bytes",mcs.bytes);
+        stats->setAttribute(getViewerFrameStamp()->getFrameNumber(),
+                "Multicast fragments",mcs.fragments);
+        stats->setAttribute(getViewerFrameStamp()->getFrameNumber(),
+                "Multicast repaired fragments",mcs.repaired);
     }
+    ComController::instance()->resetMulticastStats();
 
     // put callbacks in the list here, since we know all threads are drawing right now
     for(int i = 0; i < _addFrameStartCallbacks.size(); i++)
@@ -1905,12 +1923,14 @@ void CVRViewer::frameStart()
     if(ComController::instance()->isMaster())
     {
         frameUp.currentTime = osg::Timer::instance()->tick();
-        ComController::instance()->sendSlaves(&frameUp,
+        ComController::instance()->addFrameSyncSection(
+                ComController::FSS_FRAME_START,&frameUp,
                 sizeof(struct FrameUpdate));
     }
     else
     {
-        ComController::instance()->readMaster(&frameUp,
+        ComController::instance()->readFrameSyncSection(
+                ComController::FSS_FRAME_START,&frameUp,
                 sizeof(struct FrameUpdate));
     }
 
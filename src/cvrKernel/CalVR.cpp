@@ -13,6 +13,8 @@
 #include <cvrKernel/InteractionManager.h>
 #include <cvrKernel/Navigation.h>
 #include <cvrKernel/ThreadedLoader.h>
+#include <cvrKernel/AssetCache.h>
+#include <cvrKernel/FrameScheduler.h>
 #include <cvrKernel/CVRStatsHandler.h>
 
 #include <osgViewer/ViewerEventHandlers>
@@ -39,6 +41,7 @@ CalVR * CalVR::_myPtr = NULL;
 CalVR::CalVR()
 {
     _initStatus = INIT_OK;
+    _configReload = false;
 
     _config = NULL;
     _communication = NULL;
@@ -53,11 +56,17 @@ CalVR::CalVR()
     _file = NULL;
     _plugins = NULL;
     _threadedLoader = NULL;
+    _assetCache = NULL;
+    _scheduler = NULL;
     _myPtr = this;
 }
 
 CalVR::~CalVR()
 {
+    if(_scheduler)
+    {
+        delete _scheduler;
+    }
     if(_plugins)
     {
         delete _plugins;
@@ -74,6 +83,10 @@ CalVR::~CalVR()
     {
         delete _threadedLoader;
     }
+    if(_assetCache)
+    {
+        delete _assetCache;
+    }
     if(_collaborative)
     {
         delete _collaborative;
@@ -153,6 +166,15 @@ bool CalVR::init(osg::ArgumentParser & args, std::string home)
 
     printf("[II] CalVR sub-shell application: %s\n", ComController::application.c_str() );
 
+    // slaves get the config snapshot from the master during communication init
+    if(args.read("--config-snapshot") || getenv("CALVR_CONFIG_SNAPSHOT"))
+    {
+        cvr::ConfigManager::setSnapshotMode(
+                args.find("--node-number") >= 0 ?
+                        cvr::ConfigManager::SNAPSHOT_RECEIVE :
+                        cvr::ConfigManager::SNAPSHOT_SEND);
+    }
+
     _config = new cvr::ConfigManager();
     if(!_config->init())
     {
@@ -199,6 +221,24 @@ bool CalVR::init(osg::ArgumentParser & args, std::string home)
         }
     }
 
+    // only the master watches the config files, changes are sent in the
+    // frame sync message
+    if(_communication->isMaster())
+    {
+        _configReload = cvr::ConfigManager::getBool("value","ConfigReload",
+                false);
+        _communication->sendSlaves(&_configReload,sizeof(bool));
+        if(_configReload && !cvr::ConfigManager::startWatching())
+        {
+            std::cerr << "Warning: unable to watch config files for changes."
+                    << std::endl;
+        }
+    }
+    else
+    {
+        _communication->readMaster(&_configReload,sizeof(bool));
+    }
+
     _tracking = cvr::TrackingManager::instance();
     _tracking->init();
 
@@ -243,7 +283,11 @@ bool CalVR::init(osg::ArgumentParser & args, std::string home)
     _collaborative = cvr::CollaborativeManager::instance();
     _collaborative->init();
 
+    _assetCache = cvr::AssetCache::instance();
+    _assetCache->init();
+
     _threadedLoader = cvr::ThreadedLoader::instance();
+    _threadedLoader->init();
 
     _menu = cvr::MenuManager::instance();
     if(!_menu->init())
@@ -260,6 +304,11 @@ bool CalVR::init(osg::ArgumentParser & args, std::string home)
     _file = cvr::FileHandler::instance();
 
     _plugins = cvr::PluginManager::instance();
+
+    _scheduler = cvr::FrameScheduler::instance();
+    _scheduler->init();
+    setupFrameStages();
+
     _plugins->init();
 
     for(int i = 0; i < fileList.size(); i++)
@@ -284,20 +333,11 @@ void CalVR::run()
     while(!_viewer->done())
     {
         //std::cerr << "Frame " << frameNum << std::endl;
+        _communication->startFrameSync(frameNum);
         _viewer->frameStart();
         _viewer->advance(USE_REFERENCE_TIME);
         _viewer->eventTraversal();
-        _tracking->update();
-        _scene->update();
-        _menu->update();
-        _interaction->update();
-        _navigation->update();
-        _scene->postEventUpdate();
-        _screens->computeViewProj();
-        _screens->updateCamera();
-        _collaborative->update();
-        _threadedLoader->update();
-        _plugins->preFrame();
+        _scheduler->runFrame();
         _viewer->updateTraversal();
         _viewer->renderingTraversals();
 
@@ -313,6 +353,100 @@ void CalVR::run()
     }
 }
 
+void CalVR::setupFrameStages()
+{
+    // stages that use the cluster connection keep the original frame order.
+    // The collaborative exchange and the loader status sync only read the
+    // tracking and navigation state, so they run on the main thread while
+    // the screens update on a worker.  Loader callbacks are plugin code that
+    // may use the view matrices, so they wait for the screens.
+    _scheduler->addStage("Tracking",
+            new FrameScheduler::MethodCallback<TrackingManager>(_tracking,
+                    &TrackingManager::update),"",true);
+    _scheduler->addStage("Config",
+            new FrameScheduler::MethodCallback<CalVR>(this,
+                    &CalVR::updateConfig),"Tracking",true);
+    _scheduler->addStage("FrameSync",
+            new FrameScheduler::MethodCallback<ComController,bool>(
+                    _communication,&ComController::flushFrameSync),
+            "Tracking,Config",true);
+    _scheduler->addStage("Scene",
+            new FrameScheduler::MethodCallback<SceneManager>(_scene,
+                    &SceneManager::update),"FrameSync",true);
+    _scheduler->addStage("Menu",
+            new FrameScheduler::MethodCallback<MenuManager>(_menu,
+                    &MenuManager::update),"Scene",true);
+    _scheduler->addStage("Interaction",
+            new FrameScheduler::MethodCallback<InteractionManager>(
+                    _interaction,&InteractionManager::update),"Menu",true);
+    _scheduler->addStage("Navigation",
+            new FrameScheduler::MethodCallback<Navigation>(_navigation,
+                    &Navigation::update),"Interaction",true);
+    _scheduler->addStage("PostEvent",
+            new FrameScheduler::MethodCallback<SceneManager>(_scene,
+                    &SceneManager::postEventUpdate),"Navigation",true);
+    _scheduler->addStage("Screens",
+            new FrameScheduler::MethodCallback<CalVR>(this,
+                    &CalVR::updateScreens),"PostEvent",false,"Screens");
+    _scheduler->addStage("Collaborative",
+            new FrameScheduler::MethodCallback<CollaborativeManager>(
+                    _collaborative,&CollaborativeManager::update),"PostEvent",
+            true);
+    _scheduler->addStage("ThreadedLoader",
+            new FrameScheduler::MethodCallback<ThreadedLoader>(
+                    _threadedLoader,&ThreadedLoader::update),"Collaborative",
+            true);
+    _scheduler->addStage("LoaderCallbacks",
+            new FrameScheduler::MethodCallback<ThreadedLoader>(
+                    _threadedLoader,&ThreadedLoader::runCallbacks),
+            "Screens,ThreadedLoader",true);
+    _scheduler->addStage("PreFrame",
+            new FrameScheduler::MethodCallback<PluginManager>(_plugins,
+                    &PluginManager::preFrame),"LoaderCallbacks",true);
+}
+
+void CalVR::updateScreens()
+{
+    _screens->computeViewProj();
+    _screens->updateCamera();
+}
+
+void CalVR::updateConfig()
+{
+    if(!_configReload)
+    {
+        return;
+    }
+
+    if(_communication->isMaster())
+    {
+        std::vector<char> update;
+        if(cvr::ConfigManager::checkForChanges()
+                && !cvr::ConfigManager::reload(update))
+        {
+            update.clear();
+        }
+
+        _communication->addFrameSyncSection(
+                cvr::ComController::FSS_CONFIG_UPDATE,
+                update.size() ? &update[0] : NULL,update.size());
+    }
+    else
+    {
+        int size;
+        char * data = _communication->getFrameSyncSection(
+                cvr::ComController::FSS_CONFIG_UPDATE,size);
+        if(data && size && !cvr::ConfigManager::applyUpdate(data,size))
+        {
+            std::cerr << "Error applying config update from master."
+                    << std::endl;
+        }
+    }
+
+    // run the callbacks at the same point on every node
+    cvr::ConfigManager::notifyChanges();
+}
+
 bool CalVR::setupDirectories()
 {
     char * env;
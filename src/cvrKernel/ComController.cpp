@@ -3,6 +3,7 @@
 #include <cvrConfig/ConfigManager.h>
 #include <cvrUtil/CVRSocket.h>
 #include <cvrUtil/CVRMulticastSocket.h>
+#include <cvrUtil/CVRSharedMemoryLink.h>
 #include <cvrUtil/MultiListenSocket.h>
 
 #include <osg/Timer>
@@ -15,15 +16,47 @@
 #include <string>
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 #ifndef WIN32
 #include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #else
 #pragma comment(lib, "wsock32.lib")
 #endif
 
 using namespace cvr;
 
+namespace
+{
+
+// node links use shared memory when it is set up, otherwise the socket.
+// sendv lets large transfers use zero copy if it is enabled on the socket
+bool linkSend(CVRSocket * socket, CVRSharedMemoryLink * link, void * data,
+        int size)
+{
+    if(link)
+    {
+        return link->send(data,size);
+    }
+
+    SocketBuffer buffer;
+    buffer.data = data;
+    buffer.len = size;
+    return socket->sendv(&buffer,1);
+}
+
+bool linkRecv(CVRSocket * socket, CVRSharedMemoryLink * link, void * data,
+        int size)
+{
+    return link ? link->recv(data,size) : socket->recv(data,size);
+}
+
+}
+
 std::string ComController::application = "CalVR";
 
 ComController * ComController::_myPtr = NULL;
@@ -32,7 +65,33 @@ ComController::ComController()
 {
     _listenSocket = NULL;
     _masterSocket = NULL;
+    _masterShm = NULL;
+    _shmEnabled = false;
+    _shmRingSize = 0;
+    _shmSpinCount = -1;
+    _shmCount = 0;
     _CCError = false;
+    _frameSyncReceived = false;
+    _frameSyncFrame = 0;
+    _frameSyncMessageFrame = 0;
+    _parallelIO = false;
+    _epollFD = -1;
+    _multicastUsable = false;
+    _multicastReliable = false;
+    _masterMCSocket = NULL;
+    _slaveMCSocket = NULL;
+    _mcSeq = 0;
+    _mcNumPending = 0;
+    resetMulticastStats();
+
+    _syncTopology = SYNC_FLAT;
+    _barrierArity = 2;
+    _barrierParent = NULL;
+    _barrierParentShm = NULL;
+    _lastSyncWait = 0.0;
+    double bounds[] = {0.1, 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0};
+    _syncWaitBounds.assign(bounds,bounds + 8);
+    _syncWaitHistogram.assign(_syncWaitBounds.size() + 1,0);
 
     _maxSocketFD = -1;
 #ifndef WIN32
@@ -42,6 +101,32 @@ ComController::ComController()
 
 ComController::~ComController()
 {
+    for(int i = 0; i < _barrierPeerSockets.size(); i++)
+    {
+        delete _barrierPeerSockets[i];
+    }
+
+    for(int i = 0; i < _barrierPeerShm.size(); i++)
+    {
+        delete _barrierPeerShm[i];
+    }
+
+    for(int i = 0; i < _slaveShmList.size(); i++)
+    {
+        delete _slaveShmList[i];
+    }
+
+    if(_masterShm)
+    {
+        delete _masterShm;
+    }
+
+#ifdef __linux__
+    if(_epollFD >= 0)
+    {
+        close(_epollFD);
+    }
+#endif
 }
 
 ComController * ComController::instance()
@@ -78,11 +163,10 @@ bool ComController::init(osg::ArgumentParser * ap)
         _isMaster = true;
     }
 
-    _numSlaves = ConfigManager::getInt("MultiPC.NumSlaves",0);
-
     bool ret;
     if(_isMaster)
     {
+        _numSlaves = ConfigManager::getInt("MultiPC.NumSlaves",0);
         _masterInterface = ConfigManager::getEntry("value",
                 "MultiPC.MasterInterface",CalVR::instance()->getHostName());
         std::cerr << "Starting up as Master." << std::endl;
@@ -95,9 +179,27 @@ bool ComController::init(osg::ArgumentParser * ap)
         ret = connectMaster();
     }
 
+    if(ret
+            && ConfigManager::getSnapshotMode()
+                    != ConfigManager::SNAPSHOT_OFF)
+    {
+        ret = syncConfigSnapshot();
+    }
+
+    if(!_isMaster)
+    {
+        _numSlaves = ConfigManager::getInt("MultiPC.NumSlaves",0);
+    }
+
+    if(ret)
+    {
+        ret = setupSharedMemory();
+    }
+
     if(ret)
     {
         setupMulticast();
+        setupBarrier();
     }
 
     return ret;
@@ -110,20 +212,29 @@ bool ComController::sendSlaves(void * data, int size)
         return false;
     }
 
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
     if(!size)
     {
         return true;
     }
 
+    if(_parallelIO)
+    {
+        return parallelSlaveIO(true,(char*)data,size);
+    }
+
     bool ret = true;
-    for(std::map<int,CVRSocket *>::iterator it = _slaveSockets.begin();
-            it != _slaveSockets.end(); it++)
+    for(int i = 0; i < _slaveSocketList.size(); i++)
     {
-        if(!it->second->send(data,size))
+        if(!linkSend(_slaveSocketList[i],_slaveShmList[i],data,size))
         {
             std::cerr
                     << "ComController Error: send failure, sendSlaves, to node "
-                    << it->first << std::endl;
+                    << _slaveNodeList[i] << std::endl;
             _CCError = true;
             ret = false;
         }
@@ -139,12 +250,17 @@ bool ComController::readMaster(void * data, int size)
         return false;
     }
 
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
     if(!size)
     {
         return true;
     }
 
-    if(!_masterSocket->recv(data,size))
+    if(!linkRecv(_masterSocket,_masterShm,data,size))
     {
         std::cerr << "ComController Error: recv failure, readMaster."
                 << std::endl;
@@ -161,13 +277,25 @@ bool ComController::sendSlavesMulticast(void * data, int size)
         return false;
     }
 
+    if(!frameSyncBoundary(true))
+    {
+        return false;
+    }
+
     if(!size)
     {
         return true;
     }
 
-    if(_multicastUsable)
+    if(_multicastUsable && _multicastReliable)
+    {
+        return sendSlavesReliableMulticast((char*)data,size);
+    }
+    else if(_multicastUsable)
     {
+        _mcStats.messages++;
+        _mcStats.bytes += size;
+        _mcStats.fragments++;
         if(!_slaveMCSocket->send(data,size))
         {
             std::cerr
@@ -191,13 +319,25 @@ bool ComController::readMasterMulticast(void * data, int size)
         return false;
     }
 
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
     if(!size)
     {
         return true;
     }
 
-    if(_multicastUsable)
+    if(_multicastUsable && _multicastReliable)
+    {
+        return readMasterReliableMulticast((char*)data,size);
+    }
+    else if(_multicastUsable)
     {
+        _mcStats.messages++;
+        _mcStats.bytes += size;
+        _mcStats.fragments++;
         if(!_masterMCSocket->recv(data,size))
         {
             std::cerr
@@ -214,6 +354,292 @@ bool ComController::readMasterMulticast(void * data, int size)
     return true;
 }
 
+bool ComController::sendSlavesReliableMulticast(char * data, int size)
+{
+    _mcSeq++;
+
+    int numFragments = (size + _mcFragmentSize - 1) / _mcFragmentSize;
+
+    _mcStats.messages++;
+    _mcStats.bytes += size;
+    _mcStats.fragments += numFragments;
+
+    MCFragmentHeader header;
+    header.seq = _mcSeq;
+    header.totalSize = size;
+
+    char * packet = &_mcPacketBuffer[0];
+    for(int i = 0; i < numFragments; i++)
+    {
+        int fragSize = std::min(_mcFragmentSize,size - i * _mcFragmentSize);
+        header.fragment = i;
+        memcpy(packet,&header,sizeof(struct MCFragmentHeader));
+        memcpy(packet + sizeof(struct MCFragmentHeader),
+                data + i * _mcFragmentSize,fragSize);
+        if(!_slaveMCSocket->send(packet,
+                sizeof(struct MCFragmentHeader) + fragSize))
+        {
+            std::cerr
+                    << "ComController Error: send failure, sendSlaves, multicast"
+                    << std::endl;
+            _CCError = true;
+            return false;
+        }
+    }
+
+    // the slaves' missing fragment reports are collected before the next
+    // message that is not a multicast, keep the data until then for repair
+    if(_mcNumPending == (int)_mcPending.size())
+    {
+        _mcPending.push_back(std::vector<char>());
+    }
+    _mcPending[_mcNumPending].assign(data,data + size);
+    _mcNumPending++;
+
+    return true;
+}
+
+bool ComController::collectMulticastAcks()
+{
+    if(!_mcNumPending)
+    {
+        return true;
+    }
+
+    // every slave reports its missing fragment count for each message,
+    // followed by a list of fragment indices which are resent over the tcp
+    // control socket.  The reports were sent as each message arrived, so
+    // they are usually waiting already.
+    bool ret = true;
+    for(int m = 0; m < _mcNumPending && ret; m++)
+    {
+        char * data = &_mcPending[m][0];
+        int size = _mcPending[m].size();
+        int numFragments = (size + _mcFragmentSize - 1) / _mcFragmentSize;
+
+        for(int i = 0; i < (int)_slaveSocketList.size() && ret; i++)
+        {
+            int missingCount;
+            if(!linkRecv(_slaveSocketList[i],_slaveShmList[i],&missingCount,
+                    sizeof(int)))
+            {
+                std::cerr
+                        << "ComController Error: recv failure, multicast report, node "
+                        << _slaveNodeList[i] << std::endl;
+                ret = false;
+                break;
+            }
+
+            if(missingCount <= 0)
+            {
+                continue;
+            }
+
+            _mcMissing.resize(missingCount);
+            if(!linkRecv(_slaveSocketList[i],_slaveShmList[i],&_mcMissing[0],
+                    missingCount * sizeof(int)))
+            {
+                std::cerr
+                        << "ComController Error: recv failure, multicast report, node "
+                        << _slaveNodeList[i] << std::endl;
+                ret = false;
+                break;
+            }
+
+            // send the repaired fragments in full packets
+            if(!_slaveShmList[i])
+            {
+                _slaveSocketList[i]->setCork(true);
+            }
+
+            for(int j = 0; j < missingCount; j++)
+            {
+                int fragment = _mcMissing[j];
+                if(fragment < 0 || fragment >= numFragments)
+                {
+                    ret = false;
+                    break;
+                }
+
+                int fragSize = std::min(_mcFragmentSize,
+                        size - fragment * _mcFragmentSize);
+                if(!linkSend(_slaveSocketList[i],_slaveShmList[i],
+                        data + fragment * _mcFragmentSize,fragSize))
+                {
+                    ret = false;
+                    break;
+                }
+                _mcStats.repaired++;
+            }
+
+            if(!_slaveShmList[i])
+            {
+                _slaveSocketList[i]->setCork(false);
+            }
+
+            if(!ret)
+            {
+                std::cerr
+                        << "ComController Error: multicast repair failure, node "
+                        << _slaveNodeList[i] << std::endl;
+            }
+        }
+    }
+
+    _mcNumPending = 0;
+
+    if(!ret)
+    {
+        _CCError = true;
+    }
+
+    return ret;
+}
+
+bool ComController::readMasterReliableMulticast(char * data, int size)
+{
+    unsigned int expectedSeq = _mcSeq + 1;
+    int numFragments = (size + _mcFragmentSize - 1) / _mcFragmentSize;
+    int numReceived = 0;
+
+    _mcFragmentReceived.assign(numFragments,false);
+
+    // datagrams of this message that came in while finishing the last one
+    std::vector<std::vector<char> > early;
+    early.swap(_mcEarlyPackets);
+    int numEarly = 0;
+
+    int timeout = _mcLossTimeout;
+    char * packet = &_mcPacketBuffer[0];
+    while(numReceived < numFragments)
+    {
+        int read;
+        if(numEarly < (int)early.size())
+        {
+            read = early[numEarly].size();
+            memcpy(packet,&early[numEarly][0],read);
+            numEarly++;
+        }
+        else
+        {
+            read = _masterMCSocket->recvDatagram(packet,_mcPacketBuffer.size(),
+                    timeout);
+        }
+
+        if(read < 0)
+        {
+            std::cerr
+                    << "ComController Error: recv failure, readMasterMulticast."
+                    << std::endl;
+            _CCError = true;
+            return false;
+        }
+        else if(read == 0)
+        {
+            // timeout, request whatever is missing
+            break;
+        }
+
+        if(read < (int)sizeof(struct MCFragmentHeader))
+        {
+            continue;
+        }
+
+        MCFragmentHeader header;
+        memcpy(&header,packet,sizeof(struct MCFragmentHeader));
+
+        // the master does not wait for this node before sending the next
+        // message, so keep its datagrams.  Drop late datagrams from a
+        // message that was already repaired.
+        if(header.seq == expectedSeq + 1)
+        {
+            _mcEarlyPackets.push_back(std::vector<char>(packet,packet + read));
+            continue;
+        }
+        else if(header.seq != expectedSeq)
+        {
+            continue;
+        }
+
+        if((int)header.totalSize != size
+                || (int)header.fragment >= numFragments)
+        {
+            std::cerr
+                    << "ComController Error: multicast message mismatch, expected size "
+                    << size << " got " << header.totalSize << std::endl;
+            _CCError = true;
+            return false;
+        }
+
+        int fragSize = std::min(_mcFragmentSize,
+                size - (int)header.fragment * _mcFragmentSize);
+        if(read - (int)sizeof(struct MCFragmentHeader) != fragSize)
+        {
+            continue;
+        }
+
+        if(!_mcFragmentReceived[header.fragment])
+        {
+            memcpy(data + header.fragment * _mcFragmentSize,
+                    packet + sizeof(struct MCFragmentHeader),fragSize);
+            _mcFragmentReceived[header.fragment] = true;
+            numReceived++;
+        }
+
+        timeout = _mcRepairTimeout;
+    }
+
+    _mcMissing.clear();
+    for(int i = 0; i < numFragments; i++)
+    {
+        if(!_mcFragmentReceived[i])
+        {
+            _mcMissing.push_back(i);
+        }
+    }
+
+    int missingCount = _mcMissing.size();
+    if(!sendMaster(&missingCount,sizeof(int)))
+    {
+        return false;
+    }
+
+    if(missingCount)
+    {
+        if(!sendMaster(&_mcMissing[0],missingCount * sizeof(int)))
+        {
+            return false;
+        }
+
+        for(int i = 0; i < missingCount; i++)
+        {
+            int fragSize = std::min(_mcFragmentSize,
+                    size - _mcMissing[i] * _mcFragmentSize);
+            if(!readMaster(data + _mcMissing[i] * _mcFragmentSize,fragSize))
+            {
+                return false;
+            }
+        }
+    }
+
+    _mcSeq = expectedSeq;
+
+    _mcStats.messages++;
+    _mcStats.bytes += size;
+    _mcStats.fragments += numReceived;
+    _mcStats.repaired += missingCount;
+
+    return true;
+}
+
+void ComController::resetMulticastStats()
+{
+    _mcStats.messages = 0;
+    _mcStats.bytes = 0;
+    _mcStats.fragments = 0;
+    _mcStats.repaired = 0;
+}
+
 bool ComController::readSlaves(void * data, int size)
 {
     if(!_isMaster || _CCError)
@@ -221,13 +647,16 @@ bool ComController::readSlaves(void * data, int size)
         return false;
     }
 
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
     if(!size)
     {
         return true;
     }
 
-    bool ret = true;
-
     char * recBuf;
     if(data)
     {
@@ -235,119 +664,886 @@ bool ComController::readSlaves(void * data, int size)
     }
     else
     {
-        recBuf = new char[size * _numSlaves];
-    }
-
-    /*int nodesRead = 0;
-     fd_set _sockets;
-     std::map<int,bool> readMap;
-     while(nodesRead < _numSlaves)
-     {
-     FD_ZERO(&_sockets);
-     for(std::map<int,CVRSocket *>::iterator it = _slaveSockets.begin(); it != _slaveSockets.end(); it++)
-     {
-     FD_SET(it->second->getSocketFD(),&_sockets);
-     }
-
-     struct timeval tv;
-     tv.tv_sec = 0;
-     tv.tv_usec = 0;
-
-     select(_maxSocketFD+1,&_sockets,NULL,NULL,&tv);
-
-     char * tmpPtr = recBuf;
-     for(std::map<int,CVRSocket *>::iterator it = _slaveSockets.begin(); it != _slaveSockets.end(); it++)
-     {
-     if(!readMap[it->first] && FD_ISSET(it->second->getSocketFD(),&_sockets))
-     {
-     if(!it->second->recv(tmpPtr, size))
-     {
-     std::cerr << "ComController Error: recv failure, readSlaves, node " << it->first << std::endl;
-     _CCError = true;
-     ret = false;
-     break;
-     }
-     readMap[it->first] = true;
-     nodesRead++;
-     }
-     tmpPtr += size;
-     }
-     }*/
+        size_t needed = (size_t)size * _numSlaves;
+        if(_slaveRecvBuffer.size() < needed)
+        {
+            _slaveRecvBuffer.resize(needed);
+        }
+        recBuf = &_slaveRecvBuffer[0];
+    }
+
+    if(_parallelIO)
+    {
+        return parallelSlaveIO(false,recBuf,size);
+    }
+
+    bool ret = true;
 
     char * tmpPtr = recBuf;
-    for(std::map<int,CVRSocket *>::iterator it = _slaveSockets.begin();
-            it != _slaveSockets.end(); it++)
+    for(int i = 0; i < _slaveSocketList.size(); i++)
     {
-        if(!it->second->recv(tmpPtr,size))
+        if(!linkRecv(_slaveSocketList[i],_slaveShmList[i],tmpPtr,size))
         {
             std::cerr << "ComController Error: recv failure, readSlaves, node "
-                    << it->first << std::endl;
+                    << _slaveNodeList[i] << std::endl;
             _CCError = true;
             ret = false;
         }
-        tmpPtr += size;
+        tmpPtr += size;
+    }
+
+    return ret;
+}
+
+bool ComController::sendMaster(void * data, int size)
+{
+    if(_isMaster || !data || _CCError)
+    {
+        return false;
+    }
+
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
+    if(!size)
+    {
+        return true;
+    }
+
+    if(!linkSend(_masterSocket,_masterShm,data,size))
+    {
+        std::cerr << "ComController Error: send failure, sendMaster."
+                << std::endl;
+        _CCError = true;
+        return false;
+    }
+    return true;
+}
+
+bool ComController::sync()
+{
+    if(_CCError)
+    {
+        return false;
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    char msg = 'n';
+    if(_syncTopology == SYNC_TREE)
+    {
+        if(!treeSync())
+        {
+            _CCError = true;
+        }
+    }
+    else if(_isMaster)
+    {
+        if(_numSlaves > 0)
+        {
+            char * resp = new char[_numSlaves];
+            if(!readSlaves(resp,sizeof(char)) || !sendSlaves(&msg,sizeof(char)))
+            {
+                _CCError = true;
+            }
+            delete[] resp;
+        }
+
+    }
+    else
+    {
+        msg = (char)_slaveNum;
+        if(!sendMaster(&msg,sizeof(char)) || !readMaster(&msg,sizeof(char)))
+        {
+            _CCError = true;
+        }
+    }
+
+    _lastSyncWait = osg::Timer::instance()->delta_s(start,
+            osg::Timer::instance()->tick());
+    double waitms = _lastSyncWait * 1000.0;
+    int bucket = 0;
+    while(bucket < _syncWaitBounds.size() && waitms >= _syncWaitBounds[bucket])
+    {
+        bucket++;
+    }
+    _syncWaitHistogram[bucket]++;
+
+    return _CCError;
+}
+
+bool ComController::treeSync()
+{
+    if(!frameSyncBoundary())
+    {
+        return false;
+    }
+
+    char msg = 'n';
+
+    // wait for the whole subtree to arrive
+    for(int i = 0; i < _barrierChildren.size(); i++)
+    {
+        if(!linkRecv(_barrierChildren[i],_barrierChildShm[i],&msg,
+                sizeof(char)))
+        {
+            std::cerr << "ComController Error: recv failure, tree sync."
+                    << std::endl;
+            return false;
+        }
+    }
+
+    if(_barrierParent)
+    {
+        if(!linkSend(_barrierParent,_barrierParentShm,&msg,sizeof(char))
+                || !linkRecv(_barrierParent,_barrierParentShm,&msg,
+                        sizeof(char)))
+        {
+            std::cerr << "ComController Error: parent failure, tree sync."
+                    << std::endl;
+            return false;
+        }
+    }
+
+    // release the subtree
+    for(int i = 0; i < _barrierChildren.size(); i++)
+    {
+        if(!linkSend(_barrierChildren[i],_barrierChildShm[i],&msg,
+                sizeof(char)))
+        {
+            std::cerr << "ComController Error: send failure, tree sync."
+                    << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ComController::resetSyncWaitHistogram()
+{
+    _syncWaitHistogram.assign(_syncWaitBounds.size() + 1,0);
+}
+
+bool ComController::setupBarrier()
+{
+    struct BarrierInit
+    {
+            int topology;
+            int arity;
+    } bi;
+
+    if(_isMaster)
+    {
+        std::string type = ConfigManager::getEntry("type",
+                "MultiPC.SyncBarrier","flat");
+        bi.topology = (type == "tree" && _numSlaves > 1) ? SYNC_TREE : SYNC_FLAT;
+        bi.arity = ConfigManager::getInt("arity","MultiPC.SyncBarrier",2);
+        if(bi.arity < 1)
+        {
+            bi.arity = 1;
+        }
+        if(!_numSlaves)
+        {
+            return true;
+        }
+        sendSlaves(&bi,sizeof(struct BarrierInit));
+    }
+    else
+    {
+        readMaster(&bi,sizeof(struct BarrierInit));
+    }
+
+    if(bi.topology != SYNC_TREE)
+    {
+        return true;
+    }
+
+    _barrierArity = bi.arity;
+    int numNodes = _numSlaves + 1;
+
+    // rank 0 is the master, slaves are ranked in node number order
+    std::vector<int> nodeRanks(_numSlaves);
+    if(_isMaster)
+    {
+        for(int i = 0; i < _numSlaves; i++)
+        {
+            nodeRanks[i] = _slaveNodeList[i];
+        }
+        sendSlaves(&nodeRanks[0],_numSlaves * sizeof(int));
+    }
+    else
+    {
+        readMaster(&nodeRanks[0],_numSlaves * sizeof(int));
+    }
+
+    int myRank = 0;
+    if(!_isMaster)
+    {
+        for(int i = 0; i < _numSlaves; i++)
+        {
+            if(nodeRanks[i] == _slaveNum)
+            {
+                myRank = i + 1;
+                break;
+            }
+        }
+    }
+
+    int firstChild = myRank * _barrierArity + 1;
+    int numChildren = std::max(0,
+            std::min(_barrierArity,numNodes - firstChild));
+    if(!_isMaster && !myRank)
+    {
+        numChildren = 0;
+    }
+
+    int basePort = ConfigManager::getInt("port","MultiPC.SyncBarrier",11200);
+
+    MultiListenSocket * listenSocket = NULL;
+    std::vector<BarrierAddress> addresses(numNodes);
+    bool ok = true;
+
+    if(_isMaster)
+    {
+        // master children are reached through the existing slave sockets
+        for(int i = 0; i < numChildren; i++)
+        {
+            _barrierChildren.push_back(_slaveSocketList[firstChild + i - 1]);
+            _barrierChildShm.push_back(_slaveShmList[firstChild + i - 1]);
+        }
+
+        readSlaves(&addresses[1],sizeof(struct BarrierAddress));
+        sendSlaves(&addresses[0],numNodes * sizeof(struct BarrierAddress));
+    }
+    else
+    {
+        BarrierAddress myAddress;
+        memset(&myAddress,0,sizeof(struct BarrierAddress));
+        strncpy(myAddress.host,CalVR::instance()->getHostName().c_str(),255);
+        myAddress.port = 0;
+        if(numChildren)
+        {
+            // unique port per rank, several nodes may share a host
+            myAddress.port = basePort + myRank;
+            listenSocket = new MultiListenSocket(myAddress.port,numChildren);
+            if(!listenSocket->setup())
+            {
+                std::cerr
+                        << "ComController Error: unable to listen for barrier children on port "
+                        << myAddress.port << std::endl;
+                ok = false;
+            }
+        }
+
+        sendMaster(&myAddress,sizeof(struct BarrierAddress));
+        readMaster(&addresses[0],numNodes * sizeof(struct BarrierAddress));
+
+        int parentRank = (myRank - 1) / _barrierArity;
+        if(!myRank)
+        {
+            ok = false;
+        }
+        else if(parentRank == 0)
+        {
+            _barrierParent = _masterSocket;
+            _barrierParentShm = _masterShm;
+        }
+        else if(addresses[parentRank].port)
+        {
+            CVRSocket * sock = new CVRSocket(CONNECT,
+                    addresses[parentRank].host,addresses[parentRank].port);
+            if(sock->valid() && sock->connect(30)
+                    && sock->send(&myRank,sizeof(int))
+                    && acceptSharedMemory(sock,_barrierParentShm))
+            {
+                sock->setNoDelay(true);
+                _barrierParent = sock;
+                _barrierPeerSockets.push_back(sock);
+                if(_barrierParentShm)
+                {
+                    _barrierPeerShm.push_back(_barrierParentShm);
+                }
+            }
+            else
+            {
+                std::cerr
+                        << "ComController Error: unable to connect to barrier parent "
+                        << addresses[parentRank].host << ":"
+                        << addresses[parentRank].port << std::endl;
+                delete sock;
+                ok = false;
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+
+        int retryCount = 30;
+        while(ok && listenSocket && _barrierChildren.size() < numChildren)
+        {
+            CVRSocket * sock;
+            while((sock = listenSocket->accept()))
+            {
+                int childRank;
+                CVRSharedMemoryLink * link;
+                if(!sock->recv(&childRank,sizeof(int))
+                        || !offerSharedMemory(sock,link))
+                {
+                    delete sock;
+                    ok = false;
+                    break;
+                }
+                sock->setNoDelay(true);
+                _barrierChildren.push_back(sock);
+                _barrierChildShm.push_back(link);
+                _barrierPeerSockets.push_back(sock);
+                if(link)
+                {
+                    _barrierPeerShm.push_back(link);
+                }
+            }
+
+            if(_barrierChildren.size() < numChildren)
+            {
+                retryCount--;
+                if(!retryCount)
+                {
+                    std::cerr
+                            << "ComController Error: barrier children did not connect."
+                            << std::endl;
+                    ok = false;
+                    break;
+                }
+#ifndef WIN32
+                sleep(1);
+#else
+                Sleep(1000);
+#endif
+            }
+        }
+
+        if(listenSocket)
+        {
+            delete listenSocket;
+        }
+    }
+
+    // everyone must agree to use the tree
+    if(_isMaster)
+    {
+        bool * status = new bool[_numSlaves];
+        readSlaves(status,sizeof(bool));
+        for(int i = 0; i < _numSlaves; i++)
+        {
+            if(!status[i])
+            {
+                ok = false;
+            }
+        }
+        delete[] status;
+        sendSlaves(&ok,sizeof(bool));
+    }
+    else
+    {
+        sendMaster(&ok,sizeof(bool));
+        readMaster(&ok,sizeof(bool));
+    }
+
+    if(ok)
+    {
+        _syncTopology = SYNC_TREE;
+        std::cerr << "ComController: using tree sync barrier, arity "
+                << _barrierArity << std::endl;
+    }
+    else
+    {
+        _barrierChildren.clear();
+        _barrierChildShm.clear();
+        _barrierParent = NULL;
+        _barrierParentShm = NULL;
+        for(int i = 0; i < _barrierPeerSockets.size(); i++)
+        {
+            delete _barrierPeerSockets[i];
+        }
+        _barrierPeerSockets.clear();
+        for(int i = 0; i < _barrierPeerShm.size(); i++)
+        {
+            delete _barrierPeerShm[i];
+        }
+        _barrierPeerShm.clear();
+        std::cerr
+                << "ComController: tree sync barrier setup failed, using flat barrier."
+                << std::endl;
+    }
+
+    return ok;
+}
+
+bool ComController::addFrameSyncSection(int section, void * data, int size)
+{
+    if(!_isMaster || (!data && size) || size < 0 || _CCError)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < _frameSyncSections.size(); i++)
+    {
+        if(_frameSyncSections[i].type == section)
+        {
+            if(!frameSyncBoundary())
+            {
+                return false;
+            }
+            break;
+        }
+    }
+
+    FrameSyncSection fss;
+    fss.type = section;
+    fss.offset = _frameSyncData.size();
+    fss.size = size;
+    _frameSyncSections.push_back(fss);
+
+    if(size)
+    {
+        _frameSyncData.insert(_frameSyncData.end(),(char*)data,
+                ((char*)data) + size);
+    }
+
+    return true;
+}
+
+bool ComController::readFrameSyncSection(int section, void * data, int size)
+{
+    if(_isMaster || (!data && size) || _CCError)
+    {
+        return false;
+    }
+
+    int sectionSize;
+    char * sectionData = getFrameSyncSection(section,sectionSize);
+    if(!sectionData)
+    {
+        return false;
+    }
+
+    if(sectionSize != size)
+    {
+        std::cerr << "ComController Error: frame sync section " << section
+                << " size mismatch, expected " << size << " got "
+                << sectionSize << std::endl;
+        _CCError = true;
+        return false;
+    }
+
+    if(size)
+    {
+        memcpy(data,sectionData,size);
+    }
+
+    return true;
+}
+
+char * ComController::getFrameSyncSection(int section, int & size)
+{
+    size = 0;
+
+    if(_isMaster || _CCError)
+    {
+        return NULL;
+    }
+
+    if(_frameSyncReceived)
+    {
+        if(_frameSyncMessageFrame != _frameSyncFrame)
+        {
+            _frameSyncReceived = false;
+        }
+        else
+        {
+            // reading a section twice in a frame means the master started a
+            // new message in the same frame
+            for(int i = 0; i < _frameSyncSections.size(); i++)
+            {
+                if(_frameSyncSections[i].type == section)
+                {
+                    if(_frameSyncSectionRead[i])
+                    {
+                        _frameSyncReceived = false;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    if(!_frameSyncReceived)
+    {
+        // skip messages from frames where this node read no sections
+        do
+        {
+            if(!recvFrameSync())
+            {
+                return NULL;
+            }
+        }
+        while((int)(_frameSyncMessageFrame - _frameSyncFrame) < 0);
+
+        if(_frameSyncMessageFrame != _frameSyncFrame)
+        {
+            std::cerr << "ComController Error: frame sync message for frame "
+                    << _frameSyncMessageFrame << " read in frame "
+                    << _frameSyncFrame << std::endl;
+            _CCError = true;
+            return NULL;
+        }
+    }
+
+    for(int i = 0; i < _frameSyncSections.size(); i++)
+    {
+        if(_frameSyncSections[i].type == section)
+        {
+            _frameSyncSectionRead[i] = true;
+            size = _frameSyncSections[i].size;
+            return &_frameSyncMessage[0]
+                    + _frameSyncSections.size()
+                            * sizeof(struct FrameSyncSection)
+                    + _frameSyncSections[i].offset;
+        }
+    }
+
+    std::cerr << "ComController Error: frame sync section " << section
+            << " not found in message." << std::endl;
+    _CCError = true;
+    return NULL;
+}
+
+bool ComController::flushFrameSync()
+{
+    if(_CCError)
+    {
+        return false;
+    }
+
+    return frameSyncBoundary();
+}
+
+bool ComController::startFrameSync(unsigned int frame)
+{
+    if(_CCError)
+    {
+        return false;
+    }
+
+    // pending sections belong to the last frame's message
+    bool ret = true;
+    if(_isMaster && _frameSyncSections.size())
+    {
+        ret = frameSyncBoundary();
+    }
+
+    _frameSyncFrame = frame;
+    return ret;
+}
+
+bool ComController::frameSyncBoundary(bool multicastSend)
+{
+    if(!_isMaster)
+    {
+        _frameSyncReceived = false;
+        return true;
+    }
+
+    // repairs go over the tcp links, so they have to be done before anything
+    // else is sent or read there
+    if(!multicastSend || _frameSyncSections.size())
+    {
+        if(!collectMulticastAcks())
+        {
+            return false;
+        }
+    }
+
+    if(!_frameSyncSections.size())
+    {
+        return true;
+    }
+
+    FrameSyncHeader fsh;
+    fsh.numSections = _frameSyncSections.size();
+    fsh.frame = _frameSyncFrame;
+    fsh.size = fsh.numSections * sizeof(struct FrameSyncSection)
+            + _frameSyncData.size();
+
+    if(!_parallelIO && !_CCError)
+    {
+        // gather the pieces straight from their buffers, no assembly copy
+        SocketBuffer buffers[3];
+        buffers[0].data = &fsh;
+        buffers[0].len = sizeof(struct FrameSyncHeader);
+        buffers[1].data = &_frameSyncSections[0];
+        buffers[1].len = fsh.numSections * sizeof(struct FrameSyncSection);
+        buffers[2].data = _frameSyncData.size() ? &_frameSyncData[0] : NULL;
+        buffers[2].len = _frameSyncData.size();
+
+        bool ret = true;
+        for(int i = 0; i < _slaveSocketList.size(); i++)
+        {
+            bool sent;
+            if(_slaveShmList[i])
+            {
+                sent = _slaveShmList[i]->sendv(buffers,3);
+            }
+            else
+            {
+                sent = _slaveSocketList[i]->sendv(buffers,3);
+            }
+
+            if(!sent)
+            {
+                std::cerr
+                        << "ComController Error: send failure, frame sync, to node "
+                        << _slaveNodeList[i] << std::endl;
+                _CCError = true;
+                ret = false;
+            }
+        }
+
+        _frameSyncSections.clear();
+        _frameSyncData.clear();
+        return ret;
     }
-    if(!data)
+
+    _frameSyncMessage.resize(sizeof(struct FrameSyncHeader) + fsh.size);
+    char * msgPtr = &_frameSyncMessage[0];
+    memcpy(msgPtr,&fsh,sizeof(struct FrameSyncHeader));
+    msgPtr += sizeof(struct FrameSyncHeader);
+    memcpy(msgPtr,&_frameSyncSections[0],
+            fsh.numSections * sizeof(struct FrameSyncSection));
+    msgPtr += fsh.numSections * sizeof(struct FrameSyncSection);
+    if(_frameSyncData.size())
     {
-        delete[] recBuf;
+        memcpy(msgPtr,&_frameSyncData[0],_frameSyncData.size());
     }
 
-    return ret;
+    // clear first, sendSlaves calls back into this function
+    _frameSyncSections.clear();
+    _frameSyncData.clear();
+
+    return sendSlaves(&_frameSyncMessage[0],_frameSyncMessage.size());
 }
 
-bool ComController::sendMaster(void * data, int size)
+bool ComController::recvFrameSync()
 {
-    if(_isMaster || !data || _CCError)
+    FrameSyncHeader fsh;
+    if(!readMaster(&fsh,sizeof(struct FrameSyncHeader)))
     {
         return false;
     }
 
-    if(!size)
+    int tableSize = fsh.numSections * sizeof(struct FrameSyncSection);
+    if(fsh.numSections <= 0 || fsh.size < tableSize)
     {
-        return true;
+        std::cerr << "ComController Error: invalid frame sync header."
+                << std::endl;
+        _CCError = true;
+        return false;
     }
 
-    if(!_masterSocket->send(data,size))
+    _frameSyncMessage.resize(fsh.size);
+    if(!readMaster(&_frameSyncMessage[0],fsh.size))
     {
-        std::cerr << "ComController Error: send failure, sendMaster."
-                << std::endl;
-        _CCError = true;
         return false;
     }
+
+    _frameSyncSections.resize(fsh.numSections);
+    memcpy(&_frameSyncSections[0],&_frameSyncMessage[0],tableSize);
+    _frameSyncSectionRead.assign(fsh.numSections,false);
+
+    _frameSyncMessageFrame = fsh.frame;
+    _frameSyncReceived = true;
     return true;
 }
 
-bool ComController::sync()
+void ComController::setupParallelIO()
 {
-    if(_CCError)
+    _parallelIO = false;
+
+#ifdef __linux__
+    if(_slaveSocketList.size() < 2
+            || !ConfigManager::getBool("value","MultiPC.ParallelIO",true,NULL))
     {
-        return false;
+        return;
     }
 
-    char msg = 'n';
-    if(_isMaster)
+    _epollFD = epoll_create(_slaveSocketList.size());
+    if(_epollFD < 0)
     {
-        if(_numSlaves > 0)
+        perror("epoll_create");
+        return;
+    }
+
+    for(unsigned int i = 0; i < _slaveSocketList.size(); i++)
+    {
+        // edge triggered, a socket is only waited on after it would block
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.u32 = i;
+        if(epoll_ctl(_epollFD,EPOLL_CTL_ADD,
+                _slaveSocketList[i]->getSocketFD(),&ev) < 0)
         {
-            char * resp = new char[_numSlaves];
-            if(!readSlaves(resp,sizeof(char)) || !sendSlaves(&msg,sizeof(char)))
+            perror("epoll_ctl");
+            close(_epollFD);
+            _epollFD = -1;
+            return;
+        }
+    }
+
+    _slaveIOProgress.resize(_slaveSocketList.size());
+    _slaveIOReady.resize(_slaveSocketList.size());
+    _parallelIO = true;
+    std::cerr << "ComController: using parallel slave socket io." << std::endl;
+#endif
+}
+
+bool ComController::parallelSlaveIO(bool sending, char * data, int size)
+{
+#ifdef __linux__
+    int numSockets = _slaveSocketList.size();
+    int remaining = numSockets;
+    bool ret = true;
+
+    for(int i = 0; i < numSockets; i++)
+    {
+        _slaveIOProgress[i] = 0;
+        _slaveIOReady[i] = true;
+    }
+
+    // shared memory links are not polled, send to them before the sockets
+    // and read from them after
+    for(int i = 0; i < numSockets; i++)
+    {
+        if(!_slaveShmList[i])
+        {
+            continue;
+        }
+
+        _slaveIOProgress[i] = size;
+        remaining--;
+        if(sending && !_slaveShmList[i]->send(data,size))
+        {
+            std::cerr << "ComController Error: send failure, parallel io, node "
+                    << _slaveNodeList[i] << std::endl;
+            _CCError = true;
+            ret = false;
+        }
+    }
+
+    struct epoll_event events[64];
+
+    while(remaining)
+    {
+        for(int i = 0; i < numSockets; i++)
+        {
+            while(_slaveIOReady[i] && _slaveIOProgress[i] < size)
             {
-                _CCError = true;
+                int fd = _slaveSocketList[i]->getSocketFD();
+                ssize_t result;
+                if(sending)
+                {
+                    result = ::send(fd,data + _slaveIOProgress[i],
+                            size - _slaveIOProgress[i],
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+                }
+                else
+                {
+                    result = ::recv(fd,data + (i * size) + _slaveIOProgress[i],
+                            size - _slaveIOProgress[i],MSG_DONTWAIT);
+                }
+
+                if(result > 0)
+                {
+                    _slaveIOProgress[i] += result;
+                    if(_slaveIOProgress[i] == size)
+                    {
+                        remaining--;
+                    }
+                }
+                else if(result < 0
+                        && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    _slaveIOReady[i] = false;
+                }
+                else if(result < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                else
+                {
+                    std::cerr << "ComController Error: "
+                            << (sending ? "send" : "recv")
+                            << " failure, parallel io, node "
+                            << _slaveNodeList[i] << std::endl;
+                    _CCError = true;
+                    ret = false;
+                    // stop working on this socket
+                    _slaveIOProgress[i] = size;
+                    remaining--;
+                }
             }
-            delete[] resp;
         }
 
+        if(!remaining)
+        {
+            break;
+        }
+
+        int numEvents = epoll_wait(_epollFD,events,64,-1);
+        if(numEvents < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            _CCError = true;
+            return false;
+        }
+
+        for(int i = 0; i < numEvents; i++)
+        {
+            if(events[i].events & (sending ? EPOLLOUT : EPOLLIN))
+            {
+                _slaveIOReady[events[i].data.u32] = true;
+            }
+            if(events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                // let the io call report the error
+                _slaveIOReady[events[i].data.u32] = true;
+            }
+        }
     }
-    else
+
+    for(int i = 0; i < numSockets && !sending; i++)
     {
-        msg = (char)_slaveNum;
-        if(!sendMaster(&msg,sizeof(char)) || !readMaster(&msg,sizeof(char)))
+        if(_slaveShmList[i]
+                && !_slaveShmList[i]->recv(data + (i * size),size))
         {
+            std::cerr << "ComController Error: recv failure, parallel io, node "
+                    << _slaveNodeList[i] << std::endl;
             _CCError = true;
+            ret = false;
         }
     }
 
-    return _CCError;
+    return ret;
+#else
+    return false;
+#endif
 }
 
 bool ComController::isMaster()
@@ -468,6 +1664,10 @@ bool ComController::setupConnections()
         std::stringstream ss;
         ss << application << " --node-number " << it->first << " --master-interface "
                 << _masterInterface << " --master-port " << baseport;
+        if(ConfigManager::getSnapshotMode() == ConfigManager::SNAPSHOT_SEND)
+        {
+            ss << " --config-snapshot";
+        }
         size_t location = it->second.find("CalVR");
         if(location != std::string::npos)
         {
@@ -556,6 +1756,30 @@ bool ComController::setupConnections()
     delete _listenSocket;
     _listenSocket = NULL;
 
+    _slaveSocketList.clear();
+    _slaveNodeList.clear();
+    for(std::map<int,CVRSocket *>::iterator it = _slaveSockets.begin();
+            it != _slaveSockets.end(); it++)
+    {
+        _slaveSocketList.push_back(it->second);
+        _slaveNodeList.push_back(it->first);
+    }
+    _slaveShmList.assign(_slaveSocketList.size(),NULL);
+
+    // the parallel io path sends with plain non-blocking calls, zero copy
+    // applies to the serial sends
+    int zeroCopyMin = ConfigManager::getInt("minSize","MultiPC.ZeroCopy",
+            1024 * 1024);
+    for(unsigned int i = 0; i < _slaveSocketList.size(); i++)
+    {
+        _slaveSocketList[i]->setZeroCopy(std::max(zeroCopyMin,0));
+    }
+
+    if(ok)
+    {
+        setupParallelIO();
+    }
+
     struct InitMsg im;
     im.ok = ok;
     sendSlaves(&im,sizeof(struct InitMsg));
@@ -600,17 +1824,291 @@ bool ComController::connectMaster()
     return im.ok;
 }
 
+bool ComController::syncConfigSnapshot()
+{
+    int size = 0;
+    if(_isMaster)
+    {
+        std::vector<char> data;
+        if(ConfigManager::getSnapshot(data))
+        {
+            size = data.size();
+        }
+        else
+        {
+            std::cerr << "ComController Error: no config snapshot to send."
+                    << std::endl;
+        }
+
+        if(!sendSlaves(&size,sizeof(int)))
+        {
+            return false;
+        }
+        if(size && !sendSlaves(&data[0],size))
+        {
+            return false;
+        }
+        return size > 0;
+    }
+
+    if(!readMaster(&size,sizeof(int)))
+    {
+        return false;
+    }
+
+    if(size <= 0)
+    {
+        std::cerr << "ComController Error: master did not send a config snapshot."
+                << std::endl;
+        return false;
+    }
+
+    std::vector<char> data(size);
+    if(!readMaster(&data[0],size))
+    {
+        return false;
+    }
+
+    if(!ConfigManager::loadSnapshot(&data[0],size))
+    {
+        std::cerr << "ComController Error: unable to load config snapshot."
+                << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ComController::setupSharedMemory()
+{
+#ifdef __linux__
+    _shmEnabled = ConfigManager::getBool("value","MultiPC.SharedMemory",true,
+            NULL);
+#else
+    _shmEnabled = false;
+#endif
+    _shmRingSize = ConfigManager::getInt("ringSize","MultiPC.SharedMemory",
+            4 * 1024 * 1024);
+    _shmSpinCount = ConfigManager::getInt("spinCount","MultiPC.SharedMemory",
+            -1);
+
+    if(!_numSlaves)
+    {
+        return true;
+    }
+
+    // each slave is asked in turn, nodes on another host keep using tcp
+    if(_isMaster)
+    {
+        int numLinks = 0;
+        for(int i = 0; i < _slaveSocketList.size(); i++)
+        {
+            if(!offerSharedMemory(_slaveSocketList[i],_slaveShmList[i]))
+            {
+                std::cerr
+                        << "ComController Error: shared memory setup failure, node "
+                        << _slaveNodeList[i] << std::endl;
+                return false;
+            }
+            if(_slaveShmList[i])
+            {
+                numLinks++;
+            }
+        }
+
+        if(numLinks)
+        {
+            std::cerr << "ComController: using shared memory for " << numLinks
+                    << " local node(s)." << std::endl;
+        }
+        return true;
+    }
+
+    if(!acceptSharedMemory(_masterSocket,_masterShm))
+    {
+        std::cerr << "ComController Error: shared memory setup failure."
+                << std::endl;
+        return false;
+    }
+
+    if(_masterShm)
+    {
+        std::cerr << "ComController: using shared memory link to master."
+                << std::endl;
+    }
+    return true;
+}
+
+bool ComController::offerSharedMemory(CVRSocket * socket,
+        CVRSharedMemoryLink *& link)
+{
+    link = NULL;
+
+    SharedMemoryHello hello;
+    if(!socket->recv(&hello,sizeof(struct SharedMemoryHello)))
+    {
+        return false;
+    }
+    hello.host[255] = '\0';
+
+    SharedMemoryOffer offer;
+    memset(&offer,0,sizeof(struct SharedMemoryOffer));
+
+#ifdef __linux__
+    if(_shmEnabled && CalVR::instance()->getHostName() == hello.host)
+    {
+        std::stringstream ss;
+        ss << "/calvr-" << getpid() << "-" << _shmCount++;
+
+        link = new CVRSharedMemoryLink();
+        if(link->create(ss.str(),_shmRingSize))
+        {
+            strncpy(offer.name,ss.str().c_str(),63);
+            offer.key = link->getKey();
+        }
+        else
+        {
+            delete link;
+            link = NULL;
+        }
+    }
+#endif
+
+    bool accepted = false;
+    if(!socket->send(&offer,sizeof(struct SharedMemoryOffer))
+            || !socket->recv(&accepted,sizeof(bool)))
+    {
+        if(link)
+        {
+            delete link;
+            link = NULL;
+        }
+        return false;
+    }
+
+    if(link && !accepted)
+    {
+        delete link;
+        link = NULL;
+    }
+
+    if(link)
+    {
+        // both sides have it mapped, nothing else needs the name
+        link->unlink();
+        if(_shmSpinCount >= 0)
+        {
+            link->setSpinCount(_shmSpinCount);
+        }
+    }
+
+    return true;
+}
+
+bool ComController::acceptSharedMemory(CVRSocket * socket,
+        CVRSharedMemoryLink *& link)
+{
+    link = NULL;
+
+    SharedMemoryHello hello;
+    memset(&hello,0,sizeof(struct SharedMemoryHello));
+    strncpy(hello.host,CalVR::instance()->getHostName().c_str(),255);
+
+    SharedMemoryOffer offer;
+    if(!socket->send(&hello,sizeof(struct SharedMemoryHello))
+            || !socket->recv(&offer,sizeof(struct SharedMemoryOffer)))
+    {
+        return false;
+    }
+    offer.name[63] = '\0';
+
+    // opening also checks the key, in case host names are not unique
+    bool accepted = false;
+    if(offer.name[0])
+    {
+        link = new CVRSharedMemoryLink();
+        accepted = link->open(offer.name,offer.key);
+        if(!accepted)
+        {
+            delete link;
+            link = NULL;
+        }
+    }
+
+    if(!socket->send(&accepted,sizeof(bool)))
+    {
+        if(link)
+        {
+            delete link;
+            link = NULL;
+        }
+        return false;
+    }
+
+    if(link && _shmSpinCount >= 0)
+    {
+        link->setSpinCount(_shmSpinCount);
+    }
+
+    return true;
+}
+
 void ComController::setupMulticast()
 {
-    if(_numSlaves
-            && ConfigManager::getBool("value","MultiPC.Multicast",false,NULL))
+    // the wire format comes from the master's config, so nodes can not
+    // disagree on it
+    struct MulticastInit
+    {
+            bool enabled;
+            char groupAddress[64];
+            int port;
+            bool reliable;
+            int fragmentSize;
+            int repairTimeout;
+            int lossTimeout;
+    } mi;
+
+    memset(&mi,0,sizeof(struct MulticastInit));
+    if(_numSlaves && _isMaster)
+    {
+        mi.enabled = ConfigManager::getBool("value","MultiPC.Multicast",false,
+                NULL);
+        strncpy(mi.groupAddress,ConfigManager::getEntry("groupAddress",
+                "MultiPC.Multicast","225.0.0.51").c_str(),63);
+        mi.port = ConfigManager::getInt("port","MultiPC.Multicast",12000);
+        mi.reliable = ConfigManager::getBool("reliable","MultiPC.Multicast",
+                false,NULL);
+        mi.fragmentSize = ConfigManager::getInt("fragmentSize",
+                "MultiPC.Multicast",1400);
+        mi.repairTimeout = ConfigManager::getInt("repairTimeout",
+                "MultiPC.Multicast",20);
+        mi.lossTimeout = ConfigManager::getInt("lossTimeout",
+                "MultiPC.Multicast",1000);
+        if(mi.fragmentSize <= 0)
+        {
+            mi.fragmentSize = 1400;
+        }
+        sendSlaves(&mi,sizeof(struct MulticastInit));
+    }
+    else if(_numSlaves)
+    {
+        readMaster(&mi,sizeof(struct MulticastInit));
+    }
+
+    if(mi.enabled)
     {
-        std::string groupAddress = ConfigManager::getEntry("groupAddress",
-                "MultiPC.Multicast","225.0.0.51");
-        int port = ConfigManager::getInt("port","MultiPC.Multicast",12000);
+        mi.groupAddress[63] = '\0';
+        std::string groupAddress = mi.groupAddress;
+        int port = mi.port;
         bool found;
         std::string masterInterface = ConfigManager::getEntry("masterInterface",
                 "MultiPC.Multicast","",&found);
+        _multicastReliable = mi.reliable;
+        _mcFragmentSize = mi.fragmentSize;
+        _mcRepairTimeout = mi.repairTimeout;
+        _mcLossTimeout = mi.lossTimeout;
+        _mcPacketBuffer.resize(sizeof(struct MCFragmentHeader)
+                + _mcFragmentSize);
         if(isMaster())
         {
             _slaveMCSocket = new CVRMulticastSocket(CVRMulticastSocket::SEND,
@@ -637,12 +2135,22 @@ void ComController::setupMulticast()
             _masterMCSocket = new CVRMulticastSocket(CVRMulticastSocket::RECV,
                     groupAddress,port);
             _multicastUsable = _masterMCSocket->valid();
+            if(_multicastUsable && _multicastReliable)
+            {
+                // room to queue whole frames of fragments
+                int bufSize = ConfigManager::getInt("receiveBuffer",
+                        "MultiPC.Multicast",4 * 1024 * 1024);
+                _masterMCSocket->setsockopt(SOL_SOCKET,SO_RCVBUF,&bufSize,
+                        sizeof(int));
+            }
             sendMaster(&_multicastUsable,sizeof(bool));
             readMaster(&_multicastUsable,sizeof(bool));
         }
         if(_multicastUsable)
         {
-            std::cerr << "Multicast setup." << std::endl;
+            std::cerr << "Multicast setup"
+                    << (_multicastReliable ? " (reliable)." : ".")
+                    << std::endl;
         }
         else
         {
@@ -1,5 +1,6 @@
 #include <cvrKernel/FileHandler.h>
 #include <cvrKernel/SceneManager.h>
+#include <cvrKernel/AssetCache.h>
 
 #include <osgDB/ReadFile>
 
@@ -74,7 +75,8 @@ bool FileHandler::loadFile(std::string file)
 
     // if all else fails
 
-    osg::ref_ptr<osg::Node> loadedModel = osgDB::readNodeFile(file);
+    osg::ref_ptr<osg::Node> loadedModel = AssetCache::instance()->readNodeFile(
+            file);
 
     if(loadedModel)
     {
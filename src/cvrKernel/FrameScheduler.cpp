@@ -0,0 +1,352 @@
+#include <cvrKernel/FrameScheduler.h>
+#include <cvrKernel/CVRViewer.h>
+#include <cvrConfig/ConfigManager.h>
+
+#include <osg/Timer>
+#include <osg/Stats>
+
+#include <iostream>
+#include <map>
+
+using namespace cvr;
+
+FrameScheduler * FrameScheduler::_myPtr = NULL;
+
+FrameScheduler::FrameScheduler()
+{
+    _scheduleValid = false;
+    _stagesLeft = 0;
+    _quit = false;
+}
+
+FrameScheduler::~FrameScheduler()
+{
+    _lock.lock();
+    _quit = true;
+    _workCondition.broadcast();
+    _lock.unlock();
+
+    for(int i = 0; i < _threads.size(); i++)
+    {
+        _threads[i]->join();
+        delete _threads[i];
+    }
+    _threads.clear();
+
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        delete _stages[i].callback;
+    }
+}
+
+FrameScheduler * FrameScheduler::instance()
+{
+    if(!_myPtr)
+    {
+        _myPtr = new FrameScheduler();
+    }
+    return _myPtr;
+}
+
+bool FrameScheduler::init()
+{
+    int threads = ConfigManager::getInt("threads","FrameScheduler",1);
+
+    for(int i = 0; i < threads; i++)
+    {
+        _threads.push_back(new WorkerThread(this));
+        _threads.back()->start();
+    }
+
+    _scheduleValid = false;
+
+    return true;
+}
+
+bool FrameScheduler::addStage(const std::string & name,
+        StageCallback * callback, const std::string & after, bool clusterSync,
+        const std::string & statsName)
+{
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        if(_stages[i].name == name)
+        {
+            std::cerr << "FrameScheduler: Error: stage " << name
+                    << " already exists." << std::endl;
+            return false;
+        }
+    }
+
+    Stage stage;
+    stage.name = name;
+    stage.callback = callback;
+    stage.after = after;
+    stage.clusterSync = clusterSync;
+    stage.statsName = statsName;
+    stage.numDependencies = 0;
+    stage.onMain = true;
+    stage.waiting = 0;
+    stage.beginTime = stage.endTime = 0.0;
+    _stages.push_back(stage);
+
+    _scheduleValid = false;
+    return true;
+}
+
+void FrameScheduler::removeStage(const std::string & name)
+{
+    for(std::vector<Stage>::iterator it = _stages.begin();
+            it != _stages.end(); it++)
+    {
+        if(it->name == name)
+        {
+            delete it->callback;
+            _stages.erase(it);
+            _scheduleValid = false;
+            return;
+        }
+    }
+}
+
+void FrameScheduler::runFrame()
+{
+    if(!_scheduleValid)
+    {
+        buildSchedule();
+        _scheduleValid = true;
+    }
+
+    _lock.lock();
+    _stagesLeft = _stages.size();
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        _stages[i].waiting = _stages[i].numDependencies;
+        if(!_stages[i].waiting && !_stages[i].onMain)
+        {
+            _readyQueue.push_back(i);
+        }
+    }
+    if(!_readyQueue.empty())
+    {
+        _workCondition.broadcast();
+    }
+
+    // main thread stages go in the fixed order, help with worker stages
+    // while waiting on their dependencies
+    for(int i = 0; i < _mainOrder.size(); i++)
+    {
+        int stage = _mainOrder[i];
+        while(_stages[stage].waiting)
+        {
+            if(!runReadyStage())
+            {
+                _doneCondition.wait(&_lock);
+            }
+        }
+
+        _lock.unlock();
+        runStage(stage);
+        stageDone(stage);
+        _lock.lock();
+    }
+
+    while(_stagesLeft)
+    {
+        if(!runReadyStage())
+        {
+            _doneCondition.wait(&_lock);
+        }
+    }
+    _lock.unlock();
+
+    osg::Stats * stats = CVRViewer::instance()->getViewerStats();
+    if(stats && stats->collectStats("CalVRStatsAdvanced"))
+    {
+        int frame =
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber();
+        for(int i = 0; i < _stages.size(); i++)
+        {
+            if(_stages[i].statsName.empty())
+            {
+                continue;
+            }
+
+            stats->setAttribute(frame,_stages[i].statsName + " begin time",
+                    _stages[i].beginTime);
+            stats->setAttribute(frame,_stages[i].statsName + " end time",
+                    _stages[i].endTime);
+            stats->setAttribute(frame,_stages[i].statsName + " time taken",
+                    _stages[i].endTime - _stages[i].beginTime);
+        }
+    }
+}
+
+bool FrameScheduler::buildSchedule()
+{
+    std::map<std::string,int> stageMap;
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        stageMap[_stages[i].name] = i;
+        _stages[i].dependents.clear();
+        _stages[i].numDependencies = 0;
+        _stages[i].onMain = _stages[i].clusterSync || _threads.empty();
+    }
+
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        size_t start = 0;
+        while(start < _stages[i].after.size())
+        {
+            size_t end = _stages[i].after.find(',',start);
+            if(end == std::string::npos)
+            {
+                end = _stages[i].after.size();
+            }
+
+            std::map<std::string,int>::iterator it = stageMap.find(
+                    _stages[i].after.substr(start,end - start));
+            if(it != stageMap.end() && it->second != i)
+            {
+                _stages[it->second].dependents.push_back(i);
+                _stages[i].numDependencies++;
+            }
+            start = end + 1;
+        }
+    }
+
+    // topological order, taking the first added stage that is ready each
+    // step so every node gets the same order
+    std::vector<int> waiting(_stages.size());
+    std::vector<bool> placed(_stages.size(),false);
+    for(int i = 0; i < _stages.size(); i++)
+    {
+        waiting[i] = _stages[i].numDependencies;
+    }
+
+    _mainOrder.clear();
+    int numPlaced = 0;
+    while(numPlaced < _stages.size())
+    {
+        int next = -1;
+        for(int i = 0; i < _stages.size(); i++)
+        {
+            if(!placed[i] && !waiting[i])
+            {
+                next = i;
+                break;
+            }
+        }
+
+        if(next < 0)
+        {
+            break;
+        }
+
+        placed[next] = true;
+        numPlaced++;
+        for(int i = 0; i < _stages[next].dependents.size(); i++)
+        {
+            waiting[_stages[next].dependents[i]]--;
+        }
+
+        if(_stages[next].onMain)
+        {
+            _mainOrder.push_back(next);
+        }
+    }
+
+    if(numPlaced < _stages.size())
+    {
+        std::cerr << "FrameScheduler: Error: stage dependencies form a loop, "
+                << "running all stages in the order added." << std::endl;
+        _mainOrder.clear();
+        for(int i = 0; i < _stages.size(); i++)
+        {
+            _stages[i].dependents.clear();
+            _stages[i].numDependencies = 0;
+            _stages[i].onMain = true;
+            _mainOrder.push_back(i);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+void FrameScheduler::runStage(int stage)
+{
+    _stages[stage].beginTime = osg::Timer::instance()->delta_s(
+            CVRViewer::instance()->getStartTick(),
+            osg::Timer::instance()->tick());
+
+    _stages[stage].callback->runStage();
+
+    _stages[stage].endTime = osg::Timer::instance()->delta_s(
+            CVRViewer::instance()->getStartTick(),
+            osg::Timer::instance()->tick());
+}
+
+void FrameScheduler::stageDone(int stage)
+{
+    _lock.lock();
+    _stagesLeft--;
+    for(int i = 0; i < _stages[stage].dependents.size(); i++)
+    {
+        int dependent = _stages[stage].dependents[i];
+        if(!--_stages[dependent].waiting && !_stages[dependent].onMain)
+        {
+            _readyQueue.push_back(dependent);
+            _workCondition.signal();
+        }
+    }
+    _doneCondition.broadcast();
+    _lock.unlock();
+}
+
+bool FrameScheduler::runReadyStage()
+{
+    // called with the lock held
+    if(_readyQueue.empty())
+    {
+        return false;
+    }
+
+    int stage = _readyQueue.front();
+    _readyQueue.pop_front();
+
+    _lock.unlock();
+    runStage(stage);
+    stageDone(stage);
+    _lock.lock();
+
+    return true;
+}
+
+FrameScheduler::WorkerThread::WorkerThread(FrameScheduler * scheduler)
+{
+    _scheduler = scheduler;
+}
+
+FrameScheduler::WorkerThread::~WorkerThread()
+{
+}
+
+void FrameScheduler::WorkerThread::run()
+{
+    _scheduler->_lock.lock();
+    while(true)
+    {
+        while(!_scheduler->_quit && _scheduler->_readyQueue.empty())
+        {
+            _scheduler->_workCondition.wait(&_scheduler->_lock);
+        }
+
+        if(_scheduler->_quit)
+        {
+            break;
+        }
+
+        _scheduler->runReadyStage();
+    }
+    _scheduler->_lock.unlock();
+}
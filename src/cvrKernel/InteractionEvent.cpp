@@ -1,8 +1,150 @@
 #include <cvrKernel/InteractionEvent.h>
 
+#include <OpenThreads/Mutex>
+
+#include <algorithm>
+#include <new>
+#include <cstddef>
+
 namespace cvr
 {
 
+namespace
+{
+
+/**
+ * @brief Used to find the largest alignment a fundamental type needs
+ */
+struct AlignTest
+{
+        char c;
+        union
+        {
+                long double ld;
+                long long ll;
+                double d;
+                void * p;
+                void (*f)();
+        } u;
+};
+
+}
+
+/**
+ * @brief Free list of fixed size blocks large enough for any of the
+ * core event types
+ *
+ * Each block has a header in front of it marking if it came from the pool
+ * or from the heap (for larger, plugin defined, event classes).  The header
+ * and block stride are rounded up to the largest fundamental alignment so
+ * every event is aligned like one from the heap.
+ */
+struct EventPool
+{
+        EventPool()
+        {
+            freeList = NULL;
+            size_t blockSize = sizeof(InteractionEvent);
+            blockSize = std::max(blockSize,sizeof(HandInteractionEvent));
+            blockSize = std::max(blockSize,
+                    sizeof(TrackedButtonInteractionEvent));
+            blockSize = std::max(blockSize,sizeof(MouseInteractionEvent));
+            blockSize = std::max(blockSize,sizeof(PointerInteractionEvent));
+            blockSize = std::max(blockSize,sizeof(ValuatorInteractionEvent));
+            blockSize = std::max(blockSize,sizeof(KeyboardInteractionEvent));
+            blockSize = std::max(blockSize,sizeof(PositionInteractionEvent));
+
+            size_t align = offsetof(AlignTest,u);
+            headerSize = roundUp(std::max(sizeof(size_t),sizeof(void*)),
+                    align);
+            maxSize = roundUp(blockSize,align);
+            stride = headerSize + maxSize;
+        }
+
+        static size_t roundUp(size_t size, size_t align)
+        {
+            return ((size + align - 1) / align) * align;
+        }
+
+        static const int blocksPerChunk = 64;
+
+        OpenThreads::Mutex lock;
+        void * freeList;
+        size_t headerSize; ///< bytes in front of each event
+        size_t maxSize; ///< largest event taken from the pool
+        size_t stride; ///< distance between blocks in a chunk
+};
+
+/**
+ * @brief Get the event pool
+ *
+ * The pool is never freed, events may still be deleted by other static
+ * destructors after this file's would have run.
+ */
+static EventPool * getEventPool()
+{
+    static EventPool * pool = new EventPool();
+    return pool;
+}
+
+// create the pool during static init, before any threads can race on it
+static EventPool * eventPoolInit = getEventPool();
+
+void * InteractionEvent::operator new(size_t size)
+{
+    EventPool * pool = getEventPool();
+    char * block;
+    if(size <= pool->maxSize)
+    {
+        pool->lock.lock();
+        if(!pool->freeList)
+        {
+            // chunks are never released, blocks stay on the free list
+            char * chunk = new char[pool->stride * EventPool::blocksPerChunk];
+            for(int i = 0; i < EventPool::blocksPerChunk; i++)
+            {
+                char * nextBlock = chunk + i * pool->stride;
+                *((void**)nextBlock) = pool->freeList;
+                pool->freeList = nextBlock;
+            }
+        }
+        block = (char*)pool->freeList;
+        pool->freeList = *((void**)block);
+        pool->lock.unlock();
+
+        *((size_t*)block) = 1;
+    }
+    else
+    {
+        block = (char*)::operator new(pool->headerSize + size);
+        *((size_t*)block) = 0;
+    }
+
+    return block + pool->headerSize;
+}
+
+void InteractionEvent::operator delete(void * ptr)
+{
+    if(!ptr)
+    {
+        return;
+    }
+
+    EventPool * pool = getEventPool();
+    char * block = ((char*)ptr) - pool->headerSize;
+    if(*((size_t*)block))
+    {
+        pool->lock.lock();
+        *((void**)block) = pool->freeList;
+        pool->freeList = block;
+        pool->lock.unlock();
+    }
+    else
+    {
+        ::operator delete(block);
+    }
+}
+
 const char * interactionToName(Interaction i)
 {
     switch(i)
@@ -31,6 +31,7 @@ Navigation::Navigation()
 
 Navigation::~Navigation()
 {
+    ConfigManager::removeChangeCallback(this);
 }
 
 Navigation * Navigation::instance()
@@ -128,9 +129,38 @@ bool Navigation::init()
     _floorOffset = ConfigManager::getFloat("value","FloorOffset",1500);
     _snapToGround = ConfigManager::getBool("value","SnapToGround",false,NULL);
 
+    ConfigManager::addChangeCallback(this);
+
     return true;
 }
 
+void Navigation::configChanged(const std::vector<std::string> & paths)
+{
+    if(ConfigManager::isPathChanged(paths,"FloorOffset"))
+    {
+        _floorOffset = ConfigManager::getFloat("value","FloorOffset",1500);
+    }
+
+    if(ConfigManager::isPathChanged(paths,"SnapToGround"))
+    {
+        _snapToGround = ConfigManager::getBool("value","SnapToGround",false,
+                NULL);
+    }
+
+    // the nav type itself is fixed by the tracking setup, only its settings
+    // are read again
+    for(std::map<int,NavImplementationBase*>::iterator it =
+            _navImpMap.begin(); it != _navImpMap.end(); it++)
+    {
+        std::stringstream ss;
+        ss << "Input.Hand" << it->first << ".NavType";
+        if(ConfigManager::isPathChanged(paths,ss.str()))
+        {
+            it->second->init(ss.str());
+        }
+    }
+}
+
 void Navigation::setPrimaryButtonMode(NavMode nm)
 {
     _buttonMap[0] = nm;
@@ -669,8 +699,10 @@ void NavTracker::processNav(NavMode nm, osg::Matrix & mat)
                                     -(Navigation::instance()->getFloorOffset()
                                             + range));
 
-                    std::vector<IsectInfo> isecvec = getObjectIntersection(
-                            SceneManager::instance()->getScene(),start,end);
+                    std::vector<IsectInfo> isecvec;
+                    getObjectIntersection(
+                            SceneManager::instance()->getScene(),start,end,
+                            isecvec,true);
                     if(isecvec.size())
                     {
                         if(isecvec[0].point.z()
@@ -884,8 +916,10 @@ void NavPointer::processNav(NavMode nm, osg::Matrix & mat)
                                     -(Navigation::instance()->getFloorOffset()
                                             + range));
 
-                    std::vector<IsectInfo> isecvec = getObjectIntersection(
-                            SceneManager::instance()->getScene(),start,end);
+                    std::vector<IsectInfo> isecvec;
+                    getObjectIntersection(
+                            SceneManager::instance()->getScene(),start,end,
+                            isecvec,true);
                     if(isecvec.size())
                     {
                         if(isecvec[0].point.z()
@@ -1109,8 +1143,10 @@ void NavValuator::processEvent(InteractionEvent * ie)
             osg::Vec3 start(0,0,0), end(0,0,
                     -(Navigation::instance()->getFloorOffset() + range));
 
-            std::vector<IsectInfo> isecvec = getObjectIntersection(
-                    SceneManager::instance()->getScene(),start,end);
+            std::vector<IsectInfo> isecvec;
+            getObjectIntersection(
+                    SceneManager::instance()->getScene(),start,end,
+                    isecvec,true);
             if(isecvec.size())
             {
                 if(isecvec[0].point.z()
@@ -22,6 +22,7 @@
 #include <list>
 #include <queue>
 #include <cassert>
+#include <algorithm>
 
 using namespace cvr;
 
@@ -106,6 +107,25 @@ bool SceneManager::init()
     _depthPartitionLeft->setActive(dpart);
     _depthPartitionRight->setActive(dpart);
 
+    // partitions are only reused when a tolerance is set, the frame limit
+    // bounds how long animation inside a child's bound goes unseen
+    double dpartTolerance = ConfigManager::getDouble("reuseTolerance",
+            "UseDepthPartition",-1.0);
+    int dpartReuseFrames = ConfigManager::getInt("maxReuseFrames",
+            "UseDepthPartition",3);
+    int dpartThreads = ConfigManager::getInt("threads","UseDepthPartition",1);
+    int dpartThreshold = ConfigManager::getInt("parallelThreshold",
+            "UseDepthPartition",64);
+    DepthPartitionNode * dpartNodes[2] = {_depthPartitionLeft.get(),
+            _depthPartitionRight.get()};
+    for(int i = 0; i < 2; i++)
+    {
+        dpartNodes[i]->setReuseTolerance(dpartTolerance);
+        dpartNodes[i]->setMaxReuseFrames(std::max(dpartReuseFrames,0));
+        dpartNodes[i]->setNumThreads(std::max(dpartThreads,1));
+        dpartNodes[i]->setParallelThreshold(std::max(dpartThreshold,1));
+    }
+
     _depthPartitionLeft->setNodeMask(
             _depthPartitionLeft->getNodeMask() & ~(CULL_MASK_RIGHT));
     _depthPartitionRight->setNodeMask(
@@ -236,6 +256,27 @@ void SceneManager::update()
 
     if(stats)
     {
+        // totals from the cull traversals of the last frame
+        DepthPartitionNode::PartitionStats left =
+                _depthPartitionLeft->getStats();
+        DepthPartitionNode::PartitionStats right =
+                _depthPartitionRight->getStats();
+        _depthPartitionLeft->resetStats();
+        _depthPartitionRight->resetStats();
+        if(getDepthPartitionActive())
+        {
+            stats->setAttribute(
+                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                    "Depth partition cameras",left.cameras + right.cameras);
+            stats->setAttribute(
+                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                    "Depth partition reuses",left.reused + right.reused);
+            stats->setAttribute(
+                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                    "Depth partition time ms",
+                    (left.time + right.time) * 1000.0);
+        }
+
         endTime = osg::Timer::instance()->delta_s(
                 CVRViewer::instance()->getStartTick(),
                 osg::Timer::instance()->tick());
@@ -296,6 +337,9 @@ void SceneManager::setObjectMatrix(osg::Matrixd & mat)
 
     _obj2world = _objectScale->getMatrix() * _objectTransform->getMatrix();
     _world2obj = osg::Matrix::inverse(_obj2world);
+
+    _depthPartitionLeft->dirtyPartition();
+    _depthPartitionRight->dirtyPartition();
 }
 
 double SceneManager::getObjectScale()
@@ -314,6 +358,9 @@ void SceneManager::setObjectScale(double scale)
 
     _obj2world = _objectScale->getMatrix() * _objectTransform->getMatrix();
     _world2obj = osg::Matrix::inverse(_obj2world);
+
+    _depthPartitionLeft->dirtyPartition();
+    _depthPartitionRight->dirtyPartition();
 }
 
 const osg::Matrix & SceneManager::getWorldToObjectTransform()
@@ -1041,6 +1088,25 @@ void SceneManager::updateActiveObject()
 {
     osg::Vec3 start, end;
 
+    updateObjectBVH();
+
+    // find the objects every hand's pointer may hit in one pass over each
+    // tree, objects using navigation are in object space
+    std::vector<osg::Vec3> worldStarts, worldDirs, navStarts, navDirs;
+    for(int i = 0; i < TrackingManager::instance()->getNumHands(); i++)
+    {
+        start = osg::Vec3(0,0,0) * TrackingManager::instance()->getHandMat(i);
+        end = osg::Vec3(0,10000,0) * TrackingManager::instance()->getHandMat(i);
+        worldStarts.push_back(start);
+        worldDirs.push_back(end - start);
+        navStarts.push_back(start * _world2obj);
+        navDirs.push_back(end * _world2obj - navStarts.back());
+    }
+
+    std::vector<std::vector<void*> > worldHits, navHits;
+    _worldObjectBVH.intersect(worldStarts,worldDirs,worldHits);
+    _navObjectBVH.intersect(navStarts,navDirs,navHits);
+
     for(int i = 0; i < TrackingManager::instance()->getNumHands(); i++)
     {
         int hand;
@@ -1073,18 +1139,13 @@ void SceneManager::updateActiveObject()
         end = end * handMatrix;
 
         std::list<SceneObject*> hitList;
-
-        // Find list of all ojects that pass bounding sphere intersection
-        for(std::map<std::string,std::vector<SceneObject*> >::iterator it =
-                _pluginObjectMap.begin(); it != _pluginObjectMap.end(); it++)
+        for(int j = 0; j < worldHits[hand].size(); j++)
         {
-            for(int j = 0; j < it->second.size(); j++)
-            {
-                if(it->second[j]->intersectsFast(start,end))
-                {
-                    hitList.push_back(it->second[j]);
-                }
-            }
+            hitList.push_back((SceneObject*)worldHits[hand][j]);
+        }
+        for(int j = 0; j < navHits[hand].size(); j++)
+        {
+            hitList.push_back((SceneObject*)navHits[hand][j]);
         }
 
         if(TrackingManager::instance()->getHandTrackerType(hand)
@@ -1251,6 +1312,88 @@ void SceneManager::updateActiveObject()
     }
 }
 
+void SceneManager::updateObjectBVH()
+{
+    std::vector<SceneObject*> objects;
+    for(std::map<std::string,std::vector<SceneObject*> >::iterator it =
+            _pluginObjectMap.begin(); it != _pluginObjectMap.end(); it++)
+    {
+        for(int j = 0; j < it->second.size(); j++)
+        {
+            if(it->second[j]->_attached)
+            {
+                objects.push_back(it->second[j]);
+            }
+        }
+    }
+
+    bool rebuild = objects.size() != _pickEntries.size();
+    for(int i = 0; i < objects.size() && !rebuild; i++)
+    {
+        if(_pickEntries[i].object != objects[i]
+                || _pickEntries[i].nav != objects[i]->getNavigationOn())
+        {
+            rebuild = true;
+        }
+    }
+
+    if(rebuild)
+    {
+        _worldObjectBVH.clear();
+        _navObjectBVH.clear();
+        _pickEntries.resize(objects.size());
+        for(int i = 0; i < objects.size(); i++)
+        {
+            PickEntry & entry = _pickEntries[i];
+            entry.object = objects[i];
+            entry.nav = objects[i]->getNavigationOn();
+            entry.mat = objects[i]->_root->getMatrix() * objects[i]->_obj2root;
+            entry.bound = objects[i]->getOrComputeBoundingBox();
+
+            BoundingVolumeHierarchy & bvh =
+                    entry.nav ? _navObjectBVH : _worldObjectBVH;
+            entry.item = bvh.addItem(objects[i],
+                    transformBoundingBox(entry.bound,entry.mat));
+        }
+        _worldObjectBVH.build();
+        _navObjectBVH.build();
+        _depthPartitionLeft->dirtyPartition();
+        _depthPartitionRight->dirtyPartition();
+        return;
+    }
+
+    // only objects that moved or changed size touch the trees
+    bool changed = false;
+    for(int i = 0; i < _pickEntries.size(); i++)
+    {
+        PickEntry & entry = _pickEntries[i];
+        osg::Matrix mat = entry.object->_root->getMatrix()
+                * entry.object->_obj2root;
+        const osg::BoundingBox & bound =
+                entry.object->getOrComputeBoundingBox();
+        if(mat == entry.mat && bound._min == entry.bound._min
+                && bound._max == entry.bound._max)
+        {
+            continue;
+        }
+
+        entry.mat = mat;
+        entry.bound = bound;
+        BoundingVolumeHierarchy & bvh =
+                entry.nav ? _navObjectBVH : _worldObjectBVH;
+        bvh.setItemBound(entry.item,transformBoundingBox(bound,mat));
+        changed = true;
+    }
+
+    if(changed)
+    {
+        _depthPartitionLeft->dirtyPartition();
+        _depthPartitionRight->dirtyPartition();
+    }
+    _worldObjectBVH.refit();
+    _navObjectBVH.refit();
+}
+
 SceneObject * SceneManager::findChildActiveObject(SceneObject * object,
         osg::Vec3 & start, osg::Vec3 & end,
         VectorWithPosition<SceneObject*> & nodeList)
@@ -2,6 +2,7 @@
 #include <cvrKernel/PluginHelper.h>
 #include <cvrUtil/LocalToWorldVisitor.h>
 #include <cvrUtil/ComputeBoundingBoxVisitor.h>
+#include <cvrUtil/OsgMath.h>
 #include <cvrMenu/MenuCheckbox.h>
 #include <cvrMenu/MenuRangeValue.h>
 
@@ -9,10 +10,68 @@
 #include <osg/PolygonMode>
 #include <osg/Geometry>
 
+#include <OpenThreads/Atomic>
+
 #include <iostream>
 
 using namespace cvr;
 
+namespace
+{
+
+/**
+ * Counts the times osg recomputes a node's bound.  osg dirties the bound of
+ * a node and all its parents whenever a transform or the geometry below
+ * changes, even if the new sphere is the same, so a count that has not moved
+ * means nothing below the node has changed.
+ */
+class BoundRevisionCallback : public osg::Node::ComputeBoundingSphereCallback
+{
+    public:
+        BoundRevisionCallback(osg::Node::ComputeBoundingSphereCallback * next) :
+                _next(next)
+        {
+        }
+
+        virtual osg::BoundingSphere computeBound(const osg::Node & node) const
+        {
+            ++_revision;
+            if(_next.valid())
+            {
+                return _next->computeBound(node);
+            }
+            return node.computeBound();
+        }
+
+        unsigned int getRevision() const
+        {
+            return _revision;
+        }
+
+    protected:
+        mutable OpenThreads::Atomic _revision;
+        osg::ref_ptr<osg::Node::ComputeBoundingSphereCallback> _next; ///< callback that was on the node
+};
+
+// brings the node's bound up to date and returns its revision
+unsigned int getBoundRevision(osg::Node * node)
+{
+    BoundRevisionCallback * cb = dynamic_cast<BoundRevisionCallback*>(
+            node->getComputeBoundingSphereCallback());
+    if(!cb)
+    {
+        cb = new BoundRevisionCallback(
+                node->getComputeBoundingSphereCallback());
+        node->setComputeBoundingSphereCallback(cb);
+        node->dirtyBound();
+    }
+
+    node->getBound();
+    return cb->getRevision();
+}
+
+}
+
 SceneObject::SceneObject(std::string name, bool navigation, bool movable,
         bool clip, bool contextMenu, bool showBounds) :
         _name(name), _navigation(navigation), _movable(movable), _clip(clip), _contextMenu(
@@ -24,6 +83,7 @@ SceneObject::SceneObject(std::string name, bool navigation, bool movable,
     _moving = false;
     _parent = NULL;
     _boundsDirty = false;
+    _childBoundsDirty = false;
     _boundsCalcMode = AUTO;
     _interactionCount = 0;
 
@@ -396,6 +456,8 @@ void SceneObject::addChild(SceneObject * so)
     so->_parent = this;
     _childrenObjects.push_back(so);
     so->updateMatrices();
+
+    dirtyBounds();
 }
 
 void SceneObject::removeChild(SceneObject * so)
@@ -420,6 +482,8 @@ void SceneObject::removeChild(SceneObject * so)
             break;
         }
     }
+
+    dirtyBounds();
 }
 
 osg::Node * SceneObject::getChildNode(int node)
@@ -758,6 +822,7 @@ void SceneObject::setBoundingBox(osg::BoundingBox bb)
     {
         _bb = bb;
         updateBoundsGeometry();
+        dirtyParentBounds();
     }
 }
 
@@ -767,36 +832,107 @@ const osg::BoundingBox & SceneObject::getOrComputeBoundingBox()
     {
         return _bb;
     }
+
+    bool changed = false;
+
+    if(_boundsDirty || _childNodeBounds.size() != _childrenNodes.size())
+    {
+        SceneObject::computeBoundingBox();
+        _boundsDirty = false;
+        changed = true;
+    }
     else
     {
-        //TODO: try to do an automatic check if local nodes have changed
-        // maybe check for a change in the bounding sphere?
-        if(_boundsDirty)
+        // only nodes with something changed below them need a new box
+        bool nodeChanged = false;
+        for(int i = 0; i < _childrenNodes.size(); i++)
         {
-            SceneObject::computeBoundingBox();
-            _boundsDirty = false;
+            unsigned int revision = getBoundRevision(_childrenNodes[i].get());
+            if(revision != _childNodeRevisions[i])
+            {
+                ComputeBoundingBoxVisitor cbbv;
+                _childrenNodes[i]->accept(cbbv);
+                _childNodeBounds[i] = cbbv.getBound();
+                _childNodeRevisions[i] = revision;
+                nodeChanged = true;
+            }
         }
 
-        _bb = _bbLocal;
-
-        osg::BoundingBox tbb;
-        for(int i = 0; i < _childrenObjects.size(); i++)
+        if(nodeChanged)
         {
-            tbb = _childrenObjects[i]->getOrComputeBoundingBox();
-            if(tbb.valid())
+            _bbLocal.init();
+            for(int i = 0; i < _childNodeBounds.size(); i++)
             {
-                for(int j = 0; j < 8; j++)
-                {
-                    _bb.expandBy(
-                            tbb.corner(j)
-                                    * _childrenObjects[i]->_root->getMatrix());
-                }
+                _bbLocal.expandBy(_childNodeBounds[i]);
             }
+            changed = true;
+        }
+    }
+
+    if(_childObjectBounds.size() != _childrenObjects.size())
+    {
+        _childObjectBounds.clear();
+        _childObjectBounds.resize(_childrenObjects.size());
+        _childObjectRevisions.clear();
+        _childObjectRevisions.resize(_childrenObjects.size());
+        _childBoundsDirty = true;
+        changed = true;
+    }
+
+    // a child object's root bound is recomputed when it moves or anything
+    // below it changes, untouched subtrees are not visited
+    for(int i = 0; i < _childrenObjects.size(); i++)
+    {
+        SceneObject * child = _childrenObjects[i];
+        if(!_childBoundsDirty && getBoundRevision(child->_root.get())
+                == _childObjectRevisions[i])
+        {
+            continue;
+        }
+
+        osg::BoundingBox tbb = transformBoundingBox(
+                child->getOrComputeBoundingBox(),child->_root->getMatrix());
+
+        // the child's bounds geometry is under its root, so take the
+        // revision after the child is up to date
+        _childObjectRevisions[i] = getBoundRevision(child->_root.get());
+
+        if(tbb._min != _childObjectBounds[i]._min
+                || tbb._max != _childObjectBounds[i]._max)
+        {
+            _childObjectBounds[i] = tbb;
+            changed = true;
+        }
+    }
+    _childBoundsDirty = false;
+
+    if(changed)
+    {
+        _bb = _bbLocal;
+        for(int i = 0; i < _childObjectBounds.size(); i++)
+        {
+            _bb.expandBy(_childObjectBounds[i]);
         }
 
         updateBoundsGeometry();
+    }
 
-        return _bb;
+    return _bb;
+}
+
+void SceneObject::dirtyBounds()
+{
+    _boundsDirty = true;
+    dirtyParentBounds();
+}
+
+void SceneObject::dirtyParentBounds()
+{
+    SceneObject * object = _parent;
+    while(object && !object->_childBoundsDirty)
+    {
+        object->_childBoundsDirty = true;
+        object = object->_parent;
     }
 }
 
@@ -811,16 +947,16 @@ void SceneObject::closeMenu()
 void SceneObject::computeBoundingBox()
 {
     _bbLocal.init();
-
-    //ComputeBoundingBoxVisitor cbbv;
+    _childNodeBounds.resize(_childrenNodes.size());
+    _childNodeRevisions.resize(_childrenNodes.size());
 
     for(int i = 0; i < _childrenNodes.size(); i++)
     {
-        //cbbv = ComputeBoundingBoxVisitor();
+        _childNodeRevisions[i] = getBoundRevision(_childrenNodes[i].get());
         ComputeBoundingBoxVisitor cbbv;
-        cbbv.setBound(_bbLocal);
         _childrenNodes[i]->accept(cbbv);
-        _bbLocal = cbbv.getBound();
+        _childNodeBounds[i] = cbbv.getBound();
+        _bbLocal.expandBy(_childNodeBounds[i]);
     }
 }
 
@@ -1235,6 +1371,9 @@ void SceneObject::updateMatrices()
     _root->setMatrix(_scaleMat * _transMat);
     _invTransform = osg::Matrix::inverse(_root->getMatrix());
 
+    // a rotation can keep the bounding sphere the same, so tell the parents
+    dirtyParentBounds();
+
     if(!_parent)
     {
         _obj2root.makeIdentity();
@@ -48,6 +48,7 @@ ScreenConfig::ScreenConfig()
 
 ScreenConfig::~ScreenConfig()
 {
+    ConfigManager::removeChangeCallback(this);
 }
 
 ScreenConfig * ScreenConfig::instance()
@@ -147,9 +148,48 @@ bool ScreenConfig::init()
 
     std::cerr << "Screens Created: " << _screenList.size() << std::endl;
 
+    ConfigManager::addChangeCallback(this);
+
     return true;
 }
 
+void ScreenConfig::configChanged(const std::vector<std::string> & paths)
+{
+    if(ConfigManager::isPathChanged(paths,"Near"))
+    {
+        ScreenBase::_near = ConfigManager::getFloat("Near",10.0);
+    }
+
+    if(ConfigManager::isPathChanged(paths,"Far"))
+    {
+        ScreenBase::_far = ConfigManager::getFloat("Far",10000000);
+    }
+
+    if(ConfigManager::isPathChanged(paths,"Stereo"))
+    {
+        ScreenBase::_separation = ConfigManager::getFloat("separation",
+                "Stereo",64.0);
+    }
+
+    if(ConfigManager::isPathChanged(paths,"Background"))
+    {
+        float r, g, b, a;
+        r = ConfigManager::getFloat("r","Background",0.0);
+        g = ConfigManager::getFloat("g","Background",0.0);
+        b = ConfigManager::getFloat("b","Background",0.0);
+        a = ConfigManager::getFloat("a","Background",0.0);
+
+        setClearColor(osg::Vec4(r,g,b,a));
+    }
+
+    if(ConfigManager::isPathChanged(paths,"EyeSeparation"))
+    {
+        setEyeSeparationMultiplier(
+                ConfigManager::getBool("value","EyeSeparation",true) ? 1.0 :
+                        0.0);
+    }
+}
+
 void ScreenConfig::computeViewProj()
 {
     if(ComController::instance()->getIsSyncError())
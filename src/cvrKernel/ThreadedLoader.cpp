@@ -1,8 +1,15 @@
 #include <cvrKernel/ThreadedLoader.h>
 #include <cvrKernel/ComController.h>
 #include <cvrKernel/CVRViewer.h>
+#include <cvrKernel/AssetCache.h>
+#include <cvrConfig/ConfigManager.h>
+
+#include <osgDB/Registry>
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
 
 using namespace cvr;
 
@@ -11,28 +18,34 @@ ThreadedLoader * ThreadedLoader::_myPtr = NULL;
 ThreadedLoader::ThreadedLoader()
 {
     _jobID = 0;
+    _quit = false;
+    _stream = false;
+    _streamChunkSize = 0;
+    _streamBytes = 0;
 }
 
 ThreadedLoader::~ThreadedLoader()
 {
-    std::map<int,char>::iterator it;
-    while((it = _jobStatus.begin()) != _jobStatus.end())
+    _queueLock.lock();
+    _quit = true;
+    _queueCondition.broadcast();
+    _queueLock.unlock();
+
+    for(int i = 0; i < _threads.size(); i++)
     {
-        if(_threads[it->first]->isRunning())
-        {
-            _threads[it->first]->quit();
-            _threads[it->first]->join();
-        }
-        remove(it->first);
+        _threads[i]->join();
+        delete _threads[i];
     }
+    _threads.clear();
 
-    for(std::map<int,LoaderThread*>::iterator it2 = _threads.begin();
-            it2 != _threads.end(); it2++)
+    for(std::map<int,ThreadedJob*>::iterator it = _jobList.begin();
+            it != _jobList.end(); it++)
     {
-        it2->second->join();
-        delete it2->second;
+        deleteJob(it->second);
     }
-    _threads.clear();
+    _jobList.clear();
+    _jobs.clear();
+    _jobStatus.clear();
 }
 
 ThreadedLoader * ThreadedLoader::instance()
@@ -44,111 +57,117 @@ ThreadedLoader * ThreadedLoader::instance()
     return _myPtr;
 }
 
+bool ThreadedLoader::init()
+{
+    _stream = ConfigManager::getBool("value","ThreadedLoader.Stream",false,
+            NULL);
+    _streamChunkSize = ConfigManager::getInt("chunkSize",
+            "ThreadedLoader.Stream",1024) * 1024;
+    if(_streamChunkSize < 1024)
+    {
+        _streamChunkSize = 1024;
+    }
+
+    // all nodes must agree on where files are read
+    if(ComController::instance()->isMaster())
+    {
+        ComController::instance()->sendSlaves(&_stream,sizeof(bool));
+    }
+    else
+    {
+        ComController::instance()->readMaster(&_stream,sizeof(bool));
+    }
+
+    return true;
+}
+
 int ThreadedLoader::readNodeFile(std::string filename,
-        osgDB::ReaderWriter::Options * options)
+        osgDB::ReaderWriter::Options * options, int priority,
+        JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = READ_NODE;
+    tj->priority = priority;
+    tj->callback = callback;
     tj->strs.push_back(filename);
     tj->options.push_back(options);
 
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
-
-    _jobID++;
-    return _jobID - 1;
+    return addJob(tj);
 }
 
 int ThreadedLoader::readNodeFiles(std::vector<std::string> & filenames,
-        std::vector<osgDB::ReaderWriter::Options*> & options)
+        std::vector<osgDB::ReaderWriter::Options*> & options, int priority,
+        JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = READ_NODE_LIST;
+    tj->priority = priority;
+    tj->callback = callback;
     tj->strs = filenames;
     tj->options = options;
 
-    /*for(int i = 0; i < options.size(); i++)
-     {
-     tj->options.push_back(options[i]);
-     }*/
-
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
-
-    _jobID++;
-    return _jobID - 1;
+    return addJob(tj);
 }
 
 int ThreadedLoader::readImageFile(std::string & filename,
-        osgDB::ReaderWriter::Options * options)
+        osgDB::ReaderWriter::Options * options, int priority,
+        JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = READ_IMAGE;
+    tj->priority = priority;
+    tj->callback = callback;
     tj->strs.push_back(filename);
     tj->options.push_back(options);
 
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
-
-    _jobID++;
-    return _jobID - 1;
+    return addJob(tj);
 }
 
 int ThreadedLoader::readImageFiles(std::vector<std::string> & filenames,
-        std::vector<osgDB::ReaderWriter::Options*> & options)
+        std::vector<osgDB::ReaderWriter::Options*> & options, int priority,
+        JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = READ_IMAGE_LIST;
+    tj->priority = priority;
+    tj->callback = callback;
     tj->strs = filenames;
+    tj->options = options;
 
-    for(int i = 0; i < options.size(); i++)
-    {
-        tj->options.push_back(options[i]);
-    }
-
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
-
-    _jobID++;
-    return _jobID - 1;
+    return addJob(tj);
 }
 
-int ThreadedLoader::systemCommand(std::string command)
+int ThreadedLoader::systemCommand(std::string command, JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = SYSTEM;
+    tj->priority = 0;
+    tj->callback = callback;
     tj->strs.push_back(command);
 
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
-
-    _jobID++;
-    return _jobID - 1;
+    return addJob(tj);
 }
 
-int ThreadedLoader::systemCommandMasterOnly(std::string command)
+int ThreadedLoader::systemCommandMasterOnly(std::string command,
+        JobCallback * callback)
 {
     ThreadedJob * tj = new ThreadedJob;
     tj->type = SYSTEM_MASTER;
+    tj->priority = 0;
+    tj->callback = callback;
     tj->strs.push_back(command);
 
-    _jobs[_jobID] = tj;
-    _threads[_jobID] = new LoaderThread(tj);
-    _jobStatus[_jobID] = 0;
-    _threads[_jobID]->start();
+    return addJob(tj);
+}
 
-    _jobID++;
-    return _jobID - 1;
+void ThreadedLoader::cancel(int job)
+{
+    _queueLock.lock();
+    if(_jobList.find(job) != _jobList.end())
+    {
+        _jobList[job]->cancel = true;
+    }
+    _queueLock.unlock();
 }
 
 bool ThreadedLoader::isError(int job)
@@ -186,34 +205,55 @@ float ThreadedLoader::getProgress(int job)
     return ((float)_jobStatus[job]) / 127.0f;
 }
 
-void ThreadedLoader::remove(int job)
+int ThreadedLoader::getNumItems(int job)
 {
-    if(_jobStatus.find(job) == _jobStatus.end())
+    int items = 0;
+    _queueLock.lock();
+    if(_jobList.find(job) != _jobList.end())
     {
-        return;
+        items = _jobList[job]->strs.size();
     }
+    _queueLock.unlock();
+    return items;
+}
 
-    _jobStatus.erase(job);
-    if(!_threads[job]->isRunning())
+bool ThreadedLoader::isItemDone(int job, int item)
+{
+    bool done = false;
+    _queueLock.lock();
+    if(_jobList.find(job) != _jobList.end() && item >= 0
+            && item < _jobList[job]->itemDone.size())
     {
-        delete _threads[job];
-        _threads.erase(job);
+        done = _jobList[job]->itemDone[item];
     }
-    else
+    _queueLock.unlock();
+    return done;
+}
+
+void ThreadedLoader::remove(int job)
+{
+    if(_jobStatus.find(job) == _jobStatus.end())
     {
-        _threads[job]->quit();
+        return;
     }
 
-    if(_jobs.find(job) != _jobs.end())
+    _jobStatus.erase(job);
+    _reportedStatus.erase(job);
+    _jobs.erase(job);
+
+    // the job is deleted in update once no thread is using it
+    _queueLock.lock();
+    if(_jobList.find(job) != _jobList.end())
     {
-        //delete _jobs[job];
-        _jobs.erase(job);
+        _jobList[job]->cancel = true;
+        _jobList[job]->removed = true;
     }
+    _queueLock.unlock();
 }
 
 void ThreadedLoader::getNodeFile(int job, osg::ref_ptr<osg::Node> & node)
 {
-    if(_threads.find(job) == _threads.end())
+    if(_jobList.find(job) == _jobList.end())
     {
         std::cerr << "ThreadedLoader Error: getNodeFile, job: " << job
                 << " does not exist." << std::endl;
@@ -229,8 +269,8 @@ void ThreadedLoader::getNodeFile(int job, osg::ref_ptr<osg::Node> & node)
         return;
     }
 
-    if(_threads[job]->getResult()->type != READ_NODE
-            && _threads[job]->getResult()->type != READ_NODE_LIST)
+    if(_jobList[job]->type != READ_NODE
+            && _jobList[job]->type != READ_NODE_LIST)
     {
         std::cerr << "ThreadedLoader Error: getNodeFile, job: " << job
                 << " is not of reading a node file." << std::endl;
@@ -238,9 +278,9 @@ void ThreadedLoader::getNodeFile(int job, osg::ref_ptr<osg::Node> & node)
         return;
     }
 
-    if(_threads[job]->getResult()->ptrs.size())
+    if(_jobList[job]->ptrs.size())
     {
-        node = (osg::Node*)_threads[job]->getResult()->ptrs[0];
+        node = (osg::Node*)_jobList[job]->ptrs[0];
     }
     else
     {
@@ -251,7 +291,7 @@ void ThreadedLoader::getNodeFile(int job, osg::ref_ptr<osg::Node> & node)
 void ThreadedLoader::getNodeFiles(int job,
         std::vector<osg::ref_ptr<osg::Node> > & nodeList)
 {
-    if(_threads.find(job) == _threads.end())
+    if(_jobList.find(job) == _jobList.end())
     {
         std::cerr << "ThreadedLoader Error: getNodeFiles, job: " << job
                 << " does not exist." << std::endl;
@@ -265,23 +305,23 @@ void ThreadedLoader::getNodeFiles(int job,
         return;
     }
 
-    if(_threads[job]->getResult()->type != READ_NODE
-            && _threads[job]->getResult()->type != READ_NODE_LIST)
+    if(_jobList[job]->type != READ_NODE
+            && _jobList[job]->type != READ_NODE_LIST)
     {
         std::cerr << "ThreadedLoader Error: getNodeFiles, job: " << job
                 << " is not of reading a node file." << std::endl;
         return;
     }
 
-    for(int i = 0; i < _threads[job]->getResult()->ptrs.size(); i++)
+    for(int i = 0; i < _jobList[job]->ptrs.size(); i++)
     {
-        nodeList.push_back((osg::Node*)_threads[job]->getResult()->ptrs[i]);
+        nodeList.push_back((osg::Node*)_jobList[job]->ptrs[i]);
     }
 }
 
 void ThreadedLoader::getImageFile(int job, osg::ref_ptr<osg::Image> & image)
 {
-    if(_threads.find(job) == _threads.end())
+    if(_jobList.find(job) == _jobList.end())
     {
         std::cerr << "ThreadedLoader Error: getImageFile, job: " << job
                 << " does not exist." << std::endl;
@@ -297,8 +337,8 @@ void ThreadedLoader::getImageFile(int job, osg::ref_ptr<osg::Image> & image)
         return;
     }
 
-    if(_threads[job]->getResult()->type != READ_IMAGE
-            && _threads[job]->getResult()->type != READ_IMAGE_LIST)
+    if(_jobList[job]->type != READ_IMAGE
+            && _jobList[job]->type != READ_IMAGE_LIST)
     {
         std::cerr << "ThreadedLoader Error: getImageFile, job: " << job
                 << " is not of reading an image file." << std::endl;
@@ -306,9 +346,9 @@ void ThreadedLoader::getImageFile(int job, osg::ref_ptr<osg::Image> & image)
         return;
     }
 
-    if(_threads[job]->getResult()->ptrs.size())
+    if(_jobList[job]->ptrs.size())
     {
-        image = (osg::Image*)_threads[job]->getResult()->ptrs[0];
+        image = (osg::Image*)_jobList[job]->ptrs[0];
     }
     else
     {
@@ -319,7 +359,7 @@ void ThreadedLoader::getImageFile(int job, osg::ref_ptr<osg::Image> & image)
 void ThreadedLoader::getImageFiles(int job,
         std::vector<osg::ref_ptr<osg::Image> > & imageList)
 {
-    if(_threads.find(job) == _threads.end())
+    if(_jobList.find(job) == _jobList.end())
     {
         std::cerr << "ThreadedLoader Error: getImageFiles, job: " << job
                 << " does not exist." << std::endl;
@@ -333,17 +373,17 @@ void ThreadedLoader::getImageFiles(int job,
         return;
     }
 
-    if(_threads[job]->getResult()->type != READ_IMAGE
-            && _threads[job]->getResult()->type != READ_IMAGE_LIST)
+    if(_jobList[job]->type != READ_IMAGE
+            && _jobList[job]->type != READ_IMAGE_LIST)
     {
         std::cerr << "ThreadedLoader Error: getImageFiles, job: " << job
                 << " is not of reading an image file." << std::endl;
         return;
     }
 
-    for(int i = 0; i < _threads[job]->getResult()->ptrs.size(); i++)
+    for(int i = 0; i < _jobList[job]->ptrs.size(); i++)
     {
-        imageList.push_back((osg::Image*)_threads[job]->getResult()->ptrs[i]);
+        imageList.push_back((osg::Image*)_jobList[job]->ptrs[i]);
     }
 }
 
@@ -365,290 +405,683 @@ void ThreadedLoader::update()
                 osg::Timer::instance()->tick());
     }
 
-    if(!_jobs.size())
+    // delete all removed jobs that are no longer in use
+    _queueLock.lock();
+    for(std::map<int,ThreadedJob*>::iterator it = _jobList.begin();
+            it != _jobList.end();)
     {
-        if(stats)
+        if(it->second->removed && !it->second->itemsRunning)
         {
-            endTime = osg::Timer::instance()->delta_s(
-                    CVRViewer::instance()->getStartTick(),
-                    osg::Timer::instance()->tick());
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "TLoader begin time",startTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "TLoader end time",endTime);
-            stats->setAttribute(
-                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                    "TLoader time taken",endTime - startTime);
+            deleteJob(it->second);
+            _jobList.erase(it++);
+        }
+        else
+        {
+            it++;
         }
-        return;
     }
+    _queueLock.unlock();
 
-    char * status = new char[_jobs.size()];
-
-    int index = 0;
-    for(std::map<int,ThreadedJob*>::iterator it = _jobs.begin();
-            it != _jobs.end(); it++)
+    _streamBytes = 0;
+    if(_stream)
     {
-        status[index] = _threads[it->first]->getStatus();
-        index++;
+        streamItems();
     }
 
-    if(ComController::instance()->isMaster())
+    if(_jobs.size())
     {
-        char * slaveStatus = new char[ComController::instance()->getNumSlaves()
-                * _jobs.size() * sizeof(char)];
+        std::vector<int> jobs;
+        std::vector<char> status;
 
-        ComController::instance()->readSlaves(slaveStatus,
-                _jobs.size() * sizeof(char));
-
-        int numSlaves = ComController::instance()->getNumSlaves();
-        int index = 0;
+        _queueLock.lock();
         for(std::map<int,ThreadedJob*>::iterator it = _jobs.begin();
                 it != _jobs.end(); it++)
         {
-            for(int i = 0; i < numSlaves; i++)
+            jobs.push_back(it->first);
+            status.push_back(getLocalStatus(it->second));
+        }
+        _queueLock.unlock();
+
+        syncStatus(jobs,status);
+
+        for(int i = 0; i < jobs.size(); i++)
+        {
+            std::map<int,ThreadedJob*>::iterator it = _jobs.find(jobs[i]);
+            if(it == _jobs.end())
+            {
+                continue;
+            }
+
+            _jobStatus[jobs[i]] = status[i];
+            if(status[i] == -1 || status[i] == 127)
             {
-                status[index] = std::min(status[index],
-                        slaveStatus[(i * _jobs.size()) + index]);
+                // callbacks run in runCallbacks() once the view is updated
+                if(it->second->callback)
+                {
+                    FinishedJob fj;
+                    fj.job = jobs[i];
+                    fj.callback = it->second->callback;
+                    fj.error = status[i] == -1;
+                    _finishedJobs.push_back(fj);
+                }
+                _jobs.erase(it);
+                _reportedStatus.erase(jobs[i]);
             }
-            index++;
         }
+    }
 
-        ComController::instance()->sendSlaves(status,
-                _jobs.size() * sizeof(char));
+    if(stats)
+    {
+        endTime = osg::Timer::instance()->delta_s(
+                CVRViewer::instance()->getStartTick(),
+                osg::Timer::instance()->tick());
+        stats->setAttribute(
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                "TLoader begin time",startTime);
+        stats->setAttribute(
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                "TLoader end time",endTime);
+        stats->setAttribute(
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                "TLoader time taken",endTime - startTime);
 
-        delete[] slaveStatus;
+        AssetCache::CacheStats cacheStats = AssetCache::instance()->getStats();
+        stats->setAttribute(
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                "Asset cache hits",cacheStats.hits);
+        stats->setAttribute(
+                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                "Asset cache misses",cacheStats.misses);
+        if(_stream)
+        {
+            stats->setAttribute(
+                    CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
+                    "TLoader stream bytes",_streamBytes);
+        }
     }
-    else
+}
+
+void ThreadedLoader::runCallbacks()
+{
+    for(int i = 0; i < _finishedJobs.size(); i++)
     {
-        ComController::instance()->sendMaster(status,
-                _jobs.size() * sizeof(char));
-        ComController::instance()->readMaster(status,
-                _jobs.size() * sizeof(char));
+        // an earlier callback may have removed this job
+        if(_jobStatus.find(_finishedJobs[i].job) == _jobStatus.end())
+        {
+            continue;
+        }
+
+        _finishedJobs[i].callback->jobFinished(_finishedJobs[i].job,
+                _finishedJobs[i].error);
     }
+    _finishedJobs.clear();
+}
 
-    std::vector<int> eraseList;
+void ThreadedLoader::syncStatus(std::vector<int> & jobs,
+        std::vector<char> & status)
+{
+    // first only a bitset of the jobs whose local status changed is
+    // exchanged, status values follow only for the jobs that changed on
+    // some node
+    int bitsetSize = (jobs.size() + 7) / 8;
+    std::vector<unsigned char> changed(bitsetSize,0);
+    for(int i = 0; i < jobs.size(); i++)
+    {
+        if(_reportedStatus[jobs[i]] != status[i])
+        {
+            changed[i / 8] |= (1 << (i % 8));
+        }
+    }
 
-    index = 0;
-    for(std::map<int,ThreadedJob*>::iterator it = _jobs.begin();
-            it != _jobs.end(); it++)
+    if(ComController::instance()->isMaster())
     {
-        if(status[index] == -1)
+        int numSlaves = ComController::instance()->getNumSlaves();
+        if(numSlaves)
         {
-            if(_threads[it->first]->isRunning())
+            std::vector<unsigned char> slaveChanged(numSlaves * bitsetSize);
+            ComController::instance()->readSlaves(&slaveChanged[0],
+                    bitsetSize);
+            for(int i = 0; i < numSlaves; i++)
             {
-                _threads[it->first]->cancel();
+                for(int j = 0; j < bitsetSize; j++)
+                {
+                    changed[j] |= slaveChanged[(i * bitsetSize) + j];
+                }
             }
-            eraseList.push_back(it->first);
         }
-        else if(status[index] == 127)
+        ComController::instance()->sendSlaves(&changed[0],bitsetSize);
+    }
+    else
+    {
+        ComController::instance()->sendMaster(&changed[0],bitsetSize);
+        ComController::instance()->readMaster(&changed[0],bitsetSize);
+    }
+
+    std::vector<int> changedIndex;
+    for(int i = 0; i < jobs.size(); i++)
+    {
+        if(changed[i / 8] & (1 << (i % 8)))
         {
-            eraseList.push_back(it->first);
+            changedIndex.push_back(i);
         }
-
-        _jobStatus[it->first] = status[index];
-
-        index++;
     }
 
-    for(int i = 0; i < eraseList.size(); i++)
+    // no change anywhere, the synced status is still good
+    if(!changedIndex.size())
     {
-        //delete _jobs[eraseList[i]];
-        _jobs.erase(eraseList[i]);
+        for(int i = 0; i < jobs.size(); i++)
+        {
+            status[i] = _jobStatus[jobs[i]];
+        }
+        return;
     }
 
-    delete[] status;
+    std::vector<char> changedStatus;
+    for(int i = 0; i < changedIndex.size(); i++)
+    {
+        changedStatus.push_back(status[changedIndex[i]]);
+        _reportedStatus[jobs[changedIndex[i]]] = status[changedIndex[i]];
+    }
 
-    // look for threads that still need to finish
-    for(std::map<int,LoaderThread*>::iterator it = _threads.begin();
-            it != _threads.end(); it++)
+    int numChanged = changedStatus.size();
+    if(ComController::instance()->isMaster())
     {
-        if(_jobStatus.find(it->first) == _jobStatus.end())
+        int numSlaves = ComController::instance()->getNumSlaves();
+        if(numSlaves)
         {
-            if(!it->second->isRunning())
+            std::vector<char> slaveStatus(numSlaves * numChanged);
+            ComController::instance()->readSlaves(&slaveStatus[0],numChanged);
+            for(int i = 0; i < numSlaves; i++)
             {
-                //std::cerr << "Removing stray thread." << std::endl;
-                delete it->second;
-                _threads.erase(it);
-                break;
+                for(int j = 0; j < numChanged; j++)
+                {
+                    changedStatus[j] = std::min(changedStatus[j],
+                            slaveStatus[(i * numChanged) + j]);
+                }
             }
         }
+        ComController::instance()->sendSlaves(&changedStatus[0],numChanged);
+    }
+    else
+    {
+        ComController::instance()->sendMaster(&changedStatus[0],numChanged);
+        ComController::instance()->readMaster(&changedStatus[0],numChanged);
     }
 
-    if(stats)
+    std::vector<char> syncedStatus(jobs.size());
+    for(int i = 0; i < jobs.size(); i++)
     {
-        endTime = osg::Timer::instance()->delta_s(
-                CVRViewer::instance()->getStartTick(),
-                osg::Timer::instance()->tick());
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "TLoader begin time",startTime);
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "TLoader end time",endTime);
-        stats->setAttribute(
-                CVRViewer::instance()->getViewerFrameStamp()->getFrameNumber(),
-                "TLoader time taken",endTime - startTime);
+        syncedStatus[i] = _jobStatus[jobs[i]];
+    }
+    for(int i = 0; i < changedIndex.size(); i++)
+    {
+        syncedStatus[changedIndex[i]] = changedStatus[i];
     }
+    status = syncedStatus;
 }
 
-ThreadedLoader::LoaderThread::LoaderThread(ThreadedJob * job)
+int ThreadedLoader::addJob(ThreadedJob * job)
 {
-    _job = job;
-    _result.type = job->type;
-    _result.ret = 0;
-    _status = 0;
-    _quit = false;
+    job->ptrs.resize(job->strs.size(),NULL);
+    job->itemDone.resize(job->strs.size(),false);
+    job->itemsDone = 0;
+    job->itemsRunning = 0;
+    job->cancel = false;
+    job->removed = false;
+    job->stream = _stream && job->type != SYSTEM
+            && job->type != SYSTEM_MASTER;
+    if(job->stream)
+    {
+        job->streamData.resize(job->strs.size());
+        job->streamSize.resize(job->strs.size(),0);
+        job->streamSent.resize(job->strs.size(),0);
+    }
+
+    int id = _jobID;
+    _jobID++;
+
+    _jobs[id] = job;
+    _jobStatus[id] = 0;
+    _reportedStatus[id] = 0;
+
+    startThreads();
+
+    _queueLock.lock();
+    _jobList[id] = job;
+    // render nodes queue streamed items as their data arrives
+    for(int i = 0;
+            i < job->strs.size()
+                    && (!job->stream || ComController::instance()->isMaster());
+            i++)
+    {
+        WorkItem wi;
+        wi.priority = job->priority;
+        wi.job = id;
+        wi.item = i;
+        _queue.push(wi);
+    }
+    _queueCondition.broadcast();
+    _queueLock.unlock();
+
+    return id;
 }
 
-ThreadedLoader::LoaderThread::~LoaderThread()
+void ThreadedLoader::startThreads()
 {
-    for(int i = 0; i < _result.ptrs.size(); i++)
+    if(_threads.size())
     {
-        if(_result.type == READ_NODE || _result.type == READ_NODE_LIST)
-        {
-            ((osg::Node*)_result.ptrs[i])->unref();
-        }
-        else if(_result.type == READ_IMAGE || _result.type == READ_IMAGE_LIST)
-        {
-            ((osg::Image*)_result.ptrs[i])->unref();
-        }
+        return;
+    }
+
+    int numThreads = ConfigManager::getInt("value","ThreadedLoader.Threads",
+            4);
+    if(numThreads < 1)
+    {
+        numThreads = 1;
+    }
+
+    for(int i = 0; i < numThreads; i++)
+    {
+        _threads.push_back(new LoaderThread(this));
+        _threads.back()->start();
     }
-    delete _job;
 }
 
-void ThreadedLoader::LoaderThread::run()
+char ThreadedLoader::getLocalStatus(ThreadedJob * job)
+{
+    if(job->cancel)
+    {
+        return -1;
+    }
+
+    if(job->itemsDone == job->strs.size())
+    {
+        return 127;
+    }
+
+    return ((char)(((float)job->itemsDone) / ((float)job->strs.size())
+            * 126.0));
+}
+
+void * ThreadedLoader::processItem(ThreadedJob * job, int item)
 {
-    switch(_job->type)
+    osgDB::ReaderWriter::Options * options = NULL;
+    if(job->options.size() > item)
+    {
+        options = job->options[item];
+    }
+
+    if(job->stream && !ComController::instance()->isMaster())
+    {
+        return deserializeItem(job,item);
+    }
+
+    switch(job->type)
     {
         case READ_NODE:
         case READ_NODE_LIST:
         {
-            osg::Node * node;
-            for(int i = 0; i < _job->strs.size(); i++)
+            osg::Node * node = AssetCache::instance()->readNodeFile(
+                    job->strs[item],options);
+            if(node)
             {
-                if(_job->options.size() > i && _job->options[i])
-                {
-                    node = osgDB::readNodeFile(_job->strs[i],_job->options[i]);
-                    if(node)
-                    {
-                        node->ref();
-                    }
-                    _result.ptrs.push_back((void*)node);
-                }
-                else
-                {
-                    node = osgDB::readNodeFile(_job->strs[i]);
-                    if(node)
-                    {
-                        node->ref();
-                    }
-                    _result.ptrs.push_back((void*)node);
-                }
+                node->ref();
+            }
+            if(job->stream)
+            {
+                serializeItem(job,item,node);
+            }
+            return (void*)node;
+        }
+        case READ_IMAGE:
+        case READ_IMAGE_LIST:
+        {
+            osg::Image * image = AssetCache::instance()->readImageFile(
+                    job->strs[item],options);
+            if(image)
+            {
+                image->ref();
+            }
+            if(job->stream)
+            {
+                serializeItem(job,item,image);
+            }
+            return (void*)image;
+        }
+        case SYSTEM:
+        {
+            system(job->strs[item].c_str());
+            break;
+        }
+        case SYSTEM_MASTER:
+        {
+            if(ComController::instance()->isMaster())
+            {
+                system(job->strs[item].c_str());
+            }
+            break;
+        }
+        default:
+            break;
+    }
 
-                _quitLock.lock();
-                if(_quit)
-                {
-                    _quitLock.unlock();
-                    break;
-                }
-                _quitLock.unlock();
+    return NULL;
+}
+
+void ThreadedLoader::serializeItem(ThreadedJob * job, int item,
+        void * result)
+{
+    job->streamSize[item] = -1;
+
+    osgDB::ReaderWriter * rw =
+            osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    if(!result || !rw)
+    {
+        return;
+    }
 
-                _statusLock.lock();
-                _status = ((char)(((float)i + 1.0) / ((float)_job->strs.size())
-                        * 126.0));
-                _statusLock.unlock();
+    // embed textures, the render nodes may not be able to see the files
+    osg::ref_ptr<osgDB::ReaderWriter::Options> options =
+            new osgDB::ReaderWriter::Options("WriteImageHint=IncludeData");
 
-            }
+    std::stringstream ss;
+    osgDB::ReaderWriter::WriteResult wr;
+    if(job->type == READ_NODE || job->type == READ_NODE_LIST)
+    {
+        wr = rw->writeNode(*((osg::Node*)result),ss,options.get());
+    }
+    else
+    {
+        wr = rw->writeImage(*((osg::Image*)result),ss,options.get());
+    }
+
+    if(!wr.success())
+    {
+        std::cerr << "ThreadedLoader Error: unable to serialize "
+                << job->strs[item] << " for streaming." << std::endl;
+        return;
+    }
+
+    std::string data = ss.str();
+    job->streamData[item].assign(data.begin(),data.end());
+    job->streamSize[item] = data.size();
+}
+
+void * ThreadedLoader::deserializeItem(ThreadedJob * job, int item)
+{
+    osgDB::ReaderWriter * rw =
+            osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+    if(!rw || !job->streamData[item].size())
+    {
+        return NULL;
+    }
+
+    std::stringstream ss(std::string(&job->streamData[item][0],
+            job->streamData[item].size()));
+    std::vector<char>().swap(job->streamData[item]);
+
+    if(job->type == READ_NODE || job->type == READ_NODE_LIST)
+    {
+        osg::Node * node = rw->readNode(ss).takeNode();
+        if(node)
+        {
+            node->ref();
+        }
+        return (void*)node;
+    }
+    else
+    {
+        osg::Image * image = rw->readImage(ss).takeImage();
+        if(image)
+        {
+            image->setFileName(job->strs[item]);
+            image->ref();
+        }
+        return (void*)image;
+    }
+}
+
+void ThreadedLoader::streamItems()
+{
+    // streamed jobs stay in the sync list until they finish on all nodes, so
+    // every node agrees on whether there is a message this frame
+    bool streaming = false;
+    for(std::map<int,ThreadedJob*>::iterator it = _jobs.begin();
+            it != _jobs.end(); it++)
+    {
+        if(it->second->stream)
+        {
+            streaming = true;
             break;
         }
-        case READ_IMAGE:
-        case READ_IMAGE_LIST:
+    }
+
+    if(!streaming)
+    {
+        return;
+    }
+
+    // number of chunks, size of message
+    int header[2];
+    std::vector<char> message;
+
+    if(ComController::instance()->isMaster())
+    {
+        int budget = _streamChunkSize;
+        header[0] = 0;
+
+        _queueLock.lock();
+        for(std::map<int,ThreadedJob*>::iterator it = _jobs.begin();
+                it != _jobs.end() && budget > 0; it++)
         {
-            for(int i = 0; i < _job->strs.size(); i++)
+            ThreadedJob * job = it->second;
+            if(!job->stream || job->cancel)
             {
-                osg::Image * image;
-                if(_job->options.size() > i && _job->options[i])
+                continue;
+            }
+
+            for(int i = 0; i < job->strs.size() && budget > 0; i++)
+            {
+                if(!job->itemDone[i] || job->streamSent[i] < 0)
                 {
-                    image = osgDB::readImageFile(_job->strs[i],
-                            _job->options[i]);\
-                    if(image)
-                    {
-                        image->ref();
-                    }
-                    _result.ptrs.push_back((void*)image);
+                    continue;
                 }
-                else
+
+                StreamChunk chunk;
+                chunk.job = it->first;
+                chunk.item = i;
+                chunk.totalSize = job->streamSize[i];
+                chunk.offset = job->streamSent[i];
+                chunk.size = 0;
+                if(chunk.totalSize > 0)
                 {
-                    image = osgDB::readImageFile(_job->strs[i]);
-                    if(image)
-                    {
-                        image->ref();
-                    }
-                    _result.ptrs.push_back((void*)image);
+                    chunk.size = std::min(budget,
+                            chunk.totalSize - chunk.offset);
                 }
 
-                _quitLock.lock();
-                if(_quit)
+                int pos = message.size();
+                message.resize(pos + sizeof(StreamChunk) + chunk.size);
+                memcpy(&message[pos],&chunk,sizeof(StreamChunk));
+                if(chunk.size)
                 {
-                    _quitLock.unlock();
-                    break;
+                    memcpy(&message[pos + sizeof(StreamChunk)],
+                            &job->streamData[i][chunk.offset],chunk.size);
                 }
-                _quitLock.unlock();
+                header[0]++;
+                budget -= chunk.size;
 
-                _statusLock.lock();
-                _status = ((char)(((float)i + 1.0) / ((float)_job->strs.size())
-                        * 126.0));
-                _statusLock.unlock();
+                job->streamSent[i] += chunk.size;
+                if(chunk.totalSize <= 0
+                        || job->streamSent[i] == chunk.totalSize)
+                {
+                    // mark as sent, the master keeps the loaded result
+                    job->streamSent[i] = -1;
+                    std::vector<char>().swap(job->streamData[i]);
+                }
             }
-            break;
         }
-        case SYSTEM:
+        _queueLock.unlock();
+
+        header[1] = message.size();
+        ComController::instance()->sendSlaves(header,2 * sizeof(int));
+        if(header[1])
         {
-            if(_job->strs.size())
+            // large messages need the fragmenting multicast
+            if(ComController::instance()->getMulticastReliable())
             {
-                system(_job->strs[0].c_str());
+                ComController::instance()->sendSlavesMulticast(&message[0],
+                        header[1]);
             }
-            break;
-        }
-        case SYSTEM_MASTER:
-        {
-            if(ComController::instance()->isMaster())
+            else
             {
-                if(_job->strs.size())
-                {
-                    system(_job->strs[0].c_str());
-                }
+                ComController::instance()->sendSlaves(&message[0],header[1]);
             }
-            break;
         }
-        default:
-            break;
+        _streamBytes = header[1];
+        return;
+    }
+
+    ComController::instance()->readMaster(header,2 * sizeof(int));
+    if(!header[1])
+    {
+        return;
+    }
+
+    message.resize(header[1]);
+    if(ComController::instance()->getMulticastReliable())
+    {
+        ComController::instance()->readMasterMulticast(&message[0],header[1]);
+    }
+    else
+    {
+        ComController::instance()->readMaster(&message[0],header[1]);
+    }
+    _streamBytes = header[1];
+
+    int pos = 0;
+    _queueLock.lock();
+    for(int i = 0; i < header[0]; i++)
+    {
+        StreamChunk chunk;
+        memcpy(&chunk,&message[pos],sizeof(StreamChunk));
+        pos += sizeof(StreamChunk);
+
+        std::map<int,ThreadedJob*>::iterator it = _jobs.find(chunk.job);
+        if(it == _jobs.end() || !it->second->stream)
+        {
+            pos += chunk.size;
+            continue;
+        }
+        ThreadedJob * job = it->second;
+
+        if(chunk.totalSize <= 0)
+        {
+            // failed on the master
+            job->itemDone[chunk.item] = true;
+            job->itemsDone++;
+            pos += chunk.size;
+            continue;
+        }
+
+        if(!chunk.offset)
+        {
+            job->streamData[chunk.item].resize(chunk.totalSize);
+        }
+        memcpy(&job->streamData[chunk.item][chunk.offset],&message[pos],
+                chunk.size);
+        pos += chunk.size;
+        job->streamSent[chunk.item] += chunk.size;
+
+        if(job->streamSent[chunk.item] == chunk.totalSize)
+        {
+            WorkItem wi;
+            wi.priority = job->priority;
+            wi.job = chunk.job;
+            wi.item = chunk.item;
+            _queue.push(wi);
+            _queueCondition.broadcast();
+        }
+    }
+    _queueLock.unlock();
+}
+
+void ThreadedLoader::deleteJob(ThreadedJob * job)
+{
+    for(int i = 0; i < job->ptrs.size(); i++)
+    {
+        if(!job->ptrs[i])
+        {
+            continue;
+        }
+
+        if(job->type == READ_NODE || job->type == READ_NODE_LIST)
+        {
+            ((osg::Node*)job->ptrs[i])->unref();
+        }
+        else if(job->type == READ_IMAGE || job->type == READ_IMAGE_LIST)
+        {
+            ((osg::Image*)job->ptrs[i])->unref();
+        }
     }
+    delete job;
+}
 
-    _statusLock.lock();
-    _status = 127;
-    _statusLock.unlock();
+ThreadedLoader::LoaderThread::LoaderThread(ThreadedLoader * loader)
+{
+    _loader = loader;
 }
 
-void ThreadedLoader::LoaderThread::quit()
+ThreadedLoader::LoaderThread::~LoaderThread()
 {
-    _quitLock.lock();
-    _quit = true;
-    _quitLock.unlock();
 }
 
-char ThreadedLoader::LoaderThread::getStatus()
+void ThreadedLoader::LoaderThread::run()
 {
-    char ret;
+    while(1)
+    {
+        ThreadedJob * job = NULL;
+        WorkItem wi;
 
-    _statusLock.lock();
+        _loader->_queueLock.lock();
+        while(!_loader->_quit)
+        {
+            // skip items of cancelled or deleted jobs
+            while(_loader->_queue.size())
+            {
+                wi = _loader->_queue.top();
+                _loader->_queue.pop();
 
-    ret = _status;
+                std::map<int,ThreadedJob*>::iterator it =
+                        _loader->_jobList.find(wi.job);
+                if(it != _loader->_jobList.end() && !it->second->cancel)
+                {
+                    job = it->second;
+                    job->itemsRunning++;
+                    break;
+                }
+            }
+
+            if(job)
+            {
+                break;
+            }
 
-    _statusLock.unlock();
+            _loader->_queueCondition.wait(&_loader->_queueLock);
+        }
+        _loader->_queueLock.unlock();
 
-    return ret;
+        if(!job)
+        {
+            return;
+        }
+
+        void * result = _loader->processItem(job,wi.item);
+
+        _loader->_queueLock.lock();
+        job->ptrs[wi.item] = result;
+        job->itemDone[wi.item] = true;
+        job->itemsDone++;
+        job->itemsRunning--;
+        _loader->_queueLock.unlock();
+    }
 }
@@ -372,8 +372,8 @@ void BoardMenuScrollTextGeometry::update(osg::Vec3 & pointerStart,
     }
 
     std::vector<IsectInfo> isecvec;
-    isecvec = getObjectIntersection(SceneManager::instance()->getMenuRoot(),
-            pointerStart,pointerEnd);
+    getObjectIntersection(SceneManager::instance()->getMenuRoot(),
+            pointerStart,pointerEnd,isecvec);
     for(int i = 0; i < isecvec.size(); i++)
     {
         if(isecvec[i].geode == _upGeode.get())
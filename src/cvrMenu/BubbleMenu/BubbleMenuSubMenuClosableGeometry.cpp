@@ -110,8 +110,8 @@ void BubbleMenuSubMenuClosableGeometry::update(osg::Vec3 & pointerStart,
     if(_head)
     {
         std::vector<IsectInfo> isecvec;
-        isecvec = getObjectIntersection(SceneManager::instance()->getMenuRoot(),
-                pointerStart,pointerEnd);
+        getObjectIntersection(SceneManager::instance()->getMenuRoot(),
+                pointerStart,pointerEnd,isecvec);
 
         bool hit = false;
         for(int i = 0; i < isecvec.size(); i++)
@@ -230,8 +230,8 @@ void BubbleMenuTextButtonSetGeometry::update(osg::Vec3 & pointerStart,
 
      isecvec = getObjectIntersection(_node,pointerStart, pointerEnd);*/
     std::vector<IsectInfo> isecvec;
-    isecvec = getObjectIntersection(SceneManager::instance()->getMenuRoot(),
-            pointerStart,pointerEnd);
+    getObjectIntersection(SceneManager::instance()->getMenuRoot(),
+            pointerStart,pointerEnd,isecvec);
     //std::cerr << "isec size: " << isecvec.size() << std::endl;
     for(int i = 0; i < isecvec.size(); i++)
     {
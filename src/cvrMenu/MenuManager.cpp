@@ -6,6 +6,7 @@
 #include <cvrKernel/InteractionManager.h>
 #include <cvrKernel/NodeMask.h>
 #include <cvrUtil/Intersection.h>
+#include <cvrUtil/RayQuery.h>
 
 using namespace cvr;
 
@@ -87,35 +88,27 @@ void MenuManager::update()
         (*it)->updateStart();
     }
 
-    osgUtil::IntersectVisitor iv;
-    iv.setTraversalMask(cvr::INTERSECT_MASK);
-
-    // process intersection
-    osg::Vec3 pointerStart, pointerEnd;
-
-    std::vector<osg::ref_ptr<osg::LineSegment> > handsegs;
+    // process intersection, all hands in one pass over the menus
+    std::vector<osg::Vec3> pointerStarts, pointerEnds;
     for(int i = 0; i < TrackingManager::instance()->getNumHands(); i++)
     {
-        pointerStart = TrackingManager::instance()->getHandMat(i).getTrans();
-        pointerEnd.set(0.0f,10000.0f,0.0f);
-        pointerEnd = pointerEnd * TrackingManager::instance()->getHandMat(i);
-        handsegs.push_back(new osg::LineSegment());
-        handsegs.back()->set(pointerStart,pointerEnd);
-        iv.addLineSegment(handsegs.back().get());
+        pointerStarts.push_back(
+                TrackingManager::instance()->getHandMat(i).getTrans());
+        pointerEnds.push_back(
+                osg::Vec3(0.0f,10000.0f,0.0f)
+                        * TrackingManager::instance()->getHandMat(i));
     }
 
-    SceneManager::instance()->getMenuRoot()->accept(iv);
+    std::vector<std::vector<IsectInfo> > handHits;
+    RayQuery::instance()->intersect(SceneManager::instance()->getMenuRoot(),
+            pointerStarts,pointerEnds,handHits);
 
     for(int i = 0; i < TrackingManager::instance()->getNumHands(); i++)
     {
-        osgUtil::IntersectVisitor::HitList& hitList = iv.getHitList(
-                handsegs[i].get());
+        std::vector<IsectInfo> & hitList = handHits[i];
         for(size_t j = 0; j < hitList.size(); j++)
         {
-            IsectInfo isect;
-            isect.point = hitList.at(j).getWorldIntersectPoint();
-            isect.normal = hitList.at(j).getWorldIntersectNormal();
-            isect.geode = hitList.at(j)._geode.get();
+            IsectInfo & isect = hitList[j];
             if(_handLastMenuSystem[i])
             {
                 if(_handLastMenuSystem[i]->processIsect(isect,i))
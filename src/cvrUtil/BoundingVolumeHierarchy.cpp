@@ -0,0 +1,323 @@
+#include <cvrUtil/BoundingVolumeHierarchy.h>
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace cvr;
+
+#define BVH_LEAF_SIZE 4
+
+namespace
+{
+
+struct CentroidCompare
+{
+        CentroidCompare(const std::vector<osg::Vec3> & c, int a) :
+                centroids(c), axis(a)
+        {
+        }
+
+        bool operator()(int a, int b) const
+        {
+            return centroids[a][axis] < centroids[b][axis];
+        }
+
+        const std::vector<osg::Vec3> & centroids;
+        int axis;
+};
+
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+    _refits = 0;
+    _built = false;
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+    _items.clear();
+    _nodes.clear();
+    _itemIndex.clear();
+    _dirtyLeaves.clear();
+    _refits = 0;
+    _built = false;
+}
+
+int BoundingVolumeHierarchy::addItem(void * data,
+        const osg::BoundingBox & bound)
+{
+    Item item;
+    item.data = data;
+    item.bound = bound;
+    item.leaf = -1;
+    _items.push_back(item);
+    _built = false;
+    return _items.size() - 1;
+}
+
+void BoundingVolumeHierarchy::setItemBound(int item,
+        const osg::BoundingBox & bound)
+{
+    _items[item].bound = bound;
+
+    int leaf = _items[item].leaf;
+    if(leaf >= 0 && !_nodes[leaf].dirty)
+    {
+        _nodes[leaf].dirty = true;
+        _dirtyLeaves.push_back(leaf);
+    }
+}
+
+void BoundingVolumeHierarchy::build()
+{
+    _nodes.clear();
+    _dirtyLeaves.clear();
+    _refits = 0;
+    _built = true;
+
+    _itemIndex.resize(_items.size());
+    for(int i = 0; i < _items.size(); i++)
+    {
+        _itemIndex[i] = i;
+    }
+
+    if(_items.size())
+    {
+        std::vector<osg::Vec3> centroids(_items.size());
+        for(int i = 0; i < _items.size(); i++)
+        {
+            if(_items[i].bound.valid())
+            {
+                centroids[i] = _items[i].bound.center();
+            }
+        }
+
+        _nodes.reserve(2 * (_items.size() / BVH_LEAF_SIZE + 1));
+        buildNode(-1,0,_items.size(),centroids);
+    }
+}
+
+void BoundingVolumeHierarchy::refit()
+{
+    if(!_built)
+    {
+        build();
+        return;
+    }
+
+    // rebuild once the moved items could have spread the tree out
+    _refits += _dirtyLeaves.size();
+    if(_refits > _items.size())
+    {
+        build();
+        return;
+    }
+
+    for(int i = 0; i < _dirtyLeaves.size(); i++)
+    {
+        Node & leaf = _nodes[_dirtyLeaves[i]];
+        leaf.dirty = false;
+        leaf.bound.init();
+        for(int j = 0; j < leaf.count; j++)
+        {
+            leaf.bound.expandBy(_items[_itemIndex[leaf.first + j]].bound);
+        }
+
+        int node = leaf.parent;
+        while(node >= 0)
+        {
+            osg::BoundingBox bound = _nodes[_nodes[node].left].bound;
+            bound.expandBy(_nodes[_nodes[node].right].bound);
+            if(bound._min == _nodes[node].bound._min
+                    && bound._max == _nodes[node].bound._max)
+            {
+                break;
+            }
+            _nodes[node].bound = bound;
+            node = _nodes[node].parent;
+        }
+    }
+    _dirtyLeaves.clear();
+}
+
+void BoundingVolumeHierarchy::intersect(const std::vector<osg::Vec3> & starts,
+        const std::vector<osg::Vec3> & dirs,
+        std::vector<std::vector<void*> > & hits)
+{
+    hits.clear();
+    hits.resize(starts.size());
+
+    if(!_built)
+    {
+        build();
+    }
+
+    if(!_nodes.size())
+    {
+        return;
+    }
+
+    std::vector<osg::Vec3> invDirs(dirs.size());
+    for(int i = 0; i < dirs.size(); i++)
+    {
+        invDirs[i] = osg::Vec3(1.0 / dirs[i].x(),1.0 / dirs[i].y(),
+                1.0 / dirs[i].z());
+    }
+
+    // walk up to 32 rays at a time, each node carries a mask of the rays
+    // that reached it
+    std::vector<std::pair<int,unsigned int> > stack;
+    for(int base = 0; base < starts.size(); base += 32)
+    {
+        int numRays = std::min((int)starts.size() - base,32);
+        unsigned int rootMask =
+                numRays == 32 ? 0xFFFFFFFFu : ((1u << numRays) - 1);
+
+        stack.push_back(std::pair<int,unsigned int>(0,rootMask));
+        while(stack.size())
+        {
+            int nodeIndex = stack.back().first;
+            unsigned int inMask = stack.back().second;
+            stack.pop_back();
+
+            const Node & node = _nodes[nodeIndex];
+            unsigned int mask = 0;
+            for(int i = 0; i < numRays; i++)
+            {
+                if((inMask & (1u << i))
+                        && hitsBox(node.bound,starts[base + i],
+                                invDirs[base + i]))
+                {
+                    mask |= (1u << i);
+                }
+            }
+
+            if(!mask)
+            {
+                continue;
+            }
+
+            if(node.left >= 0)
+            {
+                stack.push_back(std::pair<int,unsigned int>(node.right,mask));
+                stack.push_back(std::pair<int,unsigned int>(node.left,mask));
+                continue;
+            }
+
+            for(int j = 0; j < node.count; j++)
+            {
+                const Item & item = _items[_itemIndex[node.first + j]];
+                for(int i = 0; i < numRays; i++)
+                {
+                    if((mask & (1u << i))
+                            && hitsBox(item.bound,starts[base + i],
+                                    invDirs[base + i]))
+                    {
+                        hits[base + i].push_back(item.data);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int BoundingVolumeHierarchy::buildNode(int parent, int first, int count,
+        const std::vector<osg::Vec3> & centroids)
+{
+    int index = _nodes.size();
+    _nodes.push_back(Node());
+    _nodes[index].parent = parent;
+    _nodes[index].left = -1;
+    _nodes[index].right = -1;
+    _nodes[index].first = first;
+    _nodes[index].count = count;
+    _nodes[index].dirty = false;
+
+    osg::BoundingBox bound;
+    osg::BoundingBox centerBound;
+    for(int i = first; i < first + count; i++)
+    {
+        const osg::BoundingBox & ib = _items[_itemIndex[i]].bound;
+        bound.expandBy(ib);
+        if(ib.valid())
+        {
+            centerBound.expandBy(ib.center());
+        }
+    }
+    _nodes[index].bound = bound;
+
+    if(count <= BVH_LEAF_SIZE || !centerBound.valid())
+    {
+        for(int i = first; i < first + count; i++)
+        {
+            _items[_itemIndex[i]].leaf = index;
+        }
+        return index;
+    }
+
+    // median split along the widest spread of item centers
+    int axis = 0;
+    osg::Vec3 extent = centerBound._max - centerBound._min;
+    if(extent.y() > extent[axis])
+    {
+        axis = 1;
+    }
+    if(extent.z() > extent[axis])
+    {
+        axis = 2;
+    }
+
+    int half = count / 2;
+    std::nth_element(_itemIndex.begin() + first,
+            _itemIndex.begin() + first + half,
+            _itemIndex.begin() + first + count,
+            CentroidCompare(centroids,axis));
+
+    // children may reallocate the node list
+    int left = buildNode(index,first,half,centroids);
+    int right = buildNode(index,first + half,count - half,centroids);
+    _nodes[index].left = left;
+    _nodes[index].right = right;
+    _nodes[index].count = 0;
+
+    return index;
+}
+
+bool BoundingVolumeHierarchy::hitsBox(const osg::BoundingBox & bound,
+        const osg::Vec3 & start, const osg::Vec3 & invDir)
+{
+    if(!bound.valid())
+    {
+        return false;
+    }
+
+    float tmin = 0.0;
+    float tmax = FLT_MAX;
+    for(int i = 0; i < 3; i++)
+    {
+        float t1 = (bound._min[i] - start[i]) * invDir[i];
+        float t2 = (bound._max[i] - start[i]) * invDir[i];
+        if(t1 > t2)
+        {
+            std::swap(t1,t2);
+        }
+
+        // a ray parallel to and inside the slab gives nan, which keeps the
+        // current range
+        if(t1 > tmin)
+        {
+            tmin = t1;
+        }
+        if(t2 < tmax)
+        {
+            tmax = t2;
+        }
+    }
+
+    return tmin <= tmax;
+}
@@ -3,6 +3,7 @@
 #ifndef WIN32
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/select.h>
 #endif
 
 #include <iostream>
@@ -20,7 +21,7 @@ CVRMulticastSocket::CVRMulticastSocket(MCSocketType st,
     _port = port;
 
     _socket = (int)socket(AF_INET,SOCK_DGRAM,0);
-    if(socket < 0)
+    if(_socket < 0)
     {
         std::cerr << "CVRMulticastSocket: error creating socket." << std::endl;
         return;
@@ -253,6 +254,49 @@ bool CVRMulticastSocket::recv(void * buf, size_t len, int flags)
     return true;
 }
 
+int CVRMulticastSocket::recvDatagram(void * buf, size_t len, int timeout)
+{
+    if(!buf || _socket < 0)
+    {
+        std::cerr << "CVRMulticastSocket: Error: invalid recvDatagram call."
+                << std::endl;
+        return -1;
+    }
+
+    if(timeout >= 0)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(_socket,&readSet);
+
+        struct timeval tv;
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+
+        int ready = select(_socket + 1,&readSet,NULL,NULL,&tv);
+        if(ready < 0)
+        {
+            perror("select");
+            return -1;
+        }
+        if(ready == 0)
+        {
+            return 0;
+        }
+    }
+
+    int read = recvfrom(_socket,(char *)buf,len,0,
+            (struct sockaddr *)&_address,&_addrlen);
+    if(read < 0)
+    {
+        std::cerr << "CVRMulticastSocket: Error on recv." << std::endl;
+        perror("recvfrom");
+        return -1;
+    }
+
+    return read;
+}
+
 void CVRMulticastSocket::setSocketFD(int socket)
 {
     _socket = socket;
@@ -0,0 +1,507 @@
+#include <cvrUtil/CVRSharedMemoryLink.h>
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <errno.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+using namespace cvr;
+
+#ifdef __linux__
+namespace
+{
+
+const unsigned int LINK_MAGIC = 0x4356524c;
+// ms to sleep before checking if the other process is still there
+const int WAIT_TIMEOUT = 100;
+
+/**
+ * Start of the segment, padded to keep the rings on their own cache lines
+ */
+struct SegmentHeader
+{
+        unsigned int magic;
+        unsigned int key;
+        unsigned int ringSize;
+        volatile unsigned int closed;
+        volatile int creatorPid;
+        volatile int openerPid;
+        char pad[40];
+};
+
+/**
+ * Single writer, single reader ring.  head and tail count bytes and wrap,
+ * the used space is head - tail.
+ */
+struct RingHeader
+{
+        volatile unsigned int head; ///< bytes written, only changed by the writer
+        char pad0[60];
+        volatile unsigned int tail; ///< bytes read, only changed by the reader
+        char pad1[60];
+        volatile unsigned int readerWaiting;
+        volatile unsigned int writerWaiting;
+        char pad2[56];
+};
+
+inline void cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause");
+#endif
+}
+
+void futexWake(volatile unsigned int * addr)
+{
+    syscall(SYS_futex,(unsigned int*)addr,FUTEX_WAKE,1,NULL,NULL,0);
+}
+
+}
+#endif
+
+CVRSharedMemoryLink::CVRSharedMemoryLink()
+{
+    _creator = false;
+    _linked = false;
+    _segment = NULL;
+    _segmentSize = 0;
+    _sendRing = _recvRing = NULL;
+    _sendData = _recvData = NULL;
+    _ringSize = 0;
+    _spinCount = 2000;
+    _error = false;
+
+#ifdef __linux__
+    // nothing can change while spinning if the other side needs this cpu
+    if(sysconf(_SC_NPROCESSORS_ONLN) < 2)
+    {
+        _spinCount = 0;
+    }
+#endif
+}
+
+CVRSharedMemoryLink::~CVRSharedMemoryLink()
+{
+    close();
+}
+
+bool CVRSharedMemoryLink::create(std::string name, unsigned int ringSize)
+{
+#ifdef __linux__
+    close();
+
+    unsigned int size = 4096;
+    while(size < ringSize && size < (1u << 30))
+    {
+        size <<= 1;
+    }
+
+    int fd = shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0600);
+    if(fd < 0 && errno == EEXIST)
+    {
+        // left over from a process that did not exit cleanly
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0600);
+    }
+    if(fd < 0)
+    {
+        perror("shm_open");
+        return false;
+    }
+
+    _name = name;
+    _creator = true;
+    _linked = true;
+
+    size_t segmentSize = sizeof(struct SegmentHeader)
+            + 2 * sizeof(struct RingHeader) + 2 * (size_t)size;
+    if(ftruncate(fd,segmentSize) < 0)
+    {
+        perror("ftruncate");
+        ::close(fd);
+        close();
+        return false;
+    }
+
+    _ringSize = size;
+    bool ok = map(fd,segmentSize);
+    ::close(fd);
+    if(!ok)
+    {
+        close();
+        return false;
+    }
+
+    SegmentHeader * header = (SegmentHeader*)_segment;
+    header->key = ((unsigned int)time(NULL)) ^ (((unsigned int)getpid()) << 16)
+            ^ (unsigned int)(size_t)_segment;
+    header->ringSize = _ringSize;
+    header->closed = 0;
+    header->creatorPid = getpid();
+    header->openerPid = 0;
+    __sync_synchronize();
+    header->magic = LINK_MAGIC;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CVRSharedMemoryLink::open(std::string name, unsigned int key)
+{
+#ifdef __linux__
+    close();
+
+    int fd = shm_open(name.c_str(),O_RDWR,0600);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd,&st) < 0
+            || st.st_size < (off_t)(sizeof(struct SegmentHeader)
+                    + 2 * sizeof(struct RingHeader)))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    _name = name;
+    _creator = false;
+    bool ok = map(fd,st.st_size);
+    ::close(fd);
+
+    SegmentHeader * header = (SegmentHeader*)_segment;
+    if(!ok || header->magic != LINK_MAGIC || header->key != key
+            || st.st_size != (off_t)(sizeof(struct SegmentHeader)
+                    + 2 * sizeof(struct RingHeader)
+                    + 2 * (size_t)header->ringSize))
+    {
+        close();
+        return false;
+    }
+
+    _ringSize = header->ringSize;
+    header->openerPid = getpid();
+    return map(-1,0);
+#else
+    return false;
+#endif
+}
+
+void CVRSharedMemoryLink::unlink()
+{
+#ifdef __linux__
+    if(_linked)
+    {
+        shm_unlink(_name.c_str());
+        _linked = false;
+    }
+#endif
+}
+
+unsigned int CVRSharedMemoryLink::getKey()
+{
+    if(!_segment)
+    {
+        return 0;
+    }
+#ifdef __linux__
+    return ((SegmentHeader*)_segment)->key;
+#else
+    return 0;
+#endif
+}
+
+bool CVRSharedMemoryLink::send(void * buf, size_t len)
+{
+#ifdef __linux__
+    if(!valid())
+    {
+        std::cerr << "Error: Calling send on invalid shared memory link."
+                << std::endl;
+        return false;
+    }
+
+    RingHeader * ring = (RingHeader*)_sendRing;
+    unsigned int mask = _ringSize - 1;
+    const char * data = (const char*)buf;
+    unsigned int head = ring->head;
+
+    while(len)
+    {
+        unsigned int tail = ring->tail;
+        __sync_synchronize();
+
+        unsigned int space = _ringSize - (head - tail);
+        if(!space)
+        {
+            if(!wait(&ring->tail,tail,&ring->writerWaiting))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        unsigned int chunk = len < space ? len : space;
+        unsigned int start = head & mask;
+        unsigned int first = _ringSize - start;
+        if(first > chunk)
+        {
+            first = chunk;
+        }
+        memcpy(_sendData + start,data,first);
+        memcpy(_sendData,data + first,chunk - first);
+
+        // publish the data, then see if the reader needs waking
+        __sync_synchronize();
+        head += chunk;
+        ring->head = head;
+        __sync_synchronize();
+        if(ring->readerWaiting)
+        {
+            futexWake(&ring->head);
+        }
+
+        data += chunk;
+        len -= chunk;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CVRSharedMemoryLink::recv(void * buf, size_t len)
+{
+#ifdef __linux__
+    if(!valid())
+    {
+        std::cerr << "Error: Calling recv on invalid shared memory link."
+                << std::endl;
+        return false;
+    }
+
+    RingHeader * ring = (RingHeader*)_recvRing;
+    unsigned int mask = _ringSize - 1;
+    char * data = (char*)buf;
+    unsigned int tail = ring->tail;
+
+    while(len)
+    {
+        unsigned int head = ring->head;
+        __sync_synchronize();
+
+        unsigned int used = head - tail;
+        if(!used)
+        {
+            if(!wait(&ring->head,head,&ring->readerWaiting))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        unsigned int chunk = len < used ? len : used;
+        unsigned int start = tail & mask;
+        unsigned int first = _ringSize - start;
+        if(first > chunk)
+        {
+            first = chunk;
+        }
+        memcpy(data,_recvData + start,first);
+        memcpy(data + first,_recvData,chunk - first);
+
+        // done with the space, then see if the writer needs waking
+        __sync_synchronize();
+        tail += chunk;
+        ring->tail = tail;
+        __sync_synchronize();
+        if(ring->writerWaiting)
+        {
+            futexWake(&ring->tail);
+        }
+
+        data += chunk;
+        len -= chunk;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CVRSharedMemoryLink::sendv(SocketBuffer * buffers, int count)
+{
+    for(int i = 0; i < count; i++)
+    {
+        if(buffers[i].len && !send(buffers[i].data,buffers[i].len))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CVRSharedMemoryLink::valid()
+{
+#ifdef __linux__
+    return _segment && _sendRing && !_error;
+#else
+    return false;
+#endif
+}
+
+bool CVRSharedMemoryLink::map(int fd, size_t size)
+{
+#ifdef __linux__
+    if(fd >= 0)
+    {
+        _segment = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        if(_segment == MAP_FAILED)
+        {
+            perror("mmap");
+            _segment = NULL;
+            return false;
+        }
+        _segmentSize = size;
+
+        // the opener checks the header before the rings are used
+        if(!_creator)
+        {
+            return true;
+        }
+    }
+
+    char * ptr = ((char*)_segment) + sizeof(struct SegmentHeader);
+    RingHeader * rings[2];
+    rings[0] = (RingHeader*)ptr;
+    rings[1] = (RingHeader*)(ptr + sizeof(struct RingHeader));
+    ptr += 2 * sizeof(struct RingHeader);
+    char * data[2];
+    data[0] = ptr;
+    data[1] = ptr + _ringSize;
+
+    // ring 0 carries data from the creator to the opener
+    int out = _creator ? 0 : 1;
+    _sendRing = rings[out];
+    _sendData = data[out];
+    _recvRing = rings[1 - out];
+    _recvData = data[1 - out];
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CVRSharedMemoryLink::close()
+{
+#ifdef __linux__
+    if(_segment)
+    {
+        SegmentHeader * header = (SegmentHeader*)_segment;
+        if(_sendRing)
+        {
+            // let a blocked peer know to give up
+            header->closed = 1;
+            __sync_synchronize();
+            futexWake(&((RingHeader*)_sendRing)->head);
+            futexWake(&((RingHeader*)_recvRing)->tail);
+        }
+        munmap(_segment,_segmentSize);
+    }
+    unlink();
+#endif
+
+    _segment = NULL;
+    _segmentSize = 0;
+    _sendRing = _recvRing = NULL;
+    _sendData = _recvData = NULL;
+    _error = false;
+}
+
+bool CVRSharedMemoryLink::wait(volatile unsigned int * value,
+        unsigned int old, volatile unsigned int * waiting)
+{
+#ifdef __linux__
+    for(int i = 0; i < _spinCount; i++)
+    {
+        if(*value != old)
+        {
+            return true;
+        }
+        cpuRelax();
+    }
+
+    struct timespec timeout;
+    timeout.tv_sec = WAIT_TIMEOUT / 1000;
+    timeout.tv_nsec = (WAIT_TIMEOUT % 1000) * 1000000;
+
+    while(true)
+    {
+        // the other side checks this flag after publishing progress
+        *waiting = 1;
+        __sync_synchronize();
+        if(*value != old)
+        {
+            *waiting = 0;
+            return true;
+        }
+
+        syscall(SYS_futex,(unsigned int*)value,FUTEX_WAIT,old,&timeout,NULL,0);
+        *waiting = 0;
+        __sync_synchronize();
+
+        if(*value != old)
+        {
+            return true;
+        }
+
+        if(!peerAlive())
+        {
+            std::cerr << "CVRSharedMemoryLink Error: other side of link "
+                    << _name << " has closed." << std::endl;
+            _error = true;
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+bool CVRSharedMemoryLink::peerAlive()
+{
+#ifdef __linux__
+    SegmentHeader * header = (SegmentHeader*)_segment;
+    if(header->closed)
+    {
+        return false;
+    }
+
+    int pid = _creator ? header->openerPid : header->creatorPid;
+    if(pid && kill(pid,0) < 0 && errno == ESRCH)
+    {
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
@@ -12,20 +12,142 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 #else
 #include <winsock2.h>
 #include <stdlib.h>
 #pragma comment(lib, "Ws2_32.lib")
 #endif
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define CVR_SOCKET_ZEROCOPY
+#endif
+
 using namespace cvr;
 
+#ifndef WIN32
+namespace
+{
+
+const int MAX_IOV = 64;
+
+/**
+ * Fill an iovec list from the buffers, starting offset bytes into buffer
+ * index.  Returns the number of entries used and sets total to their size.
+ */
+int fillIOV(struct iovec * iov, SocketBuffer * buffers, int count, int index,
+        size_t offset, size_t & total)
+{
+    int iovCount = 0;
+    total = 0;
+    for(int i = index; i < count && iovCount < MAX_IOV; i++)
+    {
+        size_t skip = i == index ? offset : 0;
+        if(buffers[i].len <= skip)
+        {
+            continue;
+        }
+        iov[iovCount].iov_base = ((char*)buffers[i].data) + skip;
+        iov[iovCount].iov_len = buffers[i].len - skip;
+        total += iov[iovCount].iov_len;
+        iovCount++;
+    }
+    return iovCount;
+}
+
+/**
+ * Move the buffer position forward by bytes, skipping empty buffers
+ */
+void advance(SocketBuffer * buffers, int count, int & index, size_t & offset,
+        size_t bytes)
+{
+    while(index < count)
+    {
+        size_t left = buffers[index].len - offset;
+        if(bytes < left)
+        {
+            offset += bytes;
+            return;
+        }
+        bytes -= left;
+        index++;
+        offset = 0;
+    }
+}
+
+#ifdef CVR_SOCKET_ZEROCOPY
+/**
+ * True if both ends of the connection are on this host.  Loopback traffic is
+ * copied even when sent with zero copy, so it only adds the completion wait.
+ */
+bool isLocalConnection(int socket)
+{
+    struct sockaddr_storage local, peer;
+    socklen_t localLength = sizeof(struct sockaddr_storage);
+    socklen_t peerLength = sizeof(struct sockaddr_storage);
+    if(getsockname(socket,(struct sockaddr *)&local,&localLength)
+            || getpeername(socket,(struct sockaddr *)&peer,&peerLength)
+            || local.ss_family != peer.ss_family)
+    {
+        return false;
+    }
+
+    if(local.ss_family == AF_INET)
+    {
+        return ((struct sockaddr_in *)&local)->sin_addr.s_addr
+                == ((struct sockaddr_in *)&peer)->sin_addr.s_addr;
+    }
+    if(local.ss_family == AF_INET6)
+    {
+        return !memcmp(&((struct sockaddr_in6 *)&local)->sin6_addr,
+                &((struct sockaddr_in6 *)&peer)->sin6_addr,
+                sizeof(struct in6_addr));
+    }
+    return false;
+}
+#endif
+
+}
+#else
+namespace
+{
+
+const int MAX_IOV = 64;
+
+/**
+ * Fill a WSABUF list from the non-empty buffers, returns the number used
+ */
+DWORD fillWSABuf(WSABUF * wsaBuffers, SocketBuffer * buffers, int count)
+{
+    DWORD wsaCount = 0;
+    for(int i = 0; i < count && wsaCount < MAX_IOV; i++)
+    {
+        if(!buffers[i].len)
+        {
+            continue;
+        }
+        wsaBuffers[wsaCount].buf = (char*)buffers[i].data;
+        wsaBuffers[wsaCount].len = (ULONG)buffers[i].len;
+        wsaCount++;
+    }
+    return wsaCount;
+}
+
+}
+#endif
+
 CVRSocket::CVRSocket(int socket)
 {
     _socket = socket;
     _type = CONNECT;
     _printErrors = false;
     _blockingState = true;
+    _zeroCopyMin = 0;
+    _zeroCopyPending = 0;
 }
 
 CVRSocket::CVRSocket(SocketType type, std::string host, int port, int family,
@@ -37,6 +159,8 @@ CVRSocket::CVRSocket(SocketType type, std::string host, int port, int family,
     _host = host;
     _port = port;
     _blockingState = true;
+    _zeroCopyMin = 0;
+    _zeroCopyPending = 0;
 
     _socket = -1;
 
@@ -471,6 +595,447 @@ bool CVRSocket::recv(void * buf, size_t len, int flags)
     return true;
 }
 
+bool CVRSocket::sendv(SocketBuffer * buffers, int count, int flags,
+        int timeout)
+{
+    if(!buffers && count)
+    {
+        std::cerr << "Error sending NULL buffer." << std::endl;
+        return false;
+    }
+
+    if(!valid())
+    {
+        std::cerr << "Error: Calling sendv on invalid socket." << std::endl;
+        return false;
+    }
+
+#ifndef WIN32
+    int index = 0;
+    size_t offset = 0;
+    struct iovec iov[MAX_IOV];
+    while(true)
+    {
+        size_t total;
+        int iovCount = fillIOV(iov,buffers,count,index,offset,total);
+        if(!iovCount)
+        {
+            break;
+        }
+
+        struct msghdr msg;
+        memset(&msg,0,sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovCount;
+
+        int sendFlags = flags;
+#ifdef CVR_SOCKET_ZEROCOPY
+        if(_zeroCopyMin && total >= _zeroCopyMin)
+        {
+            sendFlags |= MSG_ZEROCOPY;
+        }
+#endif
+
+        ssize_t sent = ::sendmsg(_socket,&msg,sendFlags);
+        if(sent < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if((errno == EAGAIN || errno == EWOULDBLOCK)
+                    && waitReady(false,timeout))
+            {
+                continue;
+            }
+            if(_printErrors && errno)
+            {
+                std::cerr << "Error sending data." << std::endl;
+                perror("sendmsg");
+            }
+            return false;
+        }
+
+#ifdef CVR_SOCKET_ZEROCOPY
+        if(sendFlags & MSG_ZEROCOPY)
+        {
+            _zeroCopyPending++;
+        }
+#endif
+
+        advance(buffers,count,index,offset,sent);
+    }
+
+    // the caller may reuse the buffers once this returns
+    return waitZeroCopy();
+#else
+    for(int i = 0; i < count; i++)
+    {
+        if(buffers[i].len && !send(buffers[i].data,buffers[i].len,flags))
+        {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+bool CVRSocket::recvv(SocketBuffer * buffers, int count, int flags,
+        int timeout)
+{
+    if(!buffers && count)
+    {
+        std::cerr << "Error recv with NULL buffer." << std::endl;
+        return false;
+    }
+
+    if(!valid())
+    {
+        std::cerr << "Error: Calling recvv on invalid socket." << std::endl;
+        return false;
+    }
+
+#ifndef WIN32
+    int index = 0;
+    size_t offset = 0;
+    struct iovec iov[MAX_IOV];
+    while(true)
+    {
+        size_t total;
+        int iovCount = fillIOV(iov,buffers,count,index,offset,total);
+        if(!iovCount)
+        {
+            break;
+        }
+
+        struct msghdr msg;
+        memset(&msg,0,sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovCount;
+
+        ssize_t read = ::recvmsg(_socket,&msg,flags);
+        if(read < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if((errno == EAGAIN || errno == EWOULDBLOCK)
+                    && waitReady(true,timeout))
+            {
+                continue;
+            }
+        }
+
+        if(read <= 0)
+        {
+            if(_printErrors && errno)
+            {
+                std::cerr << "Error on recv." << std::endl;
+                perror("recvmsg");
+            }
+            return false;
+        }
+
+        advance(buffers,count,index,offset,read);
+    }
+    return true;
+#else
+    for(int i = 0; i < count; i++)
+    {
+        if(buffers[i].len && !recv(buffers[i].data,buffers[i].len,flags))
+        {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+int CVRSocket::trySendv(SocketBuffer * buffers, int count, int flags)
+{
+    if(!valid() || (!buffers && count))
+    {
+        return -1;
+    }
+
+#ifndef WIN32
+    size_t total;
+    struct iovec iov[MAX_IOV];
+    struct msghdr msg;
+    memset(&msg,0,sizeof(struct msghdr));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = fillIOV(iov,buffers,count,0,0,total);
+    if(!msg.msg_iovlen)
+    {
+        return 0;
+    }
+
+    ssize_t sent;
+    do
+    {
+        sent = ::sendmsg(_socket,&msg,flags | MSG_DONTWAIT);
+    }
+    while(sent < 0 && errno == EINTR);
+
+    if(sent < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        if(_printErrors)
+        {
+            perror("sendmsg");
+        }
+        return -1;
+    }
+    return (int)sent;
+#else
+    // there is no per call non-blocking flag, the socket has to be set
+    // non-blocking
+    WSABUF wsaBuffers[MAX_IOV];
+    DWORD wsaCount = fillWSABuf(wsaBuffers,buffers,count);
+    if(!wsaCount)
+    {
+        return 0;
+    }
+
+    DWORD sent;
+    if(WSASend(_socket,wsaBuffers,wsaCount,&sent,flags,NULL,NULL))
+    {
+        if(WSAGetLastError() == WSAEWOULDBLOCK)
+        {
+            return 0;
+        }
+        if(_printErrors)
+        {
+            std::cerr << "WSASend error: " << WSAGetLastError() << std::endl;
+        }
+        return -1;
+    }
+    return (int)sent;
+#endif
+}
+
+int CVRSocket::tryRecvv(SocketBuffer * buffers, int count, int flags)
+{
+    if(!valid() || (!buffers && count))
+    {
+        return -1;
+    }
+
+#ifndef WIN32
+    size_t total;
+    struct iovec iov[MAX_IOV];
+    struct msghdr msg;
+    memset(&msg,0,sizeof(struct msghdr));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = fillIOV(iov,buffers,count,0,0,total);
+    if(!msg.msg_iovlen)
+    {
+        return 0;
+    }
+
+    ssize_t read;
+    do
+    {
+        read = ::recvmsg(_socket,&msg,flags | MSG_DONTWAIT);
+    }
+    while(read < 0 && errno == EINTR);
+
+    if(read < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        if(_printErrors)
+        {
+            perror("recvmsg");
+        }
+        return -1;
+    }
+
+    // zero means the other end closed the connection
+    return read ? (int)read : -1;
+#else
+    WSABUF wsaBuffers[MAX_IOV];
+    DWORD wsaCount = fillWSABuf(wsaBuffers,buffers,count);
+    if(!wsaCount)
+    {
+        return 0;
+    }
+
+    DWORD read;
+    DWORD recvFlags = flags;
+    if(WSARecv(_socket,wsaBuffers,wsaCount,&read,&recvFlags,NULL,NULL))
+    {
+        if(WSAGetLastError() == WSAEWOULDBLOCK)
+        {
+            return 0;
+        }
+        if(_printErrors)
+        {
+            std::cerr << "WSARecv error: " << WSAGetLastError() << std::endl;
+        }
+        return -1;
+    }
+    return read ? (int)read : -1;
+#endif
+}
+
+void CVRSocket::setCork(bool b)
+{
+    if(!valid())
+    {
+        std::cerr << "Error: setCork: invalid socket." << std::endl;
+        return;
+    }
+
+    int value = b ? 1 : 0;
+#if defined(__linux__)
+    if(::setsockopt(_socket,IPPROTO_TCP,TCP_CORK,(const char *)&value,
+            sizeof(int)) == -1)
+    {
+        perror("TCP_CORK");
+    }
+#elif defined(__APPLE__)
+    if(::setsockopt(_socket,IPPROTO_TCP,TCP_NOPUSH,(const char *)&value,
+            sizeof(int)) == -1)
+    {
+        perror("TCP_NOPUSH");
+    }
+#endif
+}
+
+bool CVRSocket::setZeroCopy(size_t minSize)
+{
+    if(!valid())
+    {
+        std::cerr << "Error: setZeroCopy: invalid socket." << std::endl;
+        return false;
+    }
+
+#ifdef CVR_SOCKET_ZEROCOPY
+    if(minSize && !_zeroCopyMin)
+    {
+        if(isLocalConnection(_socket))
+        {
+            return false;
+        }
+
+        int yes = 1;
+        if(::setsockopt(_socket,SOL_SOCKET,SO_ZEROCOPY,(const char *)&yes,
+                sizeof(int)) == -1)
+        {
+            if(_printErrors)
+            {
+                perror("SO_ZEROCOPY");
+            }
+            return false;
+        }
+    }
+    _zeroCopyMin = minSize;
+    return true;
+#else
+    return !minSize;
+#endif
+}
+
+bool CVRSocket::waitReady(bool read, int timeout)
+{
+#ifndef WIN32
+    struct pollfd pfd;
+    pfd.fd = _socket;
+    pfd.events = read ? POLLIN : POLLOUT;
+    pfd.revents = 0;
+
+    int res;
+    do
+    {
+        res = poll(&pfd,1,timeout);
+    }
+    while(res < 0 && errno == EINTR);
+
+    if(res == 0)
+    {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    return res > 0;
+#else
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(_socket,&fds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+    int res = select(_socket + 1,read ? &fds : NULL,read ? NULL : &fds,NULL,
+            timeout < 0 ? NULL : &tv);
+    return res > 0;
+#endif
+}
+
+bool CVRSocket::waitZeroCopy()
+{
+#ifdef CVR_SOCKET_ZEROCOPY
+    // completions come back on the error queue as ranges of send calls
+    while(_zeroCopyPending)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg,0,sizeof(struct msghdr));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(::recvmsg(_socket,&msg,MSG_ERRQUEUE) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                struct pollfd pfd;
+                pfd.fd = _socket;
+                pfd.events = 0;
+                pfd.revents = 0;
+                if(poll(&pfd,1,-1) < 0 && errno != EINTR)
+                {
+                    return false;
+                }
+                continue;
+            }
+            if(_printErrors)
+            {
+                perror("recvmsg MSG_ERRQUEUE");
+            }
+            _zeroCopyPending = 0;
+            return false;
+        }
+
+        for(struct cmsghdr * cm = CMSG_FIRSTHDR(&msg); cm;
+                cm = CMSG_NXTHDR(&msg,cm))
+        {
+            struct sock_extended_err * err =
+                    (struct sock_extended_err *)CMSG_DATA(cm);
+            if(err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno)
+            {
+                continue;
+            }
+
+            unsigned int done = err->ee_data - err->ee_info + 1;
+            _zeroCopyPending -= done < _zeroCopyPending ? done
+                    : _zeroCopyPending;
+        }
+    }
+#endif
+    return true;
+}
+
 bool CVRSocket::valid()
 {
     return _socket >= 0;
@@ -7,9 +7,12 @@
 #include <cvrKernel/SceneManager.h>
 #include <osgUtil/CullVisitor>
 #include <osg/Version>
+#include <osg/Timer>
 #include <cvrUtil/DepthPartitionNode.h>
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 
 using namespace osg;
 
@@ -44,9 +47,13 @@ DepthPartitionNode::DepthPartitionNode(const DepthPartitionNode& dpn,
         const osg::CopyOp& copyop) :
         osg::Group(dpn,copyop), _active(dpn._active), 
                 _clearColorBuffer(dpn._clearColorBuffer), _forwardOtherTraversals(
-                dpn._forwardOtherTraversals)
+                dpn._forwardOtherTraversals), _reuseTolerance(
+                dpn._reuseTolerance), _maxReuseFrames(dpn._maxReuseFrames), _sceneRevision(
+                0), _numThreads(dpn._numThreads), _parallelThreshold(
+                dpn._parallelThreshold)
 {
     _numCameras = 0;
+    resetStats();
 }
 
 DepthPartitionNode::~DepthPartitionNode()
@@ -59,6 +66,54 @@ void DepthPartitionNode::init()
     _numCameras = 0;
     setCullingActive(false);
     _clearColorBuffer = true;
+
+    _reuseTolerance = -1.0;
+    _maxReuseFrames = 3;
+    _sceneRevision = 0;
+    _numThreads = 1;
+    _parallelThreshold = 64;
+    resetStats();
+}
+
+void DepthPartitionNode::setNumThreads(unsigned int threads)
+{
+    _lock.lock();
+    _numThreads = threads;
+    for(std::map<int,osg::ref_ptr<DistanceAccumulator> >::iterator it =
+            _daMap.begin(); it != _daMap.end(); it++)
+    {
+        it->second->setNumThreads(threads);
+    }
+    _lock.unlock();
+}
+
+void DepthPartitionNode::setParallelThreshold(unsigned int children)
+{
+    _lock.lock();
+    _parallelThreshold = children;
+    for(std::map<int,osg::ref_ptr<DistanceAccumulator> >::iterator it =
+            _daMap.begin(); it != _daMap.end(); it++)
+    {
+        it->second->setParallelThreshold(children);
+    }
+    _lock.unlock();
+}
+
+DepthPartitionNode::PartitionStats DepthPartitionNode::getStats()
+{
+    _statsLock.lock();
+    PartitionStats stats = _stats;
+    _statsLock.unlock();
+    return stats;
+}
+
+void DepthPartitionNode::resetStats()
+{
+    _statsLock.lock();
+    _stats.cameras = 0;
+    _stats.reused = 0;
+    _stats.time = 0.0;
+    _statsLock.unlock();
 }
 
 void DepthPartitionNode::setActive(bool active)
@@ -132,10 +187,19 @@ void DepthPartitionNode::traverse(osg::NodeVisitor &nv)
 
     int contextId = cv->getRenderInfo().getContextID();
 
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    _lock.lock();
     if(!_daMap[contextId])
     {
         _daMap[contextId] = new DistanceAccumulator();
+        _daMap[contextId]->setNumThreads(_numThreads);
+        _daMap[contextId]->setParallelThreshold(_parallelThreshold);
+        _partitionCache[contextId].valid = false;
     }
+    DistanceAccumulator *da = _daMap[contextId].get();
+    PartitionCache &cache = _partitionCache[contextId];
+    _lock.unlock();
 
     //std::cerr << "This: " << this << " context: " << contextId << " DA: " << _daMap[contextId].get() << std::endl;
     // We are in the cull traversal, so first collect information on the
@@ -144,27 +208,55 @@ void DepthPartitionNode::traverse(osg::NodeVisitor &nv)
     osg::RefMatrix& projection = *(cv->getProjectionMatrix());
     osg::Viewport* viewport = cv->getViewport();
 
-    // Prepare for scene traversal.
-    _daMap[contextId]->setMatrices(modelview,projection);
-    _daMap[contextId]->setNearFarRatio(cv->getNearFarRatio());
-    _daMap[contextId]->reset();
-
-    // Step 1: Traverse the children, collecting the near/far distances.
     unsigned int i;
-    for(i = 0; i < numChildren; i++)
+    bool reused = canReusePartition(cache,modelview,projection);
+    if(reused)
     {
-        _children[i]->accept(*(_daMap[contextId].get()));
+        cache.frames++;
     }
+    else
+    {
+        // Prepare for scene traversal.
+        da->setMatrices(modelview,projection);
+        da->setNearFarRatio(cv->getNearFarRatio());
+        da->reset();
+
+        // Step 1: Traverse the children, collecting the near/far distances.
+        for(i = 0; i < numChildren; i++)
+        {
+            _children[i]->accept(*da);
+        }
 
-    // Step 2: Compute the near and far distances for every Camera that
-    // should be used to render the scene.
-    _daMap[contextId]->computeCameraPairs();
+        // Step 2: Compute the near and far distances for every Camera that
+        // should be used to render the scene.
+        da->computeCameraPairs();
+
+        // Keep the partition and what it was computed from
+        cache.valid = true;
+        cache.modelview = modelview;
+        cache.projection = projection;
+        cache.revision = _sceneRevision;
+        cache.frames = 0;
+        cache.bounds.resize(numChildren);
+        for(i = 0; i < numChildren; i++)
+        {
+            cache.bounds[i] = _children[i]->getBound();
+        }
+        cache.cameraPairs = da->getCameraPairs();
+    }
 
     // Step 3: Create the Cameras, and add them as children.
-    DistanceAccumulator::PairList& camPairs =
-            _daMap[contextId]->getCameraPairs();
+    DistanceAccumulator::PairList& camPairs = cache.cameraPairs;
     unsigned int numCameras = camPairs.size(); // Get the number of cameras
 
+    _statsLock.lock();
+    _stats.cameras += numCameras > 0 ? numCameras : 1;
+    if(reused)
+        _stats.reused++;
+    _stats.time += osg::Timer::instance()->delta_s(startTick,
+            osg::Timer::instance()->tick());
+    _statsLock.unlock();
+
     osg::Camera * rootCam = cv->getCurrentCamera();
 
     //std::cerr << "Num Cameras: " << numCameras << std::endl;
@@ -217,6 +309,45 @@ void DepthPartitionNode::traverse(osg::NodeVisitor &nv)
     }
 }
 
+bool DepthPartitionNode::canReusePartition(PartitionCache &cache,
+        const osg::Matrix &modelview, const osg::Matrix &projection)
+{
+    if(!cache.valid || _reuseTolerance < 0.0)
+        return false;
+
+    if(cache.revision != _sceneRevision)
+        return false;
+
+    if(_maxReuseFrames && cache.frames >= _maxReuseFrames)
+        return false;
+
+    // Anything added, removed or moved under a child changes its bound
+    if(cache.bounds.size() != _children.size())
+        return false;
+    for(unsigned int i = 0; i < _children.size(); i++)
+    {
+        if(!(cache.bounds[i] == _children[i]->getBound()))
+            return false;
+    }
+
+    for(int i = 0; i < 4; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            double mv = cache.modelview(i,j);
+            double p = cache.projection(i,j);
+            if(fabs(modelview(i,j) - mv)
+                    > _reuseTolerance * std::max(fabs(mv),1.0))
+                return false;
+            if(fabs(projection(i,j) - p)
+                    > _reuseTolerance * std::max(fabs(p),1.0))
+                return false;
+        }
+    }
+
+    return true;
+}
+
 bool DepthPartitionNode::addChild(osg::Node *child)
 {
     return insertChild(_children.size(),child);
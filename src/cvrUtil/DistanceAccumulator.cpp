@@ -39,7 +39,7 @@ double distanceDA(const osg::Vec3 &coord, const osg::Matrix& matrix)
 
 DistanceAccumulator::DistanceAccumulator() :
         osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _nearFarRatio(0.0005), _maxDepth(
-        UINT_MAX)
+        UINT_MAX), _parallelThreshold(64), _splitting(false), _threadsDone(0)
 {
     setMatrices(osg::Matrix::identity(),osg::Matrix::identity());
     reset();
@@ -47,6 +47,148 @@ DistanceAccumulator::DistanceAccumulator() :
 
 DistanceAccumulator::~DistanceAccumulator()
 {
+    setNumThreads(1);
+}
+
+void DistanceAccumulator::setNumThreads(unsigned int threads)
+{
+    if(threads < 1)
+        threads = 1;
+    if(threads == _threads.size() + 1)
+        return;
+
+    for(unsigned int i = 0; i < _threads.size(); i++)
+    {
+        _threads[i]->quit();
+        _threads[i]->join();
+        delete _threads[i];
+    }
+    _threads.clear();
+
+    for(unsigned int i = 1; i < threads; i++)
+    {
+        _threads.push_back(new AccumulateThread());
+        _threads.back()->start();
+    }
+}
+
+void DistanceAccumulator::traverseChildren(osg::Node &node)
+{
+    osg::Group *group = node.asGroup();
+
+    // Only the top level split uses the threads, the parts are not split again
+    if(_splitting || _threads.empty() || !group
+            || group->getNumChildren() < _parallelThreshold)
+    {
+        traverse(node);
+        return;
+    }
+
+    unsigned int numChildren = group->getNumChildren();
+
+    // Bounds are computed lazily and cached in the nodes, so fill them in on
+    // this thread before the parts are traversed at the same time
+    for(unsigned int i = 0; i < numChildren; i++)
+        group->getChild(i)->getBound();
+
+    unsigned int numParts = _threads.size() + 1;
+    unsigned int partSize = (numChildren + numParts - 1) / numParts;
+
+    // This thread takes the first part, the threads take the rest
+    unsigned int numStarted = 0;
+    for(unsigned int i = 0; i < _threads.size(); i++)
+    {
+        if((i + 1) * partSize < numChildren)
+            numStarted++;
+    }
+    _threadsDone.setBlockCount(numStarted);
+    _threadsDone.reset();
+
+    for(unsigned int i = 0; i < numStarted; i++)
+    {
+        unsigned int first = (i + 1) * partSize;
+        _threads[i]->startWork(this,group,first,
+                std::min(partSize,numChildren - first),&_threadsDone);
+    }
+
+    _splitting = true;
+    for(unsigned int i = 0; i < partSize && i < numChildren; i++)
+    {
+        group->getChild(i)->accept(*this);
+    }
+    _splitting = false;
+
+    if(numStarted)
+        _threadsDone.block();
+
+    // Merge the pairs and limits found by the threads
+    for(unsigned int i = 0; i < numStarted; i++)
+    {
+        DistanceAccumulator *da = _threads[i]->_accumulator.get();
+        _distancePairs.insert(_distancePairs.end(),
+                da->_distancePairs.begin(),da->_distancePairs.end());
+        if(da->_limits.first < _limits.first)
+            _limits.first = da->_limits.first;
+        if(da->_limits.second > _limits.second)
+            _limits.second = da->_limits.second;
+    }
+}
+
+DistanceAccumulator::AccumulateThread::AccumulateThread() :
+        _done(NULL), _group(NULL), _first(0), _count(0), _quit(false)
+{
+    _accumulator = new DistanceAccumulator();
+}
+
+DistanceAccumulator::AccumulateThread::~AccumulateThread()
+{
+}
+
+void DistanceAccumulator::AccumulateThread::quit()
+{
+    _quit = true;
+    _start.release();
+}
+
+void DistanceAccumulator::AccumulateThread::startWork(
+        DistanceAccumulator * parent, osg::Group * group, unsigned int first,
+        unsigned int count, OpenThreads::BlockCount * done)
+{
+    // Start from the parent's current matrices, so the local frustum and
+    // distances match what the parent would compute
+    _accumulator->setMatrices(parent->_viewMatrices.back(),
+            parent->_projectionMatrices.back());
+    _accumulator->setNearFarRatio(parent->_nearFarRatio);
+    _accumulator->setMaxDepth(parent->_maxDepth);
+    _accumulator->setTraversalMask(parent->getTraversalMask());
+    _accumulator->setNodeMaskOverride(parent->getNodeMaskOverride());
+    _accumulator->reset();
+    _accumulator->_currentDepth = parent->_currentDepth;
+
+    _group = group;
+    _first = first;
+    _count = count;
+    _done = done;
+    _start.release();
+}
+
+void DistanceAccumulator::AccumulateThread::run()
+{
+    while(1)
+    {
+        _start.block();
+        _start.reset();
+
+        if(_quit)
+            return;
+
+        for(unsigned int i = _first; i < _first + _count; i++)
+        {
+            _group->getChild(i)->accept(*(_accumulator.get()));
+        }
+
+        _done->completed();
+    }
 }
 
 void DistanceAccumulator::pushLocalFrustum()
@@ -175,7 +317,7 @@ void DistanceAccumulator::apply(osg::Node &node)
     {
         // Traverse this node
         ++_currentDepth;
-        traverse(node);
+        traverseChildren(node);
         --_currentDepth;
     }
 }
@@ -190,7 +332,7 @@ void DistanceAccumulator::apply(osg::Projection &proj)
 
         // Traverse the group
         ++_currentDepth;
-        traverse(proj);
+        traverseChildren(proj);
         --_currentDepth;
 
         // Reload original matrix and frustum
@@ -216,7 +358,7 @@ void DistanceAccumulator::apply(osg::Transform &transform)
         }
 
         ++_currentDepth;
-        traverse(transform);
+        traverseChildren(transform);
         --_currentDepth;
 
         if(pushMatrix)
@@ -123,3 +123,19 @@ float cvr::planePointDistanceRef(const osg::Vec3 & planePoint,
 {
     return ((point - planePoint) * planeNormal) / planeNormal.length();
 }
+
+osg::BoundingBox cvr::transformBoundingBox(const osg::BoundingBox & bb,
+        const osg::Matrix & mat)
+{
+    if(!bb.valid())
+    {
+        return bb;
+    }
+
+    osg::BoundingBox tbb;
+    for(int i = 0; i < 8; i++)
+    {
+        tbb.expandBy(bb.corner(i) * mat);
+    }
+    return tbb;
+}
@@ -0,0 +1,836 @@
+#include <cvrUtil/PointCloudNode.h>
+
+#include <osgUtil/CullVisitor>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <set>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace cvr;
+
+#define POINT_CLOUD_MAGIC "CVRPOCT"
+#define POINT_CLOUD_VERSION 1
+#define POINT_CLOUD_MAX_DEPTH 24
+
+namespace
+{
+
+/**
+ * File header, followed by the octree nodes, then the points of each node.
+ * Values are in native byte order.
+ */
+struct FileHeader
+{
+        char magic[8];
+        unsigned int version;
+        unsigned int numNodes;
+        float min[3];
+        float max[3];
+        unsigned long long totalPoints;
+};
+
+struct BuildItem
+{
+        int node;
+        int depth;
+        osg::Vec3 min;
+        float edge;
+        std::vector<unsigned int> points;
+};
+
+struct LastUsedCompare
+{
+        LastUsedCompare(const std::vector<int> & l) :
+                lastUsed(l)
+        {
+        }
+
+        bool operator()(int a, int b) const
+        {
+            return lastUsed[a] < lastUsed[b];
+        }
+
+        const std::vector<int> & lastUsed;
+};
+
+}
+
+PointCloudNode::PointCloudNode(PointsNode::PointsMode mode, float pointSize,
+        float radius) :
+        osg::Group()
+{
+    _data = NULL;
+    _dataSize = 0;
+#ifdef WIN32
+    _fileHandle = INVALID_HANDLE_VALUE;
+    _mapHandle = NULL;
+#else
+    _fd = -1;
+#endif
+
+    _nodes = NULL;
+    _numNodes = 0;
+    _totalPoints = 0;
+    _lastUsed = NULL;
+
+    _numThreads = 2;
+    _quit = false;
+
+    _mode = mode;
+    _pointSize = pointSize;
+    _radius = radius;
+
+    _pointBudget = 2000000;
+    _cachePoints = -1;
+    _maxPixelError = 2.0;
+    _pointsLoaded = 0;
+    _lastUpdateFrame = 0;
+
+    _updateCallback = new PointCloudUpdateCallback(this);
+    setUpdateCallback(_updateCallback);
+}
+
+PointCloudNode::~PointCloudNode()
+{
+    close();
+}
+
+bool PointCloudNode::open(std::string file)
+{
+    close();
+
+#ifdef WIN32
+    _fileHandle = CreateFileA(file.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,
+            OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if(_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "PointCloudNode: unable to open file: " << file
+                << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(_fileHandle,&fileSize);
+    _dataSize = fileSize.QuadPart;
+
+    if(_dataSize >= sizeof(FileHeader))
+    {
+        _mapHandle = CreateFileMappingA(_fileHandle,NULL,PAGE_READONLY,0,0,
+                NULL);
+        if(_mapHandle)
+        {
+            _data = (char*)MapViewOfFile(_mapHandle,FILE_MAP_READ,0,0,0);
+        }
+    }
+#else
+    _fd = ::open(file.c_str(),O_RDONLY);
+    if(_fd < 0)
+    {
+        std::cerr << "PointCloudNode: unable to open file: " << file
+                << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(_fd,&st) == 0 && st.st_size >= sizeof(FileHeader))
+    {
+        _dataSize = st.st_size;
+        void * mapped = mmap(NULL,_dataSize,PROT_READ,MAP_SHARED,_fd,0);
+        if(mapped != MAP_FAILED)
+        {
+            _data = (char*)mapped;
+        }
+    }
+#endif
+
+    if(!_data)
+    {
+        std::cerr << "PointCloudNode: unable to map file: " << file
+                << std::endl;
+        close();
+        return false;
+    }
+
+    const FileHeader * header = (const FileHeader*)_data;
+    if(strncmp(header->magic,POINT_CLOUD_MAGIC,8)
+            || header->version != POINT_CLOUD_VERSION || !header->numNodes
+            || sizeof(FileHeader) + header->numNodes * sizeof(FileNode)
+                    > _dataSize)
+    {
+        std::cerr << "PointCloudNode: not a point octree file: " << file
+                << std::endl;
+        close();
+        return false;
+    }
+
+    _numNodes = header->numNodes;
+    _nodes = (const FileNode*)(_data + sizeof(FileHeader));
+    _totalPoints = header->totalPoints;
+    _pointBound.set(header->min[0],header->min[1],header->min[2],
+            header->max[0],header->max[1],header->max[2]);
+
+    _chunks.resize(_numNodes);
+    _lastUsed = new OpenThreads::Atomic[_numNodes];
+    for(int i = 0; i < _numNodes; i++)
+    {
+        const FileNode & fn = _nodes[i];
+        bool valid = fn.offset + fn.numPoints * sizeof(FilePoint) <= _dataSize;
+        for(int j = 0; j < 8; j++)
+        {
+            if(fn.children[j] >= _numNodes || (fn.children[j] >= 0
+                    && fn.children[j] <= i))
+            {
+                valid = false;
+            }
+        }
+
+        if(!valid)
+        {
+            std::cerr << "PointCloudNode: corrupt octree node " << i
+                    << " in file: " << file << std::endl;
+            close();
+            return false;
+        }
+
+        _chunks[i].bound.set(fn.min[0],fn.min[1],fn.min[2],fn.max[0],
+                fn.max[1],fn.max[2]);
+        _chunks[i].loadState = 0;
+        _lastUsed[i].exchange((unsigned int)-1);
+        _chunks[i].lastRequested = -1;
+    }
+
+    _file = file;
+
+    _quit = false;
+    for(int i = 0; i < std::max(_numThreads,1); i++)
+    {
+        _threads.push_back(new LoadThread(this));
+        _threads.back()->start();
+    }
+
+    dirtyBound();
+    return true;
+}
+
+void PointCloudNode::close()
+{
+    _loadLock.lock();
+    _quit = true;
+    _loadCondition.broadcast();
+    _loadLock.unlock();
+
+    for(int i = 0; i < _threads.size(); i++)
+    {
+        _threads[i]->join();
+        delete _threads[i];
+    }
+    _threads.clear();
+
+    while(_requests.size())
+    {
+        _requests.pop();
+    }
+    _finished.clear();
+
+    removeChildren(0,getNumChildren());
+    _chunks.clear();
+    _loaded.clear();
+    delete[] _lastUsed;
+    _lastUsed = NULL;
+    _pointsLoaded = 0;
+    _pointsDrawn.exchange(0);
+
+    _nodes = NULL;
+    _numNodes = 0;
+    _totalPoints = 0;
+    _pointBound.init();
+    _file = "";
+
+#ifdef WIN32
+    if(_data)
+    {
+        UnmapViewOfFile(_data);
+    }
+    if(_mapHandle)
+    {
+        CloseHandle(_mapHandle);
+        _mapHandle = NULL;
+    }
+    if(_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(_fileHandle);
+        _fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(_data)
+    {
+        munmap(_data,_dataSize);
+    }
+    if(_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+#endif
+    _data = NULL;
+    _dataSize = 0;
+
+    dirtyBound();
+}
+
+bool PointCloudNode::writeFile(std::string file, osg::Vec3Array * vertArray,
+        osg::Vec4ubArray * colorArray, int maxNodePoints)
+{
+    if(!vertArray || !vertArray->size())
+    {
+        std::cerr << "PointCloudNode: no points to write." << std::endl;
+        return false;
+    }
+
+    maxNodePoints = std::max(maxNodePoints,1);
+
+    osg::BoundingBox bound;
+    for(int i = 0; i < vertArray->size(); i++)
+    {
+        bound.expandBy(vertArray->at(i));
+    }
+
+    std::vector<FileNode> nodes;
+    std::vector<std::vector<unsigned int> > nodePoints;
+
+    std::vector<BuildItem> stack(1);
+    stack[0].node = 0;
+    stack[0].depth = 0;
+    stack[0].min = bound._min;
+    stack[0].edge = std::max(bound.xMax() - bound.xMin(),
+            std::max(bound.yMax() - bound.yMin(),bound.zMax() - bound.zMin()));
+    stack[0].points.resize(vertArray->size());
+    for(int i = 0; i < vertArray->size(); i++)
+    {
+        stack[0].points[i] = i;
+    }
+
+    nodes.push_back(FileNode());
+    nodePoints.push_back(std::vector<unsigned int>());
+
+    // each node takes one point per cell of a grid over its box, the rest
+    // are passed down to the child octants
+    int gridSize = std::max((int)ceil(sqrt((double)maxNodePoints)),1);
+
+    while(stack.size())
+    {
+        BuildItem item;
+        item.points.swap(stack.back().points);
+        item.node = stack.back().node;
+        item.depth = stack.back().depth;
+        item.min = stack.back().min;
+        item.edge = stack.back().edge;
+        stack.pop_back();
+
+        FileNode fn;
+        memset(&fn,0,sizeof(FileNode));
+        for(int i = 0; i < 8; i++)
+        {
+            fn.children[i] = -1;
+        }
+
+        std::vector<unsigned int> kept;
+        std::vector<unsigned int> octants[8];
+
+        if(item.points.size() <= maxNodePoints
+                || item.depth >= POINT_CLOUD_MAX_DEPTH || item.edge <= 0.0)
+        {
+            kept.swap(item.points);
+        }
+        else
+        {
+            float cellSize = item.edge / ((float)gridSize);
+            float halfEdge = item.edge * 0.5;
+            std::set<unsigned long long> usedCells;
+
+            for(int i = 0; i < item.points.size(); i++)
+            {
+                osg::Vec3 local = vertArray->at(item.points[i]) - item.min;
+
+                if(kept.size() < maxNodePoints)
+                {
+                    unsigned long long cell = 0;
+                    for(int j = 2; j >= 0; j--)
+                    {
+                        int index = (int)(local[j] / cellSize);
+                        index = std::max(std::min(index,gridSize - 1),0);
+                        cell = cell * gridSize + index;
+                    }
+                    if(usedCells.insert(cell).second)
+                    {
+                        kept.push_back(item.points[i]);
+                        continue;
+                    }
+                }
+
+                int octant = (local.x() > halfEdge ? 1 : 0)
+                        | (local.y() > halfEdge ? 2 : 0)
+                        | (local.z() > halfEdge ? 4 : 0);
+                octants[octant].push_back(item.points[i]);
+            }
+
+            for(int i = 0; i < 8; i++)
+            {
+                if(!octants[i].size())
+                {
+                    continue;
+                }
+
+                fn.children[i] = nodes.size();
+
+                BuildItem child;
+                child.node = nodes.size();
+                child.depth = item.depth + 1;
+                child.edge = halfEdge;
+                child.min = item.min
+                        + osg::Vec3((i & 1) ? halfEdge : 0.0,
+                                (i & 2) ? halfEdge : 0.0,
+                                (i & 4) ? halfEdge : 0.0);
+                stack.push_back(child);
+                stack.back().points.swap(octants[i]);
+
+                nodes.push_back(FileNode());
+                nodePoints.push_back(std::vector<unsigned int>());
+            }
+        }
+
+        // bounds cover the node's points and everything below it
+        osg::BoundingBox nodeBound;
+        for(int i = 0; i < kept.size(); i++)
+        {
+            nodeBound.expandBy(vertArray->at(kept[i]));
+        }
+        for(int i = 0; i < 8; i++)
+        {
+            for(int j = 0; j < octants[i].size(); j++)
+            {
+                nodeBound.expandBy(vertArray->at(octants[i][j]));
+            }
+        }
+        for(int i = 0; i < 3; i++)
+        {
+            fn.min[i] = nodeBound._min[i];
+            fn.max[i] = nodeBound._max[i];
+        }
+
+        // scans are mostly surfaces, so spacing goes with the square root
+        fn.numPoints = kept.size();
+        fn.spacing = item.edge / sqrt((float)std::max((int)kept.size(),1));
+        nodes[item.node] = fn;
+        nodePoints[item.node].swap(kept);
+    }
+
+    unsigned long long offset = sizeof(FileHeader)
+            + nodes.size() * sizeof(FileNode);
+    for(int i = 0; i < nodes.size(); i++)
+    {
+        nodes[i].offset = offset;
+        offset += nodes[i].numPoints * sizeof(FilePoint);
+    }
+
+    FileHeader header;
+    memset(&header,0,sizeof(FileHeader));
+    strncpy(header.magic,POINT_CLOUD_MAGIC,8);
+    header.version = POINT_CLOUD_VERSION;
+    header.numNodes = nodes.size();
+    for(int i = 0; i < 3; i++)
+    {
+        header.min[i] = bound._min[i];
+        header.max[i] = bound._max[i];
+    }
+    header.totalPoints = vertArray->size();
+
+    FILE * fp = fopen(file.c_str(),"wb");
+    if(!fp)
+    {
+        std::cerr << "PointCloudNode: unable to write file: " << file
+                << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(&header,sizeof(FileHeader),1,fp) == 1;
+    ok = ok && fwrite(&nodes[0],sizeof(FileNode),nodes.size(),fp)
+            == nodes.size();
+
+    osg::Vec4ub white(255,255,255,255);
+    std::vector<FilePoint> buffer;
+    for(int i = 0; i < nodes.size() && ok; i++)
+    {
+        buffer.resize(nodePoints[i].size());
+        for(int j = 0; j < nodePoints[i].size(); j++)
+        {
+            unsigned int index = nodePoints[i][j];
+            const osg::Vec3 & pos = vertArray->at(index);
+            buffer[j].position[0] = pos.x();
+            buffer[j].position[1] = pos.y();
+            buffer[j].position[2] = pos.z();
+
+            osg::Vec4ub color = white;
+            if(colorArray && colorArray->size() == 1)
+            {
+                color = colorArray->at(0);
+            }
+            else if(colorArray && index < colorArray->size())
+            {
+                color = colorArray->at(index);
+            }
+            for(int k = 0; k < 4; k++)
+            {
+                buffer[j].color[k] = color[k];
+            }
+        }
+
+        if(buffer.size())
+        {
+            ok = fwrite(&buffer[0],sizeof(FilePoint),buffer.size(),fp)
+                    == buffer.size();
+        }
+    }
+
+    fclose(fp);
+
+    if(!ok)
+    {
+        std::cerr << "PointCloudNode: error writing file: " << file
+                << std::endl;
+    }
+    return ok;
+}
+
+void PointCloudNode::setPointsMode(PointsNode::PointsMode mode)
+{
+    _mode = mode;
+    for(int i = 0; i < _loaded.size(); i++)
+    {
+        _chunks[_loaded[i]].points->setPointsMode(mode);
+    }
+}
+
+void PointCloudNode::setPointSize(float size)
+{
+    _pointSize = size;
+    for(int i = 0; i < _loaded.size(); i++)
+    {
+        _chunks[_loaded[i]].points->setPointSize(size);
+    }
+}
+
+void PointCloudNode::setRadius(float radius)
+{
+    _radius = radius;
+    for(int i = 0; i < _loaded.size(); i++)
+    {
+        _chunks[_loaded[i]].points->setRadius(radius);
+    }
+}
+
+void PointCloudNode::setSpriteTexture(osg::Texture2D * texture)
+{
+    _spriteTexture = texture;
+    for(int i = 0; i < _loaded.size(); i++)
+    {
+        _chunks[_loaded[i]].points->setSpriteTexture(texture);
+    }
+}
+
+void PointCloudNode::traverse(osg::NodeVisitor & nv)
+{
+    if(nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR && _numNodes)
+    {
+        cull(nv);
+        return;
+    }
+
+    osg::Group::traverse(nv);
+}
+
+osg::BoundingSphere PointCloudNode::computeBound() const
+{
+    if(!_numNodes)
+    {
+        return osg::Group::computeBound();
+    }
+
+    osg::BoundingSphere bs;
+    bs.expandBy(_pointBound);
+    return bs;
+}
+
+void PointCloudNode::update(int frame)
+{
+    std::vector<int> finished;
+
+    _loadLock.lock();
+    _lastUpdateFrame = frame;
+    finished.swap(_finished);
+    _loadLock.unlock();
+
+    // PointsNodes are only made and attached here, so cull never sees a
+    // partly built chunk
+    for(int i = 0; i < finished.size(); i++)
+    {
+        Chunk & chunk = _chunks[finished[i]];
+        chunk.points = makePoints(chunk);
+        chunk.loadedVerts = NULL;
+        chunk.loadedColors = NULL;
+        chunk.loadState = 2;
+        addChild(chunk.points);
+        _loaded.push_back(finished[i]);
+        _pointsLoaded += chunk.points->getNumPoints();
+    }
+
+    releaseChunks(frame);
+}
+
+void PointCloudNode::cull(osg::NodeVisitor & nv)
+{
+    osgUtil::CullVisitor * cv = dynamic_cast<osgUtil::CullVisitor*>(&nv);
+    if(!cv)
+    {
+        osg::Group::traverse(nv);
+        return;
+    }
+
+    int frame = nv.getFrameStamp() ? nv.getFrameStamp()->getFrameNumber() : 0;
+    osg::Vec3 eye = cv->getEyeLocal();
+
+    // refine the nodes with the largest screen error first, a node's
+    // children only add detail so they are not drawn without it
+    std::priority_queue<LoadRequest> candidates;
+    LoadRequest root;
+    root.priority = FLT_MAX;
+    root.node = 0;
+    candidates.push(root);
+
+    int points = 0;
+    while(candidates.size())
+    {
+        LoadRequest lr = candidates.top();
+        candidates.pop();
+
+        const FileNode & fn = _nodes[lr.node];
+        Chunk & chunk = _chunks[lr.node];
+
+        if(cv->isCulled(chunk.bound))
+        {
+            continue;
+        }
+
+        if(points + (int)fn.numPoints > _pointBudget)
+        {
+            continue;
+        }
+
+        if(!chunk.points)
+        {
+            requestLoad(lr.node,lr.priority,frame);
+            continue;
+        }
+
+        // every cull thread marks the chunks it draws, all in the same frame
+        chunk.points->accept(nv);
+        _lastUsed[lr.node].exchange(frame);
+        points += fn.numPoints;
+
+        for(int i = 0; i < 8; i++)
+        {
+            int child = fn.children[i];
+            if(child < 0)
+            {
+                continue;
+            }
+
+            const osg::BoundingBox & cb = _chunks[child].bound;
+            osg::Vec3 nearest(
+                    std::max(cb.xMin(),std::min(eye.x(),cb.xMax())),
+                    std::max(cb.yMin(),std::min(eye.y(),cb.yMax())),
+                    std::max(cb.zMin(),std::min(eye.z(),cb.zMax())));
+
+            // the parent's spacing is the error left by not drawing the child
+            float error = FLT_MAX;
+            if(nearest != eye)
+            {
+                float pixels = cv->pixelSize(nearest,fn.spacing);
+                if(pixels > 0.0)
+                {
+                    error = pixels;
+                }
+            }
+
+            if(error > _maxPixelError)
+            {
+                LoadRequest clr;
+                clr.priority = error;
+                clr.node = child;
+                candidates.push(clr);
+            }
+        }
+    }
+
+    _pointsDrawn.exchange(points);
+}
+
+void PointCloudNode::requestLoad(int node, float priority, int frame)
+{
+    _loadLock.lock();
+    Chunk & chunk = _chunks[node];
+    chunk.lastRequested = frame;
+    if(!chunk.loadState)
+    {
+        chunk.loadState = 1;
+        LoadRequest lr;
+        lr.priority = priority;
+        lr.node = node;
+        _requests.push(lr);
+        _loadCondition.signal();
+    }
+    _loadLock.unlock();
+}
+
+void PointCloudNode::loadChunk(int node)
+{
+    const FileNode & fn = _nodes[node];
+    const FilePoint * fp = (const FilePoint*)(_data + fn.offset);
+
+    // touching the mapped points pages them in on this thread
+    osg::ref_ptr<osg::Vec3Array> verts = new osg::Vec3Array(fn.numPoints);
+    osg::ref_ptr<osg::Vec4ubArray> colors = new osg::Vec4ubArray(fn.numPoints);
+    for(int i = 0; i < fn.numPoints; i++)
+    {
+        verts->at(i).set(fp[i].position[0],fp[i].position[1],
+                fp[i].position[2]);
+        colors->at(i).set(fp[i].color[0],fp[i].color[1],fp[i].color[2],
+                fp[i].color[3]);
+    }
+
+    _loadLock.lock();
+    _chunks[node].loadedVerts = verts;
+    _chunks[node].loadedColors = colors;
+    _finished.push_back(node);
+    _loadLock.unlock();
+}
+
+void PointCloudNode::releaseChunks(int frame)
+{
+    int limit = _cachePoints < 0 ? 4 * _pointBudget : _cachePoints;
+    if(_pointsLoaded <= limit)
+    {
+        return;
+    }
+
+    std::vector<int> lastUsed(_chunks.size());
+    for(int i = 0; i < _loaded.size(); i++)
+    {
+        lastUsed[_loaded[i]] = (int)(unsigned int)_lastUsed[_loaded[i]];
+    }
+    std::sort(_loaded.begin(),_loaded.end(),LastUsedCompare(lastUsed));
+
+    // chunks drawn in the last frame may still be in the draw thread
+    int released = 0;
+    while(released < _loaded.size() && _pointsLoaded > limit)
+    {
+        Chunk & chunk = _chunks[_loaded[released]];
+        if(lastUsed[_loaded[released]] >= frame - 1)
+        {
+            break;
+        }
+
+        _pointsLoaded -= chunk.points->getNumPoints();
+        removeChild(chunk.points);
+        chunk.points = NULL;
+
+        _loadLock.lock();
+        chunk.loadState = 0;
+        _loadLock.unlock();
+
+        released++;
+    }
+
+    _loaded.erase(_loaded.begin(),_loaded.begin() + released);
+}
+
+PointsNode * PointCloudNode::makePoints(Chunk & chunk)
+{
+    PointsNode * pn = new PointsNode(_mode,0,_pointSize,_radius,
+            osg::Vec4ub(255,255,255,255),PointsNode::POINTS_OVERALL,
+            PointsNode::POINTS_OVERALL,PointsNode::POINTS_PER_POINT);
+    pn->setVertexArray(chunk.loadedVerts.get());
+    pn->setColorArray(chunk.loadedColors.get());
+    if(_spriteTexture)
+    {
+        pn->setSpriteTexture(_spriteTexture.get());
+    }
+    return pn;
+}
+
+PointCloudNode::LoadThread::LoadThread(PointCloudNode * pcn)
+{
+    _pointCloud = pcn;
+}
+
+PointCloudNode::LoadThread::~LoadThread()
+{
+}
+
+void PointCloudNode::LoadThread::run()
+{
+    while(1)
+    {
+        int node = -1;
+
+        _pointCloud->_loadLock.lock();
+        while(!_pointCloud->_quit)
+        {
+            // drop requests for chunks the view has moved away from
+            while(_pointCloud->_requests.size())
+            {
+                LoadRequest lr = _pointCloud->_requests.top();
+                _pointCloud->_requests.pop();
+
+                Chunk & chunk = _pointCloud->_chunks[lr.node];
+                if(chunk.lastRequested < _pointCloud->_lastUpdateFrame - 1)
+                {
+                    chunk.loadState = 0;
+                    continue;
+                }
+
+                node = lr.node;
+                break;
+            }
+
+            if(node >= 0)
+            {
+                break;
+            }
+
+            _pointCloud->_loadCondition.wait(&_pointCloud->_loadLock);
+        }
+        _pointCloud->_loadLock.unlock();
+
+        if(node < 0)
+        {
+            return;
+        }
+
+        _pointCloud->loadChunk(node);
+    }
+}
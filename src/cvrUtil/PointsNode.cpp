@@ -1,12 +1,22 @@
 #include <cvrUtil/PointsNode.h>
 #include <cvrUtil/LocalToWorldVisitor.h>
 
+#include <osg/Version>
+#include <osg/BufferObject>
+#if ( OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0) )
+#include <osg/GLExtensions>
+#endif
+
 #include <iostream>
 #include <algorithm>
 #include <cmath>
 
 using namespace cvr;
 
+#define POINTS_MAX_QUEUED_UPLOADS 64
+#define POINTS_MERGE_GAP_BYTES 4096
+#define POINTS_FULL_UPLOAD_PERCENT 50
+
 //OpenThreads::Mutex PointsNode::_textureCreationLock;
 //osg::ref_ptr<osg::Texture2D> PointsNode::_sphereTexture;
 
@@ -136,6 +146,56 @@ void main (void)                                                               \
     gl_FragColor = gl_Color * diffuse_value;                                   \n\
 }                                                                              \n";
 
+namespace
+{
+
+// every PointsNode uses the same shaders, so the programs are shared rather
+// than linked again for each node
+OpenThreads::Mutex programLock;
+osg::ref_ptr<osg::Program> pointsProgram;
+osg::ref_ptr<osg::Program> sphereProgram;
+
+osg::Program * getPointsProgram()
+{
+    programLock.lock();
+    if(!pointsProgram)
+    {
+        pointsProgram = new osg::Program();
+        pointsProgram->setName("Points");
+        pointsProgram->addShader(
+                new osg::Shader(osg::Shader::VERTEX,vertPointShaderSrc));
+        //pointsProgram->addShader(new osg::Shader(osg::Shader::FRAGMENT,fragPointShaderSrc));
+    }
+    osg::Program * program = pointsProgram.get();
+    programLock.unlock();
+    return program;
+}
+
+osg::Program * getSphereProgram()
+{
+    programLock.lock();
+    if(!sphereProgram)
+    {
+        sphereProgram = new osg::Program();
+        sphereProgram->setName("PointSphere");
+        sphereProgram->addShader(
+                new osg::Shader(osg::Shader::VERTEX,vertSphereShaderSrc));
+        sphereProgram->addShader(
+                new osg::Shader(osg::Shader::GEOMETRY,geomSphereShaderSrc));
+        sphereProgram->addShader(
+                new osg::Shader(osg::Shader::FRAGMENT,fragSphereShaderSrc));
+        sphereProgram->setParameter(GL_GEOMETRY_VERTICES_OUT_EXT,4);
+        sphereProgram->setParameter(GL_GEOMETRY_INPUT_TYPE_EXT,GL_POINTS);
+        sphereProgram->setParameter(GL_GEOMETRY_OUTPUT_TYPE_EXT,
+                GL_TRIANGLE_STRIP);
+    }
+    osg::Program * program = sphereProgram.get();
+    programLock.unlock();
+    return program;
+}
+
+}
+
 PointsNode::PointsNode(PointsMode mode, int startingNumPoints,
         float defaultPointSize, float defaultRadius, osg::Vec4ub defaultColor,
         PointsBinding sizeBinding, PointsBinding radiusBinding,
@@ -205,7 +265,7 @@ void PointsNode::setColor(osg::Vec4ub color)
             _colorArray->at(i) = color;
         }
     }
-    _colorArray->dirty();
+    markDirty(ATTRIB_COLOR,0,_colorArray->size());
     _pointColor = color;
 }
 
@@ -246,7 +306,7 @@ void PointsNode::setPointSize(float size)
         }
     }
     _point->setSize(size);
-    _sizeArray->dirty();
+    markDirty(ATTRIB_SIZE,0,_sizeArray->size());
     _pointSize = size;
 }
 
@@ -276,7 +336,7 @@ void PointsNode::setRadius(float radius)
             _radiusArray->at(i) = radius;
         }
     }
-    _radiusArray->dirty();
+    markDirty(ATTRIB_RADIUS,0,_radiusArray->size());
     _pointRadius = radius;
 }
 
@@ -286,19 +346,19 @@ void PointsNode::setPoint(int pointIndex, osg::Vec3 position, osg::Vec4ub color,
     if(pointIndex >= 0 && pointIndex < _vertArray->size())
     {
         _vertArray->at(pointIndex) = position;
-        _vertArray->dirty();
+        markDirty(ATTRIB_VERTEX,pointIndex,pointIndex + 1);
     }
 
     if(pointIndex >= 0 && pointIndex < _colorArray->size())
     {
         _colorArray->at(pointIndex) = color;
-        _colorArray->dirty();
+        markDirty(ATTRIB_COLOR,pointIndex,pointIndex + 1);
     }
 
     if(pointIndex >= 0 && pointIndex < _radiusArray->size())
     {
         _radiusArray->at(pointIndex) = radius;
-        _radiusArray->dirty();
+        markDirty(ATTRIB_RADIUS,pointIndex,pointIndex + 1);
     }
 
     if(pointIndex >= 0 && pointIndex < _sizeArray->size())
@@ -308,7 +368,7 @@ void PointsNode::setPoint(int pointIndex, osg::Vec3 position, osg::Vec4ub color,
         {
             _point->setSize(size);
         }
-        _sizeArray->dirty();
+        markDirty(ATTRIB_SIZE,pointIndex,pointIndex + 1);
     }
 }
 
@@ -328,7 +388,7 @@ void PointsNode::setPointPosition(int pointIndex, osg::Vec3 position)
     if(pointIndex >= 0 && pointIndex < _vertArray->size())
     {
         _vertArray->at(pointIndex) = position;
-        _vertArray->dirty();
+        markDirty(ATTRIB_VERTEX,pointIndex,pointIndex + 1);
     }
 }
 
@@ -337,7 +397,7 @@ void PointsNode::setPointColor(int pointIndex, osg::Vec4ub color)
     if(pointIndex >= 0 && pointIndex < _colorArray->size())
     {
         _colorArray->at(pointIndex) = color;
-        _colorArray->dirty();
+        markDirty(ATTRIB_COLOR,pointIndex,pointIndex + 1);
     }
 }
 
@@ -356,7 +416,7 @@ void PointsNode::setPointRadius(int pointIndex, float radius)
     if(pointIndex >= 0 && pointIndex < _radiusArray->size())
     {
         _radiusArray->at(pointIndex) = radius;
-        _radiusArray->dirty();
+        markDirty(ATTRIB_RADIUS,pointIndex,pointIndex + 1);
     }
 }
 
@@ -369,7 +429,7 @@ void PointsNode::setPointSize(int pointIndex, float size)
         {
             _point->setSize(size);
         }
-        _sizeArray->dirty();
+        markDirty(ATTRIB_SIZE,pointIndex,pointIndex + 1);
     }
 }
 
@@ -474,14 +534,14 @@ void PointsNode::addPoint(osg::Vec3 position)
     {
         _vertArray->at(index) = position;
     }
-    _vertArray->dirty();
+    markDirty(ATTRIB_VERTEX,index,index + 1);
 
     if(_colorBinding == POINTS_OVERALL)
     {
         if(!_colorArray->size())
         {
             _colorArray->push_back(_pointColor);
-            _colorArray->dirty();
+            markDirty(ATTRIB_COLOR,0,1);
         }
     }
     else
@@ -494,7 +554,7 @@ void PointsNode::addPoint(osg::Vec3 position)
         {
             _colorArray->at(index) = _pointColor;
         }
-        _colorArray->dirty();
+        markDirty(ATTRIB_COLOR,index,index + 1);
     }
 
     if(_radiusBinding == POINTS_OVERALL)
@@ -502,7 +562,7 @@ void PointsNode::addPoint(osg::Vec3 position)
         if(!_radiusArray->size())
         {
             _radiusArray->push_back(_pointRadius);
-            _radiusArray->dirty();
+            markDirty(ATTRIB_RADIUS,0,1);
         }
     }
     else
@@ -515,7 +575,7 @@ void PointsNode::addPoint(osg::Vec3 position)
         {
             _radiusArray->at(index) = _pointRadius;
         }
-        _radiusArray->dirty();
+        markDirty(ATTRIB_RADIUS,index,index + 1);
     }
 
     if(_sizeBinding == POINTS_OVERALL)
@@ -523,7 +583,7 @@ void PointsNode::addPoint(osg::Vec3 position)
         if(!_sizeArray->size())
         {
             _sizeArray->push_back(_pointSize);
-            _sizeArray->dirty();
+            markDirty(ATTRIB_SIZE,0,1);
         }
     }
     else
@@ -536,10 +596,17 @@ void PointsNode::addPoint(osg::Vec3 position)
         {
             _sizeArray->at(index) = _pointSize;
         }
-        _sizeArray->dirty();
+        markDirty(ATTRIB_SIZE,index,index + 1);
     }
 
-    calcSize();
+    if(_batchDepth)
+    {
+        _size = index + 1;
+    }
+    else
+    {
+        calcSize();
+    }
 }
 
 void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
@@ -555,14 +622,14 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
     {
         _vertArray->at(index) = position;
     }
-    _vertArray->dirty();
+    markDirty(ATTRIB_VERTEX,index,index + 1);
 
     if(_colorBinding == POINTS_OVERALL)
     {
         if(!_colorArray->size())
         {
             _colorArray->push_back(color);
-            _colorArray->dirty();
+            markDirty(ATTRIB_COLOR,0,1);
         }
     }
     else
@@ -575,7 +642,7 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
         {
             _colorArray->at(index) = color;
         }
-        _colorArray->dirty();
+        markDirty(ATTRIB_COLOR,index,index + 1);
     }
 
     if(_radiusBinding == POINTS_OVERALL)
@@ -590,14 +657,14 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
             {
                 _radiusArray->push_back(_pointRadius);
             }
-            _radiusArray->dirty();
+            markDirty(ATTRIB_RADIUS,0,1);
         }
         else if(!index)
         {
             if(radius > 0.0)
             {
                 _radiusArray->at(0) = radius;
-                _radiusArray->dirty();
+                markDirty(ATTRIB_RADIUS,0,1);
             }
         }
     }
@@ -625,7 +692,7 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
                 _radiusArray->at(index) = _pointRadius;
             }
         }
-        _radiusArray->dirty();
+        markDirty(ATTRIB_RADIUS,index,index + 1);
     }
 
     if(_sizeBinding == POINTS_OVERALL)
@@ -640,14 +707,14 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
             {
                 _sizeArray->push_back(_pointSize);
             }
-            _sizeArray->dirty();
+            markDirty(ATTRIB_SIZE,0,1);
         }
         else if(!index)
         {
             if(size > 0.0)
             {
                 _sizeArray->at(0) = size;
-                _sizeArray->dirty();
+                markDirty(ATTRIB_SIZE,0,1);
             }
         }
     }
@@ -675,10 +742,17 @@ void PointsNode::addPoint(osg::Vec3 position, osg::Vec4ub color, float radius,
                 _sizeArray->at(index) = _pointSize;
             }
         }
-        _sizeArray->dirty();
+        markDirty(ATTRIB_SIZE,index,index + 1);
     }
 
-    calcSize();
+    if(_batchDepth)
+    {
+        _size = index + 1;
+    }
+    else
+    {
+        calcSize();
+    }
 }
 
 void PointsNode::addPoint(osg::Vec3 position, osg::Vec4 color, float radius,
@@ -700,7 +774,7 @@ void PointsNode::removePoint(int pointIndex)
         osg::Vec3Array::iterator it = _vertArray->begin();
         it = it + pointIndex;
         _vertArray->erase(it);
-        _vertArray->dirty();
+        markDirty(ATTRIB_VERTEX,pointIndex,_vertArray->size());
     }
 
     if(_colorBinding != POINTS_OVERALL)
@@ -710,7 +784,7 @@ void PointsNode::removePoint(int pointIndex)
             osg::Vec4ubArray::iterator it = _colorArray->begin();
             it = it + pointIndex;
             _colorArray->erase(it);
-            _colorArray->dirty();
+            markDirty(ATTRIB_COLOR,pointIndex,_colorArray->size());
         }
     }
 
@@ -721,7 +795,7 @@ void PointsNode::removePoint(int pointIndex)
             osg::FloatArray::iterator it = _radiusArray->begin();
             it = it + pointIndex;
             _radiusArray->erase(it);
-            _radiusArray->dirty();
+            markDirty(ATTRIB_RADIUS,pointIndex,_radiusArray->size());
         }
     }
 
@@ -732,11 +806,21 @@ void PointsNode::removePoint(int pointIndex)
             osg::FloatArray::iterator it = _sizeArray->begin();
             it = it + pointIndex;
             _sizeArray->erase(it);
-            _sizeArray->dirty();
+            markDirty(ATTRIB_SIZE,pointIndex,_sizeArray->size());
         }
     }
 
-    calcSize();
+    if(_batchDepth)
+    {
+        if(pointIndex >= 0 && pointIndex < _size)
+        {
+            _size--;
+        }
+    }
+    else
+    {
+        calcSize();
+    }
 }
 
 void PointsNode::removePoints(int startPoint, int numPoints)
@@ -754,7 +838,7 @@ void PointsNode::removePoints(int startPoint, int numPoints)
         osg::Vec3Array::iterator ite = _vertArray->begin();
         ite = ite + (endPoint);
         _vertArray->erase(its,ite);
-        _vertArray->dirty();
+        markDirty(ATTRIB_VERTEX,startPoint,_vertArray->size());
     }
 
     if(_colorBinding != POINTS_OVERALL)
@@ -766,7 +850,7 @@ void PointsNode::removePoints(int startPoint, int numPoints)
             osg::Vec4ubArray::iterator ite = _colorArray->begin();
             ite = ite + (endPoint);
             _colorArray->erase(its,ite);
-            _colorArray->dirty();
+            markDirty(ATTRIB_COLOR,startPoint,_colorArray->size());
         }
     }
 
@@ -779,7 +863,7 @@ void PointsNode::removePoints(int startPoint, int numPoints)
             osg::FloatArray::iterator ite = _radiusArray->begin();
             ite = ite + (endPoint);
             _radiusArray->erase(its,ite);
-            _radiusArray->dirty();
+            markDirty(ATTRIB_RADIUS,startPoint,_radiusArray->size());
         }
     }
 
@@ -792,8 +876,112 @@ void PointsNode::removePoints(int startPoint, int numPoints)
             osg::FloatArray::iterator ite = _sizeArray->begin();
             ite = ite + (endPoint);
             _sizeArray->erase(its,ite);
-            _sizeArray->dirty();
+            markDirty(ATTRIB_SIZE,startPoint,_sizeArray->size());
+        }
+    }
+
+    if(_batchDepth)
+    {
+        if(startPoint >= 0)
+        {
+            _size -= endPoint - startPoint;
+        }
+    }
+    else
+    {
+        calcSize();
+    }
+}
+
+void PointsNode::swapRemovePoint(int pointIndex)
+{
+    if(pointIndex < 0 || pointIndex >= _size)
+    {
+        return;
+    }
+
+    int last = _size - 1;
+    if(pointIndex != last)
+    {
+        _vertArray->at(pointIndex) = _vertArray->at(last);
+        markDirty(ATTRIB_VERTEX,pointIndex,pointIndex + 1);
+
+        if(_colorBinding != POINTS_OVERALL)
+        {
+            _colorArray->at(pointIndex) = _colorArray->at(last);
+            markDirty(ATTRIB_COLOR,pointIndex,pointIndex + 1);
+        }
+
+        if(_radiusBinding != POINTS_OVERALL)
+        {
+            _radiusArray->at(pointIndex) = _radiusArray->at(last);
+            markDirty(ATTRIB_RADIUS,pointIndex,pointIndex + 1);
+        }
+
+        if(_sizeBinding != POINTS_OVERALL)
+        {
+            _sizeArray->at(pointIndex) = _sizeArray->at(last);
+            markDirty(ATTRIB_SIZE,pointIndex,pointIndex + 1);
+        }
+    }
+
+    // the buffers keep their size, only the drawn count shrinks
+    _vertArray->resize(last);
+    if(_colorBinding != POINTS_OVERALL)
+    {
+        _colorArray->resize(last);
+    }
+    if(_radiusBinding != POINTS_OVERALL)
+    {
+        _radiusArray->resize(last);
+    }
+    if(_sizeBinding != POINTS_OVERALL)
+    {
+        _sizeArray->resize(last);
+    }
+
+    if(_batchDepth)
+    {
+        _size = last;
+    }
+    else
+    {
+        calcSize();
+    }
+}
+
+void PointsNode::beginBatch()
+{
+    if(!_batchDepth)
+    {
+        for(int i = 0; i < ATTRIB_COUNT; i++)
+        {
+            _dirtyStart[i] = _dirtyEnd[i] = 0;
+        }
+    }
+    _batchDepth++;
+}
+
+void PointsNode::endBatch()
+{
+    if(!_batchDepth)
+    {
+        return;
+    }
+
+    _batchDepth--;
+    if(_batchDepth)
+    {
+        return;
+    }
+
+    for(int i = 0; i < ATTRIB_COUNT; i++)
+    {
+        if(_dirtyStart[i] < _dirtyEnd[i])
+        {
+            commitRange(i,_dirtyStart[i],_dirtyEnd[i]);
         }
+        _dirtyStart[i] = _dirtyEnd[i] = 0;
     }
 
     calcSize();
@@ -819,10 +1007,7 @@ void PointsNode::clear()
         _sizeArray->push_back(_pointSize);
     }
 
-    _vertArray->dirty();
-    _colorArray->dirty();
-    _radiusArray->dirty();
-    _sizeArray->dirty();
+    dirtyAll();
 
     calcSize();
 }
@@ -880,12 +1065,7 @@ void PointsNode::setPointsMode(PointsMode mode)
 
             if(!_programPoints)
             {
-                _programPoints = new osg::Program();
-                _programPoints->setName("Points");
-                _programPoints->addShader(
-                        new osg::Shader(osg::Shader::VERTEX,
-                                vertPointShaderSrc));
-                //_programPoints->addShader(new osg::Shader(osg::Shader::FRAGMENT,fragPointShaderSrc));
+                _programPoints = getPointsProgram();
             }
             getOrCreateStateSet()->setAttribute(_programPoints);
             getOrCreateStateSet()->setMode(GL_VERTEX_PROGRAM_POINT_SIZE,
@@ -909,22 +1089,7 @@ void PointsNode::setPointsMode(PointsMode mode)
 
             if(!_programSphere)
             {
-                _programSphere = new osg::Program();
-                _programSphere->setName("PointSphere");
-                _programSphere->addShader(
-                        new osg::Shader(osg::Shader::VERTEX,
-                                vertSphereShaderSrc));
-                _programSphere->addShader(
-                        new osg::Shader(osg::Shader::GEOMETRY,
-                                geomSphereShaderSrc));
-                _programSphere->addShader(
-                        new osg::Shader(osg::Shader::FRAGMENT,
-                                fragSphereShaderSrc));
-                _programSphere->setParameter(GL_GEOMETRY_VERTICES_OUT_EXT,4);
-                _programSphere->setParameter(GL_GEOMETRY_INPUT_TYPE_EXT,
-                        GL_POINTS);
-                _programSphere->setParameter(GL_GEOMETRY_OUTPUT_TYPE_EXT,
-                        GL_TRIANGLE_STRIP);
+                _programSphere = getSphereProgram();
             }
             getOrCreateStateSet()->setAttribute(_programSphere);
             break;
@@ -946,6 +1111,9 @@ void PointsNode::setPointsMode(PointsMode mode)
         default:
             break;
     }
+
+    // the attribute array bound to the shaders may have missed range uploads
+    dirtyAll();
     calcSize();
 }
 
@@ -955,6 +1123,13 @@ void PointsNode::init(PointsMode mode, int startingNumPoints,
         PointsBinding colorBinding)
 {
     _size = startingNumPoints;
+    _batchDepth = 0;
+    _uploadSerial = 0;
+    for(int i = 0; i < ATTRIB_COUNT; i++)
+    {
+        _dirtyStart[i] = _dirtyEnd[i] = 0;
+        _uploadedSize[i] = 0;
+    }
     _colorBinding = colorBinding;
     _sizeBinding = sizeBinding;
     _radiusBinding = radiusBinding;
@@ -973,6 +1148,9 @@ void PointsNode::init(PointsMode mode, int startingNumPoints,
     _geometry->setUseDisplayList(false);
     _geometry->setUseVertexBufferObjects(true);
 
+    _drawCallback = new PointsDrawCallback(this);
+    _geometry->setDrawCallback(_drawCallback);
+
     _vertArray = new osg::Vec3Array(_size);
     _geometry->setVertexArray(_vertArray);
 
@@ -1113,6 +1291,249 @@ void PointsNode::refreshGeometry()
     {
         _sizeArray->push_back(_pointSize);
     }
+
+    dirtyAll();
+}
+
+osg::Array * PointsNode::getAttributeArray(int attribute)
+{
+    switch(attribute)
+    {
+        case ATTRIB_VERTEX:
+            return _vertArray.get();
+        case ATTRIB_COLOR:
+            return _colorArray.get();
+        case ATTRIB_SIZE:
+            return _sizeArray.get();
+        case ATTRIB_RADIUS:
+            return _radiusArray.get();
+        default:
+            break;
+    }
+    return NULL;
+}
+
+void PointsNode::markDirty(int attribute, int start, int end)
+{
+    if(start >= end)
+    {
+        return;
+    }
+
+    if(_batchDepth)
+    {
+        if(_dirtyStart[attribute] >= _dirtyEnd[attribute])
+        {
+            _dirtyStart[attribute] = start;
+            _dirtyEnd[attribute] = end;
+        }
+        else
+        {
+            _dirtyStart[attribute] = std::min(_dirtyStart[attribute],start);
+            _dirtyEnd[attribute] = std::max(_dirtyEnd[attribute],end);
+        }
+        return;
+    }
+
+    commitRange(attribute,start,end);
+}
+
+void PointsNode::commitRange(int attribute, int start, int end)
+{
+    osg::Array * array = getAttributeArray(attribute);
+    end = std::min(end,(int)array->getNumElements());
+    if(start >= end)
+    {
+        return;
+    }
+
+    // a larger array needs a new buffer
+    if(!array->getBufferObject()
+            || array->getNumElements() > _uploadedSize[attribute])
+    {
+        array->dirty();
+        _uploadedSize[attribute] = array->getNumElements();
+        return;
+    }
+
+    _uploadLock.lock();
+
+    unsigned int minSerial = _uploadSerial;
+    unsigned int maxSerial = 0;
+    for(std::map<unsigned int,unsigned int>::iterator it =
+            _contextSerial.begin(); it != _contextSerial.end(); it++)
+    {
+        minSerial = std::min(minSerial,it->second);
+        maxSerial = std::max(maxSerial,it->second);
+    }
+
+    int applied = 0;
+    while(applied < _uploads.size() && _uploads[applied].serial <= minSerial)
+    {
+        applied++;
+    }
+    _uploads.erase(_uploads.begin(),_uploads.begin() + applied);
+
+    // merge with nearby ranges no context has uploaded yet, the points in
+    // between are current so sending them again is harmless
+    unsigned int elementSize = array->getElementSize();
+    int gap = std::max(1u,POINTS_MERGE_GAP_BYTES / elementSize);
+    int merged = -1;
+    for(int i = ((int)_uploads.size()) - 1;
+            i >= 0 && _uploads[i].serial > maxSerial; i--)
+    {
+        UploadRange & range = _uploads[i];
+        if(range.attribute != attribute || start > range.end + gap
+                || end + gap < range.start)
+        {
+            continue;
+        }
+
+        range.start = std::min(range.start,start);
+        range.end = std::max(range.end,end);
+        if(merged >= 0)
+        {
+            range.start = std::min(range.start,_uploads[merged].start);
+            range.end = std::max(range.end,_uploads[merged].end);
+            _uploads.erase(_uploads.begin() + merged);
+        }
+        start = range.start;
+        end = range.end;
+        merged = i;
+    }
+
+    if(merged < 0)
+    {
+        // a context that stopped drawing would keep the queue from draining
+        if(_uploads.size() >= POINTS_MAX_QUEUED_UPLOADS)
+        {
+            _uploadLock.unlock();
+            dirtyAll();
+            return;
+        }
+
+        UploadRange range;
+        range.serial = ++_uploadSerial;
+        range.attribute = attribute;
+        range.start = start;
+        range.end = end;
+        _uploads.push_back(range);
+    }
+
+    // once most of the array is queued, one full upload is cheaper than the
+    // separate ranges
+    unsigned int queued = 0;
+    for(int i = 0; i < _uploads.size(); i++)
+    {
+        if(_uploads[i].attribute == attribute)
+        {
+            queued += (_uploads[i].end - _uploads[i].start) * elementSize;
+        }
+    }
+
+    if(queued >= (array->getTotalDataSize() / 100)
+            * POINTS_FULL_UPLOAD_PERCENT)
+    {
+        // dirty buffers skip their queued ranges and are uploaded in full
+        array->dirty();
+        _uploadedSize[attribute] = array->getNumElements();
+        for(int i = ((int)_uploads.size()) - 1; i >= 0; i--)
+        {
+            if(_uploads[i].attribute == attribute)
+            {
+                _uploads.erase(_uploads.begin() + i);
+            }
+        }
+    }
+
+    _uploadLock.unlock();
+}
+
+void PointsNode::dirtyAll()
+{
+    for(int i = 0; i < ATTRIB_COUNT; i++)
+    {
+        osg::Array * array = getAttributeArray(i);
+        array->dirty();
+        _uploadedSize[i] = array->getNumElements();
+        _dirtyStart[i] = _dirtyEnd[i] = 0;
+    }
+
+    _uploadLock.lock();
+    _uploads.clear();
+    for(std::map<unsigned int,unsigned int>::iterator it =
+            _contextSerial.begin(); it != _contextSerial.end(); it++)
+    {
+        it->second = _uploadSerial;
+    }
+    _uploadLock.unlock();
+}
+
+void PointsNode::uploadRanges(osg::RenderInfo & renderInfo)
+{
+    unsigned int contextID = renderInfo.getContextID();
+
+    _uploadLock.lock();
+
+    // the first draw in a context uploads the whole arrays
+    std::map<unsigned int,unsigned int>::iterator it = _contextSerial.find(
+            contextID);
+    if(it == _contextSerial.end())
+    {
+        _contextSerial[contextID] = _uploadSerial;
+        _uploadLock.unlock();
+        return;
+    }
+
+    if(it->second == _uploadSerial)
+    {
+        _uploadLock.unlock();
+        return;
+    }
+
+#if ( OSG_VERSION_LESS_THAN(3, 4, 0) )
+    osg::GLBufferObject::Extensions * extensions =
+            osg::GLBufferObject::getExtensions(contextID,true);
+#else
+    osg::GLExtensions * extensions = osg::GLExtensions::Get(contextID,true);
+#endif
+
+    for(int i = 0; i < _uploads.size(); i++)
+    {
+        const UploadRange & range = _uploads[i];
+        if(range.serial <= it->second)
+        {
+            continue;
+        }
+
+        osg::Array * array = getAttributeArray(range.attribute);
+        osg::GLBufferObject * glbo = array->getOrCreateGLBufferObject(
+                contextID);
+
+        // dirty buffers are fully uploaded when drawn
+        if(!glbo || glbo->isDirty())
+        {
+            continue;
+        }
+
+        int end = std::min(range.end,(int)array->getNumElements());
+        if(range.start >= end)
+        {
+            continue;
+        }
+
+        unsigned int elementSize = array->getElementSize();
+        renderInfo.getState()->bindVertexBufferObject(glbo);
+        extensions->glBufferSubData(GL_ARRAY_BUFFER_ARB,
+                glbo->getOffset(array->getBufferIndex())
+                        + range.start * elementSize,
+                (end - range.start) * elementSize,
+                ((const char*)array->getDataPointer())
+                        + range.start * elementSize);
+    }
+    it->second = _uploadSerial;
+
+    _uploadLock.unlock();
 }
 
 /*void PointsNode::makeTexture()
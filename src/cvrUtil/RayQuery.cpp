@@ -0,0 +1,660 @@
+#include <cvrUtil/RayQuery.h>
+#include <cvrUtil/Bounds.h>
+#include <cvrKernel/NodeMask.h>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Transform>
+#include <osg/TriangleFunctor>
+#include <osg/NodeVisitor>
+
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace cvr;
+
+#define TRIANGLE_LEAF_SIZE 8
+#define EXPIRE_CHECK_QUERIES 1000
+
+namespace
+{
+
+struct TriangleCollector
+{
+        std::vector<osg::Vec3> * vertices;
+
+        void operator()(const osg::Vec3 & v1, const osg::Vec3 & v2,
+                const osg::Vec3 & v3)
+        {
+            vertices->push_back(v1);
+            vertices->push_back(v2);
+            vertices->push_back(v3);
+        }
+
+        // older osg versions pass a temporary data flag
+        void operator()(const osg::Vec3 & v1, const osg::Vec3 & v2,
+                const osg::Vec3 & v3, bool)
+        {
+            operator()(v1,v2,v3);
+        }
+};
+
+struct TriangleCenterCompare
+{
+        TriangleCenterCompare(const std::vector<osg::Vec3> & c, int a) :
+                centers(c), axis(a)
+        {
+        }
+
+        bool operator()(int a, int b) const
+        {
+            return centers[a][axis] < centers[b][axis];
+        }
+
+        const std::vector<osg::Vec3> & centers;
+        int axis;
+};
+
+bool segmentHitsSphere(const osg::BoundingSphere & bs, const osg::Vec3 & start,
+        const osg::Vec3 & dir, float maxRatio)
+{
+    if(!bs.valid())
+    {
+        return false;
+    }
+
+    float len2 = dir.length2();
+    float t = 0.0;
+    if(len2 > 0.0)
+    {
+        t = ((bs.center() - start) * dir) / len2;
+        t = std::max(0.0f,std::min(t,maxRatio));
+    }
+
+    return (start + dir * t - bs.center()).length2()
+            <= bs.radius() * bs.radius();
+}
+
+// returns the ratio where the segment enters the box, or -1 for a miss
+float segmentEntersBox(const osg::BoundingBox & bb, const osg::Vec3 & start,
+        const osg::Vec3 & dir, float maxRatio)
+{
+    if(!bb.valid())
+    {
+        return -1.0;
+    }
+
+    float tmin = 0.0;
+    float tmax = maxRatio;
+    for(int i = 0; i < 3; i++)
+    {
+        if(dir[i] == 0.0)
+        {
+            if(start[i] < bb._min[i] || start[i] > bb._max[i])
+            {
+                return -1.0;
+            }
+            continue;
+        }
+
+        float t1 = (bb._min[i] - start[i]) / dir[i];
+        float t2 = (bb._max[i] - start[i]) / dir[i];
+        if(t1 > t2)
+        {
+            std::swap(t1,t2);
+        }
+        tmin = std::max(tmin,t1);
+        tmax = std::min(tmax,t2);
+        if(tmin > tmax)
+        {
+            return -1.0;
+        }
+    }
+
+    return tmin;
+}
+
+// Moller-Trumbore, returns the hit ratio along the segment or -1
+float segmentHitsTriangle(const osg::Vec3 & start, const osg::Vec3 & dir,
+        const osg::Vec3 & v0, const osg::Vec3 & v1, const osg::Vec3 & v2,
+        float maxRatio)
+{
+    osg::Vec3 e1 = v1 - v0;
+    osg::Vec3 e2 = v2 - v0;
+    osg::Vec3 p = dir ^ e2;
+    float det = e1 * p;
+    if(fabs(det) < 1e-12)
+    {
+        return -1.0;
+    }
+
+    float invDet = 1.0 / det;
+    osg::Vec3 s = start - v0;
+    float u = (s * p) * invDet;
+    if(u < 0.0 || u > 1.0)
+    {
+        return -1.0;
+    }
+
+    osg::Vec3 q = s ^ e1;
+    float v = (dir * q) * invDet;
+    if(v < 0.0 || u + v > 1.0)
+    {
+        return -1.0;
+    }
+
+    float t = (e2 * q) * invDet;
+    if(t < 0.0 || t > maxRatio)
+    {
+        return -1.0;
+    }
+    return t;
+}
+
+/**
+ * Fill version with what identifies the geometry's triangles.  Arrays and
+ * primitive sets can be swapped or resized (DrawArrays::setCount) without a
+ * modified count changing, so their pointers and sizes are included.
+ * Returns false if the drawable can not tell when its data changes.
+ */
+bool getDrawableVersion(osg::Drawable * drawable, std::vector<size_t> & version)
+{
+    version.clear();
+    osg::Geometry * geometry = drawable->asGeometry();
+    if(!geometry || !geometry->getVertexArray())
+    {
+        return false;
+    }
+
+    osg::Array * vertices = geometry->getVertexArray();
+    version.push_back((size_t)vertices);
+    version.push_back(vertices->getModifiedCount());
+    version.push_back(vertices->getNumElements());
+    for(int i = 0; i < geometry->getNumPrimitiveSets(); i++)
+    {
+        osg::PrimitiveSet * primitives = geometry->getPrimitiveSet(i);
+        version.push_back((size_t)primitives);
+        version.push_back(primitives->getModifiedCount());
+        version.push_back(primitives->getMode());
+        version.push_back(primitives->getNumIndices());
+        // DrawArrays only has a start index
+        version.push_back(primitives->getNumIndices() ? primitives->index(0)
+                : 0);
+    }
+    return true;
+}
+
+}
+
+/**
+ * @brief Walks the graph with a group of segments, testing bounds to skip
+ * subgraphs no segment reaches
+ */
+class RayQuery::QueryVisitor : public osg::NodeVisitor
+{
+    public:
+        QueryVisitor(RayQuery * query, const osg::Vec3 * starts,
+                const osg::Vec3 * ends, int numSegments, bool nearestOnly,
+                std::vector<IsectInfo> * hits) :
+                osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN)
+        {
+            setTraversalMask(query->_traversalMask);
+            _query = query;
+            _nearestOnly = nearestOnly;
+            _hits = hits;
+            _numSegments = numSegments;
+            _mask = 0;
+            for(int i = 0; i < numSegments; i++)
+            {
+                _worldStarts.push_back(starts[i]);
+                _worldDirs.push_back(ends[i] - starts[i]);
+                _mask |= (1u << i);
+            }
+            _starts = _worldStarts;
+            _dirs = _worldDirs;
+            _maxRatio.resize(numSegments,1.0);
+            _ratios.resize(numSegments);
+        }
+
+        virtual void apply(osg::Node & node)
+        {
+            unsigned int mask = _mask;
+            if(testBound(node))
+            {
+                traverse(node);
+            }
+            _mask = mask;
+        }
+
+        virtual void apply(osg::Transform & transform)
+        {
+            unsigned int mask = _mask;
+            if(!testBound(transform))
+            {
+                _mask = mask;
+                return;
+            }
+
+            osg::Matrix localToWorld = _localToWorld;
+            osg::Matrix worldToLocal = _worldToLocal;
+            std::vector<osg::Vec3> starts = _starts;
+            std::vector<osg::Vec3> dirs = _dirs;
+
+            transform.computeLocalToWorldMatrix(_localToWorld,this);
+            _worldToLocal.invert(_localToWorld);
+            for(int i = 0; i < _numSegments; i++)
+            {
+                _starts[i] = _worldStarts[i] * _worldToLocal;
+                _dirs[i] = (_worldStarts[i] + _worldDirs[i]) * _worldToLocal
+                        - _starts[i];
+            }
+
+            traverse(transform);
+
+            _localToWorld = localToWorld;
+            _worldToLocal = worldToLocal;
+            _starts = starts;
+            _dirs = dirs;
+            _mask = mask;
+        }
+
+        virtual void apply(osg::Geode & geode)
+        {
+            unsigned int mask = _mask;
+            if(!testBound(geode))
+            {
+                _mask = mask;
+                return;
+            }
+
+            for(int i = 0; i < geode.getNumDrawables(); i++)
+            {
+                osg::Drawable * drawable = geode.getDrawable(i);
+                osg::BoundingBox bb = getBound(drawable);
+
+                unsigned int drawableMask = 0;
+                for(int j = 0; j < _numSegments; j++)
+                {
+                    if((_mask & (1u << j))
+                            && segmentEntersBox(bb,_starts[j],_dirs[j],
+                                    _maxRatio[j]) >= 0.0)
+                    {
+                        drawableMask |= (1u << j);
+                    }
+                }
+
+                if(!drawableMask)
+                {
+                    continue;
+                }
+
+                TriangleTree * tree = _query->getTriangleTree(drawable,
+                        &_scratchTree);
+                if(!tree || !tree->nodes.size())
+                {
+                    continue;
+                }
+
+                for(int j = 0; j < _numSegments; j++)
+                {
+                    if(drawableMask & (1u << j))
+                    {
+                        intersectTree(tree,0,j,&geode);
+                    }
+                }
+            }
+            _mask = mask;
+        }
+
+        /**
+         * @brief Sort each segment's hits nearest first
+         */
+        void finish()
+        {
+            for(int i = 0; i < _numSegments; i++)
+            {
+                std::vector<std::pair<float,int> > order;
+                for(int j = 0; j < _ratios[i].size(); j++)
+                {
+                    order.push_back(std::pair<float,int>(_ratios[i][j],j));
+                }
+                std::sort(order.begin(),order.end());
+
+                std::vector<IsectInfo> sorted;
+                sorted.reserve(order.size());
+                for(int j = 0; j < order.size(); j++)
+                {
+                    sorted.push_back(_hits[i][order[j].second]);
+                }
+                _hits[i].swap(sorted);
+            }
+        }
+
+    protected:
+        bool testBound(osg::Node & node)
+        {
+            const osg::BoundingSphere & bs = node.getBound();
+            unsigned int mask = 0;
+            for(int i = 0; i < _numSegments; i++)
+            {
+                if((_mask & (1u << i))
+                        && segmentHitsSphere(bs,_starts[i],_dirs[i],
+                                _maxRatio[i]))
+                {
+                    mask |= (1u << i);
+                }
+            }
+            _mask = mask;
+            return mask != 0;
+        }
+
+        void intersectTree(TriangleTree * tree, int nodeIndex, int seg,
+                osg::Geode * geode)
+        {
+            const TriangleTree::Node & node = tree->nodes[nodeIndex];
+            if(node.left >= 0)
+            {
+                const osg::Vec3 & start = _starts[seg];
+                const osg::Vec3 & dir = _dirs[seg];
+                float tl = segmentEntersBox(tree->nodes[node.left].bound,start,
+                        dir,_maxRatio[seg]);
+                float tr = segmentEntersBox(tree->nodes[node.right].bound,
+                        start,dir,_maxRatio[seg]);
+
+                // nearer child first, so a nearest only query can cut off
+                // the other
+                int first = node.left, second = node.right;
+                if(tr >= 0.0 && (tl < 0.0 || tr < tl))
+                {
+                    std::swap(first,second);
+                    std::swap(tl,tr);
+                }
+
+                if(tl >= 0.0)
+                {
+                    intersectTree(tree,first,seg,geode);
+                }
+                if(tr >= 0.0 && tr <= _maxRatio[seg])
+                {
+                    intersectTree(tree,second,seg,geode);
+                }
+                return;
+            }
+
+            for(int i = node.first; i < node.first + node.count; i++)
+            {
+                const osg::Vec3 & v0 = tree->vertices[3 * i];
+                const osg::Vec3 & v1 = tree->vertices[3 * i + 1];
+                const osg::Vec3 & v2 = tree->vertices[3 * i + 2];
+                float t = segmentHitsTriangle(_starts[seg],_dirs[seg],v0,v1,v2,
+                        _maxRatio[seg]);
+                if(t < 0.0)
+                {
+                    continue;
+                }
+
+                IsectInfo isect;
+                isect.found = true;
+                isect.point = _worldStarts[seg] + _worldDirs[seg] * t;
+                // normals take the inverse transpose of local to world
+                isect.normal = osg::Matrix::transform3x3(_worldToLocal,
+                        (v1 - v0) ^ (v2 - v0));
+                isect.normal.normalize();
+                isect.geode = geode;
+
+                if(_nearestOnly)
+                {
+                    _hits[seg].clear();
+                    _ratios[seg].clear();
+                    _maxRatio[seg] = t;
+                }
+                _hits[seg].push_back(isect);
+                _ratios[seg].push_back(t);
+            }
+        }
+
+        RayQuery * _query;
+        bool _nearestOnly;
+        std::vector<IsectInfo> * _hits;
+        int _numSegments;
+        unsigned int _mask; ///< segments that reach the current node
+
+        std::vector<osg::Vec3> _worldStarts;
+        std::vector<osg::Vec3> _worldDirs;
+        std::vector<osg::Vec3> _starts; ///< segment starts in local space
+        std::vector<osg::Vec3> _dirs; ///< segment directions in local space
+        std::vector<float> _maxRatio; ///< farthest ratio still of interest
+        std::vector<std::vector<float> > _ratios; ///< ratio of each hit
+
+        osg::Matrix _localToWorld;
+        osg::Matrix _worldToLocal;
+
+        TriangleTree _scratchTree; ///< tree for a drawable that is not cached
+};
+
+RayQuery * RayQuery::_myPtr = NULL;
+
+RayQuery::RayQuery()
+{
+    _traversalMask = INTERSECT_MASK;
+    _queries = 0;
+}
+
+RayQuery::~RayQuery()
+{
+    clearCache();
+}
+
+RayQuery * RayQuery::instance()
+{
+    if(!_myPtr)
+    {
+        _myPtr = new RayQuery();
+    }
+    return _myPtr;
+}
+
+bool RayQuery::intersect(osg::Node * root, const osg::Vec3 & start,
+        const osg::Vec3 & end, std::vector<IsectInfo> & hits,
+        bool nearestOnly)
+{
+    hits.clear();
+    if(!root)
+    {
+        return false;
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lock);
+
+    QueryVisitor qv(this,&start,&end,1,nearestOnly,&hits);
+    root->accept(qv);
+    qv.finish();
+
+    removeExpired();
+
+    return hits.size() > 0;
+}
+
+void RayQuery::intersect(osg::Node * root, const std::vector<osg::Vec3> & starts,
+        const std::vector<osg::Vec3> & ends,
+        std::vector<std::vector<IsectInfo> > & hits, bool nearestOnly)
+{
+    hits.clear();
+    hits.resize(starts.size());
+    if(!root)
+    {
+        return;
+    }
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lock);
+
+    // segment masks hold 32 segments
+    for(int base = 0; base < starts.size(); base += 32)
+    {
+        int num = std::min((int)starts.size() - base,32);
+        QueryVisitor qv(this,&starts[base],&ends[base],num,nearestOnly,
+                &hits[base]);
+        root->accept(qv);
+        qv.finish();
+    }
+
+    removeExpired();
+}
+
+void RayQuery::clearCache()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_lock);
+    for(std::map<const osg::Drawable*,TriangleTree*>::iterator it =
+            _cache.begin(); it != _cache.end(); it++)
+    {
+        delete it->second;
+    }
+    _cache.clear();
+}
+
+RayQuery::TriangleTree * RayQuery::getTriangleTree(osg::Drawable * drawable,
+        TriangleTree * scratch)
+{
+    std::vector<size_t> version;
+    bool cachable = getDrawableVersion(drawable,version);
+
+    std::map<const osg::Drawable*,TriangleTree*>::iterator it = _cache.find(
+            drawable);
+    if(it != _cache.end())
+    {
+        // the pointer may belong to a new drawable at the same address
+        if(it->second->drawable.get() == drawable && cachable
+                && it->second->version == version)
+        {
+            return it->second;
+        }
+        delete it->second;
+        _cache.erase(it);
+    }
+
+    // only geometry can tell when its data changes, anything else is
+    // rebuilt each query
+    TriangleTree * tree = cachable ? new TriangleTree : scratch;
+    tree->drawable = drawable;
+    tree->version = version;
+    tree->vertices.clear();
+
+    osg::TriangleFunctor<TriangleCollector> tf;
+    tf.vertices = &tree->vertices;
+    drawable->accept(tf);
+    buildTriangleTree(tree);
+
+    if(cachable)
+    {
+        _cache[drawable] = tree;
+    }
+    return tree;
+}
+
+void RayQuery::buildTriangleTree(TriangleTree * tree)
+{
+    tree->nodes.clear();
+    int numTriangles = tree->vertices.size() / 3;
+    if(!numTriangles)
+    {
+        return;
+    }
+
+    tree->nodes.reserve(2 * (numTriangles / TRIANGLE_LEAF_SIZE + 1));
+    buildTriangleNode(tree,0,numTriangles);
+}
+
+int RayQuery::buildTriangleNode(TriangleTree * tree, int first, int count)
+{
+    int index = tree->nodes.size();
+    tree->nodes.push_back(TriangleTree::Node());
+    tree->nodes[index].left = -1;
+    tree->nodes[index].right = -1;
+    tree->nodes[index].first = first;
+    tree->nodes[index].count = count;
+
+    osg::BoundingBox bound;
+    osg::BoundingBox centerBound;
+    std::vector<osg::Vec3> centers(count);
+    for(int i = 0; i < count; i++)
+    {
+        const osg::Vec3 * v = &tree->vertices[3 * (first + i)];
+        bound.expandBy(v[0]);
+        bound.expandBy(v[1]);
+        bound.expandBy(v[2]);
+        centers[i] = (v[0] + v[1] + v[2]) / 3.0;
+        centerBound.expandBy(centers[i]);
+    }
+    tree->nodes[index].bound = bound;
+
+    if(count <= TRIANGLE_LEAF_SIZE)
+    {
+        return index;
+    }
+
+    osg::Vec3 extent = centerBound._max - centerBound._min;
+    int axis = 0;
+    if(extent.y() > extent[axis])
+    {
+        axis = 1;
+    }
+    if(extent.z() > extent[axis])
+    {
+        axis = 2;
+    }
+
+    // median split, triangles are reordered in place so leaves are
+    // contiguous
+    std::vector<int> order(count);
+    for(int i = 0; i < count; i++)
+    {
+        order[i] = i;
+    }
+    int half = count / 2;
+    std::nth_element(order.begin(),order.begin() + half,order.end(),
+            TriangleCenterCompare(centers,axis));
+
+    std::vector<osg::Vec3> sorted(3 * count);
+    for(int i = 0; i < count; i++)
+    {
+        for(int j = 0; j < 3; j++)
+        {
+            sorted[3 * i + j] = tree->vertices[3 * (first + order[i]) + j];
+        }
+    }
+    std::copy(sorted.begin(),sorted.end(),tree->vertices.begin() + 3 * first);
+
+    int left = buildTriangleNode(tree,first,half);
+    int right = buildTriangleNode(tree,first + half,count - half);
+    tree->nodes[index].left = left;
+    tree->nodes[index].right = right;
+    tree->nodes[index].count = 0;
+
+    return index;
+}
+
+void RayQuery::removeExpired()
+{
+    _queries++;
+    if(_queries < EXPIRE_CHECK_QUERIES)
+    {
+        return;
+    }
+    _queries = 0;
+
+    for(std::map<const osg::Drawable*,TriangleTree*>::iterator it =
+            _cache.begin(); it != _cache.end();)
+    {
+        if(!it->second->drawable.valid())
+        {
+            delete it->second;
+            _cache.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}